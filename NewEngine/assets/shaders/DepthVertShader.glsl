@@ -1,9 +1,9 @@
 #version 330 core
 
-in vec4 vPosition;
+layout (location = 0) in vec4 vPosition;
 //in vec4 vNormal;
 //in vec4 vUVx2;
-in vec4 oOffset;
+layout (location = 3) in vec4 oOffset;
 
 uniform mat4 lightSpaceMatrix;
 uniform vec3 modelPosition;
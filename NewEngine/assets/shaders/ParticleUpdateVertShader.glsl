@@ -0,0 +1,75 @@
+#version 330 core
+
+// One vertex per particle slot, written back through transform feedback. Nothing is rasterized
+
+layout (location = 0) in vec4 vPositionTimer; // w < 0 for a dead slot
+layout (location = 1) in vec4 vVelocity;
+
+uniform float deltaTime;
+uniform float lifeTime;
+uniform vec3 gravity;
+
+// Slots spawnSlot to spawnSlot + spawnsNum (wrapping) get a new particle this update
+uniform int spawnSlot;
+uniform int spawnsNum;
+uniform int spawnSerial; // spawns made before this update, every spawn gets its own random numbers
+uniform int particlesMax;
+uniform int seed;
+
+uniform vec3 positionMin;
+uniform vec3 positionMax;
+uniform vec3 speedMin;
+uniform vec3 speedMax;
+
+out vec4 outPositionTimer;
+out vec4 outVelocity;
+
+uint Hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float Random(inout uint state)
+{
+	state = Hash(state);
+	return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+void main()
+{
+	vec3 position = vPositionTimer.xyz;
+	float timer = vPositionTimer.w;
+	vec3 velocity = vVelocity.xyz;
+
+	int spawnIndex = (gl_VertexID - spawnSlot + particlesMax) % particlesMax;
+	if (spawnIndex < spawnsNum)
+	{
+		uint state = Hash(uint(seed) ^ Hash(uint(spawnSerial + spawnIndex)));
+		position = mix(positionMin, positionMax, vec3(Random(state), Random(state), Random(state)));
+		velocity = mix(speedMin, speedMax, vec3(Random(state), Random(state), Random(state)));
+		timer = 0.0;
+	}
+
+	if (timer >= 0.0)
+	{
+		timer += deltaTime;
+
+		if (timer > lifeTime)
+		{
+			timer = -1.0;
+		}
+		else
+		{
+			position += velocity * deltaTime;
+			velocity += gravity * deltaTime;
+		}
+	}
+
+	outPositionTimer = vec4(position, timer);
+	outVelocity = vec4(velocity, 0.0);
+}
@@ -30,6 +30,13 @@ float noise (in vec2 st);
 
 void main()
 {
+	// Dead slot of a GPU simulated spawner, put outside the clip volume
+	if (oOffset.w < 0.0)
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
 	vec3 finalModelPosition = modelPosition;
 	finalModelPosition += oOffset.xyz;
 
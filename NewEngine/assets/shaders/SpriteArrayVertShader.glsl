@@ -0,0 +1,59 @@
+#version 330 core
+
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec4 vNormal;
+layout (location = 2) in vec4 vUVx2;
+
+// Per sprite
+layout (location = 3) in vec4 iPosition;		// w = rotation around y
+layout (location = 4) in vec4 iScale;			// negative z when flipped
+layout (location = 5) in vec4 iSheetExtent;		// xy = part of the layer the sheet covers
+layout (location = 6) in ivec4 iSprite;			// x = sprite id, y = layer, z = columns, w = rows
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+	mat4 lightSpace;
+	int isShadowPass;
+};
+
+out vec3 fUVLayer;
+flat out vec2 fSheetExtent;
+out vec3 fNormal;
+out vec4 fVertPosLightSpace;
+out vec4 fVertWorldPosition;
+
+void main()
+{
+	float c = cos(iPosition.w);
+	float s = sin(iPosition.w);
+	mat3 rotation = mat3(c, 0.0, -s,
+						 0.0, 1.0, 0.0,
+						 s, 0.0, c);
+
+	fVertWorldPosition = vec4(rotation * (vPosition.xyz * iScale.xyz) + iPosition.xyz, 1.0);
+
+	if(isShadowPass == 1)
+	{
+		gl_Position = lightSpace * fVertWorldPosition;
+	}
+	else
+	{
+		gl_Position = projection * view * fVertWorldPosition;
+	}
+
+	int spriteId = iSprite.x;
+	int numCols = iSprite.z;
+	int numRows = iSprite.w;
+
+	// Same frame as SpriteVertShader, without relying on the texture repeating
+	vec2 sheetUV = vec2((vUVx2.x + float(spriteId % numCols)) / float(numCols),
+						(vUVx2.y + float(spriteId / numCols)) / float(numRows));
+
+	fUVLayer = vec3(sheetUV * iSheetExtent.xy, float(iSprite.y));
+	fSheetExtent = iSheetExtent.xy;
+
+	fNormal = rotation * (vNormal.xyz / iScale.xyz);
+	fVertPosLightSpace = lightSpace * fVertWorldPosition;
+}
\ No newline at end of file
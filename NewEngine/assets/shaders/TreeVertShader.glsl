@@ -3,7 +3,7 @@
 layout (location = 0) in vec4 vPosition;
 layout (location = 1) in vec4 vNormal;
 layout (location = 2) in vec4 vUVx2;
-layout (location = 3) in vec4 oOffset;
+layout (location = 3) in vec4 oOffset; // w is the height of the mesh's origin, not 0 when a tile batch baked the model in
 
 layout (std140) uniform Matrices
 {
@@ -13,11 +13,19 @@ layout (std140) uniform Matrices
 	int isShadowPass;
 };
 
-uniform vec3 modelPosition;
-uniform mat4 modelOrientationX;
-uniform mat4 modelOrientationY;
-uniform mat4 modelOrientationZ;
-uniform mat4 modelScale;
+struct sObjectData
+{
+	mat4 model;
+	mat4 normal;
+};
+
+// Per object transforms, uploaded once per frame
+layout (std140) uniform Objects
+{
+	sObjectData objects[128];
+};
+
+uniform int objectIndex;
 
 uniform float timer;
 uniform float windSpeed;
@@ -32,26 +40,9 @@ float noise (in vec2 st);
 
 void main()
 {
-	vec4 finalModelPosition = vec4(modelPosition, 1.0);
-	finalModelPosition += oOffset;
-
-	mat4 translateMatrix;
-	translateMatrix[0] = vec4(1,0,0,0);
-	translateMatrix[1] = vec4(0,1,0,0);
-	translateMatrix[2] = vec4(0,0,1,0);
-	translateMatrix[3] = vec4(finalModelPosition.x,finalModelPosition.y,finalModelPosition.z,1);
-
-	mat4 model;
-	model[0] = vec4(1,0,0,0);
-	model[1] = vec4(0,1,0,0);
-	model[2] = vec4(0,0,1,0);
-	model[3] = vec4(0,0,0,1);
-
-	model = model * translateMatrix;
-	model = model * modelOrientationZ;
-	model = model * modelOrientationY;
-	model = model * modelOrientationX;
-	model = model * modelScale;
+	mat4 model = objects[objectIndex].model;
+	model[3].xyz += oOffset.xyz;
+	vec4 finalModelPosition = model[3];
 
 	// How zoomed into noise (resolution)
 	// Use xz coords to sample noise
@@ -69,7 +60,7 @@ void main()
 
 	// Im going to assume all the vertices that will be moved to be between a specific y level
 	vec4 newVertPos = vPosition;
-	if (newVertPos.y > 0.1)
+	if (newVertPos.y - oOffset.w > 0.1)
 	{
 		float shakeMultiplier = .75f;
 		newVertPos.x += (f - 0.5f) * shakeMultiplier;
@@ -90,7 +81,7 @@ void main()
 	fVertWorldPosition = model * newVertPos;
 	fUVx2 = vUVx2;
 
-	fNormal = mat3(transpose(inverse(model))) * vNormal.xyz;
+	fNormal = mat3(objects[objectIndex].normal) * vNormal.xyz;
 	fVertPosLightSpace = lightSpace * fVertWorldPosition;
 }
 
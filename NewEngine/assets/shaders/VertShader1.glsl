@@ -1,9 +1,9 @@
 #version 330 core
 
-in vec4 vPosition;
-in vec4 vNormal;
-in vec4 vUVx2;
-in vec4 oOffset;
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec4 vNormal;
+layout (location = 2) in vec4 vUVx2;
+layout (location = 3) in vec4 oOffset;
 
 layout (std140) uniform Matrices
 {
@@ -13,11 +13,19 @@ layout (std140) uniform Matrices
 	int isShadowPass;
 };
 
-uniform vec3 modelPosition;
-uniform mat4 modelOrientationX;
-uniform mat4 modelOrientationY;
-uniform mat4 modelOrientationZ;
-uniform mat4 modelScale;
+struct sObjectData
+{
+	mat4 model;
+	mat4 normal;
+};
+
+// Per object transforms, uploaded once per frame
+layout (std140) uniform Objects
+{
+	sObjectData objects[128];
+};
+
+uniform int objectIndex;
 
 out vec4 fUVx2;
 out vec3 fNormal;
@@ -26,26 +34,8 @@ out vec4 fVertWorldPosition;
 
 void main()
 {
-	vec4 finalModelPosition = vec4(modelPosition, 1.0);
-	finalModelPosition.xyz += oOffset.xyz;
-
-	mat4 translateMatrix;
-	translateMatrix[0] = vec4(1,0,0,0);
-	translateMatrix[1] = vec4(0,1,0,0);
-	translateMatrix[2] = vec4(0,0,1,0);
-	translateMatrix[3] = vec4(finalModelPosition.x,finalModelPosition.y,finalModelPosition.z,1);
-
-	mat4 model;
-	model[0] = vec4(1,0,0,0);
-	model[1] = vec4(0,1,0,0);
-	model[2] = vec4(0,0,1,0);
-	model[3] = vec4(0,0,0,1);
-
-	model = model * translateMatrix;
-	model = model * modelOrientationZ;
-	model = model * modelOrientationY;
-	model = model * modelOrientationX;
-	model = model * modelScale;
+	mat4 model = objects[objectIndex].model;
+	model[3].xyz += oOffset.xyz;
 
 	mat4 MVP = projection * view * model;
 
@@ -61,6 +51,6 @@ void main()
 	fVertWorldPosition = model * vPosition;
 	fUVx2 = vUVx2;
 
-	fNormal = mat3(transpose(inverse(model))) * vNormal.xyz;
+	fNormal = mat3(objects[objectIndex].normal) * vNormal.xyz;
 	fVertPosLightSpace = lightSpace * fVertWorldPosition;
 }
\ No newline at end of file
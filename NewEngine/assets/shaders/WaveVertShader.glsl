@@ -13,11 +13,19 @@ layout (std140) uniform Matrices
 	int isShadowPass;
 };
 
-uniform vec3 modelPosition;
-uniform mat4 modelOrientationX;
-uniform mat4 modelOrientationY;
-uniform mat4 modelOrientationZ;
-uniform mat4 modelScale;
+struct sObjectData
+{
+	mat4 model;
+	mat4 normal;
+};
+
+// Per object transforms, uploaded once per frame
+layout (std140) uniform Objects
+{
+	sObjectData objects[128];
+};
+
+uniform int objectIndex;
 //uniform mat4 lightSpaceMatrix;
 
 //uniform bool isShadowPass;
@@ -31,28 +39,8 @@ out vec4 fVertWorldPosition;
 
 void main()
 {
-	vec4 finalModelPosition = vec4(modelPosition, 1.0);
-	finalModelPosition.x += oOffset.x;
-	finalModelPosition.y += oOffset.y;
-	finalModelPosition.z += oOffset.z;
-
-	mat4 translateMatrix;
-	translateMatrix[0] = vec4(1,0,0,0);
-	translateMatrix[1] = vec4(0,1,0,0);
-	translateMatrix[2] = vec4(0,0,1,0);
-	translateMatrix[3] = vec4(finalModelPosition.x,finalModelPosition.y,finalModelPosition.z,1);
-
-	mat4 model;
-	model[0] = vec4(1,0,0,0);
-	model[1] = vec4(0,1,0,0);
-	model[2] = vec4(0,0,1,0);
-	model[3] = vec4(0,0,0,1);
-
-	model = model * translateMatrix;
-	model = model * modelOrientationZ;
-	model = model * modelOrientationY;
-	model = model * modelOrientationX;
-	model = model * modelScale;
+	mat4 model = objects[objectIndex].model;
+	model[3].xyz += oOffset.xyz;
 
 	mat4 MVP = projection * view * model;
 	fUVx2 = vUVx2;
@@ -71,6 +59,6 @@ void main()
 	fUVx2.x += UVoffset.x;
 	fUVx2.y += UVoffset.y;
 
-	fNormal = mat3(transpose(inverse(model))) * vNormal.xyz;
+	fNormal = mat3(objects[objectIndex].normal) * vNormal.xyz;
 	fVertPosLightSpace = lightSpace * fVertWorldPosition;
 }
\ No newline at end of file
@@ -0,0 +1,1023 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#include "Engine.h"
+#include "cRenderManager.h"
+#include "cMeshCooker.h"
+#include "cMapFile.h"
+#include "cMapManager.h"
+#include "cMappedFile.h"
+#include "cJobSystem.h"
+#include "cParticleSpawner.h"
+#include "ParticleKernels.h"
+#include "cLinearCongruentialGenerator.h"
+#include "cXoshiroGenerator.h"
+#include "cAnimationManager.h"
+
+// Replacing the global operator new costs every allocation on every thread, so only the Debug configurations define this
+#ifdef BENCHMARK_ALLOCATIONS
+static std::atomic<unsigned long long> allocationCount(0);
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* ptr = malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr) throw std::bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+#endif
+
+namespace Benchmark
+{
+	std::vector<sResult> results;
+
+	unsigned int allocationFramesTotal = 0;
+	unsigned int allocationFramesLeft = 0;
+	unsigned long long allocationsTracked = 0;
+
+	const unsigned int SHADOW_WARMUP_FRAMES = 8;
+	unsigned int shadowFramesTotal = 0;
+	unsigned int shadowFramesLeft = 0;
+	bool shadowWasCacheOn = false;
+	double shadowCpuMsTracked = 0.0;
+	double shadowGpuMsTracked = 0.0;
+	unsigned int shadowRebuildsBefore = 0;
+
+	const std::vector<sResult>& GetResults()
+	{
+		return results;
+	}
+
+	void ClearResults()
+	{
+		results.clear();
+	}
+
+	static void AddResult(const std::string& name, double value, const std::string& unit)
+	{
+		sResult newResult;
+		newResult.name = name;
+		newResult.value = value;
+		newResult.unit = unit;
+		results.push_back(newResult);
+	}
+
+	// What the timed loops computed is added here, a volatile store the compiler can't drop along with the loop
+	static volatile double resultSink = 0.0;
+
+	// The cook and compile benchmarks write here instead of over the game's own cooked files, which a loaded map may have mapped
+	static std::string GetScratchPath(unsigned int index, const std::string& extension)
+	{
+		return "BenchmarkScratch" + std::to_string(index) + extension;
+	}
+
+	static void AddTimeResult(const std::string& name, std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		AddResult(name, elapsed.count(), "ms");
+	}
+
+	void UniformSets(unsigned int setsNum)
+	{
+		Manager::render.use("scene");
+
+		glm::vec4 color(1.f);
+		unsigned int wholeColorHandle = Manager::render.GetUniformHandle("wholeColor");
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < setsNum; i++)
+		{
+			color.x = (float)i;
+			Manager::render.setVec4("wholeColor", color);
+		}
+		AddTimeResult("Uniform sets (string) x" + std::to_string(setsNum), start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < setsNum; i++)
+		{
+			color.x = (float)i;
+			Manager::render.setVec4(wholeColorHandle, color);
+		}
+		AddTimeResult("Uniform sets (handle) x" + std::to_string(setsNum), start);
+	}
+
+	void DrawFrameAllocations(unsigned int framesNum)
+	{
+		if (framesNum == 0) return;
+
+		if (!IsCountingAllocations())
+		{
+			AddResult("DrawFrame allocations need BENCHMARK_ALLOCATIONS", 0.0, "");
+			return;
+		}
+
+		allocationFramesTotal = framesNum;
+		allocationFramesLeft = framesNum;
+		allocationsTracked = 0;
+	}
+
+	bool IsCountingAllocations()
+	{
+#ifdef BENCHMARK_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	unsigned long long GetAllocationCount()
+	{
+#ifdef BENCHMARK_ALLOCATIONS
+		return allocationCount.load(std::memory_order_relaxed);
+#else
+		return 0;
+#endif
+	}
+
+	void TrackDrawFrameAllocations(unsigned long long allocationsNum)
+	{
+		if (allocationFramesLeft == 0) return;
+
+		allocationsTracked += allocationsNum;
+		allocationFramesLeft--;
+
+		if (allocationFramesLeft == 0)
+			AddResult("DrawFrame allocations per frame", (double)allocationsTracked / allocationFramesTotal, "");
+	}
+
+	void ShadowPassCost(unsigned int framesNum)
+	{
+		if (framesNum == 0 || shadowFramesLeft != 0) return;
+
+		shadowWasCacheOn = Manager::render.useShadowCache;
+		shadowFramesTotal = framesNum;
+		shadowFramesLeft = (framesNum + SHADOW_WARMUP_FRAMES) * 2;
+		shadowCpuMsTracked = 0.0;
+		shadowGpuMsTracked = 0.0;
+		Manager::render.useShadowCache = false;
+	}
+
+	void TrackShadowPass()
+	{
+		if (shadowFramesLeft == 0) return;
+
+		unsigned int halfFrames = shadowFramesTotal + SHADOW_WARMUP_FRAMES;
+		unsigned int frameInHalf = (shadowFramesLeft - 1) % halfFrames; // counts down to 0 at the end of each half
+
+		if (frameInHalf < shadowFramesTotal)
+		{
+			shadowCpuMsTracked += Manager::render.GetShadowPassCpuMs();
+			shadowGpuMsTracked += Manager::render.GetShadowPassGpuMs();
+		}
+		shadowFramesLeft--;
+
+		if (frameInHalf != 0) return;
+
+		std::string mode = Manager::render.useShadowCache ? "cached" : "full redraw";
+		AddResult("Shadow pass CPU (" + mode + ")", shadowCpuMsTracked / shadowFramesTotal, "ms");
+		AddResult("Shadow pass GPU (" + mode + ")", shadowGpuMsTracked / shadowFramesTotal, "ms");
+		shadowCpuMsTracked = 0.0;
+		shadowGpuMsTracked = 0.0;
+
+		if (shadowFramesLeft != 0)
+		{
+			Manager::render.useShadowCache = true;
+			shadowRebuildsBefore = Manager::render.GetShadowCacheRebuilds();
+		}
+		else
+		{
+			AddResult("Shadow cache rebuilds", Manager::render.GetShadowCacheRebuilds() - shadowRebuildsBefore, "");
+			Manager::render.useShadowCache = shadowWasCacheOn;
+		}
+	}
+
+	void ParticleUpdate(unsigned int framesNum)
+	{
+		if (framesNum == 0) return;
+
+		const unsigned int particleCounts[] = { 500, 10000, 100000 };
+		const float deltaTime = 1.f / 60.f;
+
+		for (unsigned int countIndex = 0; countIndex < 3; countIndex++)
+		{
+			unsigned int particlesNum = particleCounts[countIndex];
+			std::string label = std::to_string(particlesNum);
+
+			cParticleSpawner spawner(glm::vec3(0.f), cRenderModel(), particlesNum);
+			spawner.minPositionOffset = glm::vec3(-20.f, 0.f, -20.f);
+			spawner.maxPositionOffset = glm::vec3(20.f, 0.f, 20.f);
+			spawner.spawnSpeed = glm::vec3(0.f, -3.f, 0.f);
+			spawner.gravity = glm::vec3(0.f, -1.f, 0.f);
+			spawner.particleLifeTime = 1000.f;
+			spawner.SpawnParticles(particlesNum);
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (unsigned int frame = 0; frame < framesNum; frame++)
+			{
+				spawner.Update(deltaTime);
+			}
+			glFinish();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			AddResult("Particle update x" + label + " per frame", elapsed.count() / framesNum, "ms");
+
+			spawner.SetGpuSimulation(true);
+			spawner.SpawnParticles(particlesNum);
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int frame = 0; frame < framesNum; frame++)
+			{
+				spawner.Update(deltaTime);
+			}
+			glFinish();
+			elapsed = std::chrono::high_resolution_clock::now() - start;
+			AddResult("GPU particle update x" + label + " per frame", elapsed.count() / framesNum, "ms");
+
+			// What Update used to upload, one call per live particle
+			unsigned int bufferId;
+			glGenBuffers(1, &bufferId);
+			glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * particlesNum, NULL, GL_DYNAMIC_DRAW);
+
+			glm::vec4 particleData(1.f);
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int frame = 0; frame < framesNum; frame++)
+			{
+				for (unsigned int i = 0; i < particlesNum; i++)
+				{
+					particleData.w = (float)frame;
+					glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * i, sizeof(glm::vec4), &particleData.x);
+				}
+			}
+			glFinish();
+			elapsed = std::chrono::high_resolution_clock::now() - start;
+			AddResult("Per particle uploads x" + label + " per frame", elapsed.count() / framesNum, "ms");
+
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glDeleteBuffers(1, &bufferId);
+		}
+	}
+
+	void ParticleSimulation(unsigned int framesNum)
+	{
+		if (framesNum == 0) return;
+
+		const unsigned int particleCounts[] = { 10000, 100000 };
+		const float deltaTime = 1.f / 60.f;
+		const float lifeTime = 1.f;
+		const glm::vec3 gravity = glm::vec3(0.5f, -9.8f, 0.f);
+
+		for (unsigned int countIndex = 0; countIndex < 2; countIndex++)
+		{
+			unsigned int particlesNum = particleCounts[countIndex];
+			unsigned int arrayStride = (particlesNum + PARTICLE_KERNEL_WIDTH - 1) / PARTICLE_KERNEL_WIDTH * PARTICLE_KERNEL_WIDTH;
+
+			// Ages spread over the whole life time so some die every frame
+			std::vector<float> initial(arrayStride * 7, 0.f);
+			srand(particlesNum);
+			for (unsigned int i = 0; i < particlesNum; i++)
+			{
+				for (unsigned int component = 0; component < 6; component++)
+				{
+					initial[arrayStride * component + i] = ((float)rand() / RAND_MAX - 0.5f) * 40.f;
+				}
+				initial[arrayStride * 6 + i] = (float)rand() / RAND_MAX * lifeTime;
+			}
+
+			std::vector<float> scalarResult;
+			unsigned int scalarNum = 0;
+			for (unsigned int kernel = 0; kernel < ParticleKernels::KERNELS_NUM; kernel++)
+			{
+				if (!ParticleKernels::IsKernelSupported((ParticleKernels::eKernel)kernel)) continue;
+
+				std::vector<float> storage(arrayStride * 7 + PARTICLE_ARRAY_ALIGNMENT / sizeof(float));
+				uintptr_t storageAddress = (uintptr_t)&storage[0];
+				float* base = (float*)((storageAddress + PARTICLE_ARRAY_ALIGNMENT - 1) & ~(uintptr_t)(PARTICLE_ARRAY_ALIGNMENT - 1));
+				std::copy(initial.begin(), initial.end(), base);
+
+				sParticleArrays particles;
+				float** arrays[7] = { &particles.positionsX, &particles.positionsY, &particles.positionsZ,
+					&particles.velocitiesX, &particles.velocitiesY, &particles.velocitiesZ, &particles.timers };
+				for (unsigned int component = 0; component < 7; component++)
+				{
+					*arrays[component] = base + arrayStride * component;
+				}
+
+				ParticleKernels::KernelFunction integrate = ParticleKernels::GetKernelFunction((ParticleKernels::eKernel)kernel);
+				glm::vec3 boundsMin, boundsMax;
+				unsigned int aliveNum = particlesNum;
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				for (unsigned int frame = 0; frame < framesNum; frame++)
+				{
+					boundsMin = glm::vec3(FLT_MAX);
+					boundsMax = glm::vec3(-FLT_MAX);
+					aliveNum = integrate(particles, aliveNum, deltaTime, gravity, lifeTime * 2.f, boundsMin, boundsMax);
+				}
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+				std::string label = std::string(ParticleKernels::GetKernelName((ParticleKernels::eKernel)kernel)) + " x" + std::to_string(particlesNum);
+				AddResult("Particle kernel " + label + " per frame", elapsed.count() / framesNum, "ms");
+
+				// Only the live part of each array is compared, what's past it is scratch
+				std::vector<float> result;
+				for (unsigned int component = 0; component < 7; component++)
+				{
+					result.insert(result.end(), *arrays[component], *arrays[component] + aliveNum);
+				}
+
+				if (kernel == ParticleKernels::SCALAR_KERNEL)
+				{
+					scalarResult = result;
+					scalarNum = aliveNum;
+					continue;
+				}
+
+				bool isSame = aliveNum == scalarNum && (result.empty() || memcmp(&result[0], &scalarResult[0], sizeof(float) * result.size()) == 0);
+				AddResult("Particle kernel " + label + " matches scalar", isSame ? 1.0 : 0.0, "");
+			}
+		}
+	}
+
+	void RandomDraws(unsigned int particlesNum)
+	{
+		if (particlesNum == 0) return;
+
+		std::vector<float> draws(particlesNum * 6);
+
+		// The way SpawnParticle used to draw, one generator per component
+		cLinearCongruentialGenerator lcgs[6] = { 11, 22, 33, 44, 55, 66 };
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < particlesNum; i++)
+		{
+			for (unsigned int component = 0; component < 6; component++)
+			{
+				double draw;
+				lcgs[component].get_uniform_draw(draw);
+				draws[component * particlesNum + i] = (float)draw * 2.f - 1.f;
+			}
+		}
+		AddTimeResult("LCG draws for " + std::to_string(particlesNum) + " particles", start);
+
+		cXoshiroGenerator xoshiro(1234);
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int component = 0; component < 6; component++)
+		{
+			xoshiro.FillUniform(&draws[component * particlesNum], particlesNum, -1.f, 1.f);
+		}
+		AddTimeResult("Xoshiro draws for " + std::to_string(particlesNum) + " particles", start);
+
+		// Replaying from the same seed has to give the same numbers
+		std::vector<float> replay(particlesNum * 6);
+		xoshiro.Seed(1234);
+		for (unsigned int component = 0; component < 6; component++)
+		{
+			xoshiro.FillUniform(&replay[component * particlesNum], particlesNum, -1.f, 1.f);
+		}
+		AddResult("Xoshiro replay matches", replay == draws ? 1.0 : 0.0, "");
+	}
+
+	void ModelLoading()
+	{
+		const std::string modelsPath = "assets/models/";
+
+		std::vector<std::string> files;
+		cMappedFile::ListFiles(modelsPath, ".obj", files);
+		if (files.empty()) return;
+
+		std::vector<sCookedModel> imported(files.size());
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			MeshCooker::Import(modelsPath + files[i], imported[i]);
+		}
+		AddTimeResult("Assimp import x" + std::to_string(files.size()), start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			MeshCooker::Write(modelsPath + files[i], GetScratchPath(i, ".cmesh"), imported[i]);
+		}
+		AddTimeResult("Cook x" + std::to_string(files.size()), start);
+
+		// Touch every vertex so the mapped pages are actually read
+		unsigned int cookedNum = 0;
+		float checksum = 0.f;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			cMappedFile file;
+			sCookedModelView view;
+			if (!MeshCooker::Read(modelsPath + files[i], GetScratchPath(i, ".cmesh"), file, view)) continue;
+
+			for (unsigned int meshIndex = 0; meshIndex < view.meshesNum; meshIndex++)
+			{
+				const sCookedMeshRange& range = view.meshes[meshIndex];
+				for (unsigned int v = 0; v < range.verticesNum; v++)
+				{
+					checksum += view.vertices[range.firstVertex + v].x;
+				}
+			}
+			cookedNum++;
+		}
+		AddTimeResult("Cooked read x" + std::to_string(cookedNum), start);
+
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			remove(GetScratchPath(i, ".cmesh").c_str());
+		}
+
+		resultSink += checksum;
+	}
+
+	void MapLoading()
+	{
+		const std::string mapsPath = "assets/scenes/maps/";
+
+		std::vector<std::string> files;
+		cMappedFile::ListFiles(mapsPath, ".pdsmap", files);
+		if (files.empty()) return;
+
+		std::vector< std::vector<sMapGridQuadrant> > parsed(files.size());
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			MapFile::ParseText(mapsPath + files[i], parsed[i]);
+		}
+		AddTimeResult(".pdsmap parse x" + std::to_string(files.size()), start);
+
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			MapFile::Write(mapsPath + files[i], GetScratchPath(i, ".cmap"), parsed[i]);
+		}
+
+		// Sum the grids so the mapped pages are actually read
+		unsigned int compiledNum = 0;
+		long long checksum = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			cMappedFile file;
+			sMapGridView view;
+			if (!MapFile::Read(mapsPath + files[i], GetScratchPath(i, ".cmap"), file, view)) continue;
+
+			for (unsigned int quadIndex = 0; quadIndex < view.quadsNum; quadIndex++)
+			{
+				const int16_t* tiles = &view.quads[quadIndex].tiles[0][0][0];
+				for (unsigned int t = 0; t < MAP_LAYERS_NUM * MAP_QUADRANT_SIZE * MAP_QUADRANT_SIZE; t++)
+				{
+					checksum += tiles[t];
+				}
+			}
+			compiledNum++;
+		}
+		AddTimeResult(".cmap read x" + std::to_string(compiledNum), start);
+
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			remove(GetScratchPath(i, ".cmap").c_str());
+		}
+
+		resultSink += (double)checksum;
+	}
+
+	// The tile storage sQuadrant had before the flat bitsets, kept to compare against
+	struct sMapTile
+	{
+		cEntity* entity = nullptr;
+		bool isWalkable = false;
+		bool isUnchangeable = false;
+
+		bool IsAvailable()
+		{
+			if (!isWalkable) return false;
+
+			if (entity && entity->blocksTile) return false;
+
+			return true;
+		}
+	};
+
+	struct sMapQuadrant
+	{
+		int posX;
+		int posZ;
+		std::map<int, sMapTile> data;
+
+		sMapTile* GetTileFromLocalPosition(glm::ivec3 localPos)
+		{
+			int localTileId = sQuadrant::GetTileIdFromPosition(localPos);
+
+			if (localTileId == -1) return nullptr;
+
+			return &data[localTileId];
+		}
+	};
+
+	static sMapQuadrant* GetMapQuad(std::vector<sMapQuadrant>& quads, int worldX, int worldZ)
+	{
+		if (worldX + 15 < 0 || worldZ + 15 < 0) return nullptr;
+
+		int quadXCoord = (worldX + 15) / 32;
+		int quadZCoord = (worldZ + 15) / 32;
+
+		for (unsigned int i = 0; i < quads.size(); i++)
+		{
+			if (quadXCoord == quads[i].posX && quadZCoord == quads[i].posZ) return &quads[i];
+		}
+
+		return nullptr;
+	}
+
+	static sMapTile* GetMapTile(std::vector<sMapQuadrant>& quads, glm::ivec3 worldPosition)
+	{
+		sMapQuadrant* quad = GetMapQuad(quads, worldPosition.x, worldPosition.z);
+		if (!quad) return nullptr;
+
+		glm::ivec3 localPosition = worldPosition;
+		localPosition.x += 15 - 32 * quad->posX;
+		localPosition.z += 15 - 32 * quad->posZ;
+
+		return quad->GetTileFromLocalPosition(localPosition);
+	}
+
+	void TileLookups(unsigned int lookupsNum)
+	{
+		const std::vector<sQuadrant>& quads = Manager::map.GetQuads();
+		if (quads.empty()) return;
+
+		// Same tiles in the old storage, only the ones that were ever set
+		std::vector<sMapQuadrant> mapQuads(quads.size());
+		for (unsigned int quadIndex = 0; quadIndex < quads.size(); quadIndex++)
+		{
+			mapQuads[quadIndex].posX = quads[quadIndex].posX;
+			mapQuads[quadIndex].posZ = quads[quadIndex].posZ;
+			for (int tileId = 0; tileId < QUADRANT_TILES_NUM; tileId++)
+			{
+				if (!quads[quadIndex].walkableTiles[tileId] && !quads[quadIndex].unchangeableTiles[tileId]) continue;
+
+				sMapTile& tile = mapQuads[quadIndex].data[tileId];
+				tile.isWalkable = quads[quadIndex].walkableTiles[tileId];
+				tile.isUnchangeable = quads[quadIndex].unchangeableTiles[tileId];
+			}
+			for (unsigned int i = 0; i < quads[quadIndex].tileEntities.size(); i++)
+			{
+				mapQuads[quadIndex].data[quads[quadIndex].tileEntities[i].tileId].entity = quads[quadIndex].tileEntities[i].entity;
+			}
+		}
+
+		// Random positions around the loaded quadrants, the same for both
+		int minX = quads[0].posX, maxX = quads[0].posX, minZ = quads[0].posZ, maxZ = quads[0].posZ;
+		for (unsigned int i = 1; i < quads.size(); i++)
+		{
+			if (quads[i].posX < minX) minX = quads[i].posX;
+			if (quads[i].posX > maxX) maxX = quads[i].posX;
+			if (quads[i].posZ < minZ) minZ = quads[i].posZ;
+			if (quads[i].posZ > maxZ) maxZ = quads[i].posZ;
+		}
+
+		srand(1234);
+		std::vector<glm::ivec3> positions(lookupsNum);
+		for (unsigned int i = 0; i < lookupsNum; i++)
+		{
+			positions[i].x = minX * 32 - 15 + rand() % ((maxX - minX + 1) * 32);
+			positions[i].y = rand() % 8;
+			positions[i].z = minZ * 32 - 15 + rand() % ((maxZ - minZ + 1) * 32);
+		}
+
+		unsigned int availableNum = 0;
+		unsigned long long allocationsBefore = GetAllocationCount();
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < lookupsNum; i++)
+		{
+			sMapTile* tile = GetMapTile(mapQuads, positions[i]);
+			if (tile && tile->IsAvailable()) availableNum++;
+		}
+		AddTimeResult("GetTile std::map x" + std::to_string(lookupsNum), start);
+		if (IsCountingAllocations()) AddResult("  allocations", (double)(GetAllocationCount() - allocationsBefore), "");
+
+		allocationsBefore = GetAllocationCount();
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < lookupsNum; i++)
+		{
+			if (Manager::map.GetTile(positions[i]).IsAvailable()) availableNum++;
+		}
+		AddTimeResult("GetTile bitset x" + std::to_string(lookupsNum), start);
+		if (IsCountingAllocations()) AddResult("  allocations", (double)(GetAllocationCount() - allocationsBefore), "");
+
+		// What TryMoveEntity looks up before it moves anything: same height, one up, one down
+		allocationsBefore = GetAllocationCount();
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < lookupsNum; i++)
+		{
+			for (int heightOffset = 0; heightOffset < 3; heightOffset++)
+			{
+				sMapTile* tile = GetMapTile(mapQuads, positions[i] + glm::ivec3(1, heightOffset == 2 ? -1 : heightOffset, 0));
+				if (tile && tile->IsAvailable())
+				{
+					availableNum++;
+					break;
+				}
+			}
+		}
+		AddTimeResult("Move probes std::map x" + std::to_string(lookupsNum), start);
+		if (IsCountingAllocations()) AddResult("  allocations", (double)(GetAllocationCount() - allocationsBefore), "");
+
+		allocationsBefore = GetAllocationCount();
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < lookupsNum; i++)
+		{
+			for (int heightOffset = 0; heightOffset < 3; heightOffset++)
+			{
+				if (Manager::map.GetTile(positions[i] + glm::ivec3(1, heightOffset == 2 ? -1 : heightOffset, 0)).IsAvailable())
+				{
+					availableNum++;
+					break;
+				}
+			}
+		}
+		AddTimeResult("Move probes bitset x" + std::to_string(lookupsNum), start);
+		if (IsCountingAllocations()) AddResult("  allocations", (double)(GetAllocationCount() - allocationsBefore), "");
+
+		resultSink += availableNum;
+	}
+
+	void QuadLookups(unsigned int lookupsNum)
+	{
+		const unsigned int quadsNums[] = { 1, 16, 256, 1024 };
+		for (unsigned int test = 0; test < 4; test++)
+		{
+			// Square-ish block of quadrants, like a stitched map
+			unsigned int quadsNum = quadsNums[test];
+			int side = 1;
+			while ((unsigned int)(side * side) < quadsNum) side++;
+
+			std::vector<sQuadrant> quads(quadsNum);
+			for (unsigned int i = 0; i < quadsNum; i++)
+			{
+				quads[i].posX = i / side;
+				quads[i].posZ = i % side;
+			}
+
+			cQuadrantGrid grid;
+			grid.Build(quads);
+
+			srand(1234);
+			std::vector<glm::ivec2> coords(lookupsNum);
+			for (unsigned int i = 0; i < lookupsNum; i++)
+			{
+				coords[i].x = rand() % side;
+				coords[i].y = rand() % side;
+			}
+
+			unsigned int foundNum = 0;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < lookupsNum; i++)
+			{
+				for (unsigned int q = 0; q < quads.size(); q++)
+				{
+					if (coords[i].x == quads[q].posX && coords[i].y == quads[q].posZ)
+					{
+						foundNum++;
+						break;
+					}
+				}
+			}
+			AddTimeResult("Quad scan, " + std::to_string(quadsNum) + " quads x" + std::to_string(lookupsNum), start);
+
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < lookupsNum; i++)
+			{
+				if (grid.Find(coords[i].x, coords[i].y) != -1) foundNum++;
+			}
+			AddTimeResult("Quad grid, " + std::to_string(quadsNum) + " quads x" + std::to_string(lookupsNum), start);
+
+			resultSink += foundNum;
+		}
+	}
+
+	// The manager before the pools, every animation its own heap object behind a shared_ptr and a virtual Process
+	class cSharedAnimation
+	{
+	public:
+		cAnimation* state;
+
+		virtual ~cSharedAnimation() {}
+		virtual void Process(float deltaTime) = 0;
+	};
+
+	template<typename T>
+	class cSharedAnimationOf : public cSharedAnimation
+	{
+	public:
+		T animation;
+
+		cSharedAnimationOf(const T& _animation) : animation(_animation) { state = &animation; }
+		virtual void Process(float deltaTime) { animation.Process(deltaTime); }
+	};
+
+	struct sAnimationTargets
+	{
+		float value;
+		glm::vec2 vec2;
+		glm::vec3 vec3;
+		glm::vec4 vec4;
+		glm::vec3 position;
+		glm::vec3 orientation;
+		glm::vec3 scale;
+		glm::vec3 sinValue;
+		int spriteId;
+		glm::vec3 spriteScale;
+		int periodicSpriteId;
+	};
+
+	static bool AnimationTargetsMatch(const sAnimationTargets& a, const sAnimationTargets& b)
+	{
+		return a.value == b.value && a.vec2 == b.vec2 && a.vec3 == b.vec3 && a.vec4 == b.vec4 &&
+			a.position == b.position && a.orientation == b.orientation && a.scale == b.scale && a.sinValue == b.sinValue &&
+			a.spriteId == b.spriteId && a.spriteScale == b.spriteScale && a.periodicSpriteId == b.periodicSpriteId;
+	}
+
+	static void SetAnimationLoop(cAnimation& animation, bool isOneShot)
+	{
+		animation.isRepeat = !isOneShot;
+		animation.removeAfterComplete = isOneShot;
+	}
+
+	// Cycles through the eight kinds with different lengths. One in eight plays once and gets dropped by Process
+	template<typename Adder>
+	static void AddBenchmarkAnimation(unsigned int index, sAnimationTargets& targets, Adder& add)
+	{
+		bool isOneShot = (index / 8) % 8 == 0;
+		float length = 1.f + (float)(index % 37) * 0.1f;
+
+		switch (index % 8)
+		{
+		case 0:
+		{
+			cFloatAnimation animation(targets.value);
+			animation.AddKeyFrame(sKeyFrameFloat(length * 0.5f, 10.f));
+			animation.AddKeyFrame(sKeyFrameFloat(length, -10.f));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 1:
+		{
+			cVec2Animation animation(targets.vec2);
+			animation.AddKeyFrame(sKeyFrameVec2(length, glm::vec2(5.f)));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 2:
+		{
+			cVec3Animation animation(targets.vec3);
+			animation.AddKeyFrame(sKeyFrameVec3(length * 0.5f, glm::vec3(1.f, 2.f, 3.f)));
+			animation.AddKeyFrame(sKeyFrameVec3(length, glm::vec3(0.f)));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 3:
+		{
+			cVec4Animation animation(targets.vec4);
+			animation.AddKeyFrame(sKeyFrameVec4(length, glm::vec4(0.12f, 0.22f, 0.5f, 1.f)));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 4:
+		{
+			cModelAnimation animation(targets.position, targets.orientation, targets.scale);
+			animation.AddPositionKeyFrame(sKeyFrameVec3(length * 0.5f, targets.position + glm::vec3(1.f, 0.f, 0.f)));
+			animation.AddPositionKeyFrame(sKeyFrameVec3(length, targets.position));
+			animation.AddScaleKeyFrame(sKeyFrameVec3(length, glm::vec3(2.f)));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 5:
+		{
+			cSinAnimation animation(targets.sinValue, 2.f, 0.f);
+			animation.AddKeyFrame(sKeyFrameVec3(length, glm::vec3(360.f, 180.f, 0.f)));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		case 6:
+		{
+			cSpriteAnimation animation(targets.spriteId, targets.spriteScale);
+			animation.AddKeyFrame(sKeyFrameSprite(0.01f, 1));
+			animation.AddKeyFrame(sKeyFrameSprite(length * 0.5f, 0, true));
+			animation.AddKeyFrame(sKeyFrameSprite(length, 2));
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		default:
+		{
+			cPeriodicSpriteAnimation animation(targets.periodicSpriteId, 10);
+			SetAnimationLoop(animation, isOneShot);
+			add(animation);
+			break;
+		}
+		}
+	}
+
+	void Animations(unsigned int animationsNum, unsigned int framesNum)
+	{
+		const float deltaTime = 1.f / 60.f;
+		const std::string countName = " x" + std::to_string(animationsNum);
+
+		sAnimationTargets initialTargets;
+		initialTargets.value = 0.f;
+		initialTargets.vec2 = glm::vec2(0.f);
+		initialTargets.vec3 = glm::vec3(0.f);
+		initialTargets.vec4 = glm::vec4(1.f);
+		initialTargets.position = glm::vec3(0.f);
+		initialTargets.orientation = glm::vec3(0.f);
+		initialTargets.scale = glm::vec3(1.f);
+		initialTargets.sinValue = glm::vec3(0.f);
+		initialTargets.spriteId = 0;
+		initialTargets.spriteScale = glm::vec3(1.f);
+		initialTargets.periodicSpriteId = 0;
+
+		// Shared list, kept by the owners too like CharacterSprite did
+		std::vector<sAnimationTargets> sharedTargets(animationsNum, initialTargets);
+		std::vector<std::shared_ptr<cSharedAnimation>> sharedAnimations;
+		std::vector<std::shared_ptr<cSharedAnimation>> sharedOwners;
+		auto addShared = [&](const auto& animation)
+		{
+			typedef typename std::decay<decltype(animation)>::type tAnimation;
+			std::shared_ptr<cSharedAnimation> newAnimation = std::make_shared<cSharedAnimationOf<tAnimation>>(animation);
+			sharedOwners.push_back(newAnimation);
+			sharedAnimations.push_back(newAnimation);
+		};
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < animationsNum; i++)
+		{
+			AddBenchmarkAnimation(i, sharedTargets[i], addShared);
+		}
+		AddTimeResult("Animations add, shared_ptr list" + countName, start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < framesNum; frame++)
+		{
+			for (int i = (int)sharedAnimations.size() - 1; i >= 0; i--)
+			{
+				sharedAnimations[i]->Process(deltaTime);
+
+				cAnimation* animation = sharedAnimations[i]->state;
+				if (animation->timer >= animation->maxDuration)
+				{
+					if (animation->isRepeat)
+					{
+						animation->timer = 0.f;
+					}
+					else
+					{
+						animation->isDone = true;
+
+						if (animation->callback)
+							animation->callback();
+					}
+				}
+
+				if (animation->removeAfterComplete && animation->isDone)
+				{
+					sharedAnimations.erase(sharedAnimations.begin() + i);
+				}
+			}
+		}
+		AddTimeResult("Animations process, shared_ptr list" + countName + ", " + std::to_string(framesNum) + " frames", start);
+		unsigned int sharedLeft = (unsigned int)sharedAnimations.size();
+
+		// Pools
+		std::vector<sAnimationTargets> pooledTargets(animationsNum, initialTargets);
+		cAnimationManager pooled;
+		std::vector<sAnimationHandle> handles;
+		handles.reserve(animationsNum);
+		auto addPooled = [&](const auto& animation)
+		{
+			handles.push_back(pooled.AddAnimation(animation));
+		};
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < animationsNum; i++)
+		{
+			AddBenchmarkAnimation(i, pooledTargets[i], addPooled);
+		}
+		AddTimeResult("Animations add, pools" + countName, start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < framesNum; frame++)
+		{
+			pooled.Process(deltaTime);
+		}
+		AddTimeResult("Animations process, pools" + countName + ", " + std::to_string(framesNum) + " frames", start);
+
+		bool isMatch = sharedLeft == pooled.GetAnimationsNum();
+		for (unsigned int i = 0; i < animationsNum && isMatch; i++)
+		{
+			isMatch = AnimationTargetsMatch(sharedTargets[i], pooledTargets[i]);
+		}
+		AddResult("Animation pools match", isMatch ? 1.0 : 0.0, "");
+
+		// Owners going away in the order they were made, the worst case for erase
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < sharedOwners.size(); i++)
+		{
+			for (unsigned int j = 0; j < sharedAnimations.size(); j++)
+			{
+				if (sharedAnimations[j] == sharedOwners[i])
+				{
+					sharedAnimations.erase(sharedAnimations.begin() + j);
+					break;
+				}
+			}
+		}
+		AddTimeResult("Animations remove, shared_ptr list" + countName, start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < handles.size(); i++)
+		{
+			pooled.RemoveAnimation(handles[i]);
+		}
+		AddTimeResult("Animations remove, pools" + countName, start);
+	}
+
+	void TextureLoading()
+	{
+		std::vector<std::string> paths;
+		cMappedFile::ListFilesRecursive("assets/", ".png", paths);
+		if (paths.empty()) return;
+
+		// Serial, decode and upload one after the other like CreateTexture
+		std::vector<unsigned int> textureIds;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < paths.size(); i++)
+		{
+			sDecodedImage image;
+			if (cRenderManager::DecodeImage(paths[i], image))
+				textureIds.push_back(Manager::render.UploadTexture(image));
+		}
+		AddTimeResult("PNG load serial x" + std::to_string(paths.size()), start);
+
+		glDeleteTextures((GLsizei)textureIds.size(), textureIds.data());
+		textureIds.clear();
+
+		// Parallel, decodes on the job system and uploads drained here as they come back
+		unsigned int finishedNum = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < paths.size(); i++)
+		{
+			std::string path = paths[i];
+			std::shared_ptr<sDecodedImage> image = std::make_shared<sDecodedImage>();
+			Manager::jobs.Submit(
+				[path, image]()
+				{
+					cRenderManager::DecodeImage(path, *image);
+				},
+				[image, &textureIds, &finishedNum]()
+				{
+					if (image->pixels)
+						textureIds.push_back(Manager::render.UploadTexture(*image));
+					finishedNum++;
+				});
+		}
+
+		while (finishedNum < paths.size())
+		{
+			Manager::jobs.ProcessMainThreadJobs();
+		}
+		AddTimeResult("PNG load parallel (" + std::to_string(Manager::jobs.GetWorkersNum()) + " workers) x" + std::to_string(paths.size()), start);
+
+		glDeleteTextures((GLsizei)textureIds.size(), textureIds.data());
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Micro benchmarks, started from the debug window. They need a live GL context
+namespace Benchmark
+{
+	struct sResult
+	{
+		std::string name;
+		double value;
+		std::string unit;
+	};
+
+	const std::vector<sResult>& GetResults();
+	void ClearResults();
+
+	// Same uniform uploads through the std::string path and the handle path
+	void UniformSets(unsigned int setsNum = 10000);
+
+	// Heap allocations made inside DrawFrame, averaged over the next framesNum frames.
+	// Counted by the global operator new in Benchmarks.cpp, which only exists with BENCHMARK_ALLOCATIONS defined
+	void DrawFrameAllocations(unsigned int framesNum = 120);
+	bool IsCountingAllocations();
+	unsigned long long GetAllocationCount();
+	void TrackDrawFrameAllocations(unsigned long long allocationsNum);
+
+	// Shadow pass CPU and GPU time averaged over framesNum frames redrawing every caster, then framesNum with the shadow cache.
+	// The GPU time comes from timer queries a few frames late, so the first ones of each half are skipped
+	void ShadowPassCost(unsigned int framesNum = 120);
+	void TrackShadowPass();
+
+	// Every .obj in assets/models through Assimp, then through the cooked files (rewritten first).
+	// CPU side only, the GL upload is the same either way
+	void ModelLoading();
+
+	// Every .pdsmap in assets/scenes/maps through the text parser, then through the compiled files (rewritten first)
+	void MapLoading();
+
+	// Random GetTile calls and TryMoveEntity style probes on the loaded map, against the old std::map tile storage
+	void TileLookups(unsigned int lookupsNum = 1000000);
+
+	// Linear scan against cQuadrantGrid over 1, 16, 256 and 1024 quadrants
+	void QuadLookups(unsigned int lookupsNum = 1000000);
+
+	// Per frame cost of a spawner's Update with 500, 10k and 100k live particles on the CPU and on the GPU,
+	// against the per particle glBufferSubData calls it used to make for the same data
+	void ParticleUpdate(unsigned int framesNum = 60);
+
+	// Every particle kernel this CPU runs on the same 10k and 100k particles, checked bit for bit against the scalar one
+	void ParticleSimulation(unsigned int framesNum = 60);
+
+	// Random draws for particlesNum spawns: six virtual LCG draws per particle against batched xoshiro draws
+	void RandomDraws(unsigned int particlesNum = 100000);
+
+	// animationsNum animations spread over the eight kinds, added, processed for framesNum frames and removed through the
+	// typed pools, then through the shared_ptr list with a virtual Process the manager used to keep. Results are compared
+	void Animations(unsigned int animationsNum = 10000, unsigned int framesNum = 600);
+
+	// Every .png under assets, decoded and uploaded on the main thread and then with the decodes on the job system
+	void TextureLoading();
+}
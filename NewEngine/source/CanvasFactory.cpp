@@ -456,10 +456,10 @@ cPartyMemberButton::cPartyMemberButton(cUICanvas* canvas, int memberNum)
 
 cPartyBackground::cPartyBackground(cUICanvas* canvas)
 {
-    scroll = std::make_shared<cVec2Animation>(translate);
-    scroll->AddKeyFrame(sKeyFrameVec2(5.f, glm::vec2(5.f)));
-    scroll->isRepeat = true;
-    Manager::animation.AddAnimation(scroll);
+    cVec2Animation scrollAnimation(translate);
+    scrollAnimation.AddKeyFrame(sKeyFrameVec2(5.f, glm::vec2(5.f)));
+    scrollAnimation.isRepeat = true;
+    scroll = Manager::animation.AddAnimation(scrollAnimation);
 }
 
 cPartyBackground::~cPartyBackground()
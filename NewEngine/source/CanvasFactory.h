@@ -85,7 +85,7 @@ public:
 
 class cPartyBackground : public cUIImage
 {
-	std::shared_ptr<cVec2Animation> scroll;
+	sAnimationHandle scroll;
 public:
 	cPartyBackground(cUICanvas* canvas);
 	virtual ~cPartyBackground();
@@ -10,28 +10,35 @@
 cCharacterSprite::cCharacterSprite(std::string textureName, glm::vec3 pos)
 {
 	model = Manager::render.CreateSpriteModel();
-	model->meshName = "SpriteHolder.obj";
+	model->SetMeshName("SpriteHolder.obj");
 	model->position = pos;
 	model->textureName = textureName;
 
-	spriteAnimation = std::make_shared<cSpriteAnimation>(model->currSpriteId, model->scale);
-	modelAnimation = std::make_shared<cModelAnimation>(model->position, model->orientation, model->scale);
-
-	Manager::animation.AddAnimation(spriteAnimation);
-	Manager::animation.AddAnimation(modelAnimation);
+	spriteAnimationHandle = Manager::animation.AddAnimation(cSpriteAnimation(model->currSpriteId, model->scale));
+	modelAnimationHandle = Manager::animation.AddAnimation(cModelAnimation(model->position, model->orientation, model->scale));
 }
 
 cCharacterSprite::~cCharacterSprite()
 {
 	Manager::render.RemoveModel(model);
 
-	Manager::animation.RemoveAnimation(spriteAnimation);
-	Manager::animation.RemoveAnimation(modelAnimation);
+	Manager::animation.RemoveAnimation(spriteAnimationHandle);
+	Manager::animation.RemoveAnimation(modelAnimationHandle);
+}
+
+cSpriteAnimation* cCharacterSprite::GetSpriteAnimation()
+{
+	return Manager::animation.GetAnimation<cSpriteAnimation>(spriteAnimationHandle);
+}
+
+cModelAnimation* cCharacterSprite::GetModelAnimation()
+{
+	return Manager::animation.GetAnimation<cModelAnimation>(modelAnimationHandle);
 }
 
 glm::vec3 cCharacterSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveResult moveResult)
 {
-	modelAnimation->Reset(model->position, model->orientation, model->scale);
+	GetModelAnimation()->Reset(model->position, model->orientation, model->scale);
 
 	// Make model animation
 	glm::vec3 newPosition = model->position;
@@ -48,8 +55,8 @@ glm::vec3 cCharacterSprite::AnimateMovement(eDirection dir, bool run, eEntityMov
 	if (moveResult == eEntityMoveResult::SUCCESS_UP) newPosition.y += 1.f;
 	else if (moveResult == eEntityMoveResult::SUCCESS_DOWN) newPosition.y -= 1.f;
 
-	if (!run || moveResult == eEntityMoveResult::FAILURE) modelAnimation->AddPositionKeyFrame(sKeyFrameVec3(0.3f, newPosition));
-	else modelAnimation->AddPositionKeyFrame(sKeyFrameVec3(0.14f, newPosition));
+	if (!run || moveResult == eEntityMoveResult::FAILURE) GetModelAnimation()->AddPositionKeyFrame(sKeyFrameVec3(0.3f, newPosition));
+	else GetModelAnimation()->AddPositionKeyFrame(sKeyFrameVec3(0.14f, newPosition));
 
 	return newPosition;
 }
@@ -57,11 +64,11 @@ glm::vec3 cCharacterSprite::AnimateMovement(eDirection dir, bool run, eEntityMov
 cOverworldPokemonSprite::cOverworldPokemonSprite(std::string textureName, glm::vec3 pos) : cCharacterSprite(textureName, pos)
 {
 	lastDesiredDirection = DOWN;
-	spriteAnimation->isRepeat = true;
+	GetSpriteAnimation()->isRepeat = true;
 
 	std::vector<sKeyFrameSprite> keyframes;
 	Manager::animation.GetSpriteAnimationKeyframes(OW_POKEMON, "WALK_DOWN", keyframes);
-	spriteAnimation->AddKeyFrames(keyframes);
+	GetSpriteAnimation()->AddKeyFrames(keyframes);
 }
 
 cOverworldPokemonSprite::~cOverworldPokemonSprite()
@@ -74,7 +81,7 @@ glm::vec3 cOverworldPokemonSprite::AnimateMovement(eDirection dir, bool run, eEn
 	// Change sprite animation
 	if (lastDesiredDirection != dir)
 	{
-		spriteAnimation->Reset();
+		GetSpriteAnimation()->Reset();
 		std::string animationName;
 		if (dir == UP) animationName = "WALK_UP";
 		else if (dir == DOWN) animationName = "WALK_DOWN";
@@ -83,7 +90,7 @@ glm::vec3 cOverworldPokemonSprite::AnimateMovement(eDirection dir, bool run, eEn
 
 		std::vector<sKeyFrameSprite> keyframes;
 		Manager::animation.GetSpriteAnimationKeyframes(OW_POKEMON, animationName, keyframes);
-		spriteAnimation->AddKeyFrames(keyframes);
+		GetSpriteAnimation()->AddKeyFrames(keyframes);
 	}
 
 	lastDesiredDirection = dir;
@@ -103,7 +110,7 @@ cNPCSprite::~cNPCSprite()
 
 glm::vec3 cNPCSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveResult moveResult)
 {
-	spriteAnimation->Reset();
+	GetSpriteAnimation()->Reset();
 	std::string animationName;
 	if (dir == UP)
 	{
@@ -128,11 +135,11 @@ glm::vec3 cNPCSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveResul
 
 	std::vector<sKeyFrameSprite> keyframes;
 	Manager::animation.GetSpriteAnimationKeyframes(NPC, animationName, keyframes);
-	spriteAnimation->AddKeyFrames(keyframes);
+	GetSpriteAnimation()->AddKeyFrames(keyframes);
 	switchLeg = !switchLeg;
 
-	if (run) spriteAnimation->speed = 2.f;
-	else spriteAnimation->speed = 1.f;
+	if (run) GetSpriteAnimation()->speed = 2.f;
+	else GetSpriteAnimation()->speed = 1.f;
 
 	return cCharacterSprite::AnimateMovement(dir, run, moveResult);
 }
@@ -142,7 +149,7 @@ cPlayerSprite::cPlayerSprite(std::string textureName, glm::vec3 pos) : cCharacte
 	lastDesiredDirection = DOWN;
 	switchLeg = false;
 
-	spriteAnimation->isRepeat = true;
+	GetSpriteAnimation()->isRepeat = true;
 }
 
 cPlayerSprite::~cPlayerSprite()
@@ -152,7 +159,7 @@ cPlayerSprite::~cPlayerSprite()
 
 void cPlayerSprite::SetupSpriteWalk(eDirection dir)
 {
-	spriteAnimation->Reset();
+	GetSpriteAnimation()->Reset();
 	std::string animationName;
 	if (dir == UP)
 	{
@@ -177,15 +184,15 @@ void cPlayerSprite::SetupSpriteWalk(eDirection dir)
 
 	std::vector<sKeyFrameSprite> keyframes;
 	Manager::animation.GetSpriteAnimationKeyframes(PLAYER, animationName, keyframes);
-	spriteAnimation->AddKeyFrames(keyframes);
+	GetSpriteAnimation()->AddKeyFrames(keyframes);
 	switchLeg = !switchLeg;
 }
 
 void cPlayerSprite::SetupSpriteRun(eDirection dir)
 {
-	if (lastDesiredDirection != dir || spriteAnimation->keyframes.size() != 5) // <-- very hacky way to find if player was running
+	if (lastDesiredDirection != dir || GetSpriteAnimation()->keyframes.size() != 5) // <-- very hacky way to find if player was running
 	{
-		spriteAnimation->Reset(model->currSpriteId, model->scale);
+		GetSpriteAnimation()->Reset(model->currSpriteId, model->scale);
 
 		std::string animationName;
 		if (dir == UP) animationName = "RUN_UP";
@@ -195,7 +202,7 @@ void cPlayerSprite::SetupSpriteRun(eDirection dir)
 
 		std::vector<sKeyFrameSprite> keyframes;
 		Manager::animation.GetSpriteAnimationKeyframes(PLAYER, animationName, keyframes);
-		spriteAnimation->AddKeyFrames(keyframes);
+		GetSpriteAnimation()->AddKeyFrames(keyframes);
 	}
 }
 glm::vec3 cPlayerSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveResult moveResult)
@@ -206,9 +213,9 @@ glm::vec3 cPlayerSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveRe
 	lastDesiredDirection = dir;
 
 	glm::vec3 newPosition = cCharacterSprite::AnimateMovement(dir, run, moveResult);
-	modelAnimation->callback = [this]() 
+	GetModelAnimation()->callback = [this]() 
 	{
-		if (spriteAnimation->keyframes.size() != 5 || // not running
+		if (GetSpriteAnimation()->keyframes.size() != 5 || // not running
 			!(Manager::input.IsInputDown(IT_UP) || Manager::input.IsInputDown(IT_DOWN) || Manager::input.IsInputDown(IT_LEFT) || Manager::input.IsInputDown(IT_RIGHT)))
 		{
 			StopMovement();
@@ -220,10 +227,10 @@ glm::vec3 cPlayerSprite::AnimateMovement(eDirection dir, bool run, eEntityMoveRe
 
 void cPlayerSprite::StopMovement()
 {
-	if (!modelAnimation->isDone) return;
+	if (!GetModelAnimation()->isDone) return;
 
-	spriteAnimation->Reset();
-	modelAnimation->Reset();
+	GetSpriteAnimation()->Reset();
+	GetModelAnimation()->Reset();
 
 	if (lastDesiredDirection == UP) model->currSpriteId = 0;
 	else if (lastDesiredDirection == DOWN) model->currSpriteId = 3;
@@ -234,13 +241,13 @@ void cPlayerSprite::StopMovement()
 cBattleSprite::cBattleSprite(glm::vec3 pos)
 {
 	model = Manager::render.CreateSpriteModel(true);
-	model->meshName = "SpriteHolder.obj";
+	model->SetMeshName("SpriteHolder.obj");
 	model->position = pos;
 	model->orientation.y = glm::radians(15.f);
 
 	cRenderModel prtcl;
-	prtcl.meshName = "ParticleHolder.obj";
-	prtcl.shaderName = "particle";
+	prtcl.SetMeshName("ParticleHolder.obj");
+	prtcl.SetShaderName("particle");
 	prtcl.textureName = "HitParticle.png";
 	prtcl.scale = glm::vec3(0.3f);
 
@@ -256,31 +263,36 @@ cBattleSprite::cBattleSprite(glm::vec3 pos)
 
 cBattleSprite::~cBattleSprite()
 {
+	Manager::render.ReleaseSpriteSheet(model->textureName);
 	Manager::render.RemoveModel(model);
 
-	Manager::animation.RemoveAnimation(spriteAnimation);
+	Manager::animation.RemoveAnimation(spriteAnimationHandle);
 }
 
 void cBattleSprite::SetSpriteData(std::string textureName, float spriteHeightSize, float spriteAspectRatio, int spritesNum)
 {
 	model->scale.z = spriteHeightSize * spriteAspectRatio;
 	model->scale.y = spriteHeightSize;
+
+	// The sheet's reference from LoadPokemonBattleSpriteSheet is this sprite's until it's cleared
+	Manager::render.ReleaseSpriteSheet(model->textureName);
 	model->textureName = textureName;
 
-	spriteAnimation = std::make_shared<cPeriodicSpriteAnimation>(model->currSpriteId, spritesNum);
-	spriteAnimation->isRepeat = true;
+	cPeriodicSpriteAnimation spriteAnimation(model->currSpriteId, spritesNum);
+	spriteAnimation.isRepeat = true;
 
-	Manager::animation.AddAnimation(spriteAnimation);
+	Manager::animation.RemoveAnimation(spriteAnimationHandle);
+	spriteAnimationHandle = Manager::animation.AddAnimation(spriteAnimation);
 }
 
 void cBattleSprite::ClearSpriteData()
 {
 	model->scale.z = 1.f;
 	model->scale.y = 1.f;
+	Manager::render.ReleaseSpriteSheet(model->textureName);
 	model->textureName = "";
 
-	spriteAnimation->Reset();
-	Manager::animation.RemoveAnimation(spriteAnimation);
+	Manager::animation.RemoveAnimation(spriteAnimationHandle);
 }
 
 void cBattleSprite::SpawnHitParticles()
@@ -13,8 +13,10 @@ public:
 	virtual ~cCharacterSprite();
 
 protected:
-	std::shared_ptr<cSpriteAnimation> spriteAnimation;
-	std::shared_ptr<cModelAnimation> modelAnimation;
+	sAnimationHandle spriteAnimationHandle;
+	sAnimationHandle modelAnimationHandle;
+	cSpriteAnimation* GetSpriteAnimation();
+	cModelAnimation* GetModelAnimation();
 public:
 	std::shared_ptr<cSpriteModel> model;
 	virtual glm::vec3 AnimateMovement(eDirection dir, bool run, eEntityMoveResult moveResult);
@@ -72,7 +74,7 @@ public:
 	void ClearSpriteData();
 
 protected:
-	std::shared_ptr<cPeriodicSpriteAnimation> spriteAnimation;
+	sAnimationHandle spriteAnimationHandle;
 	std::shared_ptr<cSpriteModel> model;
 
 protected:
@@ -1,6 +1,18 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <glm/glm.hpp>
+
+// Meshes are loaded as sVertexData and packed for the GPU in one of these layouts.
+// Ordered from most to least compact, a layout can hold anything the ones before it can
+enum eVertexLayout
+{
+	VERTEX_LAYOUT_PACKED_UNORM,	// sPackedVertexData, UVs as unorm16. Only when every UV is in 0..1
+	VERTEX_LAYOUT_PACKED_HALF,	// sPackedVertexData, UVs as half float
+	VERTEX_LAYOUT_FLOAT,		// sVertexData as is
+	VERTEX_LAYOUT_NUM
+};
 
 struct sVertexData
 {
@@ -10,16 +22,36 @@ struct sVertexData
 	float u1, v1, u2, v2;
 };
 
+// w, nw, u2 and v2 are constant so they're left to the attribute defaults
+struct sPackedVertexData
+{
+	float x, y, z;
+	uint32_t normal; // GL_INT_2_10_10_10_REV
+	uint16_t u, v;
+};
+
 struct sMeshDrawInfo
 {
 	unsigned int VAO_ID;
-	unsigned int VBO_ID;
-	unsigned int INDEX_ID;
+	eVertexLayout vertexLayout; // which mesh arena it lives in
+	unsigned int baseVertex; // where the mesh starts in the mesh arena
+	unsigned int firstIndex;
 
 	unsigned int numberOfVertices;
 	unsigned int numberOfIndices;
 	unsigned int numberOfTriangles;
 
+	glm::vec3 boundsMin; // local space
+	glm::vec3 boundsMax;
+
+	std::string textureName;
+};
+
+// A mesh built at runtime instead of loaded from a file
+struct sMeshGeometry
+{
+	std::vector<sVertexData> vertices;
+	std::vector<unsigned int> indices;
 	std::string textureName;
 };
 
@@ -28,5 +60,22 @@ struct sModelDrawInfo
 	unsigned int numMeshes;
 	unsigned int totalNumOfVertices;
 
+	glm::vec3 boundsMin; // local space, around every mesh
+	glm::vec3 boundsMax;
+
 	std::vector<sMeshDrawInfo> allMeshesData;
-};
\ No newline at end of file
+};
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct sDrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+// Index into cRenderManager's mesh registry. Stays valid after the mesh is unloaded and reloaded
+typedef unsigned int MeshHandle;
+const MeshHandle INVALID_MESH_HANDLE = 0xFFFFFFFF;
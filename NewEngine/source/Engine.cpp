@@ -24,10 +24,13 @@
 #include "cSceneManager.h"
 #include "cUIManager.h"
 #include "cInputManager.h"
+#include "cJobSystem.h"
 
 #include "PokemonData.h"
 
 #include "Player.h"
+#include "Benchmarks.h"
+#include "ParticleKernels.h"
 #include "cPlayerEntity.h"
 #include "cTamedRoamingPokemon.h"
 
@@ -227,6 +230,25 @@ void RenderImgui()
         }
 
         ImGui::DragFloat("Wind Speed", &Manager::scene.windSpeed, 0.01f, 0.01f, 10.f);
+        ImGui::Checkbox("GPU storm particles (next weather change)", &Manager::scene.useGpuStormParticles);
+
+        ParticleKernels::eKernel activeKernel = ParticleKernels::GetActiveKernel();
+        if (ImGui::BeginCombo("Particle kernel", ParticleKernels::GetKernelName(activeKernel)))
+        {
+            for (int n = 0; n < ParticleKernels::KERNELS_NUM; n++)
+            {
+                ParticleKernels::eKernel kernel = static_cast<ParticleKernels::eKernel>(n);
+                if (!ParticleKernels::IsKernelSupported(kernel)) continue;
+
+                const bool is_selected = (activeKernel == kernel);
+                if (ImGui::Selectable(ParticleKernels::GetKernelName(kernel), is_selected))
+                    ParticleKernels::SetActiveKernel(kernel);
+
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndCombo();
+        }
 
         if (ImGui::BeginTabBar("Tabs"))
         {
@@ -366,6 +388,123 @@ void RenderImgui()
         
     }
 
+    if (ImGui::CollapsingHeader("Render"))
+    {
+        ImGui::Checkbox("Sorted render queue", &Manager::render.useRenderQueue);
+
+        if (!Manager::render.IsIndirectDrawSupported()) ImGui::BeginDisabled();
+        ImGui::Checkbox("Indirect tile batches", &Manager::render.useIndirectTiles);
+        if (!Manager::render.IsIndirectDrawSupported()) ImGui::EndDisabled();
+        ImGui::Checkbox("Sprite array batch", &Manager::render.useSpriteArray);
+        ImGui::Text("Batched sprites: %u, sheet layers used: %u in %u arrays", Manager::render.GetSpriteBatchSize(), Manager::render.GetSpriteLayersUsed(), Manager::render.GetSpriteArraysNum());
+
+        const sRenderStats& stats = Manager::render.GetLastFrameStats();
+        ImGui::Text("Draw calls: %u", stats.drawCalls);
+        ImGui::Text("Program binds: %u", stats.programBinds);
+        ImGui::Text("Texture binds: %u", stats.textureBinds);
+        ImGui::Text("VAO binds: %u", stats.vaoBinds);
+        ImGui::Text("Uniform uploads: %u", stats.uniformUploads);
+
+        ImGui::Checkbox("Frustum culling", &Manager::render.useFrustumCulling);
+        ImGui::SliderFloat("Draw distance", &Manager::render.drawDistance, 0.f, 200.f);
+        ImGui::Text("Main pass: %u visible, %u culled", stats.mainPassVisible, stats.mainPassCulled);
+        ImGui::Text("Shadow pass: %u visible, %u culled", stats.shadowPassVisible, stats.shadowPassCulled);
+        ImGui::Text("Particle spawners culled: %u", stats.particleSpawnersCulled);
+        ImGui::Text("Instance buckets: %u drawn, %u culled", stats.instanceBucketsVisible, stats.instanceBucketsCulled);
+
+        ImGui::Checkbox("Shadow cache", &Manager::render.useShadowCache);
+        ImGui::SliderFloat("Shadow cache step", &Manager::render.shadowCacheStep, 0.f, 10.f);
+        ImGui::Text("Shadow pass: %.2f ms CPU, %.2f ms GPU, cache rebuilds: %u", Manager::render.GetShadowPassCpuMs(), Manager::render.GetShadowPassGpuMs(), Manager::render.GetShadowCacheRebuilds());
+
+        ImGui::Separator();
+        ImGui::Text("Mesh arenas (%u files)", Manager::render.GetArenaModelsNum());
+        const char* layoutNames[VERTEX_LAYOUT_NUM] = { "Packed unorm UV", "Packed half UV", "Float" };
+        unsigned int vertexBytes = 0;
+        unsigned int floatVertexBytes = 0;
+        for (unsigned int layout = 0; layout < VERTEX_LAYOUT_NUM; layout++)
+        {
+            const cMeshArena& arena = Manager::render.GetMeshArena((eVertexLayout)layout);
+            const cArenaAllocator& vertices = arena.GetVertexAllocator();
+            const cArenaAllocator& indices = arena.GetIndexAllocator();
+            vertexBytes += vertices.GetUsed() * arena.GetStride();
+            floatVertexBytes += vertices.GetUsed() * sizeof(sVertexData);
+
+            ImGui::Text("%s (%u bytes per vertex)", layoutNames[layout], arena.GetStride());
+            ImGui::Text("  Vertices: %u / %u (%.1f%%)", vertices.GetUsed(), vertices.GetCapacity(), vertices.GetCapacity() ? 100.f * vertices.GetUsed() / vertices.GetCapacity() : 0.f);
+            ImGui::Text("  Indices: %u / %u (%.1f%%)", indices.GetUsed(), indices.GetCapacity(), indices.GetCapacity() ? 100.f * indices.GetUsed() / indices.GetCapacity() : 0.f);
+            ImGui::Text("  Free ranges: %u / %u, fragmentation: %.2f / %.2f", vertices.GetFreeRangesNum(), indices.GetFreeRangesNum(), vertices.GetFragmentation(), indices.GetFragmentation());
+        }
+        ImGui::Text("Vertex memory: %.1f KB (%.1f KB as float)", vertexBytes / 1024.f, floatVertexBytes / 1024.f);
+        ImGui::Checkbox("Pack vertices on load", &Manager::render.usePackedVertices);
+        ImGui::Checkbox("Use cooked meshes", &Manager::render.useMeshCache);
+        ImGui::Checkbox("Use compiled maps", &Manager::map.useCompiledMaps);
+
+        ImGui::Separator();
+        const sAssetCacheStats& assetStats = Manager::render.GetAssetCacheStats();
+        ImGui::Checkbox("Keep assets between scenes", &Manager::render.useAssetCache);
+        ImGui::InputScalar("Asset cache budget (MB)", ImGuiDataType_U32, &Manager::render.assetCacheBudgetMb);
+        ImGui::Text("Assets: %u resident (%.1f MB), %u unreferenced (%.1f MB)", assetStats.assetsNum, assetStats.residentBytes / (1024.f * 1024.f), assetStats.pooledAssetsNum, assetStats.pooledBytes / (1024.f * 1024.f));
+        ImGui::Text("Hits: %u, misses: %u, evictions: %u", assetStats.hits, assetStats.misses, assetStats.evictions);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Reset")) Manager::render.ResetAssetCacheCounters();
+        ImGui::Checkbox("Decode sprite sheets on workers", &Manager::render.useAsyncTextureLoading);
+        ImGui::Text("Textures decoding: %u", Manager::render.GetPendingTextureLoadsNum());
+
+        ImGui::Separator();
+        ImGui::Checkbox("Stream quadrants (next map load)", &Manager::map.useQuadrantStreaming);
+        ImGui::SliderInt("Streaming radius", &Manager::map.streamingRadius, 1, 4);
+        ImGui::InputScalar("Streaming memory cap (KB)", ImGuiDataType_U32, &Manager::map.streamingMemoryCapKb);
+        ImGui::SliderFloat("Streaming upload budget (ms)", &Manager::map.streamingUploadBudgetMs, 0.25f, 8.f);
+        ImGui::SliderFloat("Main thread job budget (ms)", &Manager::jobs.mainThreadBudgetMs, 0.5f, 8.f);
+        if (Manager::map.IsStreaming())
+        {
+            const sStreamingStats& streaming = Manager::map.GetStreamingStats();
+            ImGui::Text("Quadrants: %u resident (%.1f KB), %u pending", streaming.residentQuadsNum, streaming.residentBytes / 1024.f, streaming.pendingQuadsNum);
+            ImGui::Text("Loaded: %u, evicted: %u, last tile upload: %.2f ms", streaming.loadedQuadsNum, streaming.evictedQuadsNum, streaming.lastUploadMs);
+            ImGui::Text("Quadrants waiting for upload: %u", streaming.queuedUploadsNum);
+        }
+        ImGui::Text("Job workers: %u, worker jobs: %u, main thread jobs: %u", Manager::jobs.GetWorkersNum(), Manager::jobs.GetWorkerJobsNum(), Manager::jobs.GetMainThreadJobsNum());
+
+        ImGui::Checkbox("Async scene transitions", &Manager::scene.useAsyncTransitions);
+        ImGui::SliderFloat("Transition upload budget (ms)", &Manager::scene.transitionBudgetMs, 1.f, 16.f);
+        const sSceneTransitionStats& transition = Manager::scene.GetTransitionStats();
+        ImGui::Text("Last transition: %.1f ms (prepare %.1f, upload %.1f over %u frames, unload %.1f, map %.1f over %u frames, finish %.1f)",
+            transition.totalMs, transition.prepareMs, transition.uploadMs, transition.uploadFrames, transition.unloadMs,
+            transition.loadMapMs, transition.loadMapFrames, transition.finishMs);
+
+        ImGui::Separator();
+        ImGui::Text("Benchmarks");
+        if (ImGui::Button("Uniform sets")) Benchmark::UniformSets();
+        ImGui::SameLine();
+        if (ImGui::Button("DrawFrame allocations")) Benchmark::DrawFrameAllocations();
+        ImGui::SameLine();
+        if (ImGui::Button("Model loading")) Benchmark::ModelLoading();
+        ImGui::SameLine();
+        if (ImGui::Button("Map loading")) Benchmark::MapLoading();
+        if (ImGui::Button("Tile lookups")) Benchmark::TileLookups();
+        ImGui::SameLine();
+        if (ImGui::Button("Quad lookups")) Benchmark::QuadLookups();
+        ImGui::SameLine();
+        if (ImGui::Button("Texture loading")) Benchmark::TextureLoading();
+        if (ImGui::Button("Shadow pass cost")) Benchmark::ShadowPassCost();
+        ImGui::SameLine();
+        if (ImGui::Button("Particle update")) Benchmark::ParticleUpdate();
+        ImGui::SameLine();
+        if (ImGui::Button("Particle kernels")) Benchmark::ParticleSimulation();
+        ImGui::SameLine();
+        if (ImGui::Button("Random draws")) Benchmark::RandomDraws();
+        ImGui::SameLine();
+        if (ImGui::Button("Animations")) Benchmark::Animations();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear")) Benchmark::ClearResults();
+
+        const std::vector<Benchmark::sResult>& results = Benchmark::GetResults();
+        for (unsigned int i = 0; i < results.size(); i++)
+        {
+            ImGui::Text("%s: %.3f %s", results[i].name.c_str(), results[i].value, results[i].unit.c_str());
+        }
+    }
+
     ImGui::End();
 
     ImGui::Render();
@@ -389,6 +528,7 @@ namespace Manager
     cSceneManager scene;
     cUIManager ui;
     cInputManager input;
+    cJobSystem jobs;
 }
 
 namespace Engine
@@ -447,6 +587,8 @@ namespace Engine
         //cSceneManager::GetInstance();
         //cUIManager::GetInstance();
 
+        Manager::jobs.Startup();
+
         Manager::light.Startup();
 
         Manager::render.Startup();
@@ -488,6 +630,9 @@ namespace Engine
         //cUIManager::DestroyInstance();
         //cAnimationManager::DestroyInstance();
 
+        // Nothing queued can run past this point
+        Manager::jobs.Shutdown();
+
         Manager::light.Shutdown();
 
         Manager::map.Shutdown();
@@ -521,9 +666,18 @@ namespace Engine
 
             Manager::animation.Process(deltaTime);
 
+            Manager::map.UpdateTileModels(deltaTime);
+
             Manager::scene.Process(deltaTime);
 
+            Manager::jobs.ProcessMainThreadJobs();
+
+            Manager::map.UpdateStreaming();
+
+            unsigned long long allocationsBefore = Benchmark::GetAllocationCount();
             Manager::render.DrawFrame();
+            Benchmark::TrackDrawFrameAllocations(Benchmark::GetAllocationCount() - allocationsBefore);
+            Benchmark::TrackShadowPass();
 
             if (renderDebugInfo) RenderImgui();
 
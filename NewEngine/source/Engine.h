@@ -10,6 +10,7 @@ class cMapManager;
 class cSceneManager;
 class cUIManager;
 class cInputManager;
+class cJobSystem;
 
 namespace Manager
 {
@@ -21,6 +22,7 @@ namespace Manager
 	extern cSceneManager scene;
 	extern cUIManager ui;
 	extern cInputManager input;
+	extern cJobSystem jobs;
 }
 
 enum eGameMode
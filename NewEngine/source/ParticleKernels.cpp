@@ -0,0 +1,411 @@
+#include "ParticleKernels.h"
+
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PARTICLE_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits any intrinsic, GCC and Clang need the function marked for the wider instruction set
+#if defined(__GNUC__)
+#define SSE_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define SSE_TARGET
+#define AVX2_TARGET
+#endif
+
+namespace ParticleKernels
+{
+	static eKernel activeKernel = KERNELS_NUM; // picked on first use
+
+	// The scalar kernel, also used for what's left after the last full group of the SIMD ones
+	static unsigned int IntegrateRange(const sParticleArrays& particles, unsigned int first, unsigned int end, unsigned int aliveNum,
+		float deltaTime, const glm::vec3& gravityStep, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		for (unsigned int i = first; i < end; i++)
+		{
+			float timer = particles.timers[i] + deltaTime;
+			if (timer > lifeTime) continue;
+
+			float velocityX = particles.velocitiesX[i];
+			float velocityY = particles.velocitiesY[i];
+			float velocityZ = particles.velocitiesZ[i];
+
+			glm::vec3 position = glm::vec3(particles.positionsX[i] + velocityX * deltaTime,
+				particles.positionsY[i] + velocityY * deltaTime,
+				particles.positionsZ[i] + velocityZ * deltaTime);
+
+			particles.positionsX[aliveNum] = position.x;
+			particles.positionsY[aliveNum] = position.y;
+			particles.positionsZ[aliveNum] = position.z;
+			particles.velocitiesX[aliveNum] = velocityX + gravityStep.x;
+			particles.velocitiesY[aliveNum] = velocityY + gravityStep.y;
+			particles.velocitiesZ[aliveNum] = velocityZ + gravityStep.z;
+			particles.timers[aliveNum] = timer;
+			aliveNum++;
+
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+
+		return aliveNum;
+	}
+
+	unsigned int IntegrateScalar(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		return IntegrateRange(particles, 0, particlesNum, 0, deltaTime, gravity * deltaTime, lifeTime, boundsMin, boundsMax);
+	}
+
+#ifdef PARTICLE_KERNELS_X86
+	SSE_TARGET static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	SSE_TARGET unsigned int IntegrateSSE(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		glm::vec3 gravityStep = gravity * deltaTime;
+
+		__m128 step = _mm_set1_ps(deltaTime);
+		__m128 life = _mm_set1_ps(lifeTime);
+		__m128 gravityStepX = _mm_set1_ps(gravityStep.x);
+		__m128 gravityStepY = _mm_set1_ps(gravityStep.y);
+		__m128 gravityStepZ = _mm_set1_ps(gravityStep.z);
+		__m128 minX = _mm_set1_ps(boundsMin.x), minY = _mm_set1_ps(boundsMin.y), minZ = _mm_set1_ps(boundsMin.z);
+		__m128 maxX = _mm_set1_ps(boundsMax.x), maxY = _mm_set1_ps(boundsMax.y), maxZ = _mm_set1_ps(boundsMax.z);
+
+		unsigned int aliveNum = 0;
+		unsigned int i = 0;
+		for (; i + 4 <= particlesNum; i += 4)
+		{
+			__m128 timer = _mm_add_ps(_mm_load_ps(particles.timers + i), step);
+			__m128 alive = _mm_cmpngt_ps(timer, life); // same test as the scalar one, NaN included
+			int aliveMask = _mm_movemask_ps(alive);
+			if (aliveMask == 0) continue;
+
+			__m128 velocityX = _mm_load_ps(particles.velocitiesX + i);
+			__m128 velocityY = _mm_load_ps(particles.velocitiesY + i);
+			__m128 velocityZ = _mm_load_ps(particles.velocitiesZ + i);
+			__m128 positionX = _mm_add_ps(_mm_load_ps(particles.positionsX + i), _mm_mul_ps(velocityX, step));
+			__m128 positionY = _mm_add_ps(_mm_load_ps(particles.positionsY + i), _mm_mul_ps(velocityY, step));
+			__m128 positionZ = _mm_add_ps(_mm_load_ps(particles.positionsZ + i), _mm_mul_ps(velocityZ, step));
+			velocityX = _mm_add_ps(velocityX, gravityStepX);
+			velocityY = _mm_add_ps(velocityY, gravityStepY);
+			velocityZ = _mm_add_ps(velocityZ, gravityStepZ);
+
+			// Candidate first: min/max return the second operand on NaN, like glm::min/max keep the bound
+			minX = _mm_min_ps(Select(alive, positionX, minX), minX);
+			minY = _mm_min_ps(Select(alive, positionY, minY), minY);
+			minZ = _mm_min_ps(Select(alive, positionZ, minZ), minZ);
+			maxX = _mm_max_ps(Select(alive, positionX, maxX), maxX);
+			maxY = _mm_max_ps(Select(alive, positionY, maxY), maxY);
+			maxZ = _mm_max_ps(Select(alive, positionZ, maxZ), maxZ);
+
+			// Writes never pass the group being read, so compacting in place is safe
+			if (aliveMask == 0xF)
+			{
+				_mm_storeu_ps(particles.positionsX + aliveNum, positionX);
+				_mm_storeu_ps(particles.positionsY + aliveNum, positionY);
+				_mm_storeu_ps(particles.positionsZ + aliveNum, positionZ);
+				_mm_storeu_ps(particles.velocitiesX + aliveNum, velocityX);
+				_mm_storeu_ps(particles.velocitiesY + aliveNum, velocityY);
+				_mm_storeu_ps(particles.velocitiesZ + aliveNum, velocityZ);
+				_mm_storeu_ps(particles.timers + aliveNum, timer);
+				aliveNum += 4;
+				continue;
+			}
+
+			// SSE2 has no variable shuffle, survivors of a partly dead group are moved one by one
+			alignas(16) float lanes[7][4];
+			_mm_store_ps(lanes[0], positionX);
+			_mm_store_ps(lanes[1], positionY);
+			_mm_store_ps(lanes[2], positionZ);
+			_mm_store_ps(lanes[3], velocityX);
+			_mm_store_ps(lanes[4], velocityY);
+			_mm_store_ps(lanes[5], velocityZ);
+			_mm_store_ps(lanes[6], timer);
+			for (unsigned int lane = 0; lane < 4; lane++)
+			{
+				if ((aliveMask & (1 << lane)) == 0) continue;
+
+				particles.positionsX[aliveNum] = lanes[0][lane];
+				particles.positionsY[aliveNum] = lanes[1][lane];
+				particles.positionsZ[aliveNum] = lanes[2][lane];
+				particles.velocitiesX[aliveNum] = lanes[3][lane];
+				particles.velocitiesY[aliveNum] = lanes[4][lane];
+				particles.velocitiesZ[aliveNum] = lanes[5][lane];
+				particles.timers[aliveNum] = lanes[6][lane];
+				aliveNum++;
+			}
+		}
+
+		alignas(16) float bounds[6][4];
+		_mm_store_ps(bounds[0], minX); _mm_store_ps(bounds[1], minY); _mm_store_ps(bounds[2], minZ);
+		_mm_store_ps(bounds[3], maxX); _mm_store_ps(bounds[4], maxY); _mm_store_ps(bounds[5], maxZ);
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			boundsMin = glm::min(boundsMin, glm::vec3(bounds[0][lane], bounds[1][lane], bounds[2][lane]));
+			boundsMax = glm::max(boundsMax, glm::vec3(bounds[3][lane], bounds[4][lane], bounds[5][lane]));
+		}
+
+		return IntegrateRange(particles, i, particlesNum, aliveNum, deltaTime, gravityStep, lifeTime, boundsMin, boundsMax);
+	}
+
+	// For every alive mask of a group of 8, the lanes to gather so the survivors end up packed at the front
+	struct sCompactTable
+	{
+		int lanes[256][8];
+		unsigned int counts[256];
+	};
+
+	static sCompactTable BuildCompactTable()
+	{
+		sCompactTable table;
+		for (unsigned int mask = 0; mask < 256; mask++)
+		{
+			unsigned int count = 0;
+			for (unsigned int lane = 0; lane < 8; lane++)
+			{
+				if (mask & (1 << lane)) table.lanes[mask][count++] = lane;
+			}
+			table.counts[mask] = count;
+
+			for (unsigned int lane = count; lane < 8; lane++)
+			{
+				table.lanes[mask][lane] = 0;
+			}
+		}
+		return table;
+	}
+
+	static const sCompactTable compactTable = BuildCompactTable();
+
+	AVX2_TARGET unsigned int IntegrateAVX2(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		glm::vec3 gravityStep = gravity * deltaTime;
+
+		__m256 step = _mm256_set1_ps(deltaTime);
+		__m256 life = _mm256_set1_ps(lifeTime);
+		__m256 gravityStepX = _mm256_set1_ps(gravityStep.x);
+		__m256 gravityStepY = _mm256_set1_ps(gravityStep.y);
+		__m256 gravityStepZ = _mm256_set1_ps(gravityStep.z);
+		__m256 minX = _mm256_set1_ps(boundsMin.x), minY = _mm256_set1_ps(boundsMin.y), minZ = _mm256_set1_ps(boundsMin.z);
+		__m256 maxX = _mm256_set1_ps(boundsMax.x), maxY = _mm256_set1_ps(boundsMax.y), maxZ = _mm256_set1_ps(boundsMax.z);
+
+		unsigned int aliveNum = 0;
+		unsigned int i = 0;
+		for (; i + 8 <= particlesNum; i += 8)
+		{
+			__m256 timer = _mm256_add_ps(_mm256_load_ps(particles.timers + i), step);
+			__m256 alive = _mm256_cmp_ps(timer, life, _CMP_NGT_UQ); // same test as the scalar one, NaN included
+			int aliveMask = _mm256_movemask_ps(alive);
+			if (aliveMask == 0) continue;
+
+			__m256 velocityX = _mm256_load_ps(particles.velocitiesX + i);
+			__m256 velocityY = _mm256_load_ps(particles.velocitiesY + i);
+			__m256 velocityZ = _mm256_load_ps(particles.velocitiesZ + i);
+			__m256 positionX = _mm256_add_ps(_mm256_load_ps(particles.positionsX + i), _mm256_mul_ps(velocityX, step));
+			__m256 positionY = _mm256_add_ps(_mm256_load_ps(particles.positionsY + i), _mm256_mul_ps(velocityY, step));
+			__m256 positionZ = _mm256_add_ps(_mm256_load_ps(particles.positionsZ + i), _mm256_mul_ps(velocityZ, step));
+			velocityX = _mm256_add_ps(velocityX, gravityStepX);
+			velocityY = _mm256_add_ps(velocityY, gravityStepY);
+			velocityZ = _mm256_add_ps(velocityZ, gravityStepZ);
+
+			// Candidate first, a NaN position leaves the bound alone as in the scalar kernel
+			minX = _mm256_min_ps(_mm256_blendv_ps(minX, positionX, alive), minX);
+			minY = _mm256_min_ps(_mm256_blendv_ps(minY, positionY, alive), minY);
+			minZ = _mm256_min_ps(_mm256_blendv_ps(minZ, positionZ, alive), minZ);
+			maxX = _mm256_max_ps(_mm256_blendv_ps(maxX, positionX, alive), maxX);
+			maxY = _mm256_max_ps(_mm256_blendv_ps(maxY, positionY, alive), maxY);
+			maxZ = _mm256_max_ps(_mm256_blendv_ps(maxZ, positionZ, alive), maxZ);
+
+			// Survivors packed at the front of the group. The whole group is stored, the lanes past the
+			// survivors land on particles already read and get overwritten later
+			__m256i gather = _mm256_loadu_si256((const __m256i*)compactTable.lanes[aliveMask]);
+			_mm256_storeu_ps(particles.positionsX + aliveNum, _mm256_permutevar8x32_ps(positionX, gather));
+			_mm256_storeu_ps(particles.positionsY + aliveNum, _mm256_permutevar8x32_ps(positionY, gather));
+			_mm256_storeu_ps(particles.positionsZ + aliveNum, _mm256_permutevar8x32_ps(positionZ, gather));
+			_mm256_storeu_ps(particles.velocitiesX + aliveNum, _mm256_permutevar8x32_ps(velocityX, gather));
+			_mm256_storeu_ps(particles.velocitiesY + aliveNum, _mm256_permutevar8x32_ps(velocityY, gather));
+			_mm256_storeu_ps(particles.velocitiesZ + aliveNum, _mm256_permutevar8x32_ps(velocityZ, gather));
+			_mm256_storeu_ps(particles.timers + aliveNum, _mm256_permutevar8x32_ps(timer, gather));
+			aliveNum += compactTable.counts[aliveMask];
+		}
+
+		alignas(32) float bounds[6][8];
+		_mm256_store_ps(bounds[0], minX); _mm256_store_ps(bounds[1], minY); _mm256_store_ps(bounds[2], minZ);
+		_mm256_store_ps(bounds[3], maxX); _mm256_store_ps(bounds[4], maxY); _mm256_store_ps(bounds[5], maxZ);
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			boundsMin = glm::min(boundsMin, glm::vec3(bounds[0][lane], bounds[1][lane], bounds[2][lane]));
+			boundsMax = glm::max(boundsMax, glm::vec3(bounds[3][lane], bounds[4][lane], bounds[5][lane]));
+		}
+
+		return IntegrateRange(particles, i, particlesNum, aliveNum, deltaTime, gravityStep, lifeTime, boundsMin, boundsMax);
+	}
+
+	static bool DetectSSE()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true; // part of x64
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	static bool DetectAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// The OS has to save the YMM registers too, not just the CPU have them
+		__cpuid(info, 1);
+		bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+		bool hasAVX = (info[2] & (1 << 28)) != 0;
+		if (!hasOSXSave || !hasAVX || (_xgetbv(0) & 6) != 6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#else
+	unsigned int IntegrateSSE(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		return IntegrateScalar(particles, particlesNum, deltaTime, gravity, lifeTime, boundsMin, boundsMax);
+	}
+
+	unsigned int IntegrateAVX2(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		return IntegrateScalar(particles, particlesNum, deltaTime, gravity, lifeTime, boundsMin, boundsMax);
+	}
+
+	static bool DetectSSE() { return false; }
+	static bool DetectAVX2() { return false; }
+#endif
+
+	bool IsKernelSupported(eKernel kernel)
+	{
+		static const bool isSSESupported = DetectSSE();
+		static const bool isAVX2Supported = DetectAVX2();
+
+		switch (kernel)
+		{
+		case SCALAR_KERNEL:
+			return true;
+		case SSE_KERNEL:
+			return isSSESupported;
+		case AVX2_KERNEL:
+			return isAVX2Supported;
+		default:
+			return false;
+		}
+	}
+
+	const char* GetKernelName(eKernel kernel)
+	{
+		switch (kernel)
+		{
+		case SCALAR_KERNEL:
+			return "Scalar";
+		case SSE_KERNEL:
+			return "SSE2";
+		case AVX2_KERNEL:
+			return "AVX2";
+		default:
+			return "None";
+		}
+	}
+
+	KernelFunction GetKernelFunction(eKernel kernel)
+	{
+		if (!IsKernelSupported(kernel)) return IntegrateScalar;
+
+		switch (kernel)
+		{
+		case SSE_KERNEL:
+			return IntegrateSSE;
+		case AVX2_KERNEL:
+			return IntegrateAVX2;
+		default:
+			return IntegrateScalar;
+		}
+	}
+
+	eKernel GetActiveKernel()
+	{
+		if (activeKernel == KERNELS_NUM)
+		{
+			activeKernel = SCALAR_KERNEL;
+			if (IsKernelSupported(SSE_KERNEL)) activeKernel = SSE_KERNEL;
+			if (IsKernelSupported(AVX2_KERNEL)) activeKernel = AVX2_KERNEL;
+		}
+
+		return activeKernel;
+	}
+
+	void SetActiveKernel(eKernel kernel)
+	{
+		if (kernel < KERNELS_NUM && IsKernelSupported(kernel)) activeKernel = kernel;
+	}
+
+	unsigned int TrackGpuSpawns(std::deque<sGpuSpawnBatch>& batches, float deltaTime, float lifeTime, unsigned int spawnsNum,
+		const glm::vec3& origin, unsigned int maxParticles, glm::vec3& originMinOut, glm::vec3& originMaxOut)
+	{
+		// Same timer the shader keeps, a frame late so a batch is only dropped once the GPU surely killed it
+		while (!batches.empty() && batches.front().age > lifeTime)
+		{
+			batches.pop_front();
+		}
+		for (unsigned int i = 0; i < batches.size(); i++)
+		{
+			batches[i].age += deltaTime;
+		}
+		if (spawnsNum > 0) batches.push_back({ deltaTime, spawnsNum, origin });
+
+		unsigned int liveNum = 0;
+		originMinOut = glm::vec3(FLT_MAX);
+		originMaxOut = glm::vec3(-FLT_MAX);
+		for (unsigned int i = 0; i < batches.size(); i++)
+		{
+			liveNum += batches[i].spawnsNum;
+			originMinOut = glm::min(originMinOut, batches[i].origin);
+			originMaxOut = glm::max(originMaxOut, batches[i].origin);
+		}
+
+		return glm::min(liveNum, maxParticles);
+	}
+
+	unsigned int GetGpuFirstLiveSlot(unsigned int spawnsTotal, unsigned int liveNum, unsigned int maxParticles)
+	{
+		return maxParticles ? (spawnsTotal - liveNum) % maxParticles : 0;
+	}
+
+	void GetGpuTravelBounds(const glm::vec3& speedMin, const glm::vec3& speedMax, const glm::vec3& gravity, float lifeTime,
+		glm::vec3& travelMinOut, glm::vec3& travelMaxOut)
+	{
+		// The shader steps position by the old velocity, so a particle t seconds old moved v * t + gravity * s with s
+		// between 0 and t * t / 2. The lower end is concave and the upper end convex in t, both peak at 0 or the lifetime
+		glm::vec3 fallMin = glm::min(gravity, glm::vec3(0.f)) * (lifeTime * lifeTime * 0.5f);
+		glm::vec3 fallMax = glm::max(gravity, glm::vec3(0.f)) * (lifeTime * lifeTime * 0.5f);
+		travelMinOut = glm::min(speedMin * lifeTime + fallMin, glm::vec3(0.f));
+		travelMaxOut = glm::max(speedMax * lifeTime + fallMax, glm::vec3(0.f));
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <deque>
+
+// One array per component. Every array is PARTICLE_ARRAY_ALIGNMENT aligned and padded to a multiple of
+// PARTICLE_KERNEL_WIDTH, so the kernels can load and store a whole group past the last particle
+struct sParticleArrays
+{
+	float* positionsX;
+	float* positionsY;
+	float* positionsZ;
+	float* velocitiesX;
+	float* velocitiesY;
+	float* velocitiesZ;
+	float* timers;
+};
+
+const unsigned int PARTICLE_ARRAY_ALIGNMENT = 32;
+const unsigned int PARTICLE_KERNEL_WIDTH = 8;
+
+// Particles spawned on the GPU in one update, kept until they all died to know which slots are live and where
+struct sGpuSpawnBatch
+{
+	float age;
+	unsigned int spawnsNum;
+	glm::vec3 origin;
+};
+
+namespace ParticleKernels
+{
+	enum eKernel
+	{
+		SCALAR_KERNEL,
+		SSE_KERNEL,
+		AVX2_KERNEL,
+		KERNELS_NUM
+	};
+
+	// Advances every particle by deltaTime, drops the ones past lifeTime keeping the order of the rest
+	// and grows the bounds around the survivors. Returns how many are left. All kernels give the same bits
+	typedef unsigned int (*KernelFunction)(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	unsigned int IntegrateScalar(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax);
+	unsigned int IntegrateSSE(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax);
+	unsigned int IntegrateAVX2(const sParticleArrays& particles, unsigned int particlesNum, float deltaTime,
+		const glm::vec3& gravity, float lifeTime, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	// CPUID, checked once
+	bool IsKernelSupported(eKernel kernel);
+	const char* GetKernelName(eKernel kernel);
+	KernelFunction GetKernelFunction(eKernel kernel);
+
+	// Used by every spawner, starts as the widest one this CPU runs. Unsupported ones are ignored
+	eKernel GetActiveKernel();
+	void SetActiveKernel(eKernel kernel);
+
+	// What the CPU keeps of a GPU simulated spawner instead of reading its buffers back, no GL so the tests can run it.
+	// Called after every update with its spawns, ages the batches like the update shader ages its particles and returns
+	// how many of the latest spawns' ring slots can hold a live particle, with the box their spawn origins span
+	unsigned int TrackGpuSpawns(std::deque<sGpuSpawnBatch>& batches, float deltaTime, float lifeTime, unsigned int spawnsNum,
+		const glm::vec3& origin, unsigned int maxParticles, glm::vec3& originMinOut, glm::vec3& originMaxOut);
+	// Ring slot the oldest of the last liveNum spawns went to, the update shader fills the ring from slot 0 in spawn order
+	unsigned int GetGpuFirstLiveSlot(unsigned int spawnsTotal, unsigned int liveNum, unsigned int maxParticles);
+	// Farthest a particle gets from its spawn position in a lifetime with the update shader's integration
+	void GetGpuTravelBounds(const glm::vec3& speedMin, const glm::vec3& speedMax, const glm::vec3& gravity, float lifeTime,
+		glm::vec3& travelMinOut, glm::vec3& travelMaxOut);
+}
@@ -3,6 +3,10 @@
 #include "Engine.h"
 #include "cRenderManager.h"
 #include "cSceneManager.h"
+#include "cAnimationManager.h"
+
+// Timers used to go up 0.0043 per draw, this is that at 60 frames a second
+static const float TIMER_SPEED = 0.258f;
 
 cAnimatedModel::cAnimatedModel()
 {
@@ -12,90 +16,136 @@ cAnimatedModel::~cAnimatedModel()
 {
 }
 
+void cAnimatedModel::StartAnimation()
+{
+}
+
+void cAnimatedModel::Update(float /*deltaTime*/)
+{
+}
+
+void cAnimatedModel::StopAnimation()
+{
+	Manager::animation.RemoveAnimation(animationHandle);
+	animationHandle = sAnimationHandle();
+}
+
 cFoamModel::cFoamModel()
 {
-	shaderName = "foam";
+	SetShaderName("foam");
 	textureOffset = glm::vec3(0);
-
-	animation = std::make_shared<cSinAnimation>(textureOffset, 2, 0);
-	std::static_pointer_cast<cSinAnimation>(animation)->AddKeyFrame(sKeyFrameVec3(7.f, glm::vec3(360.f, 0.f, 0.f)));
-	animation->isRepeat = true;
 }
 
 cFoamModel::~cFoamModel()
 {
 }
 
+void cFoamModel::StartAnimation()
+{
+	cSinAnimation animation(textureOffset, 2, 0);
+	animation.AddKeyFrame(sKeyFrameVec3(7.f, glm::vec3(360.f, 0.f, 0.f)));
+	animation.isRepeat = true;
+	animationHandle = Manager::animation.AddAnimation(animation);
+}
+
 void cFoamModel::SetUpUniforms()
 {
-	Manager::render.setVec2("UVoffset", textureOffset);
+	static const unsigned int UVoffsetHandle = Manager::render.GetUniformHandle("UVoffset");
+
+	Manager::render.setVec2(UVoffsetHandle, textureOffset);
 }
 
 cOceanModel::cOceanModel()
 {
-	shaderName = "ocean";
+	SetShaderName("ocean");
 	globalUVRatios = glm::vec2(0.35f);
 	textureOffset = glm::vec3(0.f);
 	timer = 0.f;
-
-	animation = std::make_shared<cSinAnimation>(textureOffset, 0.5f, 0);
-	std::shared_ptr<cSinAnimation> waterOscilate = std::static_pointer_cast<cSinAnimation>(animation);
-	waterOscilate->AddKeyFrame(sKeyFrameVec3(6.f, glm::vec3(360.f, 180.f, 0.f)));
-	waterOscilate->AddKeyFrame(sKeyFrameVec3(12.f, glm::vec3(720.f, 360.f, 0.f)));
-	waterOscilate->isRepeat = true;
 }
 
 cOceanModel::~cOceanModel()
 {
 }
 
+void cOceanModel::StartAnimation()
+{
+	cSinAnimation waterOscilate(textureOffset, 0.5f, 0);
+	waterOscilate.AddKeyFrame(sKeyFrameVec3(6.f, glm::vec3(360.f, 180.f, 0.f)));
+	waterOscilate.AddKeyFrame(sKeyFrameVec3(12.f, glm::vec3(720.f, 360.f, 0.f)));
+	waterOscilate.isRepeat = true;
+	animationHandle = Manager::animation.AddAnimation(waterOscilate);
+}
+
+void cOceanModel::Update(float deltaTime)
+{
+	timer += deltaTime * TIMER_SPEED;
+}
+
 void cOceanModel::SetUpUniforms()
 {
-	// TODO: use deltaTime for the love of god (and in other animated models)
-	timer += 0.0043f;
+	static const unsigned int globalUVRatiosHandle = Manager::render.GetUniformHandle("globalUVRatios");
+	static const unsigned int UVoffsetHandle = Manager::render.GetUniformHandle("UVoffset");
+	static const unsigned int timerHandle = Manager::render.GetUniformHandle("timer");
 
-	Manager::render.setVec2("globalUVRatios", globalUVRatios);
-	Manager::render.setVec2("UVoffset", textureOffset);
-	Manager::render.setFloat("timer", timer);
+	Manager::render.setVec2(globalUVRatiosHandle, globalUVRatios);
+	Manager::render.setVec2(UVoffsetHandle, textureOffset);
+	Manager::render.setFloat(timerHandle, timer);
 }
 
 cWaveModel::cWaveModel()
 {
-	shaderName = "wave";
+	SetShaderName("wave");
 	textureOffset = glm::vec3(0);
 	timer = 0.f;
-
-	animation = std::make_shared<cSinAnimation>(textureOffset, 2, 0);
-	std::static_pointer_cast<cSinAnimation>(animation)->AddKeyFrame(sKeyFrameVec3(7.f, glm::vec3(360.f, 0.f, 0.f)));
-	animation->isRepeat = true;
 }
 
 cWaveModel::~cWaveModel()
 {
 }
 
+void cWaveModel::StartAnimation()
+{
+	cSinAnimation animation(textureOffset, 2, 0);
+	animation.AddKeyFrame(sKeyFrameVec3(7.f, glm::vec3(360.f, 0.f, 0.f)));
+	animation.isRepeat = true;
+	animationHandle = Manager::animation.AddAnimation(animation);
+}
+
+void cWaveModel::Update(float deltaTime)
+{
+	timer += deltaTime * TIMER_SPEED;
+}
+
 void cWaveModel::SetUpUniforms()
 {
-	timer += 0.0043f;
+	static const unsigned int UVoffsetHandle = Manager::render.GetUniformHandle("UVoffset");
+	static const unsigned int timerHandle = Manager::render.GetUniformHandle("timer");
 
-	Manager::render.setVec2("UVoffset", textureOffset);
-	Manager::render.setFloat("timer", timer);
+	Manager::render.setVec2(UVoffsetHandle, textureOffset);
+	Manager::render.setFloat(timerHandle, timer);
 }
 
 cTreeModel::cTreeModel()
 {
-	shaderName = "tree";
+	SetShaderName("tree");
 	timer = 0.f;
+	isDynamicShadowCaster = true; // sways in the shadow pass too
 }
 
 cTreeModel::~cTreeModel()
 {
 }
 
+void cTreeModel::Update(float deltaTime)
+{
+	timer += deltaTime * TIMER_SPEED;
+}
+
 void cTreeModel::SetUpUniforms()
 {
-	timer += 0.0043f;
+	static const unsigned int timerHandle = Manager::render.GetUniformHandle("timer");
+	static const unsigned int windSpeedHandle = Manager::render.GetUniformHandle("windSpeed");
 
-	Manager::render.setFloat("timer", timer);
-	Manager::render.setFloat("windSpeed", Manager::scene.windSpeed);
+	Manager::render.setFloat(timerHandle, timer);
+	Manager::render.setFloat(windSpeedHandle, Manager::scene.windSpeed);
 }
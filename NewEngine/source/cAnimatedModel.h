@@ -6,10 +6,17 @@
 class cAnimatedModel : public cRenderModel
 {
 public:
-	std::shared_ptr<cAnimation> animation;
+	sAnimationHandle animationHandle;
 
 	cAnimatedModel();
 	~cAnimatedModel();
+
+	// Adds the model's animation to the animation manager, called when the model first gets instances
+	virtual void StartAnimation();
+	void StopAnimation();
+
+	// Called once a frame for every tile model, SetUpUniforms only reads what this advanced
+	virtual void Update(float deltaTime);
 };
 
 class cFoamModel : public cAnimatedModel
@@ -22,6 +29,7 @@ public:
 	~cFoamModel();
 
 	virtual void SetUpUniforms();
+	virtual void StartAnimation();
 };
 
 class cOceanModel : public cAnimatedModel
@@ -36,6 +44,8 @@ public:
 	~cOceanModel();
 
 	virtual void SetUpUniforms();
+	virtual void Update(float deltaTime);
+	virtual void StartAnimation();
 };
 
 class cWaveModel : public cAnimatedModel
@@ -49,6 +59,8 @@ public:
 	~cWaveModel();
 
 	virtual void SetUpUniforms();
+	virtual void Update(float deltaTime);
+	virtual void StartAnimation();
 };
 
 class cTreeModel : public cAnimatedModel
@@ -62,4 +74,5 @@ public:
 	~cTreeModel();
 
 	virtual void SetUpUniforms();
+	virtual void Update(float deltaTime);
 };
\ No newline at end of file
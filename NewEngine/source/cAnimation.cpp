@@ -10,10 +10,6 @@ cAnimation::cAnimation()
 	removeAfterComplete = false;
 }
 
-cAnimation::~cAnimation()
-{
-}
-
 void cAnimation::Reset()
 {
 	timer = 0.f;
@@ -23,7 +19,7 @@ void cAnimation::Reset()
 }
 
 cFloatAnimation::cFloatAnimation(float& _valueRef) :
-	valueRef(_valueRef)
+	valuePtr(&_valueRef)
 {
 	initValue = _valueRef;
 }
@@ -64,7 +60,7 @@ void cFloatAnimation::Process(float deltaTime)
 			fraction = (timer - currKeyframe.time) / (nextKeyframe.time - currKeyframe.time);
 
 			float newValue = currKeyframe.value + (nextKeyframe.value - currKeyframe.value) * fraction;
-			valueRef = newValue;
+			*valuePtr = newValue;
 
 			break;
 		}
@@ -73,12 +69,12 @@ void cFloatAnimation::Process(float deltaTime)
 	if (keyframes.size() != 0 && timer >= maxDuration)
 	{
 		float finalDegree = keyframes[keyframes.size() - 1].value;
-		valueRef = finalDegree;		
+		*valuePtr = finalDegree;		
 	}
 }
 
 cVec2Animation::cVec2Animation(glm::vec2& _valueRef) :
-	valueRef(_valueRef)
+	valuePtr(&_valueRef)
 {
 	initValue = _valueRef;
 }
@@ -119,7 +115,7 @@ void cVec2Animation::Process(float deltaTime)
 			fraction = (timer - currKeyframe.time) / (nextKeyframe.time - currKeyframe.time);
 
 			glm::vec2 newValue = currKeyframe.value + (nextKeyframe.value - currKeyframe.value) * fraction;
-			valueRef = newValue;
+			*valuePtr = newValue;
 
 			break;
 		}
@@ -128,12 +124,12 @@ void cVec2Animation::Process(float deltaTime)
 	if (keyframes.size() != 0 && timer >= maxDuration)
 	{
 		glm::vec2 finalValue = keyframes[keyframes.size() - 1].value;
-		valueRef = finalValue;
+		*valuePtr = finalValue;
 	}
 }
 
 cVec3Animation::cVec3Animation(glm::vec3& _valueRef) :
-	valueRef(_valueRef)
+	valuePtr(&_valueRef)
 {
 	initValue = _valueRef;
 }
@@ -174,7 +170,7 @@ void cVec3Animation::Process(float deltaTime)
 			fraction = (timer - currKeyframe.time) / (nextKeyframe.time - currKeyframe.time);
 
 			glm::vec3 newValue = currKeyframe.value + (nextKeyframe.value - currKeyframe.value) * fraction;
-			valueRef = newValue;
+			*valuePtr = newValue;
 
 			break;
 		}
@@ -183,12 +179,12 @@ void cVec3Animation::Process(float deltaTime)
 	if (keyframes.size() != 0 && timer >= maxDuration)
 	{
 		glm::vec3 finalValue = keyframes[keyframes.size() - 1].value;
-		valueRef = finalValue;
+		*valuePtr = finalValue;
 	}
 }
 
 cVec4Animation::cVec4Animation(glm::vec4& _valueRef) :
-	valueRef(_valueRef)
+	valuePtr(&_valueRef)
 {
 	initValue = _valueRef;
 }
@@ -229,7 +225,7 @@ void cVec4Animation::Process(float deltaTime)
 			fraction = (timer - currKeyframe.time) / (nextKeyframe.time - currKeyframe.time);
 
 			glm::vec4 newValue = currKeyframe.value + (nextKeyframe.value - currKeyframe.value) * fraction;
-			valueRef = newValue;
+			*valuePtr = newValue;
 
 			break;
 		}
@@ -238,14 +234,14 @@ void cVec4Animation::Process(float deltaTime)
 	if (keyframes.size() != 0 && timer >= maxDuration)
 	{
 		glm::vec4 finalValue = keyframes[keyframes.size() - 1].value;
-		valueRef = finalValue;
+		*valuePtr = finalValue;
 	}
 }
 
 cModelAnimation::cModelAnimation(glm::vec3& _posRef, glm::vec3& _rotRef, glm::vec3& _sclRef) :
-	positionRef(_posRef),
-	orintationRef(_rotRef),
-	scaleRef(_sclRef)
+	positionPtr(&_posRef),
+	orientationPtr(&_rotRef),
+	scalePtr(&_sclRef)
 {
 	initPosition = _posRef;
 	initOrientation = _rotRef;
@@ -318,7 +314,7 @@ void cModelAnimation::Process(float deltaTime)
 			//}
 
 			glm::vec3 newPosition = currPosKeyframe.value + (nextPosKeyframe.value - currPosKeyframe.value) * posFraction;
-			positionRef = newPosition;
+			*positionPtr = newPosition;
 
 			break;
 		}
@@ -329,7 +325,7 @@ void cModelAnimation::Process(float deltaTime)
 		if (timer >= maxDuration)
 		{
 			glm::vec3 finalPosition = positionKeyframes[positionKeyframes.size() - 1].value;
-			positionRef = finalPosition;
+			*positionPtr = finalPosition;
 		}
 	}
 
@@ -374,7 +370,7 @@ void cModelAnimation::Process(float deltaTime)
 			//}
 
 			glm::vec3 newScale = currScaleKeyframe.value + (nextScaleKeyframe.value - currScaleKeyframe.value) * scaleFraction;
-			scaleRef = newScale;
+			*scalePtr = newScale;
 
 			break;
 		}
@@ -385,7 +381,7 @@ void cModelAnimation::Process(float deltaTime)
 		if (timer >= maxDuration)
 		{
 			glm::vec3 finalScale = scaleKeyframes[scaleKeyframes.size() - 1].value;
-			scaleRef = finalScale;
+			*scalePtr = finalScale;
 		}
 	}
 }
@@ -407,7 +403,7 @@ void cModelAnimation::Reset(glm::vec3 newInitPos, glm::vec3 newInitOri, glm::vec
 }
 
 cSinAnimation::cSinAnimation(glm::vec3& _value, float _valueRange, float _valueOffset) :
-	valueRef(_value)
+	valuePtr(&_value)
 {
 	initValue = _value;
 
@@ -463,9 +459,9 @@ void cSinAnimation::Process(float deltaTime)
 			fraction = (timer - currKeyframe.time) / (nextKeyframe.time - currKeyframe.time);
 
 			glm::vec3 newOffset = currKeyframe.value + (nextKeyframe.value - currKeyframe.value) * fraction;
-			valueRef.x = glm::sin(glm::radians(newOffset.x)) * (valueRange / (float)2) + valueOffset;
-			valueRef.y = glm::sin(glm::radians(newOffset.y)) * (valueRange / (float)2) + valueOffset;
-			valueRef.z = glm::sin(glm::radians(newOffset.z)) * (valueRange / (float)2) + valueOffset;
+			valuePtr->x = glm::sin(glm::radians(newOffset.x)) * (valueRange / (float)2) + valueOffset;
+			valuePtr->y = glm::sin(glm::radians(newOffset.y)) * (valueRange / (float)2) + valueOffset;
+			valuePtr->z = glm::sin(glm::radians(newOffset.z)) * (valueRange / (float)2) + valueOffset;
 
 			break;
 		}
@@ -476,14 +472,14 @@ void cSinAnimation::Process(float deltaTime)
 		if (timer >= maxDuration)
 		{
 			glm::vec3 finalPosition = keyframes[keyframes.size() - 1].value;
-			valueRef = finalPosition;
+			*valuePtr = finalPosition;
 		}
 	}
 }
 
 cSpriteAnimation::cSpriteAnimation(int& _spriteRef, glm::vec3& _modelScale) :
-	spriteIdRef(_spriteRef),
-	modelScaleRef(_modelScale)
+	spriteIdPtr(&_spriteRef),
+	modelScalePtr(&_modelScale)
 {
 	initId = _spriteRef;
 }
@@ -536,12 +532,12 @@ void cSpriteAnimation::Process(float deltaTime)
 		if (keyframes[keyFrameIndex].time < timer)
 		{
 			// no interpolation I guess
-			spriteIdRef = keyframes[keyFrameIndex].value;
+			*spriteIdPtr = keyframes[keyFrameIndex].value;
 
-			if ((keyframes[keyFrameIndex].flip && modelScaleRef.z > 0) ||
-				!keyframes[keyFrameIndex].flip && modelScaleRef.z < 0)
+			if ((keyframes[keyFrameIndex].flip && modelScalePtr->z > 0) ||
+				!keyframes[keyFrameIndex].flip && modelScalePtr->z < 0)
 			{
-				modelScaleRef.z *= -1;
+				modelScalePtr->z *= -1;
 			}
 
 			break;
@@ -550,7 +546,7 @@ void cSpriteAnimation::Process(float deltaTime)
 }
 
 cPeriodicSpriteAnimation::cPeriodicSpriteAnimation(int& _spriteIdRef, int _maxId) :
-	spriteIdRef(_spriteIdRef)
+	spriteIdPtr(&_spriteIdRef)
 {
 	maxId = _maxId;
 	maxDuration = 0.5f; // hack
@@ -564,8 +560,8 @@ void cPeriodicSpriteAnimation::Process(float deltaTime)
 
 	if (timer >= interval)
 	{
-		if (spriteIdRef + 1 > maxId) spriteIdRef = 0;
-		else spriteIdRef++;
+		if (*spriteIdPtr + 1 > maxId) *spriteIdPtr = 0;
+		else (*spriteIdPtr)++;
 
 		timer -= interval;
 	}
@@ -108,6 +108,34 @@ struct sKeyFrameSprite // sprite
 	float time;
 };
 
+enum eAnimationType
+{
+	FLOAT_ANIMATION,
+	VEC2_ANIMATION,
+	VEC3_ANIMATION,
+	VEC4_ANIMATION,
+	MODEL_ANIMATION,
+	SIN_ANIMATION,
+	SPRITE_ANIMATION,
+	PERIODIC_SPRITE_ANIMATION,
+	ANIMATION_TYPES_NUM
+};
+
+// Names an animation inside the animation manager. A removed animation's slot gets a new generation
+// when it's reused, so an old handle finds nothing instead of someone else's animation
+struct sAnimationHandle
+{
+	sAnimationHandle() :
+		type(ANIMATION_TYPES_NUM),
+		slot(0),
+		generation(0) {}
+
+	eAnimationType type;
+	unsigned int slot;
+	unsigned int generation;
+};
+
+// Animations are plain values kept in the animation manager's pools, they write into the values they point to
 class cAnimation
 {
 public:
@@ -121,18 +149,16 @@ public:
 	std::function<void()> callback;
 
 	cAnimation();
-	~cAnimation();
-	// maybe try removing this from the animation manager when delteting
-
-	virtual void Process(float deltaTime) = 0;
 
-	virtual void Reset();
+	void Reset();
 };
 
 class cFloatAnimation : public cAnimation
 {
 public:
-	float& valueRef;
+	static const eAnimationType TYPE = FLOAT_ANIMATION;
+
+	float* valuePtr;
 	float initValue;
 
 	std::vector<sKeyFrameFloat> keyframes;
@@ -140,13 +166,15 @@ public:
 	cFloatAnimation(float& _valueRef);
 	void AddKeyFrame(sKeyFrameFloat newKeyframe);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cVec2Animation : public cAnimation
 {
 public:
-	glm::vec2& valueRef;
+	static const eAnimationType TYPE = VEC2_ANIMATION;
+
+	glm::vec2* valuePtr;
 	glm::vec2 initValue;
 
 	std::vector<sKeyFrameVec2> keyframes;
@@ -154,13 +182,15 @@ public:
 	cVec2Animation(glm::vec2& _valueRef);
 	void AddKeyFrame(sKeyFrameVec2 newKeyframe);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cVec3Animation : public cAnimation
 {
 public:
-	glm::vec3& valueRef;
+	static const eAnimationType TYPE = VEC3_ANIMATION;
+
+	glm::vec3* valuePtr;
 	glm::vec3 initValue;
 
 	std::vector<sKeyFrameVec3> keyframes;
@@ -168,13 +198,15 @@ public:
 	cVec3Animation(glm::vec3& _valueRef);
 	void AddKeyFrame(sKeyFrameVec3 newKeyframe);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cVec4Animation : public cAnimation
 {
 public:
-	glm::vec4& valueRef;
+	static const eAnimationType TYPE = VEC4_ANIMATION;
+
+	glm::vec4* valuePtr;
 	glm::vec4 initValue;
 
 	std::vector<sKeyFrameVec4> keyframes;
@@ -182,16 +214,17 @@ public:
 	cVec4Animation(glm::vec4& _valueRef);
 	void AddKeyFrame(sKeyFrameVec4 newKeyframe);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cModelAnimation : public cAnimation
 {
 public:
+	static const eAnimationType TYPE = MODEL_ANIMATION;
 
-	glm::vec3& positionRef;
-	glm::vec3& orintationRef;
-	glm::vec3& scaleRef;
+	glm::vec3* positionPtr;
+	glm::vec3* orientationPtr;
+	glm::vec3* scalePtr;
 
 	glm::vec3 initPosition;
 	glm::vec3 initOrientation;
@@ -206,16 +239,18 @@ public:
 	void AddOrientationKeyFrame(sKeyFrameVec3 newKeyframe);
 	void AddScaleKeyFrame(sKeyFrameVec3 newKeyframe);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 
-	virtual void Reset();
+	void Reset();
 	void Reset(glm::vec3 newInitPos, glm::vec3 newInitOri, glm::vec3 newInitScale);
 };
 
 class cSinAnimation : public cAnimation
 {
 public:
-	glm::vec3& valueRef;
+	static const eAnimationType TYPE = SIN_ANIMATION;
+
+	glm::vec3* valuePtr;
 	glm::vec3 initValue;
 
 	float valueRange;
@@ -226,18 +261,20 @@ public:
 	cSinAnimation(glm::vec3& _value, float _valueRange, float _valueOffset);
 	void AddKeyFrame(sKeyFrameVec3 newKeyframe);
 
-	virtual void Reset();
+	void Reset();
 	void Reset(glm::vec3 newValue);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cSpriteAnimation : public cAnimation
 {
 public:
-	int& spriteIdRef;
+	static const eAnimationType TYPE = SPRITE_ANIMATION;
+
+	int* spriteIdPtr;
 	int initId;
-	glm::vec3& modelScaleRef;
+	glm::vec3* modelScalePtr;
 	glm::vec3 initScale;
 
 	std::vector<sKeyFrameSprite> keyframes;
@@ -246,20 +283,22 @@ public:
 	void AddKeyFrame(sKeyFrameSprite newKeyframe);
 	void AddKeyFrames(std::vector<sKeyFrameSprite>& newKeyframes);
 
-	virtual void Reset();
+	void Reset();
 	void Reset(int newInitId, glm::vec3 newInitScale);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
 
 class cPeriodicSpriteAnimation : public cAnimation
 {
 public:
-	int& spriteIdRef;
+	static const eAnimationType TYPE = PERIODIC_SPRITE_ANIMATION;
+
+	int* spriteIdPtr;
 	float interval = 0.1f;
 	int maxId; // If this number is hit, reset id red to 0
 
 	cPeriodicSpriteAnimation(int& _spriteIdRef, int _maxId);
 
-	virtual void Process(float deltaTime);
+	void Process(float deltaTime);
 };
\ No newline at end of file
@@ -15,30 +15,14 @@ void cAnimationManager::Process(float deltaTime)
 {
 	ZoneScopedN("AnimationProcess");
 
-	for (int i = animations.size() - 1; i >= 0; i--)
-	{
-		animations[i]->Process(deltaTime);
-
-		if (animations[i]->timer >= animations[i]->maxDuration)
-		{
-			if (animations[i]->isRepeat)
-			{
-				animations[i]->timer = 0.f;
-			}
-			else
-			{
-				animations[i]->isDone = true;
-				
-				if(animations[i]->callback)
-					animations[i]->callback();
-			}
-		}
-
-		if (animations[i]->removeAfterComplete && animations[i]->isDone)
-		{
-			animations.erase(animations.begin() + i);
-		}
-	}
+	floatAnimations.Process(deltaTime);
+	vec2Animations.Process(deltaTime);
+	vec3Animations.Process(deltaTime);
+	vec4Animations.Process(deltaTime);
+	modelAnimations.Process(deltaTime);
+	sinAnimations.Process(deltaTime);
+	spriteAnimations.Process(deltaTime);
+	periodicSpriteAnimations.Process(deltaTime);
 }
 
 void cAnimationManager::InitializeAnimationsPresets()
@@ -212,21 +196,26 @@ void cAnimationManager::InitializeAnimationsPresets()
 	CreateSpritePresetAnimation(OW_POKEMON, "WALK_RIGHT", OWP_WALK_RIGHT);
 }
 
-void cAnimationManager::AddAnimation(std::shared_ptr<cAnimation> newAnimation)
+void cAnimationManager::RemoveAnimation(sAnimationHandle handle)
 {
-	animations.push_back(newAnimation);
+	switch (handle.type)
+	{
+	case FLOAT_ANIMATION: floatAnimations.Remove(handle.slot, handle.generation); break;
+	case VEC2_ANIMATION: vec2Animations.Remove(handle.slot, handle.generation); break;
+	case VEC3_ANIMATION: vec3Animations.Remove(handle.slot, handle.generation); break;
+	case VEC4_ANIMATION: vec4Animations.Remove(handle.slot, handle.generation); break;
+	case MODEL_ANIMATION: modelAnimations.Remove(handle.slot, handle.generation); break;
+	case SIN_ANIMATION: sinAnimations.Remove(handle.slot, handle.generation); break;
+	case SPRITE_ANIMATION: spriteAnimations.Remove(handle.slot, handle.generation); break;
+	case PERIODIC_SPRITE_ANIMATION: periodicSpriteAnimations.Remove(handle.slot, handle.generation); break;
+	default: break;
+	}
 }
 
-void cAnimationManager::RemoveAnimation(std::shared_ptr<cAnimation> animationToRemove)
+unsigned int cAnimationManager::GetAnimationsNum()
 {
-	for (int i = 0; i < animations.size(); i++)
-	{
-		if (animationToRemove == animations[i])
-		{
-			animations.erase(animations.begin() + i);
-			return;
-		}
-	}
+	return floatAnimations.Size() + vec2Animations.Size() + vec3Animations.Size() + vec4Animations.Size() +
+		modelAnimations.Size() + sinAnimations.Size() + spriteAnimations.Size() + periodicSpriteAnimations.Size();
 }
 
 void cAnimationManager::CreateSpritePresetAnimation(eSpriteEntityType spriteType, std::string animationName, std::vector<sKeyFrameSprite>& keyframes)
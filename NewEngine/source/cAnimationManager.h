@@ -3,7 +3,7 @@
 #include "cAnimation.h"
 #include <vector>
 #include <map>
-#include <memory>
+#include <functional>
 
 struct sEntitySpriteAnimationPreset
 {
@@ -11,6 +11,128 @@ struct sEntitySpriteAnimationPreset
 	std::vector<sKeyFrameSprite> keyframes;
 };
 
+// Every animation of one type in a single array, looked up through slots so handles survive the swap on removal
+template<typename T>
+class cAnimationPool
+{
+public:
+	cAnimationPool() : isProcessing(false) {}
+
+private:
+	std::vector<T> animations;
+	std::vector<unsigned int> animationSlots; // slot of each animation
+	std::vector<unsigned int> slotIndices; // animation index of each slot
+	std::vector<unsigned int> slotGenerations;
+	std::vector<unsigned int> freeSlots;
+	bool isProcessing;
+
+	void Erase(unsigned int index)
+	{
+		unsigned int slot = animationSlots[index];
+		unsigned int lastIndex = (unsigned int)animations.size() - 1;
+		if (index != lastIndex)
+		{
+			animations[index] = std::move(animations[lastIndex]);
+			animationSlots[index] = animationSlots[lastIndex];
+			slotIndices[animationSlots[index]] = index;
+		}
+		animations.pop_back();
+		animationSlots.pop_back();
+
+		slotGenerations[slot]++;
+		freeSlots.push_back(slot);
+	}
+
+public:
+	unsigned int Add(const T& newAnimation, unsigned int& generation)
+	{
+		unsigned int slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (unsigned int)slotGenerations.size();
+			slotIndices.push_back(0);
+			slotGenerations.push_back(1);
+		}
+
+		slotIndices[slot] = (unsigned int)animations.size();
+		animations.push_back(newAnimation);
+		animationSlots.push_back(slot);
+
+		generation = slotGenerations[slot];
+		return slot;
+	}
+
+	T* Get(unsigned int slot, unsigned int generation)
+	{
+		if (slot >= slotGenerations.size() || slotGenerations[slot] != generation) return nullptr;
+
+		return &animations[slotIndices[slot]];
+	}
+
+	void Remove(unsigned int slot, unsigned int generation)
+	{
+		T* animation = Get(slot, generation);
+		if (!animation) return;
+
+		if (!isProcessing)
+		{
+			Erase(slotIndices[slot]);
+			return;
+		}
+
+		// Removed from a callback. Process is still walking the array, so stop it here and let Process drop it
+		animation->isDone = true;
+		animation->isRepeat = false;
+		animation->removeAfterComplete = true;
+		animation->callback = nullptr;
+		slotGenerations[slot]++;
+	}
+
+	void Process(float deltaTime)
+	{
+		isProcessing = true;
+
+		for (int i = (int)animations.size() - 1; i >= 0; i--)
+		{
+			T& animation = animations[i];
+			animation.Process(deltaTime);
+
+			if (animation.timer >= animation.maxDuration)
+			{
+				if (animation.isRepeat)
+				{
+					animation.timer = 0.f;
+				}
+				else
+				{
+					animation.isDone = true;
+
+					if (animation.callback)
+					{
+						// Callbacks can add animations and move the array, and can reset their own
+						std::function<void()> callback = animation.callback;
+						callback();
+					}
+				}
+			}
+
+			if (animations[i].removeAfterComplete && animations[i].isDone)
+			{
+				Erase(i);
+			}
+		}
+
+		isProcessing = false;
+	}
+
+	unsigned int Size() const { return (unsigned int)animations.size(); }
+};
+
 class cAnimationManager
 {
 public:
@@ -18,11 +140,40 @@ public:
 	~cAnimationManager();
 
 private:
-	std::vector<std::shared_ptr<cAnimation>> animations;
+	cAnimationPool<cFloatAnimation> floatAnimations;
+	cAnimationPool<cVec2Animation> vec2Animations;
+	cAnimationPool<cVec3Animation> vec3Animations;
+	cAnimationPool<cVec4Animation> vec4Animations;
+	cAnimationPool<cModelAnimation> modelAnimations;
+	cAnimationPool<cSinAnimation> sinAnimations;
+	cAnimationPool<cSpriteAnimation> spriteAnimations;
+	cAnimationPool<cPeriodicSpriteAnimation> periodicSpriteAnimations;
+
+	template<typename T>
+	cAnimationPool<T>& GetPool();
 public:
-	void AddAnimation(std::shared_ptr<cAnimation> newAnimation);
+	// The animation is copied into its pool
+	template<typename T>
+	sAnimationHandle AddAnimation(const T& newAnimation)
+	{
+		sAnimationHandle handle;
+		handle.type = T::TYPE;
+		handle.slot = GetPool<T>().Add(newAnimation, handle.generation);
+		return handle;
+	}
+
+	// nullptr once the animation is gone. Don't keep the pointer, the next add or remove of the same type can move it
+	template<typename T>
+	T* GetAnimation(sAnimationHandle handle)
+	{
+		if (handle.type != T::TYPE) return nullptr;
+
+		return GetPool<T>().Get(handle.slot, handle.generation);
+	}
+
 	void Process(float deltaTime);
-	void RemoveAnimation(std::shared_ptr<cAnimation> animationToRemove);
+	void RemoveAnimation(sAnimationHandle handle);
+	unsigned int GetAnimationsNum();
 
 private:
 	std::map<eSpriteEntityType, std::vector<sEntitySpriteAnimationPreset>> entitySpriteAnimationPresets;
@@ -30,4 +181,13 @@ private:
 public:
 	void InitializeAnimationsPresets();
 	bool GetSpriteAnimationKeyframes(eSpriteEntityType spriteType, std::string animationName, std::vector<sKeyFrameSprite>& keyframes);
-};
\ No newline at end of file
+};
+
+template<> inline cAnimationPool<cFloatAnimation>& cAnimationManager::GetPool<cFloatAnimation>() { return floatAnimations; }
+template<> inline cAnimationPool<cVec2Animation>& cAnimationManager::GetPool<cVec2Animation>() { return vec2Animations; }
+template<> inline cAnimationPool<cVec3Animation>& cAnimationManager::GetPool<cVec3Animation>() { return vec3Animations; }
+template<> inline cAnimationPool<cVec4Animation>& cAnimationManager::GetPool<cVec4Animation>() { return vec4Animations; }
+template<> inline cAnimationPool<cModelAnimation>& cAnimationManager::GetPool<cModelAnimation>() { return modelAnimations; }
+template<> inline cAnimationPool<cSinAnimation>& cAnimationManager::GetPool<cSinAnimation>() { return sinAnimations; }
+template<> inline cAnimationPool<cSpriteAnimation>& cAnimationManager::GetPool<cSpriteAnimation>() { return spriteAnimations; }
+template<> inline cAnimationPool<cPeriodicSpriteAnimation>& cAnimationManager::GetPool<cPeriodicSpriteAnimation>() { return periodicSpriteAnimations; }
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "cAssetCache.h"
+
+cAssetCache::cAssetCache()
+{
+}
+
+cAssetCache::~cAssetCache()
+{
+}
+
+std::string cAssetCache::MakeId(eAssetType type, const std::string& name)
+{
+	return std::to_string((int)type) + ":" + name;
+}
+
+bool cAssetCache::Acquire(eAssetType type, const std::string& name)
+{
+	std::unordered_map<std::string, sAsset>::iterator it = assets.find(MakeId(type, name));
+	if (it == assets.end())
+	{
+		stats.misses++;
+		return false;
+	}
+
+	sAsset& asset = it->second;
+	if (asset.refCount == 0)
+	{
+		pool.erase(asset.poolIt);
+		stats.pooledAssetsNum--;
+		stats.pooledBytes -= asset.bytes;
+	}
+	asset.refCount++;
+
+	stats.hits++;
+	return true;
+}
+
+void cAssetCache::Add(eAssetType type, const std::string& name, size_t bytes)
+{
+	std::string id = MakeId(type, name);
+	if (assets.find(id) != assets.end()) return;
+
+	sAsset newAsset;
+	newAsset.key.type = type;
+	newAsset.key.name = name;
+	newAsset.refCount = 1;
+	newAsset.bytes = bytes;
+	assets.insert(std::pair<std::string, sAsset>(id, newAsset));
+
+	stats.assetsNum++;
+	stats.residentBytes += bytes;
+}
+
+void cAssetCache::Resize(eAssetType type, const std::string& name, size_t bytes)
+{
+	std::unordered_map<std::string, sAsset>::iterator it = assets.find(MakeId(type, name));
+	if (it == assets.end()) return;
+
+	sAsset& asset = it->second;
+	stats.residentBytes = stats.residentBytes - asset.bytes + bytes;
+	if (asset.refCount == 0)
+		stats.pooledBytes = stats.pooledBytes - asset.bytes + bytes;
+	asset.bytes = bytes;
+}
+
+void cAssetCache::Release(eAssetType type, const std::string& name)
+{
+	std::string id = MakeId(type, name);
+	std::unordered_map<std::string, sAsset>::iterator it = assets.find(id);
+	if (it == assets.end() || it->second.refCount == 0) return;
+
+	sAsset& asset = it->second;
+	asset.refCount--;
+	if (asset.refCount != 0) return;
+
+	asset.poolIt = pool.insert(pool.end(), id);
+	stats.pooledAssetsNum++;
+	stats.pooledBytes += asset.bytes;
+}
+
+void cAssetCache::Remove(eAssetType type, const std::string& name)
+{
+	std::unordered_map<std::string, sAsset>::iterator it = assets.find(MakeId(type, name));
+	if (it == assets.end()) return;
+
+	sAsset& asset = it->second;
+	if (asset.refCount == 0)
+	{
+		pool.erase(asset.poolIt);
+		stats.pooledAssetsNum--;
+		stats.pooledBytes -= asset.bytes;
+	}
+
+	stats.assetsNum--;
+	stats.residentBytes -= asset.bytes;
+	assets.erase(it);
+}
+
+void cAssetCache::Evict(size_t budgetBytes, std::vector< std::pair<eAssetType, std::string> >& evictedOut)
+{
+	while (stats.residentBytes > budgetBytes && !pool.empty())
+	{
+		std::unordered_map<std::string, sAsset>::iterator it = assets.find(pool.front());
+		pool.pop_front();
+
+		sAsset& asset = it->second;
+		evictedOut.push_back(std::pair<eAssetType, std::string>(asset.key.type, asset.key.name));
+
+		stats.evictions++;
+		stats.assetsNum--;
+		stats.pooledAssetsNum--;
+		stats.residentBytes -= asset.bytes;
+		stats.pooledBytes -= asset.bytes;
+		assets.erase(it);
+	}
+}
+
+void cAssetCache::Clear()
+{
+	assets.clear();
+	pool.clear();
+
+	stats.assetsNum = 0;
+	stats.pooledAssetsNum = 0;
+	stats.residentBytes = 0;
+	stats.pooledBytes = 0;
+}
+
+bool cAssetCache::IsResident(eAssetType type, const std::string& name) const
+{
+	return assets.find(MakeId(type, name)) != assets.end();
+}
+
+void cAssetCache::ResetCounters()
+{
+	stats.hits = 0;
+	stats.misses = 0;
+	stats.evictions = 0;
+}
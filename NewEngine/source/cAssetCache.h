@@ -0,0 +1,69 @@
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+enum eAssetType
+{
+	ASSET_MODEL,
+	ASSET_TEXTURE,
+	ASSET_SPRITE_SHEET,
+	ASSET_TYPES_NUM
+};
+
+struct sAssetCacheStats
+{
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	unsigned int evictions = 0;
+	unsigned int assetsNum = 0;
+	unsigned int pooledAssetsNum = 0;
+	size_t residentBytes = 0;
+	size_t pooledBytes = 0; // part of resident that nothing references
+};
+
+// Book keeping for GPU assets, the owner keeps the actual GL objects. Assets nothing references anymore
+// stay resident in an LRU pool until they go over the budget, so the next scene can pick them back up
+class cAssetCache
+{
+public:
+	cAssetCache();
+	~cAssetCache();
+
+private:
+	struct sAssetKey
+	{
+		eAssetType type;
+		std::string name;
+	};
+
+	struct sAsset
+	{
+		sAssetKey key;
+		unsigned int refCount;
+		size_t bytes;
+		std::list<std::string>::iterator poolIt; // only valid when refCount is 0
+	};
+
+	std::unordered_map<std::string, sAsset> assets; // by MakeId
+	std::list<std::string> pool; // least recently released first
+	sAssetCacheStats stats;
+
+	static std::string MakeId(eAssetType type, const std::string& name);
+public:
+	// True and a new reference when the asset is resident, otherwise counts a miss and the caller loads it and calls Add
+	bool Acquire(eAssetType type, const std::string& name);
+	void Add(eAssetType type, const std::string& name, size_t bytes);
+	void Resize(eAssetType type, const std::string& name, size_t bytes); // once an asset loaded in the background knows its size
+	void Release(eAssetType type, const std::string& name);
+	void Remove(eAssetType type, const std::string& name); // the owner unloaded it itself, references or not
+
+	// Least recently released first, until resident bytes fit in the budget. Referenced assets are never evicted
+	void Evict(size_t budgetBytes, std::vector< std::pair<eAssetType, std::string> >& evictedOut);
+	void Clear();
+
+	bool IsResident(eAssetType type, const std::string& name) const;
+	const sAssetCacheStats& GetStats() const { return stats; }
+	void ResetCounters();
+};
@@ -19,7 +19,7 @@ cCharacterEntity::~cCharacterEntity()
 
 void cCharacterEntity::AttemptMovement(eDirection dir, bool run)
 {
-	if (!spriteModel->modelAnimation->isDone) return;
+	if (!spriteModel->GetModelAnimation()->isDone) return;
 
 	eEntityMoveResult moveResult = Manager::map.TryMoveEntity(this, dir);
 
@@ -53,7 +53,7 @@ void cCharacterEntity::MoveFollower(glm::vec3 newPos, bool run)
 	else if ((newPos - follower->spriteModel->model->position).x == -1.f) dir = DOWN;
 	else return;
 
-	follower->spriteModel->modelAnimation->isDone = true;
+	follower->spriteModel->GetModelAnimation()->isDone = true;
 
 	follower->AttemptMovement(dir, run);
 }
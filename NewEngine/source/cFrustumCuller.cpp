@@ -0,0 +1,149 @@
+#include "cFrustumCuller.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+#include <tracy/tracy/Tracy.hpp>
+
+void sFrustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann, rows of the matrix added to or taken from the last one
+	glm::vec4 rowX = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 rowY = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 rowZ = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 rowW = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	planes[0] = rowW + rowX;
+	planes[1] = rowW - rowX;
+	planes[2] = rowW + rowY;
+	planes[3] = rowW - rowY;
+	planes[4] = rowW + rowZ;
+	planes[5] = rowW - rowZ;
+
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool sFrustum::IsBoxVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		// The corner furthest along the plane's normal
+		glm::vec3 corner = glm::vec3(planes[i].x > 0.f ? boundsMax.x : boundsMin.x,
+			planes[i].y > 0.f ? boundsMax.y : boundsMin.y,
+			planes[i].z > 0.f ? boundsMax.z : boundsMin.z);
+
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.f) return false;
+	}
+
+	return true;
+}
+
+cFrustumCuller::cFrustumCuller()
+{
+	boxesNum = 0;
+}
+
+cFrustumCuller::~cFrustumCuller()
+{
+}
+
+void cFrustumCuller::Clear()
+{
+	boxesNum = 0;
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void cFrustumCuller::Reserve(unsigned int newBoxesNum)
+{
+	unsigned int paddedNum = (newBoxesNum + 3) & ~3u;
+	minX.reserve(paddedNum); minY.reserve(paddedNum); minZ.reserve(paddedNum);
+	maxX.reserve(paddedNum); maxY.reserve(paddedNum); maxZ.reserve(paddedNum);
+}
+
+unsigned int cFrustumCuller::AddBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	// Arrays grow a whole group at a time so the last group can always be loaded, its unused lanes are ignored
+	if (boxesNum % 4 == 0)
+	{
+		minX.resize(boxesNum + 4, 0.f); minY.resize(boxesNum + 4, 0.f); minZ.resize(boxesNum + 4, 0.f);
+		maxX.resize(boxesNum + 4, 0.f); maxY.resize(boxesNum + 4, 0.f); maxZ.resize(boxesNum + 4, 0.f);
+	}
+
+	minX[boxesNum] = boundsMin.x; minY[boxesNum] = boundsMin.y; minZ[boxesNum] = boundsMin.z;
+	maxX[boxesNum] = boundsMax.x; maxY[boxesNum] = boundsMax.y; maxZ[boxesNum] = boundsMax.z;
+
+	return boxesNum++;
+}
+
+unsigned int cFrustumCuller::Cull(const sFrustum& frustum, std::vector<uint8_t>& visibleOut) const
+{
+	ZoneScopedN("FrustumCull");
+
+	visibleOut.resize(boxesNum);
+	if (boxesNum == 0) return 0;
+
+	// Each plane picks the same corner for every box, so pick the arrays once
+	const float* cornerX[6];
+	const float* cornerY[6];
+	const float* cornerZ[6];
+	for (unsigned int plane = 0; plane < 6; plane++)
+	{
+		cornerX[plane] = frustum.planes[plane].x > 0.f ? &maxX[0] : &minX[0];
+		cornerY[plane] = frustum.planes[plane].y > 0.f ? &maxY[0] : &minY[0];
+		cornerZ[plane] = frustum.planes[plane].z > 0.f ? &maxZ[0] : &minZ[0];
+	}
+
+	unsigned int visibleNum = 0;
+	unsigned int groupsNum = (boxesNum + 3) / 4;
+	for (unsigned int group = 0; group < groupsNum; group++)
+	{
+		unsigned int first = group * 4;
+		int outsideMask = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+		__m128 outside = _mm_setzero_ps();
+		for (unsigned int plane = 0; plane < 6; plane++)
+		{
+			__m128 distance = _mm_mul_ps(_mm_loadu_ps(cornerX[plane] + first), _mm_set1_ps(frustum.planes[plane].x));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(cornerY[plane] + first), _mm_set1_ps(frustum.planes[plane].y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(cornerZ[plane] + first), _mm_set1_ps(frustum.planes[plane].z)));
+			distance = _mm_add_ps(distance, _mm_set1_ps(frustum.planes[plane].w));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+		}
+		outsideMask = _mm_movemask_ps(outside);
+#else
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			for (unsigned int plane = 0; plane < 6; plane++)
+			{
+				float distance = cornerX[plane][first + lane] * frustum.planes[plane].x +
+					cornerY[plane][first + lane] * frustum.planes[plane].y +
+					cornerZ[plane][first + lane] * frustum.planes[plane].z +
+					frustum.planes[plane].w;
+
+				if (distance < 0.f)
+				{
+					outsideMask |= 1 << lane;
+					break;
+				}
+			}
+		}
+#endif
+
+		for (unsigned int lane = 0; lane < 4 && first + lane < boxesNum; lane++)
+		{
+			uint8_t isVisible = (outsideMask & (1 << lane)) == 0 ? 1 : 0;
+			visibleOut[first + lane] = isVisible;
+			visibleNum += isVisible;
+		}
+	}
+
+	return visibleNum;
+}
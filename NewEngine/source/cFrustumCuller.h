@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Planes point inwards, a point is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct sFrustum
+{
+	glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+	void FromMatrix(const glm::mat4& viewProjection);
+	bool IsBoxVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+};
+
+// World space boxes kept as separate min/max arrays so four of them are tested per iteration
+class cFrustumCuller
+{
+public:
+	cFrustumCuller();
+	~cFrustumCuller();
+
+private:
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	unsigned int boxesNum;
+public:
+	void Clear();
+	void Reserve(unsigned int newBoxesNum);
+	unsigned int AddBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	unsigned int GetBoxesNum() const { return boxesNum; }
+
+	// visibleOut[i] is 1 when box i touches the frustum. Returns how many do
+	unsigned int Cull(const sFrustum& frustum, std::vector<uint8_t>& visibleOut) const;
+};
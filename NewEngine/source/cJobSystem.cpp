@@ -0,0 +1,140 @@
+#include "cJobSystem.h"
+
+#include <chrono>
+
+#include <tracy/tracy/Tracy.hpp>
+
+cJobSystem::cJobSystem()
+{
+	isShuttingDown = false;
+	workerJobsNum = 0;
+}
+
+cJobSystem::~cJobSystem()
+{
+	Shutdown();
+}
+
+void cJobSystem::Startup(unsigned int workersNum)
+{
+	if (workersNum == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workersNum = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	isShuttingDown = false;
+	for (unsigned int i = 0; i < workersNum; i++)
+	{
+		workers.emplace_back(&cJobSystem::WorkerLoop, this);
+	}
+}
+
+void cJobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		isShuttingDown = true;
+		pendingJobs.clear();
+	}
+	pendingCondition.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	workers.clear();
+
+	// Completions of dropped or finished jobs are never run
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	mainThreadJobs.clear();
+	workerJobsNum = 0;
+}
+
+void cJobSystem::WorkerLoop()
+{
+	while (true)
+	{
+		sJob job;
+		{
+			std::unique_lock<std::mutex> lock(pendingMutex);
+			pendingCondition.wait(lock, [this] { return isShuttingDown || !pendingJobs.empty(); });
+
+			if (isShuttingDown) return;
+
+			job = std::move(pendingJobs.front());
+			pendingJobs.pop_front();
+		}
+
+		{
+			ZoneScopedN("WorkerJob");
+			job.work();
+		}
+
+		if (job.onDone)
+			SubmitMainThread(std::move(job.onDone));
+
+		workerJobsNum--;
+	}
+}
+
+void cJobSystem::Submit(std::function<void()> work, std::function<void()> onDone)
+{
+	// No workers (not started or shut down), run it right away
+	if (workers.empty())
+	{
+		work();
+		if (onDone) SubmitMainThread(std::move(onDone));
+		return;
+	}
+
+	workerJobsNum++;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		sJob newJob;
+		newJob.work = std::move(work);
+		newJob.onDone = std::move(onDone);
+		pendingJobs.push_back(std::move(newJob));
+	}
+	pendingCondition.notify_one();
+}
+
+void cJobSystem::SubmitMainThread(std::function<void()> job)
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	mainThreadJobs.push_back(std::move(job));
+}
+
+unsigned int cJobSystem::ProcessMainThreadJobs()
+{
+	ZoneScopedN("ProcessMainThreadJobs");
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	unsigned int jobsRun = 0;
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			if (mainThreadJobs.empty()) break;
+
+			job = std::move(mainThreadJobs.front());
+			mainThreadJobs.pop_front();
+		}
+
+		job();
+		jobsRun++;
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= mainThreadBudgetMs) break;
+	}
+
+	return jobsRun;
+}
+
+unsigned int cJobSystem::GetMainThreadJobsNum()
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	return (unsigned int)mainThreadJobs.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Worker threads for loading work. A job's work runs on a worker and its completion runs back on the main thread,
+// where anything touching GL or the managers has to happen
+class cJobSystem
+{
+public:
+	cJobSystem();
+	~cJobSystem();
+
+	void Startup(unsigned int workersNum = 0); // 0 leaves one hardware thread for the main thread
+	void Shutdown();
+
+private:
+	struct sJob
+	{
+		std::function<void()> work;
+		std::function<void()> onDone;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<sJob> pendingJobs;
+	std::mutex pendingMutex;
+	std::condition_variable pendingCondition;
+	bool isShuttingDown;
+
+	std::deque< std::function<void()> > mainThreadJobs;
+	std::mutex mainThreadMutex;
+
+	std::atomic<unsigned int> workerJobsNum; // queued or running on a worker
+
+	void WorkerLoop();
+public:
+	float mainThreadBudgetMs = 2.f;
+
+	void Submit(std::function<void()> work, std::function<void()> onDone = nullptr);
+	void SubmitMainThread(std::function<void()> job);
+
+	// Runs main thread jobs until the budget runs out, at least one so the queue always drains
+	unsigned int ProcessMainThreadJobs();
+
+	unsigned int GetWorkersNum() const { return (unsigned int)workers.size(); }
+	unsigned int GetWorkerJobsNum() const { return workerJobsNum; }
+	unsigned int GetMainThreadJobsNum();
+};
@@ -0,0 +1,193 @@
+#include "cMapFile.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+
+// Bump when sMapGridQuadrant or the header change
+const uint32_t COMPILED_MAP_VERSION = 1;
+const char COMPILED_MAP_MAGIC[4] = { 'M', 'G', 'K', 'P' };
+
+struct sCompiledMapHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t quadSize;
+	uint32_t quadsNum;
+	uint64_t sourceWriteTime;
+	uint64_t sourceSize;
+};
+// Followed by quadsNum sMapGridQuadrant
+
+std::string MapFile::GetCompiledPath(const std::string& sourcePath)
+{
+	return sourcePath + ".cmap";
+}
+
+bool MapFile::ParseText(const std::string& sourcePath, std::vector<sMapGridQuadrant>& quadsOut)
+{
+	std::ifstream pdsmap(sourcePath);
+
+	if (!pdsmap.is_open()) return false;
+
+	std::string currToken;
+
+	// make sure reader is at first mapstart
+	while (pdsmap >> currToken)
+	{
+		if (currToken == "mapstart") break;
+	}
+
+	// start here
+	while (currToken == "mapstart")
+	{
+		quadsOut.emplace_back();
+		sMapGridQuadrant& newQuad = quadsOut.back();
+		memset(newQuad.tiles, 0xFF, sizeof(newQuad.tiles)); // -1
+		memset(newQuad.heights, 0, sizeof(newQuad.heights));
+		newQuad.layersNum = 0;
+		newQuad.padding = 0;
+
+		// set quadrant coords
+		pdsmap >> newQuad.posX;
+		pdsmap >> newQuad.posZ;
+
+		// skip areaindex
+		pdsmap >> currToken;
+		pdsmap >> currToken;
+
+		for (unsigned int layerId = 0; layerId < MAP_LAYERS_NUM; layerId++)
+		{
+			pdsmap >> currToken;
+
+			if (currToken != "tilegrid") break;
+
+			for (unsigned int x = 0; x < MAP_QUADRANT_SIZE; x++)
+			{
+				for (unsigned int z = 0; z < MAP_QUADRANT_SIZE; z++)
+				{
+					int tileId;
+					pdsmap >> tileId;
+					if (pdsmap.fail() || tileId < SHRT_MIN || tileId > SHRT_MAX)
+					{
+						printf("MapFile::ParseText: ERROR: Bad tile id in quadrant %d,%d of %s\n", newQuad.posX, newQuad.posZ, sourcePath.c_str());
+						return false;
+					}
+					newQuad.tiles[layerId][x][z] = (int16_t)tileId;
+				}
+			}
+			newQuad.layersNum++;
+		}
+
+		for (unsigned int layerId = 0; layerId < MAP_LAYERS_NUM; layerId++)
+		{
+			pdsmap >> currToken;
+
+			if (currToken != "heightgrid") break;
+
+			for (unsigned int x = 0; x < MAP_QUADRANT_SIZE; x++)
+			{
+				for (unsigned int z = 0; z < MAP_QUADRANT_SIZE; z++)
+				{
+					int currHeight;
+					pdsmap >> currHeight;
+					if (pdsmap.fail() || currHeight < MAP_MIN_HEIGHT || currHeight > MAP_MAX_HEIGHT)
+					{
+						printf("MapFile::ParseText: ERROR: Bad height in quadrant %d,%d of %s\n", newQuad.posX, newQuad.posZ, sourcePath.c_str());
+						return false;
+					}
+					newQuad.heights[layerId][x][z] = (int8_t)currHeight;
+				}
+			}
+		}
+
+		pdsmap >> currToken; // this should be mapend
+		pdsmap >> currToken; // if there is another quad, this will be mapstart
+	}
+	// end here
+
+	pdsmap.close();
+
+	return true;
+}
+
+bool MapFile::Write(const std::string& sourcePath, const std::vector<sMapGridQuadrant>& quads)
+{
+	return Write(sourcePath, GetCompiledPath(sourcePath), quads);
+}
+
+bool MapFile::Write(const std::string& sourcePath, const std::string& compiledPath, const std::vector<sMapGridQuadrant>& quads)
+{
+	sCompiledMapHeader header;
+	memcpy(header.magic, COMPILED_MAP_MAGIC, sizeof(header.magic));
+	header.version = COMPILED_MAP_VERSION;
+	header.quadSize = sizeof(sMapGridQuadrant);
+	header.quadsNum = (uint32_t)quads.size();
+	if (!cMappedFile::GetFileStamp(sourcePath, header.sourceWriteTime, header.sourceSize)) return false;
+
+	FILE* fp;
+	if (fopen_s(&fp, compiledPath.c_str(), "wb") != 0 || fp == nullptr) return false;
+
+	bool isWritten = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (isWritten && !quads.empty()) isWritten = fwrite(&quads[0], sizeof(sMapGridQuadrant), quads.size(), fp) == quads.size();
+
+	fclose(fp);
+
+	if (!isWritten) remove(compiledPath.c_str());
+
+	return isWritten;
+}
+
+bool MapFile::Read(const std::string& sourcePath, cMappedFile& fileOut, sMapGridView& viewOut)
+{
+	return Read(sourcePath, GetCompiledPath(sourcePath), fileOut, viewOut);
+}
+
+bool MapFile::Read(const std::string& sourcePath, const std::string& compiledPath, cMappedFile& fileOut, sMapGridView& viewOut)
+{
+	uint64_t sourceWriteTime, sourceSize;
+	if (!cMappedFile::GetFileStamp(sourcePath, sourceWriteTime, sourceSize)) return false;
+
+	if (!fileOut.Open(compiledPath)) return false;
+
+	if (fileOut.GetSize() < sizeof(sCompiledMapHeader))
+	{
+		fileOut.Close();
+		return false;
+	}
+
+	sCompiledMapHeader header;
+	memcpy(&header, fileOut.GetData(), sizeof(header));
+
+	if (memcmp(header.magic, COMPILED_MAP_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != COMPILED_MAP_VERSION ||
+		header.quadSize != sizeof(sMapGridQuadrant) ||
+		header.sourceWriteTime != sourceWriteTime ||
+		header.sourceSize != sourceSize ||
+		fileOut.GetSize() != sizeof(sCompiledMapHeader) + sizeof(sMapGridQuadrant) * (size_t)header.quadsNum)
+	{
+		fileOut.Close();
+		return false;
+	}
+
+	viewOut.quadsNum = header.quadsNum;
+	viewOut.quads = (const sMapGridQuadrant*)(fileOut.GetData() + sizeof(sCompiledMapHeader));
+
+	return true;
+}
+
+bool MapFile::Load(const std::string& sourcePath, bool useCompiled, cMappedFile& fileOut, std::vector<sMapGridQuadrant>& parsedOut, sMapGridView& viewOut)
+{
+	if (useCompiled && Read(sourcePath, fileOut, viewOut)) return true;
+
+	if (!ParseText(sourcePath, parsedOut)) return false;
+
+	if (useCompiled && !Write(sourcePath, parsedOut))
+		printf("MapFile::Load: WARNING: Could not compile %s\n", sourcePath.c_str());
+
+	viewOut.quadsNum = (unsigned int)parsedOut.size();
+	viewOut.quads = parsedOut.empty() ? nullptr : &parsedOut[0];
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cMappedFile.h"
+
+const unsigned int MAP_QUADRANT_SIZE = 32;
+const unsigned int MAP_LAYERS_NUM = 8;
+const int MAP_MIN_HEIGHT = -15; // tile heights the quadrants' tile indices have room for
+const int MAP_MAX_HEIGHT = 15;
+
+// One quadrant of a .pdsmap. Stored as is in the compiled file
+struct sMapGridQuadrant
+{
+	int32_t posX;
+	int32_t posZ;
+	uint32_t layersNum;
+	uint32_t padding;
+	int16_t tiles[MAP_LAYERS_NUM][MAP_QUADRANT_SIZE][MAP_QUADRANT_SIZE]; // [layer][x][z], -1 for empty
+	int8_t heights[MAP_LAYERS_NUM][MAP_QUADRANT_SIZE][MAP_QUADRANT_SIZE];
+};
+
+// Points either into parsed quadrants or straight into a mapped compiled file
+struct sMapGridView
+{
+	unsigned int quadsNum;
+	const sMapGridQuadrant* quads;
+};
+
+// Compiled maps sit next to their .pdsmap (Map.pdsmap -> Map.pdsmap.cmap) and are rebuilt when the source changes
+namespace MapFile
+{
+	std::string GetCompiledPath(const std::string& sourcePath);
+
+	// Old token by token parser, kept to compile from and as a fallback
+	bool ParseText(const std::string& sourcePath, std::vector<sMapGridQuadrant>& quadsOut);
+	bool Write(const std::string& sourcePath, const std::vector<sMapGridQuadrant>& quads);
+	// Fails if there's no compiled file or it's older than the source
+	bool Read(const std::string& sourcePath, cMappedFile& fileOut, sMapGridView& viewOut);
+	// Same, with the compiled file somewhere other than next to its source
+	bool Write(const std::string& sourcePath, const std::string& compiledPath, const std::vector<sMapGridQuadrant>& quads);
+	bool Read(const std::string& sourcePath, const std::string& compiledPath, cMappedFile& fileOut, sMapGridView& viewOut);
+
+	// Read, or parse and compile when that fails. parsedOut only holds data in the second case
+	bool Load(const std::string& sourcePath, bool useCompiled, cMappedFile& fileOut, std::vector<sMapGridQuadrant>& parsedOut, sMapGridView& viewOut);
+}
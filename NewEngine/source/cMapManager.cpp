@@ -1,19 +1,28 @@
 #include "cMapManager.h"
 
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <unordered_map>
 
 #include <rapidjson/filereadstream.h>
 #include <rapidjson/document.h>
 
+#include <tracy/tracy/Tracy.hpp>
+
 #include "cAnimatedModel.h"
+#include "cMapFile.h"
+#include "cJobSystem.h"
 
 #include "Player.h"
 #include "cPlayerEntity.h"
 
 #include "Engine.h"
 #include "cRenderManager.h"
-#include "cAnimationManager.h"
 #include "cSceneManager.h"
 
 #include "cTamedRoamingPokemon.h"
@@ -22,13 +31,75 @@
 const std::string MAPS_PATH = "assets/scenes/maps/";
 const std::string ARENAS_PATH = "assets/scenes/arenas/";
 
-sTile* sQuadrant::GetRandomSpawnTile(glm::vec3& globalPos)
+static bool ReadDescriptionFile(const std::string& path, rapidjson::Document& d)
+{
+	FILE* fp = 0;
+	fopen_s(&fp, path.c_str(), "rb"); // non-Windows use "r"
+	if (fp == 0) return false;
+
+	char readBuffer[4096];
+	rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+	d.ParseStream(is);
+	fclose(fp);
+
+	return !d.HasParseError() && d.IsObject();
+}
+
+static void AddModelFile(const std::string& fileName, std::vector<std::string>& modelFiles)
+{
+	if (std::find(modelFiles.begin(), modelFiles.end(), fileName) == modelFiles.end())
+		modelFiles.push_back(fileName);
+}
+
+bool sTile::IsWalkable() const
+{
+	return quad && quad->walkableTiles[tileId];
+}
+
+void sTile::SetWalkable(bool isWalkable)
+{
+	if (quad) quad->walkableTiles[tileId] = isWalkable;
+}
+
+bool sTile::IsUnchangeable() const
+{
+	return quad && quad->unchangeableTiles[tileId];
+}
+
+void sTile::SetUnchangeable(bool isUnchangeable)
 {
-	if (wildPokemonCount >= 5) return nullptr;
+	if (quad) quad->unchangeableTiles[tileId] = isUnchangeable;
+}
+
+cEntity* sTile::GetEntity() const
+{
+	return quad ? quad->GetTileEntity(tileId) : nullptr;
+}
+
+void sTile::SetEntity(cEntity* entity)
+{
+	if (quad) quad->SetTileEntity(tileId, entity);
+}
+
+bool sTile::IsAvailable() const
+{
+	if (!IsWalkable()) return false;
+
+	cEntity* entity = GetEntity();
+	if (entity && entity->blocksTile) return false;
+
+	return true;
+}
+
+sTile sQuadrant::GetRandomSpawnTile(glm::vec3& globalPos)
+{
+	if (wildPokemonCount >= 5) return sTile();
 
 	int tileId = localSpawnTiles[rand() % localSpawnTiles.size()];
 
-	sTile* spawnTile = &data[tileId];
+	sTile spawnTile;
+	spawnTile.quad = this;
+	spawnTile.tileId = tileId;
 	globalPos = TileIdToGlobalPosition(tileId);
 	return spawnTile;
 }
@@ -45,13 +116,52 @@ int sQuadrant::GetTileIdFromPosition(glm::ivec3 localPos)
 	return heightIndex + layerIndex;
 }
 
-sTile* sQuadrant::GetTileFromLocalPosition(glm::ivec3 localPos)
+sTile sQuadrant::GetTileFromLocalPosition(glm::ivec3 localPos)
 {
+	sTile tile;
+
 	int localTileId = GetTileIdFromPosition(localPos);
+	if (localTileId == -1) return tile;
 
-	if (localTileId == -1) return nullptr;
+	tile.quad = this;
+	tile.tileId = localTileId;
+	return tile;
+}
 
-	return &data[localTileId];
+cEntity* sQuadrant::GetTileEntity(int tileId) const
+{
+	for (unsigned int i = 0; i < tileEntities.size(); i++)
+	{
+		if (tileEntities[i].tileId == tileId) return tileEntities[i].entity;
+	}
+
+	return nullptr;
+}
+
+void sQuadrant::SetTileEntity(int tileId, cEntity* entity)
+{
+	for (unsigned int i = 0; i < tileEntities.size(); i++)
+	{
+		if (tileEntities[i].tileId != tileId) continue;
+
+		if (entity)
+		{
+			tileEntities[i].entity = entity;
+		}
+		else // swap and pop, order doesn't matter
+		{
+			tileEntities[i] = tileEntities.back();
+			tileEntities.pop_back();
+		}
+		return;
+	}
+
+	if (!entity) return;
+
+	sTileEntity newTileEntity;
+	newTileEntity.tileId = tileId;
+	newTileEntity.entity = entity;
+	tileEntities.push_back(newTileEntity);
 }
 
 glm::vec3 sQuadrant::LocalPositionToGlobalPosition(glm::ivec3 localPos)
@@ -59,16 +169,102 @@ glm::vec3 sQuadrant::LocalPositionToGlobalPosition(glm::ivec3 localPos)
 	return glm::vec3(posX * 32 + localPos.x - 15, localPos.y, posZ * 32 + localPos.z - 15);
 }
 
+glm::ivec3 sQuadrant::GetLocalPositionFromTileId(int tileId)
+{
+	int localY = tileId / (32 * 32) - 15;
+	int localX = (tileId % (32 * 32)) / 32;
+	int localZ = tileId % 32;
+
+	return glm::ivec3(localX, localY, localZ);
+}
+
 glm::vec3 sQuadrant::TileIdToGlobalPosition(int tileId)
 {
 	if (tileId < 0) return glm::vec3(0); // <- don't let this happen (like ever)
 
 	// Go to local first
-	int localY = tileId / (32 * 32) - 15;
-	int localX = (tileId % (32 * 32)) / 32;
-	int localZ = tileId % 32;
+	return LocalPositionToGlobalPosition(GetLocalPositionFromTileId(tileId));
+}
+
+cQuadrantGrid::cQuadrantGrid()
+{
+	minX = 0;
+	minZ = 0;
+	width = 0;
+	depth = 0;
+}
+
+cQuadrantGrid::~cQuadrantGrid()
+{
+}
+
+void cQuadrantGrid::Build(const std::vector<sQuadrant>& quads)
+{
+	Clear();
+	if (quads.empty()) return;
+
+	int buildMinX = quads[0].posX;
+	int buildMinZ = quads[0].posZ;
+	int maxX = quads[0].posX;
+	int maxZ = quads[0].posZ;
+	for (unsigned int i = 1; i < quads.size(); i++)
+	{
+		if (quads[i].posX < buildMinX) buildMinX = quads[i].posX;
+		if (quads[i].posX > maxX) maxX = quads[i].posX;
+		if (quads[i].posZ < buildMinZ) buildMinZ = quads[i].posZ;
+		if (quads[i].posZ > maxZ) maxZ = quads[i].posZ;
+	}
+
+	Reset(buildMinX, buildMinZ, maxX, maxZ);
+
+	for (unsigned int i = 0; i < quads.size(); i++)
+	{
+		Set(quads[i].posX, quads[i].posZ, (int)i);
+	}
+}
+
+void cQuadrantGrid::Reset(int _minX, int _minZ, int maxX, int maxZ)
+{
+	minX = _minX;
+	minZ = _minZ;
+	width = maxX - minX + 1;
+	depth = maxZ - minZ + 1;
+	cells.assign(width * depth, -1);
+}
+
+void cQuadrantGrid::Set(int quadX, int quadZ, int index)
+{
+	int x = quadX - minX;
+	int z = quadZ - minZ;
+	if (x < 0 || x >= width || z < 0 || z >= depth) return;
+
+	cells[x * depth + z] = index;
+}
+
+void cQuadrantGrid::Clear()
+{
+	minX = 0;
+	minZ = 0;
+	width = 0;
+	depth = 0;
+	cells.clear();
+}
 
-	return LocalPositionToGlobalPosition(glm::vec3(localX, localY, localZ));
+int cQuadrantGrid::Find(int quadX, int quadZ) const
+{
+	int cell = GetCell(quadX, quadZ);
+	if (cell == -1) return -1;
+
+	return cells[cell];
+}
+
+int cQuadrantGrid::GetCell(int quadX, int quadZ) const
+{
+	int x = quadX - minX;
+	int z = quadZ - minZ;
+	if (x < 0 || x >= width || z < 0 || z >= depth) return -1;
+
+	return x * depth + z;
 }
 
 void cTransitionTrigger::WalkInteract()
@@ -132,13 +328,13 @@ void cMapManager::Shutdown()
 
 	for (std::map<int, sInstancedTile>::iterator it = mapInstancedTiles.begin(); it != mapInstancedTiles.end(); it++)
 	{
-		Manager::animation.RemoveAnimation(it->second.instancedModel.get()->animation);
+		it->second.instancedModel->StopAnimation();
 		Manager::render.RemoveModel(it->second.instancedModel);
 	}
 
 	for (std::map<int, sInstancedTile>::iterator it = arenaInstancedTiles.begin(); it != arenaInstancedTiles.end(); it++)
 	{
-		Manager::animation.RemoveAnimation(it->second.instancedModel.get()->animation);
+		it->second.instancedModel->StopAnimation();
 		Manager::render.RemoveModel(it->second.instancedModel);
 	}
 
@@ -156,12 +352,15 @@ sQuadrant* cMapManager::GetQuad(int worldX, int worldZ)
 	int quadXCoord = worldX / 32;
 	int quadZCoord = worldZ / 32;
 
-	for (int i = 0; i < quads.size(); i++)
-	{
-		if (quadXCoord == quads[i].posX && quadZCoord == quads[i].posZ) return &quads[i];
-	}
+	return GetQuadFromCoords(quadXCoord, quadZCoord);
+}
 
-	return nullptr;
+sQuadrant* cMapManager::GetQuadFromCoords(int quadX, int quadZ)
+{
+	int quadIndex = quadGrid.Find(quadX, quadZ);
+	if (quadIndex == -1) return nullptr;
+
+	return &quads[quadIndex];
 }
 
 void cMapManager::LoadArena(std::string arenaDescriptionFile)
@@ -181,8 +380,8 @@ void cMapManager::LoadArena(std::string arenaDescriptionFile)
 
 	// Load arena model
 	std::string mapModelName = d["arenaModelFileName"].GetString();
-	Manager::render.LoadModel(mapModelName, "scene");
-	arenaModel->meshName = mapModelName;
+	LoadMapModel(mapModelName, "scene");
+	arenaModel->SetMeshName(mapModelName);
 
 	// Load tile animations
 	rapidjson::Value& instancedTileData = d["instancedTiles"];
@@ -200,76 +399,36 @@ void cMapManager::LoadArena(std::string arenaDescriptionFile)
 
 		int animationType = currInstancedTile["animationType"].GetInt();
 		arenaInstancedTiles[tileId].instancedModel = Manager::render.CreateAnimatedModel(static_cast<eAnimatedModel>(animationType), true);
-		arenaInstancedTiles[tileId].instancedModel->meshName = currInstancedTile["meshName"].GetString();
+		arenaInstancedTiles[tileId].instancedModel->SetMeshName(currInstancedTile["meshName"].GetString());
 		arenaInstancedTiles[tileId].instancedModel->orientation.y = glm::radians(meshOrientationY);
 		arenaInstancedTiles[tileId].modelOffset = meshPosOffset;
 	}
 
 	// Load detail file
 	std::string arenaDetailFileName = d["arenaDetailFileName"].GetString();
-	std::ifstream pdsmap(ARENAS_PATH + arenaDetailFileName);
-
-	if (!pdsmap.is_open()) return;
+	cMappedFile compiledMap;
+	std::vector<sMapGridQuadrant> parsedQuads;
+	sMapGridView grid;
+	if (!MapFile::Load(ARENAS_PATH + arenaDetailFileName, useCompiledMaps, compiledMap, parsedQuads, grid)) return;
 
-	std::string currToken;
-
-	// make sure reader is at first mapstart
-	while (pdsmap >> currToken)
+	for (unsigned int quadIndex = 0; quadIndex < grid.quadsNum; quadIndex++)
 	{
-		if (currToken == "mapstart") break;
-	}
-
-	// start here
-	while (currToken == "mapstart")
-	{
-		sQuadrant newQuad;
-		int tempLayers[32][32][8];
-
-		// set quadrant coords
-		pdsmap >> newQuad.posX;
-		pdsmap >> newQuad.posZ;
-
-		// skip areaindex
-		pdsmap >> currToken;
-		pdsmap >> currToken;
-
-		for (int layerId = 0; layerId < 8; layerId++)
-		{
-			pdsmap >> currToken;
-
-			if (currToken != "tilegrid") break;
-
-			for (int x = 0; x < 32; x++)
-			{
-				for (int z = 0; z < 32; z++)
-				{
-					pdsmap >> tempLayers[x][z][layerId];
-				}
-			}
-		}
+		const sMapGridQuadrant& gridQuad = grid.quads[quadIndex];
 
-		for (int layerId = 0; layerId < 8; layerId++)
+		for (unsigned int layerId = 0; layerId < gridQuad.layersNum; layerId++)
 		{
-			pdsmap >> currToken;
-
-			if (currToken != "heightgrid") break;
-
 			for (int x = 0; x < 32; x++)
 			{
 				for (int z = 0; z < 32; z++)
 				{
-					int currHeight;
-					pdsmap >> currHeight;
-
-					int tileId = tempLayers[x][z][layerId];
+					int currHeight = gridQuad.heights[layerId][x][z];
+					int tileId = gridQuad.tiles[layerId][x][z];
 
 					if (tileId == -1) continue;
 
-					sTile* currTile = newQuad.GetTileFromLocalPosition(glm::vec3(x, currHeight, z));
-
 					if (arenaInstancedTiles.find(tileId) != arenaInstancedTiles.end()) // it exists
 					{
-						glm::vec4 newOffset = glm::vec4((newQuad.posX * 32 - 15 + x), currHeight, (newQuad.posZ * 32 - 15 + z), 1.f);
+						glm::vec4 newOffset = glm::vec4((gridQuad.posX * 32 - 15 + x), currHeight, (gridQuad.posZ * 32 - 15 + z), 0.f);
 						newOffset.x += arenaInstancedTiles[tileId].modelOffset.x;
 						newOffset.y += arenaInstancedTiles[tileId].modelOffset.y;
 						newOffset.z += arenaInstancedTiles[tileId].modelOffset.z;
@@ -279,13 +438,7 @@ void cMapManager::LoadArena(std::string arenaDescriptionFile)
 				}
 			}
 		}
-
-		pdsmap >> currToken; // this should be mapend
-		pdsmap >> currToken; // if there is another quad, this will be mapstart
 	}
-	// end here
-
-	pdsmap.close();
 
 	// Load tile specific animations
 	for (std::map<int, sInstancedTile>::iterator it = arenaInstancedTiles.begin(); it != arenaInstancedTiles.end(); it++)
@@ -294,8 +447,7 @@ void cMapManager::LoadArena(std::string arenaDescriptionFile)
 		{
 			it->second.instancedModel->InstanceObject(it->second.instanceOffsets);
 
-			if (it->second.instancedModel->animation)
-				Manager::animation.AddAnimation(it->second.instancedModel->animation);
+			it->second.instancedModel->StartAnimation();
 
 			it->second.instanceOffsets.clear();
 		}
@@ -308,28 +460,46 @@ void cMapManager::LoadArena(std::string arenaDescriptionFile)
 		playerSpriteModel = new cBattleSprite(glm::vec3(-4.f, 0.f, 1.f));
 }
 
+void cMapManager::LoadMapModel(const std::string& fileName, const std::string& programName)
+{
+	if (Manager::render.LoadModel(fileName, programName) == INVALID_MESH_HANDLE) return;
+
+	loadedModelFiles.push_back(fileName);
+}
+
 void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entranceNumUsed)
 {
+	BeginLoadingMap(mapDescriptionFile, entranceNumUsed);
+	while (!ContinueLoadingMap(FLT_MAX));
+}
+
+void cMapManager::BeginLoadingMap(const std::string mapDescriptionFile, const int entranceNumUsed)
+{
+	mapLoad = sMapLoad();
+
 	// TEMP: will find a more modular way to load necessary models
-	Manager::render.LoadModel("SpriteHolder.obj", "sprite");
-	Manager::render.LoadModel("ParticleHolder.obj", "snow");
-	Manager::render.LoadModel("ParticleHolder.obj", "particle");
-	Manager::render.LoadModel("Water_c2.obj", "wave");
-	Manager::render.LoadModel("Water_b2.obj", "wave");
-	Manager::render.LoadModel("Water_bl2.obj", "wave");
-	Manager::render.LoadModel("sea_water2.obj", "ocean");
-	Manager::render.LoadModel("Foam_b2.obj", "foam");
-	Manager::render.LoadModel("Foam_bl2.obj", "foam");
-	Manager::render.LoadModel("Foam_c2.obj", "foam");
-	Manager::render.LoadModel("Foam_c2.obj", "foam");
-	Manager::render.LoadModel("r0_treePine.obj", "tree");
+	LoadMapModel("SpriteHolder.obj", "sprite");
+	LoadMapModel("ParticleHolder.obj", "snow");
+	LoadMapModel("ParticleHolder.obj", "particle");
+	LoadMapModel("Water_c2.obj", "wave");
+	LoadMapModel("Water_b2.obj", "wave");
+	LoadMapModel("Water_bl2.obj", "wave");
+	LoadMapModel("sea_water2.obj", "ocean");
+	LoadMapModel("Foam_b2.obj", "foam");
+	LoadMapModel("Foam_bl2.obj", "foam");
+	LoadMapModel("Foam_c2.obj", "foam");
+	LoadMapModel("Foam_c2.obj", "foam");
+	LoadMapModel("r0_treePine.obj", "tree");
 
 	Manager::render.LoadSpriteSheet("Nate.png", 3, 8, false);
+	loadedSpriteSheets.push_back("Nate.png");
 
 	//Manager::render.LoadTexture("SnowFlake1.png");
 	//Manager::render.LoadTexture("SnowFlake2.png");
 	Manager::render.LoadTexture("SnowFlake3.png");
 	Manager::render.LoadTexture("HitParticle.png");
+	loadedTextures.push_back("SnowFlake3.png");
+	loadedTextures.push_back("HitParticle.png");
 
 	// Load json info file with rapidjson
 	FILE* fp = 0;
@@ -345,16 +515,23 @@ void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entran
 	if (fp == 0) return;
 	fclose(fp);
 	
-	// Load new map
+	// Load new map, a streamed one only ever has its quadrants' pieces of the mesh on the GPU
 	std::string mapModelName = d["mapModelFileName"].GetString();
-	Manager::render.LoadModel(mapModelName, "scene");
-	mapModel->meshName = mapModelName;
+	if (!useQuadrantStreaming)
+	{
+		LoadMapModel(mapModelName, "scene");
+		mapModel->SetMeshName(mapModelName);
+	}
+
+	std::shared_ptr<sMapStreamSource> source = std::make_shared<sMapStreamSource>();
+	source->mapMesh.meshesNum = 0;
+	source->mapMeshPosition = mapModel->position;
 
 	// Load simple walkable tiles
 	rapidjson::Value& walkableTileData = d["walkableTiles"];
 	for (unsigned int i = 0; i < walkableTileData.Size(); i++)
 	{
-		walkableTiles[walkableTileData[i].GetInt()];
+		source->walkableTiles[walkableTileData[i].GetInt()];
 	}
 
 	// Load complex walkable tiles
@@ -388,8 +565,8 @@ void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entran
 		for (unsigned int j = 0; j < tileIds.Size(); j++)
 		{
 			int tileId = tileIds[j].GetInt();
-			walkableTiles[tileId].walkableOffsets = newTileWalkableOffsets;
-			walkableTiles[tileId].unwalkableOffsets = newTileUnwalkableOffsets;
+			source->walkableTiles[tileId].walkableOffsets = newTileWalkableOffsets;
+			source->walkableTiles[tileId].unwalkableOffsets = newTileUnwalkableOffsets;
 		}
 	}
 
@@ -409,13 +586,13 @@ void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entran
 
 		int animationType = currInstancedTile["animationType"].GetInt();
 		mapInstancedTiles[tileId].instancedModel = Manager::render.CreateAnimatedModel(static_cast<eAnimatedModel>(animationType));
-		mapInstancedTiles[tileId].instancedModel->meshName = currInstancedTile["meshName"].GetString();
+		mapInstancedTiles[tileId].instancedModel->SetMeshName(currInstancedTile["meshName"].GetString());
 		mapInstancedTiles[tileId].instancedModel->orientation.y = glm::radians(meshOrientationY);
 		mapInstancedTiles[tileId].modelOffset = meshPosOffset;
+		source->instancedTileOffsets[tileId] = meshPosOffset;
 	}
 
 	// Load spawn data
-	std::vector<int> spawnTileIds;
 	if (d.HasMember("wildSpawning"))
 	{
 		rapidjson::Value& spawnData = d["wildSpawning"];
@@ -427,7 +604,7 @@ void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entran
 				rapidjson::Value& spawnTileId = spawnData[i]["spawnTileId"];
 				for (unsigned int j = 0; j < spawnTileId.Size(); j++)
 				{
-					spawnTileIds.push_back(spawnTileId[j].GetInt());
+					source->spawnTileIds.push_back(spawnTileId[j].GetInt());
 				}
 			}
 		}
@@ -439,262 +616,791 @@ void cMapManager::LoadMap(const std::string mapDescriptionFile, const int entran
 
 	// Load collision map
 	std::string collisionMapFileName = d["mapCollisionFileName"].GetString();
-	std::ifstream pdsmap(MAPS_PATH + collisionMapFileName);
+	if (!MapFile::Load(MAPS_PATH + collisionMapFileName, useCompiledMaps, source->compiledMap, source->parsedQuads, source->grid)) return;
 
-	if (!pdsmap.is_open()) return;
+	if (source->grid.quadsNum != 0)
+	{
+		int minX = source->grid.quads[0].posX;
+		int minZ = source->grid.quads[0].posZ;
+		int maxX = minX;
+		int maxZ = minZ;
+		for (unsigned int quadIndex = 1; quadIndex < source->grid.quadsNum; quadIndex++)
+		{
+			minX = std::min(minX, (int)source->grid.quads[quadIndex].posX);
+			minZ = std::min(minZ, (int)source->grid.quads[quadIndex].posZ);
+			maxX = std::max(maxX, (int)source->grid.quads[quadIndex].posX);
+			maxZ = std::max(maxZ, (int)source->grid.quads[quadIndex].posZ);
+		}
 
-	std::string currToken;
+		source->gridIndex.Reset(minX, minZ, maxX, maxZ);
+		for (unsigned int quadIndex = 0; quadIndex < source->grid.quadsNum; quadIndex++)
+		{
+			source->gridIndex.Set(source->grid.quads[quadIndex].posX, source->grid.quads[quadIndex].posZ, (int)quadIndex);
+		}
 
-	// make sure reader is at first mapstart
-	while (pdsmap >> currToken)
+		// Loaded quadrants are filled in as they're added
+		quadGrid.Reset(minX, minZ, maxX, maxZ);
+	}
+
+	// Load transition tiles
+	if (d.HasMember("sceneTransitions"))
 	{
-		if (currToken == "mapstart") break;
+		rapidjson::Value& sceneTramsitionsData = d["sceneTransitions"];
+		triggers.reserve(sceneTramsitionsData.Size()); // tiles point into this vector
+		for (unsigned int i = 0; i < sceneTramsitionsData.Size(); i++)
+		{
+			rapidjson::Value& currTransitionTile = sceneTramsitionsData[i];
+
+			int quadX = currTransitionTile["quadCoord"]["x"].GetInt();
+			int quadZ = currTransitionTile["quadCoord"]["z"].GetInt();
+
+			if (source->gridIndex.Find(quadX, quadZ) == -1) continue;
+
+			std::string transitionTo = currTransitionTile["transitionTo"].GetString();
+			int entranceNum = currTransitionTile["newSceneEntranceId"].GetInt();
+
+			triggers.emplace_back(transitionTo, entranceNum);
+			cTransitionTrigger& transitionTrigger = triggers.back();
+
+			int tileType = currTransitionTile["tileType"].GetInt();
+			glm::ivec3 localPos;
+			localPos.x = currTransitionTile["localQuadPos"]["x"].GetInt();
+			localPos.y = currTransitionTile["localQuadPos"]["y"].GetInt();
+			localPos.z = currTransitionTile["localQuadPos"]["z"].GetInt();
+			for (int j = 0; j < transitionTiles[static_cast<eTransitionTileTypes>(tileType)].size(); j++)
+			{
+				sMapTileEntity newTileEntity;
+				newTileEntity.quadX = quadX;
+				newTileEntity.quadZ = quadZ;
+				newTileEntity.localPos = localPos + transitionTiles[(eTransitionTileTypes)tileType][j];
+				newTileEntity.entity = &transitionTrigger;
+				mapTileEntities.push_back(newTileEntity);
+			}
+		}
 	}
 
-	// start here
-	while (currToken == "mapstart")
+	streamGeneration++;
+	if (useQuadrantStreaming)
 	{
-		quads.emplace_back();
-		sQuadrant& newQuad = quads.back();
-		int tempLayers[32][32][8];
+		streamSource = source;
+		streamPending.assign(source->grid.quadsNum, false);
+		streamingStats = sStreamingStats();
+	}
+	else
+	{
+		quads.reserve(quads.size() + source->grid.quadsNum);
+	}
 
-		// set quadrant coords
-		pdsmap >> newQuad.posX;
-		pdsmap >> newQuad.posZ;
+	// Only the quadrants around the entrance are built for a streamed map, the rest come in as the player walks
+	glm::ivec2 startQuad = GetQuadCoords(Player::GetPlayerPosition());
+	if (d.HasMember("sceneTransitions") && entranceNumUsed >= 0 && entranceNumUsed < (int)d["sceneTransitions"].Size())
+	{
+		rapidjson::Value& transitionTileUsed = d["sceneTransitions"][entranceNumUsed];
+
+		mapLoad.hasEntrance = true;
+		mapLoad.entranceQuadX = transitionTileUsed["quadCoord"]["x"].GetInt();
+		mapLoad.entranceQuadZ = transitionTileUsed["quadCoord"]["z"].GetInt();
+		mapLoad.entranceLocalPos.x = transitionTileUsed["localQuadPos"]["x"].GetInt();
+		mapLoad.entranceLocalPos.y = transitionTileUsed["localQuadPos"]["y"].GetInt();
+		mapLoad.entranceLocalPos.z = transitionTileUsed["localQuadPos"]["z"].GetInt();
+		mapLoad.playerSpawnOffset.x = transitionTileUsed["playerSpawnOffset"]["x"].GetInt();
+		mapLoad.playerSpawnOffset.y = transitionTileUsed["playerSpawnOffset"]["y"].GetInt();
+		mapLoad.playerSpawnOffset.z = transitionTileUsed["playerSpawnOffset"]["z"].GetInt();
+		mapLoad.entranceTileType = transitionTileUsed["tileType"].GetInt();
+		startQuad = glm::ivec2(mapLoad.entranceQuadX, mapLoad.entranceQuadZ);
+	}
+
+	for (unsigned int quadIndex = 0; quadIndex < source->grid.quadsNum; quadIndex++)
+	{
+		const sMapGridQuadrant& gridQuad = source->grid.quads[quadIndex];
+		if (useQuadrantStreaming && std::max(std::abs(gridQuad.posX - startQuad.x), std::abs(gridQuad.posZ - startQuad.y)) > streamingRadius) continue;
+
+		mapLoad.quadsToBuild.push_back(quadIndex);
+	}
+
+	mapLoad.source = source;
+	mapLoad.mapModelFile = mapModelName;
+	mapLoad.arenaDescFile = d["arenaDescFileName"].GetString();
+	mapLoad.stage = useQuadrantStreaming ? MAP_LOAD_SPLIT_MESH : MAP_LOAD_QUADRANTS;
+}
 
-		// skip areaindex
-		pdsmap >> currToken;
-		pdsmap >> currToken;
+bool cMapManager::ContinueLoadingMap(float budgetMs)
+{
+	ZoneScopedN("ContinueLoadingMap");
 
-		for (int layerId = 0; layerId < 8; layerId++)
+	// Each step is at most one quadrant or one whole pass, so a frame can go over by that much
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<float, std::milli> elapsed(0.f);
+	while (mapLoad.stage != MAP_LOAD_NONE && elapsed.count() < budgetMs)
+	{
+		if (mapLoad.stage == MAP_LOAD_SPLIT_MESH)
 		{
-			pdsmap >> currToken;
+			sMapStreamSource& source = *mapLoad.source;
+			if (Manager::render.ReadModelGeometry(mapLoad.mapModelFile, source.mapMeshFile, source.importedMapMesh, source.mapMesh))
+			{
+				std::vector<sMeshGeometry> restGeometry;
+				SplitMapMesh(source, restGeometry);
 
-			if (currToken != "tilegrid") break;
+				splitMeshName = mapLoad.mapModelFile;
+				Manager::render.CreateMesh(splitMeshName + "#rest", "scene", restGeometry);
+				mapModel->SetMeshName(splitMeshName + "#rest");
+			}
 
-			for (int x = 0; x < 32; x++)
+			mapLoad.stage = MAP_LOAD_QUADRANTS;
+		}
+		else if (mapLoad.stage == MAP_LOAD_QUADRANTS)
+		{
+			if (mapLoad.builtQuadsNum < mapLoad.quadsToBuild.size())
 			{
-				for (int z = 0; z < 32; z++)
-				{
-					pdsmap >> tempLayers[x][z][layerId];
-				}
+				sQuadrant newQuad;
+				BuildQuadrant(*mapLoad.source, mapLoad.source->grid.quads[mapLoad.quadsToBuild[mapLoad.builtQuadsNum]], newQuad);
+				AddQuadrant(newQuad);
+				mapLoad.builtQuadsNum++;
+				if (useQuadrantStreaming) streamingStats.loadedQuadsNum++;
+			}
+			else
+			{
+				PlacePlayerAtEntrance();
+				mapLoad.stage = MAP_LOAD_UPLOADS;
 			}
 		}
+		else if (mapLoad.stage == MAP_LOAD_UPLOADS)
+		{
+			// Everything built so far goes up before the batches are laid out around it
+			if (!pendingQuadUploads.empty())
+				UploadPendingQuadrants(budgetMs - elapsed.count());
+			else
+				mapLoad.stage = MAP_LOAD_BATCHES;
+		}
+		else if (mapLoad.stage == MAP_LOAD_BATCHES)
+		{
+			std::vector< std::shared_ptr<cRenderModel> > tileModels;
+			for (std::map<int, sInstancedTile>::iterator it = mapInstancedTiles.begin(); it != mapInstancedTiles.end(); it++)
+			{
+				tileModels.push_back(it->second.instancedModel);
+			}
 
-		for (int layerId = 0; layerId < 8; layerId++)
+			// Pack all tile meshes so they can be drawn with one indirect call per shader
+			Manager::render.BuildTileBatches(tileModels);
+			mapLoad.stage = MAP_LOAD_ARENA;
+		}
+		else if (mapLoad.stage == MAP_LOAD_ARENA)
 		{
-			pdsmap >> currToken;
+			LoadArena(mapLoad.arenaDescFile);
+			mapLoad = sMapLoad();
+		}
 
-			if (currToken != "heightgrid") break;
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+	}
 
-			for (int x = 0; x < 32; x++)
+	return mapLoad.stage == MAP_LOAD_NONE;
+}
+
+void cMapManager::PlacePlayerAtEntrance()
+{
+	if (!mapLoad.hasEntrance) return;
+
+	sQuadrant* entranceQuad = GetQuadFromCoords(mapLoad.entranceQuadX, mapLoad.entranceQuadZ);
+	if (!entranceQuad) return;
+
+	glm::ivec3 finalPlayerLocalPos = mapLoad.entranceLocalPos + mapLoad.playerSpawnOffset;
+	glm::ivec3 finalPlayerPos = entranceQuad->LocalPositionToGlobalPosition(finalPlayerLocalPos);
+	Player::playerChar->spriteModel->model.get()->position = finalPlayerPos;
+	Player::playerChar->position = finalPlayerPos;
+	entranceQuad->GetTileFromLocalPosition(finalPlayerLocalPos).SetEntity(Player::playerChar);
+
+	glm::ivec3 partnerOffest = glm::ivec3(0);
+	switch (mapLoad.entranceTileType)
+	{
+	case eTransitionTileTypes::HEDGE_LEFT:
+		partnerOffest.z = 1;
+		//Player::playerPartner.get()->spriteModel->AnimateMovement(LEFT, false, FAILURE); // investigate why this teleports partner to origin
+		break;
+	case eTransitionTileTypes::HEDGE_RIGHT:
+		partnerOffest.z = -1;
+		//Player::playerPartner.get()->spriteModel->AnimateMovement(RIGHT, false, FAILURE);
+		break;
+	default:
+		break;
+	}
+
+	glm::ivec3 partnerLocalPos = finalPlayerLocalPos + partnerOffest;
+	glm::ivec3 partnerPos = entranceQuad->LocalPositionToGlobalPosition(partnerLocalPos);
+	Player::playerPartner.get()->spriteModel->model.get()->position = partnerPos;
+	Player::playerPartner.get()->position = partnerPos;
+	//entranceQuad->GetTileFromLocalPosition(partnerLocalPos).SetEntity(Player::playerPartner.get());
+}
+
+void cMapManager::UnloadMap()
+{
+	// Streaming jobs still in flight hold their own reference to the source and are dropped when they finish
+	streamGeneration++;
+	streamSource.reset();
+	streamPending.clear();
+	pendingQuadUploads.clear();
+	mapLoad = sMapLoad();
+
+	Manager::render.ClearTileBatches();
+
+	for (unsigned int quadIndex = 0; quadIndex < quads.size(); quadIndex++)
+	{
+		if (!quads[quadIndex].meshModel) continue;
+
+		Manager::render.RemoveModel(quads[quadIndex].meshModel);
+		Manager::render.DestroyMesh(GetQuadrantMeshName(quads[quadIndex]));
+	}
+
+	if (splitMeshName != "")
+	{
+		Manager::render.DestroyMesh(splitMeshName + "#rest");
+		splitMeshName = "";
+	}
+
+	for (std::map<int, sInstancedTile>::iterator it = mapInstancedTiles.begin(); it != mapInstancedTiles.end(); it++)
+	{
+		it->second.instancedModel->StopAnimation();
+		Manager::render.RemoveModel(it->second.instancedModel);
+	}
+	mapInstancedTiles.clear();
+
+	for (std::map<int, sInstancedTile>::iterator it = arenaInstancedTiles.begin(); it != arenaInstancedTiles.end(); it++)
+	{
+		it->second.instancedModel->StopAnimation();
+		Manager::render.RemoveModel(it->second.instancedModel);
+	}
+	arenaInstancedTiles.clear();
+
+	quads.clear();
+	quadGrid.Clear();
+	triggers.clear();
+	mapTileEntities.clear();
+	evictedTileEntities.clear();
+
+	for (unsigned int i = 0; i < loadedModelFiles.size(); i++)
+	{
+		Manager::render.ReleaseModel(loadedModelFiles[i]);
+	}
+	loadedModelFiles.clear();
+
+	for (unsigned int i = 0; i < loadedTextures.size(); i++)
+	{
+		Manager::render.ReleaseTexture(loadedTextures[i]);
+	}
+	loadedTextures.clear();
+
+	for (unsigned int i = 0; i < loadedSpriteSheets.size(); i++)
+	{
+		Manager::render.ReleaseSpriteSheet(loadedSpriteSheets[i]);
+	}
+	loadedSpriteSheets.clear();
+}
+
+void cMapManager::PrepareMap(const std::string mapDescriptionFile, bool compileMaps, bool isStreamed, std::vector<std::string>& modelFilesOut)
+{
+	ZoneScopedN("PrepareMap");
+
+	rapidjson::Document d;
+	if (!ReadDescriptionFile(MAPS_PATH + mapDescriptionFile, d)) return;
+
+	if (isStreamed)
+		cRenderManager::CookModel(d["mapModelFileName"].GetString());
+	else
+		AddModelFile(d["mapModelFileName"].GetString(), modelFilesOut);
+
+	rapidjson::Value& instancedTileData = d["instancedTiles"];
+	for (unsigned int i = 0; i < instancedTileData.Size(); i++)
+	{
+		AddModelFile(instancedTileData[i]["meshName"].GetString(), modelFilesOut);
+	}
+
+	// Loading writes the compiled file when it's missing or stale, LoadMap then only has to map it
+	if (compileMaps)
+	{
+		cMappedFile compiledMap;
+		std::vector<sMapGridQuadrant> parsedQuads;
+		sMapGridView grid;
+		MapFile::Load(MAPS_PATH + d["mapCollisionFileName"].GetString(), true, compiledMap, parsedQuads, grid);
+	}
+
+	rapidjson::Document arenaDoc;
+	if (!ReadDescriptionFile(ARENAS_PATH + d["arenaDescFileName"].GetString(), arenaDoc)) return;
+
+	AddModelFile(arenaDoc["arenaModelFileName"].GetString(), modelFilesOut);
+
+	rapidjson::Value& arenaInstancedTileData = arenaDoc["instancedTiles"];
+	for (unsigned int i = 0; i < arenaInstancedTileData.Size(); i++)
+	{
+		AddModelFile(arenaInstancedTileData[i]["meshName"].GetString(), modelFilesOut);
+	}
+
+	if (compileMaps)
+	{
+		cMappedFile compiledMap;
+		std::vector<sMapGridQuadrant> parsedQuads;
+		sMapGridView grid;
+		MapFile::Load(ARENAS_PATH + arenaDoc["arenaDetailFileName"].GetString(), true, compiledMap, parsedQuads, grid);
+	}
+}
+
+void cMapManager::BuildQuadrant(const sMapStreamSource& source, const sMapGridQuadrant& gridQuad, sQuadrant& newQuad)
+{
+	newQuad.posX = gridQuad.posX;
+	newQuad.posZ = gridQuad.posZ;
+
+	for (unsigned int layerId = 0; layerId < gridQuad.layersNum; layerId++)
+	{
+		for (int x = 0; x < 32; x++)
+		{
+			for (int z = 0; z < 32; z++)
 			{
-				for (int z = 0; z < 32; z++)
-				{
-					int currHeight;
-					pdsmap >> currHeight;
+				int currHeight = gridQuad.heights[layerId][x][z];
+				int tileId = gridQuad.tiles[layerId][x][z];
 
-					int tileId = tempLayers[x][z][layerId];
+				if (tileId == -1) continue;
 
-					if (tileId == -1) continue;
+				sTile currTile = newQuad.GetTileFromLocalPosition(glm::ivec3(x, currHeight, z));
 
-					sTile* currTile = newQuad.GetTileFromLocalPosition(glm::ivec3(x, currHeight, z));
-
-					if (!currTile->isUnchangeable && walkableTiles.find(tileId) != walkableTiles.end()) // is walkable
-					{						
-						currTile->isWalkable = true;
-
-						// Walkable correction tiles
-						for (unsigned int i = 0; i < walkableTiles[tileId].walkableOffsets.size(); i++)
-						{
-							int correctionX = x + walkableTiles[tileId].walkableOffsets[i].x;
-							int correctionZ = z + walkableTiles[tileId].walkableOffsets[i].z;
-							int correctionHeight = currHeight + walkableTiles[tileId].walkableOffsets[i].y;
-
-							newQuad.GetTileFromLocalPosition(glm::ivec3(correctionX, correctionHeight, correctionZ))->isWalkable = true;
-						}
-
-						// Unwalkable correction tiles
-						for (unsigned int i = 0; i < walkableTiles[tileId].unwalkableOffsets.size(); i++)
-						{
-							int correctionX = x + walkableTiles[tileId].unwalkableOffsets[i].x;
-							int correctionZ = z + walkableTiles[tileId].unwalkableOffsets[i].z;
-							int correctionHeight = currHeight + walkableTiles[tileId].unwalkableOffsets[i].y;
-
-							sTile* tileToCorrect = newQuad.GetTileFromLocalPosition(glm::vec3(correctionX, correctionHeight, correctionZ));
-							tileToCorrect->isWalkable = false;
-							tileToCorrect->isUnchangeable = true;
-						}
-
-						if (std::find(spawnTileIds.begin(), spawnTileIds.end(), tileId) != spawnTileIds.end())
-						{
-							newQuad.localSpawnTiles.push_back(sQuadrant::GetTileIdFromPosition(glm::vec3(x, currHeight, z)));
-						}
-					}
-					else // is NOT walkable
+				std::map<int, sCorrectionTiles>::const_iterator walkableIt = source.walkableTiles.find(tileId);
+				if (!currTile.IsUnchangeable() && walkableIt != source.walkableTiles.end()) // is walkable
+				{
+					const sCorrectionTiles& corrections = walkableIt->second;
+					currTile.SetWalkable(true);
+
+					// Walkable correction tiles
+					for (unsigned int i = 0; i < corrections.walkableOffsets.size(); i++)
 					{
-						currTile->isWalkable = false;
-						currTile->isUnchangeable = true;
+						int correctionX = x + corrections.walkableOffsets[i].x;
+						int correctionZ = z + corrections.walkableOffsets[i].z;
+						int correctionHeight = currHeight + corrections.walkableOffsets[i].y;
+
+						newQuad.GetTileFromLocalPosition(glm::ivec3(correctionX, correctionHeight, correctionZ)).SetWalkable(true);
 					}
 
-					if (mapInstancedTiles.find(tileId) != mapInstancedTiles.end()) // it exists
+					// Unwalkable correction tiles
+					for (unsigned int i = 0; i < corrections.unwalkableOffsets.size(); i++)
 					{
-						glm::vec4 newOffset = glm::vec4((newQuad.posX * 32 - 15 + x), currHeight, (newQuad.posZ * 32 - 15 + z), 1.f);
-						newOffset.x += mapInstancedTiles[tileId].modelOffset.x;
-						newOffset.y += mapInstancedTiles[tileId].modelOffset.y;
-						newOffset.z += mapInstancedTiles[tileId].modelOffset.z;
+						int correctionX = x + corrections.unwalkableOffsets[i].x;
+						int correctionZ = z + corrections.unwalkableOffsets[i].z;
+						int correctionHeight = currHeight + corrections.unwalkableOffsets[i].y;
+
+						sTile tileToCorrect = newQuad.GetTileFromLocalPosition(glm::vec3(correctionX, correctionHeight, correctionZ));
+						tileToCorrect.SetWalkable(false);
+						tileToCorrect.SetUnchangeable(true);
+					}
 
-						mapInstancedTiles[tileId].instanceOffsets.push_back(newOffset);
+					if (std::find(source.spawnTileIds.begin(), source.spawnTileIds.end(), tileId) != source.spawnTileIds.end())
+					{
+						newQuad.localSpawnTiles.push_back(sQuadrant::GetTileIdFromPosition(glm::vec3(x, currHeight, z)));
 					}
 				}
+				else // is NOT walkable
+				{
+					currTile.SetWalkable(false);
+					currTile.SetUnchangeable(true);
+				}
+
+				std::map<int, glm::vec3>::const_iterator instancedIt = source.instancedTileOffsets.find(tileId);
+				if (instancedIt != source.instancedTileOffsets.end()) // it exists
+				{
+					// w is where the mesh's origin is in vertex space, tile batches bake the model transform and change it
+					glm::vec4 newOffset = glm::vec4((newQuad.posX * 32 - 15 + x), currHeight, (newQuad.posZ * 32 - 15 + z), 0.f);
+					newOffset.x += instancedIt->second.x;
+					newOffset.y += instancedIt->second.y;
+					newOffset.z += instancedIt->second.z;
+
+					newQuad.tileInstanceOffsets[tileId].push_back(newOffset);
+				}
 			}
 		}
+	}
+
+	int sourceIndex = source.gridIndex.Find(gridQuad.posX, gridQuad.posZ);
+	if (sourceIndex != -1)
+		BuildQuadrantMesh(source, sourceIndex, newQuad.meshGeometry);
 
-		pdsmap >> currToken; // this should be mapend
-		pdsmap >> currToken; // if there is another quad, this will be mapstart
+	for (unsigned int i = 0; i < newQuad.meshGeometry.size(); i++)
+	{
+		newQuad.meshBytes += (unsigned int)(newQuad.meshGeometry[i].vertices.size() * sizeof(sVertexData) + newQuad.meshGeometry[i].indices.size() * sizeof(unsigned int));
 	}
-	// end here
+}
 
-	pdsmap.close();
+// Copies one triangle of the map mesh, vertices the piece already has are shared
+static void AppendMapTriangle(const sCookedModelView& mesh, unsigned int meshIndex, unsigned int firstIndex, std::vector<sMeshGeometry>& geometry, std::vector< std::unordered_map<unsigned int, unsigned int> >& vertexRemaps)
+{
+	const sCookedMeshRange& range = mesh.meshes[meshIndex];
+	sMeshGeometry& piece = geometry[meshIndex];
+	std::unordered_map<unsigned int, unsigned int>& remap = vertexRemaps[meshIndex];
 
-	// Load transition tiles
-	if (d.HasMember("sceneTransitions"))
+	for (unsigned int i = 0; i < 3; i++)
 	{
-		rapidjson::Value& sceneTramsitionsData = d["sceneTransitions"];
-		for (unsigned int i = 0; i < sceneTramsitionsData.Size(); i++)
+		unsigned int index = mesh.indices[firstIndex + i];
+		std::unordered_map<unsigned int, unsigned int>::iterator it = remap.find(index);
+		if (it == remap.end())
 		{
-			rapidjson::Value& currTransitionTile = sceneTramsitionsData[i];
+			it = remap.insert(std::pair<unsigned int, unsigned int>(index, (unsigned int)piece.vertices.size())).first;
+			piece.vertices.push_back(mesh.vertices[range.firstVertex + index]);
+		}
 
-			int quadX = currTransitionTile["quadCoord"]["x"].GetInt();
-			int quadZ = currTransitionTile["quadCoord"]["z"].GetInt();
+		piece.indices.push_back(it->second);
+	}
+}
 
-			sQuadrant* quad = nullptr;
-			for (int q = 0; q < quads.size(); q++)
+void cMapManager::SplitMapMesh(sMapStreamSource& source, std::vector<sMeshGeometry>& restGeometryOut)
+{
+	ZoneScopedN("SplitMapMesh");
+
+	const sCookedModelView& mesh = source.mapMesh;
+	restGeometryOut.resize(mesh.meshesNum);
+	std::vector< std::unordered_map<unsigned int, unsigned int> > vertexRemaps(mesh.meshesNum);
+
+	// Triangles go to the quadrant their centre is on, counted first so they can be packed by quadrant
+	std::vector<int> triangleQuads;
+	source.quadTrianglesFirst.assign(source.grid.quadsNum + 1, 0);
+	for (unsigned int meshIndex = 0; meshIndex < mesh.meshesNum; meshIndex++)
+	{
+		const sCookedMeshRange& range = mesh.meshes[meshIndex];
+		restGeometryOut[meshIndex].textureName = range.textureName;
+
+		for (unsigned int firstIndex = range.firstIndex; firstIndex + 2 < range.firstIndex + range.indicesNum; firstIndex += 3)
+		{
+			glm::vec3 centre = glm::vec3(0.f);
+			for (unsigned int i = 0; i < 3; i++)
 			{
-				if (quads[q].posX == quadX && quads[q].posZ == quadZ)
-				{
-					quad = &quads[q];
-					break;
-				}
+				const sVertexData& vertex = mesh.vertices[range.firstVertex + mesh.indices[firstIndex + i]];
+				centre += glm::vec3(vertex.x, vertex.y, vertex.z) / 3.f;
 			}
-			if (!quad) continue;
 
-			std::string transitionTo = currTransitionTile["transitionTo"].GetString();
-			int entranceNum = currTransitionTile["newSceneEntranceId"].GetInt();
+			glm::ivec2 quadCoords = GetQuadCoords(centre + source.mapMeshPosition);
+			int sourceIndex = source.gridIndex.Find(quadCoords.x, quadCoords.y);
+			triangleQuads.push_back(sourceIndex);
 
-			triggers.emplace_back(transitionTo, entranceNum);
-			cTransitionTrigger& transitionTrigger = triggers.back();
+			if (sourceIndex != -1)
+				source.quadTrianglesFirst[sourceIndex + 1]++;
+			else
+				AppendMapTriangle(mesh, meshIndex, firstIndex, restGeometryOut, vertexRemaps);
+		}
+	}
 
-			int tileType = currTransitionTile["tileType"].GetInt();
-			glm::ivec3 localPos;
-			localPos.x = currTransitionTile["localQuadPos"]["x"].GetInt();
-			localPos.y = currTransitionTile["localQuadPos"]["y"].GetInt();
-			localPos.z = currTransitionTile["localQuadPos"]["z"].GetInt();
-			for (int j = 0; j < transitionTiles[static_cast<eTransitionTileTypes>(tileType)].size(); j++)
-			{
-				glm::ivec3 finalPos = localPos + transitionTiles[(eTransitionTileTypes)tileType][j];
+	for (unsigned int i = 1; i < source.quadTrianglesFirst.size(); i++)
+	{
+		source.quadTrianglesFirst[i] += source.quadTrianglesFirst[i - 1];
+	}
 
-				quad->GetTileFromLocalPosition(finalPos)->entity = &transitionTrigger;
-			}
+	std::vector<unsigned int> quadCursors(source.quadTrianglesFirst.begin(), source.quadTrianglesFirst.end() - 1);
+	source.quadTriangles.resize(source.quadTrianglesFirst.back());
+
+	unsigned int triangleIndex = 0;
+	for (unsigned int meshIndex = 0; meshIndex < mesh.meshesNum; meshIndex++)
+	{
+		const sCookedMeshRange& range = mesh.meshes[meshIndex];
+		for (unsigned int firstIndex = range.firstIndex; firstIndex + 2 < range.firstIndex + range.indicesNum; firstIndex += 3, triangleIndex++)
+		{
+			int sourceIndex = triangleQuads[triangleIndex];
+			if (sourceIndex == -1) continue;
+
+			source.quadTriangles[quadCursors[sourceIndex]++] = glm::uvec2(meshIndex, firstIndex);
 		}
+	}
+}
+
+void cMapManager::BuildQuadrantMesh(const sMapStreamSource& source, unsigned int sourceIndex, std::vector<sMeshGeometry>& geometryOut)
+{
+	if (source.quadTrianglesFirst.empty()) return;
+
+	unsigned int firstTriangle = source.quadTrianglesFirst[sourceIndex];
+	unsigned int lastTriangle = source.quadTrianglesFirst[sourceIndex + 1];
+	if (firstTriangle == lastTriangle) return;
+
+	const sCookedModelView& mesh = source.mapMesh;
+	geometryOut.resize(mesh.meshesNum);
+	for (unsigned int meshIndex = 0; meshIndex < mesh.meshesNum; meshIndex++)
+	{
+		geometryOut[meshIndex].textureName = mesh.meshes[meshIndex].textureName;
+	}
+
+	std::vector< std::unordered_map<unsigned int, unsigned int> > vertexRemaps(mesh.meshesNum);
+	for (unsigned int i = firstTriangle; i < lastTriangle; i++)
+	{
+		AppendMapTriangle(mesh, source.quadTriangles[i].x, source.quadTriangles[i].y, geometryOut, vertexRemaps);
+	}
+}
+
+std::string cMapManager::GetQuadrantMeshName(const sQuadrant& quad)
+{
+	return splitMeshName + "#" + std::to_string(quad.posX) + "," + std::to_string(quad.posZ);
+}
 
-		// Set player position based on entrance used
-		if (entranceNumUsed >= 0 && entranceNumUsed < sceneTramsitionsData.Size())
+glm::ivec2 cMapManager::GetQuadCoords(glm::vec3 worldPosition)
+{
+	int quadX = (int)std::floor((std::floor(worldPosition.x) + 15.f) / 32.f);
+	int quadZ = (int)std::floor((std::floor(worldPosition.z) + 15.f) / 32.f);
+
+	return glm::ivec2(quadX, quadZ);
+}
+
+void cMapManager::AddQuadrant(sQuadrant& newQuad)
+{
+	quads.push_back(std::move(newQuad));
+	sQuadrant& quad = quads.back();
+	quadGrid.Set(quad.posX, quad.posZ, (int)quads.size() - 1);
+
+	for (unsigned int i = 0; i < mapTileEntities.size(); i++)
+	{
+		if (mapTileEntities[i].quadX != quad.posX || mapTileEntities[i].quadZ != quad.posZ) continue;
+
+		quad.GetTileFromLocalPosition(mapTileEntities[i].localPos).SetEntity(mapTileEntities[i].entity);
+	}
+
+	// Whatever was still standing on it when it was evicted
+	for (unsigned int i = 0; i < evictedTileEntities.size(); )
+	{
+		if (evictedTileEntities[i].quadX != quad.posX || evictedTileEntities[i].quadZ != quad.posZ)
 		{
-			rapidjson::Value& transitionTileUsed = sceneTramsitionsData[entranceNumUsed];
+			i++;
+			continue;
+		}
 
-			int quadX = transitionTileUsed["quadCoord"]["x"].GetInt();
-			int quadZ = transitionTileUsed["quadCoord"]["z"].GetInt();
+		quad.GetTileFromLocalPosition(evictedTileEntities[i].localPos).SetEntity(evictedTileEntities[i].entity);
+		evictedTileEntities[i] = evictedTileEntities.back();
+		evictedTileEntities.pop_back();
+	}
 
-			sQuadrant* entranceQuad = nullptr;
-			for (int q = 0; q < quads.size(); q++)
-			{
-				if (quads[q].posX == quadX && quads[q].posZ == quadZ)
-				{
-					entranceQuad = &quads[q];
-					break;
-				}
-			}
+	pendingQuadUploads.push_back(glm::ivec2(quad.posX, quad.posZ));
+}
 
-			if (entranceQuad)
-			{
-				glm::ivec3 spawnOffset;
-				spawnOffset.x = transitionTileUsed["playerSpawnOffset"]["x"].GetInt();
-				spawnOffset.y = transitionTileUsed["playerSpawnOffset"]["y"].GetInt();
-				spawnOffset.z = transitionTileUsed["playerSpawnOffset"]["z"].GetInt();
-
-				glm::ivec3 localPos;
-				localPos.x = transitionTileUsed["localQuadPos"]["x"].GetInt();
-				localPos.y = transitionTileUsed["localQuadPos"]["y"].GetInt();
-				localPos.z = transitionTileUsed["localQuadPos"]["z"].GetInt();
-
-				glm::ivec3 finalPlayerLocalPos = localPos + spawnOffset;
-				glm::ivec3 finalPlayerPos = entranceQuad->LocalPositionToGlobalPosition(finalPlayerLocalPos);
-				Player::playerChar->spriteModel->model.get()->position = finalPlayerPos;
-				Player::playerChar->position = finalPlayerPos;
-				entranceQuad->GetTileFromLocalPosition(finalPlayerLocalPos)->entity = Player::playerChar;
-
-				glm::ivec3 partnerOffest = glm::ivec3(0);
-				switch (transitionTileUsed["tileType"].GetInt())
-				{
-				case eTransitionTileTypes::HEDGE_LEFT:
-					partnerOffest.z = 1;
-					//Player::playerPartner.get()->spriteModel->AnimateMovement(LEFT, false, FAILURE); // investigate why this teleports partner to origin
-					break;
-				case eTransitionTileTypes::HEDGE_RIGHT:
-					partnerOffest.z = -1;
-					//Player::playerPartner.get()->spriteModel->AnimateMovement(RIGHT, false, FAILURE);
-					break;
-				default:
-					break;
-				}
+void cMapManager::RemoveQuadrant(unsigned int quadIndex)
+{
+	sQuadrant& quad = quads[quadIndex];
 
-				glm::ivec3 partnerLocalPos = finalPlayerLocalPos + partnerOffest;
-				glm::ivec3 partnerPos = entranceQuad->LocalPositionToGlobalPosition(partnerLocalPos);
-				Player::playerPartner.get()->spriteModel->model.get()->position = partnerPos;
-				Player::playerPartner.get()->position = partnerPos;
-				//entranceQuad->GetTileFromLocalPosition(partnerLocalPos)->entity = Player::playerPartner.get();
-			}
+	// Map description entities are placed again from mapTileEntities, anything else is kept for when it comes back
+	for (unsigned int i = 0; i < quad.tileEntities.size(); i++)
+	{
+		glm::ivec3 localPos = sQuadrant::GetLocalPositionFromTileId(quad.tileEntities[i].tileId);
+
+		bool isMapTileEntity = false;
+		for (unsigned int j = 0; j < mapTileEntities.size() && !isMapTileEntity; j++)
+		{
+			isMapTileEntity = mapTileEntities[j].quadX == quad.posX && mapTileEntities[j].quadZ == quad.posZ
+				&& mapTileEntities[j].localPos == localPos && mapTileEntities[j].entity == quad.tileEntities[i].entity;
 		}
+		if (isMapTileEntity) continue;
+
+		sMapTileEntity evictedEntity;
+		evictedEntity.quadX = quad.posX;
+		evictedEntity.quadZ = quad.posZ;
+		evictedEntity.localPos = localPos;
+		evictedEntity.entity = quad.tileEntities[i].entity;
+		evictedTileEntities.push_back(evictedEntity);
 	}
 
-	// Load tile specific animations
-	for (std::map<int, sInstancedTile>::iterator it = mapInstancedTiles.begin(); it != mapInstancedTiles.end(); it++)
+	if (quad.meshModel)
 	{
-		if (it->second.instanceOffsets.size() != 0)
+		Manager::render.RemoveModel(quad.meshModel);
+		Manager::render.DestroyMesh(GetQuadrantMeshName(quad));
+	}
+
+	// Only its buckets go, the rest of each tile buffer stays as it is
+	if (quads[quadIndex].isUploaded)
+	{
+		int key = quadGrid.GetCell(quads[quadIndex].posX, quads[quadIndex].posZ);
+		for (std::map<int, std::vector<glm::vec4>>::const_iterator it = quads[quadIndex].tileInstanceOffsets.begin(); it != quads[quadIndex].tileInstanceOffsets.end(); it++)
 		{
-			it->second.instancedModel->InstanceObject(it->second.instanceOffsets);
+			std::map<int, sInstancedTile>::iterator tile = mapInstancedTiles.find(it->first);
+			if (tile != mapInstancedTiles.end())
+				Manager::render.RemoveTileInstances(tile->second.instancedModel, key);
+		}
+	}
 
-			if (it->second.instancedModel->animation)
-				Manager::animation.AddAnimation(it->second.instancedModel->animation);
+	quadGrid.Set(quads[quadIndex].posX, quads[quadIndex].posZ, -1);
 
-			it->second.instanceOffsets.clear();
+	// Swap and pop, the moved quadrant gets its new index
+	if (quadIndex != quads.size() - 1)
+	{
+		quads[quadIndex] = std::move(quads.back());
+		quadGrid.Set(quads[quadIndex].posX, quads[quadIndex].posZ, (int)quadIndex);
+	}
+	quads.pop_back();
+}
+
+void cMapManager::UploadQuadrant(sQuadrant& quad)
+{
+	ZoneScopedN("UploadQuadrant");
+
+	// Each tile type gets one bucket per quadrant, keyed by the quadrant's cell so it can be found again on eviction
+	int key = quadGrid.GetCell(quad.posX, quad.posZ);
+	for (std::map<int, std::vector<glm::vec4>>::const_iterator it = quad.tileInstanceOffsets.begin(); it != quad.tileInstanceOffsets.end(); it++)
+	{
+		std::map<int, sInstancedTile>::iterator tile = mapInstancedTiles.find(it->first);
+		if (tile == mapInstancedTiles.end()) continue;
+
+		std::shared_ptr<cAnimatedModel>& model = tile->second.instancedModel;
+
+		// First time this tile shows up
+		if (!model->isInstanced)
+			model->StartAnimation();
+
+		Manager::render.SetTileInstances(model, key, it->second);
+	}
+
+	if (!quad.meshGeometry.empty())
+	{
+		std::string meshName = GetQuadrantMeshName(quad);
+		Manager::render.CreateMesh(meshName, "scene", quad.meshGeometry);
+
+		quad.meshModel = Manager::render.CreateRenderModel();
+		quad.meshModel->position = mapModel->position;
+		quad.meshModel->SetMeshName(meshName);
+
+		std::vector<sMeshGeometry>().swap(quad.meshGeometry); // the arenas have it now
+	}
+
+	quad.isUploaded = true;
+}
+
+void cMapManager::UploadPendingQuadrants(float budgetMs)
+{
+	if (pendingQuadUploads.empty()) return;
+
+	ZoneScopedN("UploadPendingQuadrants");
+
+	// At least one a frame, each one is a few small buffer updates
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<float, std::milli> elapsed(0.f);
+	while (!pendingQuadUploads.empty() && elapsed.count() < budgetMs)
+	{
+		glm::ivec2 quadCoords = pendingQuadUploads.front();
+		pendingQuadUploads.pop_front();
+
+		// Evicted before it got here, or already up from an earlier entry
+		sQuadrant* quad = GetQuadFromCoords(quadCoords.x, quadCoords.y);
+		if (quad && !quad->isUploaded)
+			UploadQuadrant(*quad);
+
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+	}
+
+	streamingStats.lastUploadMs = elapsed.count();
+	streamingStats.queuedUploadsNum = (unsigned int)pendingQuadUploads.size();
+}
+
+unsigned int cMapManager::GetQuadrantBytes(const sQuadrant& quad)
+{
+	unsigned int bytes = sizeof(sQuadrant);
+	bytes += (unsigned int)(quad.tileEntities.capacity() * sizeof(sTileEntity));
+	bytes += (unsigned int)(quad.localSpawnTiles.capacity() * sizeof(int));
+	bytes += quad.meshBytes; // in the arenas once it's uploaded, freed with the quadrant either way
+
+	for (std::map<int, std::vector<glm::vec4>>::const_iterator it = quad.tileInstanceOffsets.begin(); it != quad.tileInstanceOffsets.end(); it++)
+	{
+		bytes += (unsigned int)(it->second.capacity() * sizeof(glm::vec4));
+	}
+
+	return bytes;
+}
+
+void cMapManager::RequestQuadrant(unsigned int sourceIndex)
+{
+	streamPending[sourceIndex] = true;
+	streamingStats.pendingQuadsNum++;
+
+	// The job only touches the source and its own quadrant, everything else happens back on the main thread
+	std::shared_ptr<sMapStreamSource> source = streamSource;
+	std::shared_ptr<sQuadrant> newQuad = std::make_shared<sQuadrant>();
+	unsigned int generation = streamGeneration;
+
+	Manager::jobs.Submit(
+		[source, newQuad, sourceIndex]()
+		{
+			BuildQuadrant(*source, source->grid.quads[sourceIndex], *newQuad);
+		},
+		[this, newQuad, sourceIndex, generation]()
+		{
+			if (generation != streamGeneration) return; // map changed while it was loading
+
+			streamPending[sourceIndex] = false;
+			streamingStats.pendingQuadsNum--;
+			streamingStats.loadedQuadsNum++;
+			AddQuadrant(*newQuad);
+		});
+}
+
+void cMapManager::EvictFarQuadrants(int centerQuadX, int centerQuadZ)
+{
+	unsigned int residentBytes = 0;
+	for (unsigned int quadIndex = 0; quadIndex < quads.size(); quadIndex++)
+	{
+		residentBytes += GetQuadrantBytes(quads[quadIndex]);
+	}
+
+	// Farthest first, never the ones inside the radius even if that means going over the cap
+	while (residentBytes > streamingMemoryCapKb * 1024)
+	{
+		int farthestIndex = -1;
+		int farthestDistance = streamingRadius;
+		for (unsigned int quadIndex = 0; quadIndex < quads.size(); quadIndex++)
+		{
+			int distance = std::max(std::abs(quads[quadIndex].posX - centerQuadX), std::abs(quads[quadIndex].posZ - centerQuadZ));
+			if (distance > farthestDistance)
+			{
+				farthestDistance = distance;
+				farthestIndex = (int)quadIndex;
+			}
 		}
+
+		if (farthestIndex == -1) break;
+
+		// Wild Pokémon only spawn around the player, the ones it left behind go with their quadrant
+		Manager::scene.DespawnWildPokemonInQuadrant(quads[farthestIndex].posX, quads[farthestIndex].posZ);
+
+		residentBytes -= GetQuadrantBytes(quads[farthestIndex]);
+		RemoveQuadrant(farthestIndex);
+		streamingStats.evictedQuadsNum++;
 	}
 
-	std::string arenaDescFileName = d["arenaDescFileName"].GetString();
-	LoadArena(arenaDescFileName);
+	streamingStats.residentQuadsNum = (unsigned int)quads.size();
+	streamingStats.residentBytes = residentBytes;
 }
 
-void cMapManager::UnloadMap()
+void cMapManager::UpdateTileModels(float deltaTime)
 {
 	for (std::map<int, sInstancedTile>::iterator it = mapInstancedTiles.begin(); it != mapInstancedTiles.end(); it++)
 	{
-		Manager::animation.RemoveAnimation(it->second.instancedModel.get()->animation);
-		Manager::render.RemoveModel(it->second.instancedModel);
+		if (it->second.instancedModel->isInstanced) it->second.instancedModel->Update(deltaTime);
 	}
-	mapInstancedTiles.clear();
 
 	for (std::map<int, sInstancedTile>::iterator it = arenaInstancedTiles.begin(); it != arenaInstancedTiles.end(); it++)
 	{
-		Manager::animation.RemoveAnimation(it->second.instancedModel.get()->animation);
-		Manager::render.RemoveModel(it->second.instancedModel);
+		if (it->second.instancedModel->isInstanced) it->second.instancedModel->Update(deltaTime);
 	}
-	arenaInstancedTiles.clear();
+}
 
-	quads.clear();
-	walkableTiles.clear();
-	triggers.clear();
+void cMapManager::UpdateStreaming()
+{
+	// Quadrant models can only be created and removed while the map's models are the ones drawn,
+	// and the player isn't at the new map's entrance until its first quadrants are built
+	if (!streamSource || IsLoadingMap() || Engine::currGameMode != eGameMode::MAP) return;
+
+	ZoneScopedN("UpdateStreaming");
+
+	glm::ivec2 centerQuad = GetQuadCoords(Player::GetPlayerPosition());
+	int centerQuadX = centerQuad.x;
+	int centerQuadZ = centerQuad.y;
+
+	// Prefetch the ring around the player
+	for (int quadX = centerQuadX - streamingRadius; quadX <= centerQuadX + streamingRadius; quadX++)
+	{
+		for (int quadZ = centerQuadZ - streamingRadius; quadZ <= centerQuadZ + streamingRadius; quadZ++)
+		{
+			int sourceIndex = streamSource->gridIndex.Find(quadX, quadZ);
+			if (sourceIndex == -1 || streamPending[sourceIndex] || quadGrid.Find(quadX, quadZ) != -1) continue;
+
+			RequestQuadrant(sourceIndex);
+		}
+	}
+
+	EvictFarQuadrants(centerQuadX, centerQuadZ);
+
+	UploadPendingQuadrants(streamingUploadBudgetMs);
 }
 
 //void cMapManager::ChangeScene(const std::string newSceneDescFile)
@@ -703,7 +1409,7 @@ void cMapManager::UnloadMap()
 //	LoadMap(newSceneDescFile);
 //}
 
-sTile* cMapManager::GetTile(glm::ivec3 worldPosition)
+sTile cMapManager::GetTile(glm::ivec3 worldPosition)
 {
 	if (sQuadrant* quad = GetQuad(worldPosition.x, worldPosition.z))
 	{
@@ -715,10 +1421,10 @@ sTile* cMapManager::GetTile(glm::ivec3 worldPosition)
 		return quad->GetTileFromLocalPosition(localPosition);
 	}
 
-	return nullptr;
+	return sTile();
 }
 
-sTile* cMapManager::GetRandomSpawnTile(glm::vec3& globalPositionOut)
+sTile cMapManager::GetRandomSpawnTile(glm::vec3& globalPositionOut)
 {
 	// Semi random: make sure to pick a tile close to player
 	glm::vec3 playerPos = Player::GetPlayerPosition();
@@ -738,13 +1444,13 @@ sTile* cMapManager::GetRandomSpawnTile(glm::vec3& globalPositionOut)
 
 		findQuadAttempts++;
 		if (findQuadAttempts >= 5) 
-			return nullptr;
+			return sTile();
 	}
 
 	glm::vec3 tilePos;
-	sTile* spawnTile = spawnQuad->GetRandomSpawnTile(tilePos);
+	sTile spawnTile = spawnQuad->GetRandomSpawnTile(tilePos);
 
-	if (spawnTile)
+	if (spawnTile.IsValid())
 		spawnQuad->wildPokemonCount++;
 
 	globalPositionOut = tilePos;
@@ -753,11 +1459,26 @@ sTile* cMapManager::GetRandomSpawnTile(glm::vec3& globalPositionOut)
 
 void cMapManager::RemoveEntityFromTile(glm::ivec3 worldPosition)
 {
-	sTile* tile = GetTile(worldPosition);
+	sTile tile = GetTile(worldPosition);
+	if (tile.IsValid())
+	{
+		tile.SetEntity(nullptr);
+		return;
+	}
 
-	if (!tile) return;
+	// Its quadrant is evicted, it mustn't be placed again when that comes back
+	glm::ivec2 quadCoords = GetQuadCoords(worldPosition);
+	glm::ivec3 localPos = worldPosition;
+	localPos.x += 15 - 32 * quadCoords.x;
+	localPos.z += 15 - 32 * quadCoords.y;
+	for (unsigned int i = 0; i < evictedTileEntities.size(); i++)
+	{
+		if (evictedTileEntities[i].quadX != quadCoords.x || evictedTileEntities[i].quadZ != quadCoords.y || evictedTileEntities[i].localPos != localPos) continue;
 
-	tile->entity = nullptr;
+		evictedTileEntities[i] = evictedTileEntities.back();
+		evictedTileEntities.pop_back();
+		return;
+	}
 }
 
 eEntityMoveResult cMapManager::TryMoveEntity(cEntity* entityToMove, eDirection direction)
@@ -782,16 +1503,16 @@ eEntityMoveResult cMapManager::TryMoveEntity(cEntity* entityToMove, eDirection d
 	desiredPosZ += 15 - 32 * desiredQuad->posZ;
 
 	eEntityMoveResult moveResult = eEntityMoveResult::FAILURE;
-	if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY, desiredPosZ))->IsAvailable()) // same height
+	if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY, desiredPosZ)).IsAvailable()) // same height
 	{
 		moveResult = eEntityMoveResult::SUCCESS;
 	}
-	else if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY + 1, desiredPosZ))->IsAvailable()) // go up
+	else if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY + 1, desiredPosZ)).IsAvailable()) // go up
 	{
 		moveResult = eEntityMoveResult::SUCCESS_UP;
 		desiredPosY++;
 	}
-	else if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY - 1, desiredPosZ))->IsAvailable()) // go down
+	else if (desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY - 1, desiredPosZ)).IsAvailable()) // go down
 	{
 		moveResult = eEntityMoveResult::SUCCESS_DOWN;
 		desiredPosY--;
@@ -805,30 +1526,28 @@ eEntityMoveResult cMapManager::TryMoveEntity(cEntity* entityToMove, eDirection d
 		{
 			int currLocalX = (int)entityToMove->position.x + 15 - 32 * currQuad->posX;
 			int currLocalZ = (int)entityToMove->position.z + 15 - 32 * currQuad->posZ;
-			if (sTile* currTile = currQuad->GetTileFromLocalPosition(glm::vec3(currLocalX, entityToMove->position.y, currLocalZ)))
+			sTile currTile = currQuad->GetTileFromLocalPosition(glm::vec3(currLocalX, entityToMove->position.y, currLocalZ));
+			if (currTile.GetEntity() == entityToMove)
 			{
-				if (currTile->entity == entityToMove)
-				{
-					currTile->entity = nullptr;
-				}
+				currTile.SetEntity(nullptr);
 			}
 		}
 
-		sTile* tileToWalk = desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY, desiredPosZ));
-		if (tileToWalk->entity)
+		sTile tileToWalk = desiredQuad->GetTileFromLocalPosition(glm::vec3(desiredPosX, desiredPosY, desiredPosZ));
+		if (cEntity* tileEntity = tileToWalk.GetEntity())
 		{
 			if (dynamic_cast<cPlayerEntity*>(entityToMove) == Player::playerChar) // Player walk into it
 			{
-				tileToWalk->entity->WalkInteract();
+				tileEntity->WalkInteract();
 			}
-			else if (dynamic_cast<cPlayerEntity*>(tileToWalk->entity) == Player::playerChar) // It walk into player
+			else if (dynamic_cast<cPlayerEntity*>(tileEntity) == Player::playerChar) // It walk into player
 			{
 				entityToMove->WalkInteract();
 			}
 		}
 		else
 		{
-			tileToWalk->entity = entityToMove;
+			tileToWalk.SetEntity(entityToMove);
 		}
 	}
 
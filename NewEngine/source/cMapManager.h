@@ -1,12 +1,16 @@
 #pragma once
 
 #include <set>
+#include <deque>
 #include <map>
+#include <bitset>
 #include <string>
 #include <memory>
 #include "cAnimatedModel.h"
 #include "cEntity.h"
 #include "CharacterSprite.h"
+#include "cMapFile.h"
+#include "cMeshCooker.h"
 
 struct sInstancedTile
 {
@@ -21,21 +25,34 @@ struct sCorrectionTiles
 	std::vector<glm::ivec3> unwalkableOffsets;
 };
 
+struct sQuadrant;
+
+// Handle to one tile of a quadrant. The tile's data lives in the quadrant, an invalid handle reads as an empty tile
 struct sTile
 {
-	cEntity* entity = nullptr;
-	bool isWalkable = false;
-	bool isUnchangeable = false;
+	sQuadrant* quad = nullptr;
+	int tileId = -1;
+
+	bool IsValid() const { return quad != nullptr; }
+
+	bool IsWalkable() const;
+	void SetWalkable(bool isWalkable);
+	bool IsUnchangeable() const;
+	void SetUnchangeable(bool isUnchangeable);
+	cEntity* GetEntity() const;
+	void SetEntity(cEntity* entity);
 
 	// For walking or spawning
-	bool IsAvailable()
-	{
-		if (!isWalkable) return false;
+	bool IsAvailable() const;
+};
 
-		if (entity && entity->blocksTile) return false;
+// 32x32 tiles per height, heights -15 to 15
+const int QUADRANT_TILES_NUM = 32 * 32 * 31;
 
-		return true;
-	}
+struct sTileEntity
+{
+	int tileId;
+	cEntity* entity;
 };
 
 struct sQuadrant
@@ -43,19 +60,55 @@ struct sQuadrant
 	int posX;
 	int posZ;
 
-	std::map<int, sTile> data;
+	std::bitset<QUADRANT_TILES_NUM> walkableTiles;
+	std::bitset<QUADRANT_TILES_NUM> unchangeableTiles;
+	std::vector<sTileEntity> tileEntities; // only a handful per quadrant, searched linearly
+	std::map<int, std::vector<glm::vec4>> tileInstanceOffsets; // instanced tile id to the offsets in this quadrant
+
+	bool isUploaded = false; // its tile instances and mesh are on the GPU
+
+	// Its piece of the map mesh, built with the quadrant and moved into the mesh arenas when it's uploaded
+	std::vector<sMeshGeometry> meshGeometry;
+	unsigned int meshBytes = 0;
+	std::shared_ptr<cRenderModel> meshModel;
 
 	int wildPokemonCount = 0;
 	std::vector<int> localSpawnTiles;
-	sTile* GetRandomSpawnTile(glm::vec3& globalPos);
+	sTile GetRandomSpawnTile(glm::vec3& globalPos);
 	
 	static int GetTileIdFromPosition(glm::ivec3 localPos);
-	sTile* GetTileFromLocalPosition(glm::ivec3 localPos);
+	static glm::ivec3 GetLocalPositionFromTileId(int tileId);
+	sTile GetTileFromLocalPosition(glm::ivec3 localPos);
+
+	cEntity* GetTileEntity(int tileId) const;
+	void SetTileEntity(int tileId, cEntity* entity);
 
 	glm::vec3 LocalPositionToGlobalPosition(glm::ivec3 localPos);
 	glm::vec3 TileIdToGlobalPosition(int tileId);
 };
 
+// Flat grid over a bounding box of quadrants, quadrant coords to an index in a quadrants vector
+class cQuadrantGrid
+{
+public:
+	cQuadrantGrid();
+	~cQuadrantGrid();
+
+private:
+	int minX;
+	int minZ;
+	int width;
+	int depth;
+	std::vector<int> cells; // -1 where there's no quadrant
+public:
+	void Build(const std::vector<sQuadrant>& quads);
+	void Reset(int _minX, int _minZ, int maxX, int maxZ); // empty grid over these bounds, filled with Set
+	void Set(int quadX, int quadZ, int index);
+	void Clear();
+	int Find(int quadX, int quadZ) const;
+	int GetCell(int quadX, int quadZ) const; // stable for the grid's lifetime, -1 outside it
+};
+
 enum eEntityMoveResult
 {
 	FAILURE,
@@ -83,6 +136,75 @@ public:
 	virtual void WalkInteract();
 };
 
+// Everything a quadrant is built from. Shared with the streaming jobs so it outlives an unloaded map
+struct sMapStreamSource
+{
+	cMappedFile compiledMap;
+	std::vector<sMapGridQuadrant> parsedQuads;
+	sMapGridView grid;
+	cQuadrantGrid gridIndex; // quadrant coords to index in grid
+
+	std::map<int, sCorrectionTiles> walkableTiles;
+	std::vector<int> spawnTileIds;
+	std::map<int, glm::vec3> instancedTileOffsets; // instanced tile id to its model offset
+
+	// The map mesh, cut into one piece per quadrant as they're built
+	cMappedFile mapMeshFile;
+	sCookedModel importedMapMesh;
+	sCookedModelView mapMesh;
+	glm::vec3 mapMeshPosition;
+	std::vector<unsigned int> quadTrianglesFirst; // by index in grid into quadTriangles, one more at the end. Empty when the mesh isn't split
+	std::vector<glm::uvec2> quadTriangles; // mesh index and first index of each triangle
+};
+
+// Entity placed on a tile by the map description, placed again every time its quadrant is loaded
+struct sMapTileEntity
+{
+	int quadX;
+	int quadZ;
+	glm::ivec3 localPos;
+	cEntity* entity;
+};
+
+struct sStreamingStats
+{
+	unsigned int residentQuadsNum = 0;
+	unsigned int pendingQuadsNum = 0;
+	unsigned int loadedQuadsNum = 0;
+	unsigned int evictedQuadsNum = 0;
+	unsigned int queuedUploadsNum = 0;
+	unsigned int residentBytes = 0;
+	float lastUploadMs = 0.f;
+};
+
+enum eMapLoadStage
+{
+	MAP_LOAD_NONE,
+	MAP_LOAD_SPLIT_MESH,	// streamed maps only, cut the map mesh between the quadrants
+	MAP_LOAD_QUADRANTS,		// build the first quadrants, one per step
+	MAP_LOAD_UPLOADS,		// their tile instances and meshes
+	MAP_LOAD_BATCHES,		// lay the tile batches out around them
+	MAP_LOAD_ARENA
+};
+
+// What BeginLoadingMap read from the description that the later stages still need
+struct sMapLoad
+{
+	eMapLoadStage stage = MAP_LOAD_NONE;
+	std::shared_ptr<sMapStreamSource> source;
+	std::string mapModelFile;
+	std::string arenaDescFile;
+	std::vector<unsigned int> quadsToBuild; // by index in the source grid
+	unsigned int builtQuadsNum = 0;
+
+	bool hasEntrance = false;
+	int entranceQuadX = 0;
+	int entranceQuadZ = 0;
+	glm::ivec3 entranceLocalPos = glm::ivec3(0);
+	glm::ivec3 playerSpawnOffset = glm::ivec3(0);
+	int entranceTileType = 0;
+};
+
 class cMapManager
 {
 public:
@@ -94,21 +216,71 @@ public:
 
 private:
 	std::vector<sQuadrant> quads;
-	std::map<int, sCorrectionTiles> walkableTiles;
+	cQuadrantGrid quadGrid;
 	std::shared_ptr<cRenderModel> mapModel;
 	std::shared_ptr<cRenderModel> arenaModel;
 	std::map<int, sInstancedTile> mapInstancedTiles;
 	std::map<int, sInstancedTile> arenaInstancedTiles;
 	sQuadrant* GetQuad(int worldX, int worldZ);
+	sQuadrant* GetQuadFromCoords(int quadX, int quadZ);
 	void LoadArena(const std::string arenaDescriptionFile);
+
+	// Every asset reference LoadMap and LoadArena took, given back by UnloadMap
+	std::vector<std::string> loadedModelFiles;
+	std::vector<std::string> loadedTextures;
+	std::vector<std::string> loadedSpriteSheets;
+	void LoadMapModel(const std::string& fileName, const std::string& programName);
+
+	static void BuildQuadrant(const sMapStreamSource& source, const sMapGridQuadrant& gridQuad, sQuadrant& newQuad);
+	// Sorts the map mesh's triangles by quadrant, the ones outside every quadrant are kept together for the map model
+	static void SplitMapMesh(sMapStreamSource& source, std::vector<sMeshGeometry>& restGeometryOut);
+	static void BuildQuadrantMesh(const sMapStreamSource& source, unsigned int sourceIndex, std::vector<sMeshGeometry>& geometryOut);
+	std::string GetQuadrantMeshName(const sQuadrant& quad);
+	void AddQuadrant(sQuadrant& newQuad);
+	void RemoveQuadrant(unsigned int quadIndex);
+	void UploadQuadrant(sQuadrant& quad);
+	static unsigned int GetQuadrantBytes(const sQuadrant& quad);
+
+	// Streaming
+	std::shared_ptr<sMapStreamSource> streamSource;
+	std::vector<bool> streamPending; // by index in the source grid
+	unsigned int streamGeneration = 0; // bumped on every load and unload so late jobs from an old map are dropped
+	std::deque<glm::ivec2> pendingQuadUploads; // added quadrants whose tile instances and mesh still have to reach the GPU
+	std::string splitMeshName; // the map model file when its mesh is split, quadrant pieces are named after it
+	std::vector<sMapTileEntity> evictedTileEntities; // runtime entities left on evicted quadrants, placed again when they're loaded
+	sStreamingStats streamingStats;
+	void UploadPendingQuadrants(float budgetMs);
+	void RequestQuadrant(unsigned int sourceIndex);
+	void EvictFarQuadrants(int centerQuadX, int centerQuadZ);
+
+	sMapLoad mapLoad;
+	void PlacePlayerAtEntrance();
 public:
+	bool useCompiledMaps = true; // load from and write .cmap files next to the .pdsmap ones
+	bool useQuadrantStreaming = false; // only keep the quadrants around the player loaded, applied on the next map load
+	int streamingRadius = 1; // in quadrants around the player's, always kept loaded
+	unsigned int streamingMemoryCapKb = 512; // quadrants outside the radius are evicted past this
+	float streamingUploadBudgetMs = 1.f; // main thread time per frame for uploading streamed quadrants
 	void LoadMap(const std::string mapDescriptionFile, const int entranceNumUsed);
+	// LoadMap spread over frames: Begin reads the descriptions, Continue does what fits in the budget and returns true once the map is loaded
+	void BeginLoadingMap(const std::string mapDescriptionFile, const int entranceNumUsed);
+	bool ContinueLoadingMap(float budgetMs);
+	bool IsLoadingMap() { return mapLoad.stage != MAP_LOAD_NONE; }
 	void UnloadMap();
+	// Reads a map's descriptions and compiles its collision maps without touching any loaded state, safe on a worker thread
+	// A streamed map's mesh is only cooked, LoadMap splits it between the quadrants instead of uploading it whole
+	static void PrepareMap(const std::string mapDescriptionFile, bool compileMaps, bool isStreamed, std::vector<std::string>& modelFilesOut);
+	void UpdateStreaming();
+	void UpdateTileModels(float deltaTime); // advances the animated tiles' own timers, once a frame
+	const sStreamingStats& GetStreamingStats() { return streamingStats; }
+	bool IsStreaming() { return streamSource != nullptr; }
 	//void ChangeScene(const std::string newSceneDescFile);
 
 public:
-	sTile* GetTile(glm::ivec3 worldPosition);
-	sTile* GetRandomSpawnTile(glm::vec3& globalPositionOut);
+	sTile GetTile(glm::ivec3 worldPosition);
+	sTile GetRandomSpawnTile(glm::vec3& globalPositionOut);
+	const std::vector<sQuadrant>& GetQuads() { return quads; }
+	static glm::ivec2 GetQuadCoords(glm::vec3 worldPosition);
 	void RemoveEntityFromTile(glm::ivec3 worldPosition);
 
 	eEntityMoveResult TryMoveEntity(cEntity* entityToMove, eDirection direction);
@@ -119,4 +291,5 @@ public:
 private:
 	std::map<eTransitionTileTypes, std::vector<glm::ivec3>> transitionTiles;
 	std::vector<cTransitionTrigger> triggers;
+	std::vector<sMapTileEntity> mapTileEntities;
 };
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "cMappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+cMappedFile::cMappedFile()
+{
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#endif
+}
+
+cMappedFile::~cMappedFile()
+{
+	Close();
+}
+
+bool cMappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat fileInfo;
+	if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference
+	if (mapped == MAP_FAILED) return false;
+
+	data = (const unsigned char*)mapped;
+	size = (size_t)fileInfo.st_size;
+#endif
+
+	return true;
+}
+
+void cMappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mappingHandle != NULL) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != nullptr) munmap((void*)data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+bool cMappedFile::GetFileStamp(const std::string& path, uint64_t& writeTimeOut, uint64_t& sizeOut)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &fileInfo)) return false;
+
+	writeTimeOut = ((uint64_t)fileInfo.ftLastWriteTime.dwHighDateTime << 32) | fileInfo.ftLastWriteTime.dwLowDateTime;
+	sizeOut = ((uint64_t)fileInfo.nFileSizeHigh << 32) | fileInfo.nFileSizeLow;
+#else
+	struct stat fileInfo;
+	if (stat(path.c_str(), &fileInfo) != 0) return false;
+
+	writeTimeOut = (uint64_t)fileInfo.st_mtime;
+	sizeOut = (uint64_t)fileInfo.st_size;
+#endif
+
+	return true;
+}
+
+void cMappedFile::ListFiles(const std::string& directory, const std::string& extension, std::vector<std::string>& filesOut)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA((directory + "*" + extension).c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) return;
+
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			filesOut.push_back(findData.cFileName);
+	} while (FindNextFileA(findHandle, &findData));
+
+	FindClose(findHandle);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr) return;
+
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != nullptr)
+	{
+		std::string name = entry->d_name;
+		if (name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+			filesOut.push_back(name);
+	}
+
+	closedir(dir);
+#endif
+}
+
+void cMappedFile::ListFilesRecursive(const std::string& directory, const std::string& extension, std::vector<std::string>& pathsOut)
+{
+	std::vector<std::string> files;
+	ListFiles(directory, extension, files);
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		pathsOut.push_back(directory + files[i]);
+	}
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA((directory + "*").c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) return;
+
+	do
+	{
+		std::string name = findData.cFileName;
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && name != "." && name != "..")
+			ListFilesRecursive(directory + name + "/", extension, pathsOut);
+	} while (FindNextFileA(findHandle, &findData));
+
+	FindClose(findHandle);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr) return;
+
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != nullptr)
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..") continue;
+
+		struct stat fileStat;
+		if (stat((directory + name).c_str(), &fileStat) == 0 && S_ISDIR(fileStat.st_mode))
+			ListFilesRecursive(directory + name + "/", extension, pathsOut);
+	}
+
+	closedir(dir);
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file mapped into memory
+class cMappedFile
+{
+public:
+	cMappedFile();
+	~cMappedFile();
+
+private:
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+	cMappedFile(const cMappedFile&) = delete;
+	cMappedFile& operator=(const cMappedFile&) = delete;
+public:
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const unsigned char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+	// Last write time and size, used to tell if a file derived from this one is stale
+	static bool GetFileStamp(const std::string& path, uint64_t& writeTimeOut, uint64_t& sizeOut);
+	// File names (not paths) in a directory ending with extension
+	static void ListFiles(const std::string& directory, const std::string& extension, std::vector<std::string>& filesOut);
+	// Paths (directory included) of every file under a directory and its subdirectories ending with extension
+	static void ListFilesRecursive(const std::string& directory, const std::string& extension, std::vector<std::string>& pathsOut);
+};
@@ -0,0 +1,397 @@
+#include "cMeshArena.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+// How far off a packed UV can land, in texels
+const float MAX_UV_TEXEL_ERROR = 0.25f;
+
+cArenaAllocator::cArenaAllocator()
+{
+	capacity = 0;
+	used = 0;
+}
+
+cArenaAllocator::~cArenaAllocator()
+{
+}
+
+void cArenaAllocator::Reset(unsigned int newCapacity)
+{
+	capacity = newCapacity;
+	used = 0;
+
+	freeRanges.clear();
+	if (capacity > 0)
+	{
+		sArenaRange wholeRange;
+		wholeRange.offset = 0;
+		wholeRange.size = capacity;
+		freeRanges.push_back(wholeRange);
+	}
+}
+
+bool cArenaAllocator::Allocate(unsigned int size, unsigned int& offsetOut)
+{
+	if (size == 0)
+	{
+		offsetOut = 0;
+		return true;
+	}
+
+	for (unsigned int i = 0; i < freeRanges.size(); i++)
+	{
+		if (freeRanges[i].size < size) continue;
+
+		offsetOut = freeRanges[i].offset;
+
+		freeRanges[i].offset += size;
+		freeRanges[i].size -= size;
+		if (freeRanges[i].size == 0)
+			freeRanges.erase(freeRanges.begin() + i);
+
+		used += size;
+		return true;
+	}
+
+	return false; // needs to grow
+}
+
+void cArenaAllocator::Free(unsigned int offset, unsigned int size)
+{
+	if (size == 0) return;
+
+	used -= size;
+
+	// Find where it goes to keep the list sorted
+	unsigned int insertAt = 0;
+	while (insertAt < freeRanges.size() && freeRanges[insertAt].offset < offset)
+	{
+		insertAt++;
+	}
+
+	sArenaRange newRange;
+	newRange.offset = offset;
+	newRange.size = size;
+	freeRanges.insert(freeRanges.begin() + insertAt, newRange);
+
+	// Merge with next
+	if (insertAt + 1 < freeRanges.size() && freeRanges[insertAt].offset + freeRanges[insertAt].size == freeRanges[insertAt + 1].offset)
+	{
+		freeRanges[insertAt].size += freeRanges[insertAt + 1].size;
+		freeRanges.erase(freeRanges.begin() + insertAt + 1);
+	}
+
+	// Merge with previous
+	if (insertAt > 0 && freeRanges[insertAt - 1].offset + freeRanges[insertAt - 1].size == freeRanges[insertAt].offset)
+	{
+		freeRanges[insertAt - 1].size += freeRanges[insertAt].size;
+		freeRanges.erase(freeRanges.begin() + insertAt);
+	}
+}
+
+void cArenaAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity) return;
+
+	unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+
+	// The new space is a free range at the end, Free does the merging
+	used += newCapacity - oldCapacity;
+	Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+unsigned int cArenaAllocator::GetLargestFreeRange() const
+{
+	unsigned int largest = 0;
+	for (unsigned int i = 0; i < freeRanges.size(); i++)
+	{
+		if (freeRanges[i].size > largest)
+			largest = freeRanges[i].size;
+	}
+
+	return largest;
+}
+
+float cArenaAllocator::GetFragmentation() const
+{
+	unsigned int freeSpace = capacity - used;
+	if (freeSpace == 0) return 0.f;
+
+	return 1.f - (float)GetLargestFreeRange() / freeSpace;
+}
+
+cMeshArena::cMeshArena()
+{
+	layout = VERTEX_LAYOUT_FLOAT;
+	stride = sizeof(sVertexData);
+	VAO_ID = 0;
+	VBO_ID = 0;
+	INDEX_ID = 0;
+}
+
+cMeshArena::~cMeshArena()
+{
+}
+
+void cMeshArena::Startup(eVertexLayout newLayout, unsigned int initialVerticesNum, unsigned int initialIndicesNum)
+{
+	layout = newLayout;
+	stride = GetVertexStride(layout);
+
+	glGenVertexArrays(1, &VAO_ID);
+
+	glGenBuffers(1, &VBO_ID);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO_ID);
+	glBufferData(GL_ARRAY_BUFFER, stride * initialVerticesNum, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &INDEX_ID);
+
+	glBindVertexArray(VAO_ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, INDEX_ID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * initialIndicesNum, NULL, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	SetupVertexBuffer();
+
+	vertexAllocator.Reset(initialVerticesNum);
+	indexAllocator.Reset(initialIndicesNum);
+}
+
+void cMeshArena::Shutdown()
+{
+	glDeleteVertexArrays(1, &VAO_ID);
+	glDeleteBuffers(1, &VBO_ID);
+	glDeleteBuffers(1, &INDEX_ID);
+
+	vertexAllocator.Reset(0);
+	indexAllocator.Reset(0);
+
+	packedVertices.clear();
+	packedVertices.shrink_to_fit();
+}
+
+unsigned int cMeshArena::GetVertexStride(eVertexLayout layout)
+{
+	if (layout == VERTEX_LAYOUT_FLOAT) return sizeof(sVertexData);
+
+	return sizeof(sPackedVertexData);
+}
+
+eVertexLayout cMeshArena::ChooseVertexLayout(const sVertexData* vertices, unsigned int verticesNum, unsigned int textureSize)
+{
+	// Half floats lose precision the further UVs get from 0, which tiled map textures do a lot
+	const float maxError = MAX_UV_TEXEL_ERROR / textureSize;
+
+	eVertexLayout chosen = VERTEX_LAYOUT_PACKED_UNORM;
+	for (unsigned int i = 0; i < verticesNum; i++)
+	{
+		float u = vertices[i].u1;
+		float v = vertices[i].v1;
+
+		if (u >= 0.f && u <= 1.f && v >= 0.f && v <= 1.f) continue; // unorm16 is always precise enough
+
+		chosen = VERTEX_LAYOUT_PACKED_HALF;
+
+		float errorU = std::fabs(glm::unpackHalf1x16(glm::packHalf1x16(u)) - u);
+		float errorV = std::fabs(glm::unpackHalf1x16(glm::packHalf1x16(v)) - v);
+		if (errorU > maxError || errorV > maxError)
+			return VERTEX_LAYOUT_FLOAT;
+	}
+
+	return chosen;
+}
+
+void cMeshArena::PackVertices(eVertexLayout layout, const sVertexData* vertices, unsigned int verticesNum, unsigned char* packedOut)
+{
+	if (layout == VERTEX_LAYOUT_FLOAT)
+	{
+		memcpy(packedOut, vertices, sizeof(sVertexData) * verticesNum);
+		return;
+	}
+
+	sPackedVertexData* packed = (sPackedVertexData*)packedOut;
+	for (unsigned int i = 0; i < verticesNum; i++)
+	{
+		const sVertexData& vertex = vertices[i];
+
+		packed[i].x = vertex.x;
+		packed[i].y = vertex.y;
+		packed[i].z = vertex.z;
+
+		glm::vec3 normal(vertex.nx, vertex.ny, vertex.nz);
+		float length = glm::length(normal);
+		if (length > 0.f) normal /= length;
+		packed[i].normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 1.f));
+
+		if (layout == VERTEX_LAYOUT_PACKED_UNORM)
+		{
+			packed[i].u = glm::packUnorm1x16(vertex.u1);
+			packed[i].v = glm::packUnorm1x16(vertex.v1);
+		}
+		else
+		{
+			packed[i].u = glm::packHalf1x16(vertex.u1);
+			packed[i].v = glm::packHalf1x16(vertex.v1);
+		}
+	}
+}
+
+void cMeshArena::SetupVertexAttributes(eVertexLayout layout)
+{
+	if (layout == VERTEX_LAYOUT_FLOAT)
+	{
+		// Position
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4,
+			GL_FLOAT, GL_FALSE,
+			sizeof(sVertexData),
+			(void*)offsetof(sVertexData, x));
+
+		// Normal
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4,
+			GL_FLOAT, GL_FALSE,
+			sizeof(sVertexData),
+			(void*)offsetof(sVertexData, nx));
+
+		// UVs
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4,
+			GL_FLOAT, GL_FALSE,
+			sizeof(sVertexData),
+			(void*)offsetof(sVertexData, u1));
+
+		return;
+	}
+
+	// Position, w defaults to 1
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3,
+		GL_FLOAT, GL_FALSE,
+		sizeof(sPackedVertexData),
+		(void*)offsetof(sPackedVertexData, x));
+
+	// Normal
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4,
+		GL_INT_2_10_10_10_REV, GL_TRUE,
+		sizeof(sPackedVertexData),
+		(void*)offsetof(sPackedVertexData, normal));
+
+	// UVs
+	glEnableVertexAttribArray(2);
+	if (layout == VERTEX_LAYOUT_PACKED_UNORM)
+	{
+		glVertexAttribPointer(2, 2,
+			GL_UNSIGNED_SHORT, GL_TRUE,
+			sizeof(sPackedVertexData),
+			(void*)offsetof(sPackedVertexData, u));
+	}
+	else
+	{
+		glVertexAttribPointer(2, 2,
+			GL_HALF_FLOAT, GL_FALSE,
+			sizeof(sPackedVertexData),
+			(void*)offsetof(sPackedVertexData, u));
+	}
+}
+
+void cMeshArena::SetupVertexBuffer()
+{
+	glBindVertexArray(VAO_ID);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO_ID);
+
+	SetupVertexAttributes(layout);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cMeshArena::GrowVertexBuffer(unsigned int minVerticesNum)
+{
+	unsigned int oldCapacity = vertexAllocator.GetCapacity();
+	unsigned int newCapacity = oldCapacity * 2 > minVerticesNum ? oldCapacity * 2 : minVerticesNum;
+
+	unsigned int newVBO;
+	glGenBuffers(1, &newVBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, stride * newCapacity, NULL, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, VBO_ID);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, stride * oldCapacity);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &VBO_ID);
+	VBO_ID = newVBO;
+
+	SetupVertexBuffer(); // the VAO still points at the old buffer
+
+	vertexAllocator.Grow(newCapacity);
+}
+
+void cMeshArena::GrowIndexBuffer(unsigned int minIndicesNum)
+{
+	unsigned int oldCapacity = indexAllocator.GetCapacity();
+	unsigned int newCapacity = oldCapacity * 2 > minIndicesNum ? oldCapacity * 2 : minIndicesNum;
+
+	unsigned int newIBO;
+	glGenBuffers(1, &newIBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newIBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * newCapacity, NULL, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, INDEX_ID);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(unsigned int) * oldCapacity);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &INDEX_ID);
+	INDEX_ID = newIBO;
+
+	glBindVertexArray(VAO_ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, INDEX_ID);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	indexAllocator.Grow(newCapacity);
+}
+
+void cMeshArena::Allocate(const sVertexData* vertices, unsigned int verticesNum, const unsigned int* indices, unsigned int indicesNum, unsigned int& baseVertexOut, unsigned int& firstIndexOut)
+{
+	if (!vertexAllocator.Allocate(verticesNum, baseVertexOut))
+	{
+		GrowVertexBuffer(vertexAllocator.GetCapacity() + verticesNum);
+		vertexAllocator.Allocate(verticesNum, baseVertexOut);
+	}
+
+	if (!indexAllocator.Allocate(indicesNum, firstIndexOut))
+	{
+		GrowIndexBuffer(indexAllocator.GetCapacity() + indicesNum);
+		indexAllocator.Allocate(indicesNum, firstIndexOut);
+	}
+
+	packedVertices.resize(stride * verticesNum);
+	if (verticesNum > 0) PackVertices(layout, vertices, verticesNum, &packedVertices[0]);
+
+	// Indices stay relative to the mesh, draws add baseVertex
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO_ID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, stride * baseVertexOut, stride * verticesNum, packedVertices.data());
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, INDEX_ID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * firstIndexOut, sizeof(unsigned int) * indicesNum, indices);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void cMeshArena::Free(unsigned int baseVertex, unsigned int verticesNum, unsigned int firstIndex, unsigned int indicesNum)
+{
+	vertexAllocator.Free(baseVertex, verticesNum);
+	indexAllocator.Free(firstIndex, indicesNum);
+}
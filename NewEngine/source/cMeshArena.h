@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include "DrawInfo.h"
+
+// Range of elements inside one arena buffer
+struct sArenaRange
+{
+	unsigned int offset;
+	unsigned int size;
+};
+
+// First fit sub-allocator over a buffer of fixed size elements. Free ranges are kept sorted and merged
+class cArenaAllocator
+{
+public:
+	cArenaAllocator();
+	~cArenaAllocator();
+
+private:
+	unsigned int capacity;
+	unsigned int used;
+	std::vector<sArenaRange> freeRanges; // sorted by offset
+public:
+	void Reset(unsigned int newCapacity);
+	bool Allocate(unsigned int size, unsigned int& offsetOut);
+	void Free(unsigned int offset, unsigned int size);
+	void Grow(unsigned int newCapacity);
+
+	unsigned int GetCapacity() const { return capacity; }
+	unsigned int GetUsed() const { return used; }
+	unsigned int GetFreeRangesNum() const { return (unsigned int)freeRanges.size(); }
+	unsigned int GetLargestFreeRange() const;
+	float GetFragmentation() const; // 0 when all free space is one range, close to 1 when it's scattered
+};
+
+// One VAO/VBO/IBO shared by every static mesh of the same vertex layout. Meshes are drawn with a base vertex and a first index
+class cMeshArena
+{
+public:
+	cMeshArena();
+	~cMeshArena();
+
+	void Startup(eVertexLayout newLayout, unsigned int initialVerticesNum, unsigned int initialIndicesNum);
+	void Shutdown();
+
+	static unsigned int GetVertexStride(eVertexLayout layout);
+	static eVertexLayout ChooseVertexLayout(const sVertexData* vertices, unsigned int verticesNum, unsigned int textureSize);
+	static void PackVertices(eVertexLayout layout, const sVertexData* vertices, unsigned int verticesNum, unsigned char* packedOut);
+	static void SetupVertexAttributes(eVertexLayout layout); // for the bound VAO and GL_ARRAY_BUFFER
+
+private:
+	eVertexLayout layout;
+	unsigned int stride;
+	std::vector<unsigned char> packedVertices; // scratch for packing
+	unsigned int VAO_ID;
+	unsigned int VBO_ID;
+	unsigned int INDEX_ID;
+	cArenaAllocator vertexAllocator;
+	cArenaAllocator indexAllocator;
+	void GrowVertexBuffer(unsigned int minVerticesNum);
+	void GrowIndexBuffer(unsigned int minIndicesNum);
+	void SetupVertexBuffer();
+public:
+	void Allocate(const sVertexData* vertices, unsigned int verticesNum, const unsigned int* indices, unsigned int indicesNum, unsigned int& baseVertexOut, unsigned int& firstIndexOut);
+	void Free(unsigned int baseVertex, unsigned int verticesNum, unsigned int firstIndex, unsigned int indicesNum);
+
+	eVertexLayout GetLayout() const { return layout; }
+	unsigned int GetStride() const { return stride; }
+	unsigned int GetVAO() const { return VAO_ID; }
+	const cArenaAllocator& GetVertexAllocator() const { return vertexAllocator; }
+	const cArenaAllocator& GetIndexAllocator() const { return indexAllocator; }
+};
@@ -0,0 +1,215 @@
+#include "cMeshCooker.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <cstdio>
+#include <cstring>
+
+// Bump when the layout of the file or of sVertexData changes
+const uint32_t COOKED_MESH_VERSION = 1;
+const char COOKED_MESH_MAGIC[4] = { 'M', 'G', 'K', 'M' };
+
+struct sCookedMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t meshesNum;
+	uint64_t sourceWriteTime;
+	uint64_t sourceSize;
+	uint32_t verticesNum;
+	uint32_t indicesNum;
+};
+// Followed by meshesNum sCookedMeshRange, verticesNum sVertexData and indicesNum unsigned int
+
+std::string MeshCooker::GetCookedPath(const std::string& sourcePath)
+{
+	return sourcePath + ".cmesh";
+}
+
+bool MeshCooker::Import(const std::string& sourcePath, sCookedModel& modelOut)
+{
+	Assimp::Importer importer;
+
+	const aiScene* scene = importer.ReadFile(sourcePath,
+		aiProcess_Triangulate |
+		aiProcess_GenSmoothNormals |
+		aiProcess_PopulateArmatureData |
+		aiProcess_FixInfacingNormals |
+		aiProcess_LimitBoneWeights);
+
+	if (scene == nullptr)
+	{
+		printf("MeshCooker::Import: ERROR: Failed to load file %s\n", sourcePath.c_str());
+		printf(importer.GetErrorString());
+		return false;
+	}
+
+	if (!scene->HasMeshes())
+		return false;
+
+	modelOut.meshes.clear();
+	modelOut.vertices.clear();
+	modelOut.indices.clear();
+
+	for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) // per mesh
+	{
+		aiMesh* currMesh = scene->mMeshes[meshIndex];
+
+		sCookedMeshRange newRange;
+		memset(&newRange, 0, sizeof(newRange));
+		newRange.firstVertex = (uint32_t)modelOut.vertices.size();
+		newRange.verticesNum = currMesh->mNumVertices;
+		newRange.firstIndex = (uint32_t)modelOut.indices.size();
+
+		for (unsigned int vertexIndex = 0; vertexIndex < currMesh->mNumVertices; vertexIndex++) // per vertex
+		{
+			sVertexData newVertexInfo;
+
+			newVertexInfo.x = currMesh->mVertices[vertexIndex].x;
+			newVertexInfo.y = currMesh->mVertices[vertexIndex].y;
+			newVertexInfo.z = currMesh->mVertices[vertexIndex].z;
+			newVertexInfo.w = 1;
+
+			newVertexInfo.nx = currMesh->mNormals[vertexIndex].x;
+			newVertexInfo.ny = currMesh->mNormals[vertexIndex].y;
+			newVertexInfo.nz = currMesh->mNormals[vertexIndex].z;
+			newVertexInfo.nw = 1;
+
+			newVertexInfo.u1 = 0.f;
+			newVertexInfo.v1 = 0.f;
+			if (currMesh->mTextureCoords[0]) // if it has textures
+			{
+				newVertexInfo.u1 = currMesh->mTextureCoords[0][vertexIndex].x;
+				newVertexInfo.v1 = 1.f - currMesh->mTextureCoords[0][vertexIndex].y;
+			}
+			newVertexInfo.u2 = 0;
+			newVertexInfo.v2 = 0;
+
+			modelOut.vertices.push_back(newVertexInfo);
+		} // end of per vertex
+
+		for (unsigned int i = 0; i < currMesh->mNumFaces; i++)
+		{
+			aiFace currFace = currMesh->mFaces[i];
+			if (currFace.mNumIndices != 3) continue; // points and lines left over by Triangulate
+
+			modelOut.indices.push_back(currFace.mIndices[0]);
+			modelOut.indices.push_back(currFace.mIndices[1]);
+			modelOut.indices.push_back(currFace.mIndices[2]);
+		}
+		newRange.indicesNum = (uint32_t)modelOut.indices.size() - newRange.firstIndex;
+
+		if (currMesh->mMaterialIndex > 0) // get texture for this mesh
+		{
+			aiMaterial* material = scene->mMaterials[currMesh->mMaterialIndex];
+
+			aiString path;
+			material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+			if (path.length >= COOKED_TEXTURE_NAME_SIZE)
+			{
+				printf("MeshCooker::Import: ERROR: Texture name too long in %s\n", sourcePath.c_str());
+				return false;
+			}
+			memcpy(newRange.textureName, path.C_Str(), path.length);
+		}
+
+		modelOut.meshes.push_back(newRange);
+	} // end of per mesh
+
+	return true;
+}
+
+bool MeshCooker::Write(const std::string& sourcePath, const sCookedModel& model)
+{
+	return Write(sourcePath, GetCookedPath(sourcePath), model);
+}
+
+bool MeshCooker::Write(const std::string& sourcePath, const std::string& cookedPath, const sCookedModel& model)
+{
+	sCookedMeshHeader header;
+	memcpy(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic));
+	header.version = COOKED_MESH_VERSION;
+	header.vertexSize = sizeof(sVertexData);
+	header.meshesNum = (uint32_t)model.meshes.size();
+	header.verticesNum = (uint32_t)model.vertices.size();
+	header.indicesNum = (uint32_t)model.indices.size();
+	if (!cMappedFile::GetFileStamp(sourcePath, header.sourceWriteTime, header.sourceSize)) return false;
+
+	FILE* fp;
+	if (fopen_s(&fp, cookedPath.c_str(), "wb") != 0 || fp == nullptr) return false;
+
+	bool isWritten = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (isWritten && !model.meshes.empty()) isWritten = fwrite(&model.meshes[0], sizeof(sCookedMeshRange), model.meshes.size(), fp) == model.meshes.size();
+	if (isWritten && !model.vertices.empty()) isWritten = fwrite(&model.vertices[0], sizeof(sVertexData), model.vertices.size(), fp) == model.vertices.size();
+	if (isWritten && !model.indices.empty()) isWritten = fwrite(&model.indices[0], sizeof(unsigned int), model.indices.size(), fp) == model.indices.size();
+
+	fclose(fp);
+
+	// A half written file would fail the size check in Read anyway, but don't leave it around
+	if (!isWritten) remove(cookedPath.c_str());
+
+	return isWritten;
+}
+
+bool MeshCooker::Read(const std::string& sourcePath, cMappedFile& fileOut, sCookedModelView& viewOut)
+{
+	return Read(sourcePath, GetCookedPath(sourcePath), fileOut, viewOut);
+}
+
+bool MeshCooker::Read(const std::string& sourcePath, const std::string& cookedPath, cMappedFile& fileOut, sCookedModelView& viewOut)
+{
+	uint64_t sourceWriteTime, sourceSize;
+	if (!cMappedFile::GetFileStamp(sourcePath, sourceWriteTime, sourceSize)) return false;
+
+	if (!fileOut.Open(cookedPath)) return false;
+
+	if (fileOut.GetSize() < sizeof(sCookedMeshHeader))
+	{
+		fileOut.Close();
+		return false;
+	}
+
+	sCookedMeshHeader header;
+	memcpy(&header, fileOut.GetData(), sizeof(header));
+
+	size_t expectedSize = sizeof(sCookedMeshHeader)
+		+ sizeof(sCookedMeshRange) * (size_t)header.meshesNum
+		+ sizeof(sVertexData) * (size_t)header.verticesNum
+		+ sizeof(unsigned int) * (size_t)header.indicesNum;
+
+	if (memcmp(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != COOKED_MESH_VERSION ||
+		header.vertexSize != sizeof(sVertexData) ||
+		header.sourceWriteTime != sourceWriteTime ||
+		header.sourceSize != sourceSize ||
+		fileOut.GetSize() != expectedSize)
+	{
+		fileOut.Close();
+		return false;
+	}
+
+	// Every section is a multiple of 4 bytes, so the pointers stay aligned
+	const unsigned char* cursor = fileOut.GetData() + sizeof(sCookedMeshHeader);
+	viewOut.meshesNum = header.meshesNum;
+	viewOut.meshes = (const sCookedMeshRange*)cursor;
+	cursor += sizeof(sCookedMeshRange) * header.meshesNum;
+	viewOut.vertices = (const sVertexData*)cursor;
+	cursor += sizeof(sVertexData) * header.verticesNum;
+	viewOut.indices = (const unsigned int*)cursor;
+
+	return true;
+}
+
+sCookedModelView MeshCooker::GetView(const sCookedModel& model)
+{
+	sCookedModelView view;
+	view.meshesNum = (unsigned int)model.meshes.size();
+	view.meshes = model.meshes.empty() ? nullptr : &model.meshes[0];
+	view.vertices = model.vertices.empty() ? nullptr : &model.vertices[0];
+	view.indices = model.indices.empty() ? nullptr : &model.indices[0];
+
+	return view;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DrawInfo.h"
+#include "cMappedFile.h"
+
+const unsigned int COOKED_TEXTURE_NAME_SIZE = 128;
+
+// One mesh inside a cooked model. Ranges index the model's vertex and index arrays
+struct sCookedMeshRange
+{
+	uint32_t firstVertex;
+	uint32_t verticesNum;
+	uint32_t firstIndex;
+	uint32_t indicesNum;
+	char textureName[COOKED_TEXTURE_NAME_SIZE];
+};
+
+// Model as it comes out of Assimp
+struct sCookedModel
+{
+	std::vector<sCookedMeshRange> meshes;
+	std::vector<sVertexData> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// Points either into a sCookedModel or straight into a mapped cooked file
+struct sCookedModelView
+{
+	unsigned int meshesNum;
+	const sCookedMeshRange* meshes;
+	const sVertexData* vertices;
+	const unsigned int* indices;
+};
+
+// Cooked files sit next to their source (Model.obj -> Model.obj.cmesh) and are rebuilt when the source changes
+namespace MeshCooker
+{
+	std::string GetCookedPath(const std::string& sourcePath);
+
+	bool Import(const std::string& sourcePath, sCookedModel& modelOut);
+	bool Write(const std::string& sourcePath, const sCookedModel& model);
+	// Fails if there's no cooked file or it's older than the source
+	bool Read(const std::string& sourcePath, cMappedFile& fileOut, sCookedModelView& viewOut);
+	// Same, with the cooked file somewhere other than next to its source
+	bool Write(const std::string& sourcePath, const std::string& cookedPath, const sCookedModel& model);
+	bool Read(const std::string& sourcePath, const std::string& cookedPath, cMappedFile& fileOut, sCookedModelView& viewOut);
+
+	sCookedModelView GetView(const sCookedModel& model);
+}
@@ -1,9 +1,11 @@
 #include "cParticleSpawner.h"
 
 #include "Player.h"
+#include "Engine.h"
+#include "cRenderManager.h"
 
-#include "cLinearCongruentialGenerator.h"
-#include <time.h>
+#include <cfloat>
+#include <cstdint>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -14,137 +16,233 @@ cParticleSpawner::cParticleSpawner(glm::vec3 position, cRenderModel _model, unsi
 	spawnPosition = position;
 	isPositionPlayerRelative = false;
 
-	particles.reserve(_maxParticles);
-	maxParticles = _maxParticles; // if -1, no limit
+	maxParticles = _maxParticles;
+	instanceData.resize(_maxParticles);
+
+	// Kernels read and write whole groups, so every array is padded to the group size and starts aligned
+	unsigned int arrayStride = (_maxParticles + PARTICLE_KERNEL_WIDTH - 1) / PARTICLE_KERNEL_WIDTH * PARTICLE_KERNEL_WIDTH;
+	arrayStride = (arrayStride * sizeof(float) + PARTICLE_ARRAY_ALIGNMENT - 1) / PARTICLE_ARRAY_ALIGNMENT * PARTICLE_ARRAY_ALIGNMENT / sizeof(float);
+	particleStorage.resize(arrayStride * 7 + PARTICLE_ARRAY_ALIGNMENT / sizeof(float), 0.f);
+
+	uintptr_t storageAddress = (uintptr_t)&particleStorage[0];
+	float* base = (float*)((storageAddress + PARTICLE_ARRAY_ALIGNMENT - 1) & ~(uintptr_t)(PARTICLE_ARRAY_ALIGNMENT - 1));
+	particles.positionsX = base;
+	particles.positionsY = base + arrayStride;
+	particles.positionsZ = base + arrayStride * 2;
+	particles.velocitiesX = base + arrayStride * 3;
+	particles.velocitiesY = base + arrayStride * 4;
+	particles.velocitiesZ = base + arrayStride * 5;
+	particles.timers = base + arrayStride * 6;
+	particlesNum = 0;
 	timer = 0.f;
 
 	model = _model;
 
-	// do the random
-	srand((int)time(0));
-	unsigned int init_seed = (rand() % 100) + 1;
-	lcgPosX = cLinearCongruentialGenerator(init_seed);
-
-	init_seed = (rand() % 100) + 1;
-	lcgPosY = cLinearCongruentialGenerator(init_seed);
-
-	init_seed = (rand() % 100) + 1;
-	lcgPosZ = cLinearCongruentialGenerator(init_seed);
-
-	init_seed = (rand() % 100) + 1;
-	lcgSpdX = cLinearCongruentialGenerator(init_seed);
-
-	init_seed = (rand() % 100) + 1;
-	lcgSpdY = cLinearCongruentialGenerator(init_seed);
-
-	init_seed = (rand() % 100) + 1;
-	lcgSpdZ = cLinearCongruentialGenerator(init_seed);
+	random.Seed(cXoshiroGenerator::NextSeed());
 
 	// Create buffer for particle data (position + timer)
 	glGenBuffers(1, &particleBufferId);
 	glBindBuffer(GL_ARRAY_BUFFER, particleBufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * _maxParticles, NULL, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * _maxParticles, NULL, GL_STREAM_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 cParticleSpawner::~cParticleSpawner()
 {
-	particles.clear();
-
 	glDeleteBuffers(1, &particleBufferId);
+	SetGpuSimulation(false);
 }
 
-bool cParticleSpawner::SpawnParticle()
+void cParticleSpawner::SetGpuSimulation(bool enable)
 {
-	if (particles.size() >= particles.capacity()) return false;
-
-	double randomPosX;
-	double randomPosY;
-	double randomPosZ;
-
-	double randomSpdX;
-	double randomSpdY;
-	double randomSpdZ;
-
-	lcgPosX.get_uniform_draw(randomPosX);
-	lcgPosY.get_uniform_draw(randomPosY);
-	lcgPosZ.get_uniform_draw(randomPosZ);
-
-	lcgSpdX.get_uniform_draw(randomSpdX);
-	lcgSpdY.get_uniform_draw(randomSpdY);
-	lcgSpdZ.get_uniform_draw(randomSpdZ);
-
-	//NewValue = (((OldValue - OldMin) * (NewMax - NewMin)) / (OldMax - OldMin)) + NewMin
-	glm::vec3 newParticlePosOffset = glm::vec3(
-		(((float)randomPosX * (maxPositionOffset.x - minPositionOffset.x)) / (1 - 0)) + minPositionOffset.x,
-		(((float)randomPosY * (maxPositionOffset.y - minPositionOffset.y)) / (1 - 0)) + minPositionOffset.y,
-		(((float)randomPosZ * (maxPositionOffset.z - minPositionOffset.z)) / (1 - 0)) + minPositionOffset.z
-	);
-
-	//NewValue = (((OldValue - OldMin) * (NewMax - NewMin)) / (OldMax - OldMin)) + NewMin
-	glm::vec3 newParticleSpdOffset = glm::vec3(
-		(((float)randomSpdX * (maxSpeedOffset.x - minSpeedOffset.x)) / (1 - 0)) + minSpeedOffset.x,
-		(((float)randomSpdY * (maxSpeedOffset.y - minSpeedOffset.y)) / (1 - 0)) + minSpeedOffset.y,
-		(((float)randomSpdZ * (maxSpeedOffset.z - minSpeedOffset.z)) / (1 - 0)) + minSpeedOffset.z
-	);
-
-	particles.emplace_back();
-	sParticle& newParticle = particles.back();
-	newParticle.position = newParticlePosOffset + spawnPosition;
-	newParticle.velocity = newParticleSpdOffset + spawnSpeed;
-	newParticle.timer = 0.f;
+	if (enable == isGpuSimulated) return;
 
-	if (isPositionPlayerRelative)
+	isGpuSimulated = enable;
+	particlesNum = 0;
+	gpuCurrentBuffer = 0;
+	gpuSpawnsNum = 0;
+	gpuPendingSpawns = 0;
+	gpuSpawnBatches.clear();
+	gpuLiveNum = 0;
+
+	if (!enable)
 	{
-		newParticle.position += Player::GetPlayerPosition();
+		glDeleteVertexArrays(2, gpuVAOs);
+		glDeleteBuffers(2, gpuBufferIds);
+		gpuVAOs[0] = gpuVAOs[1] = 0;
+		gpuBufferIds[0] = gpuBufferIds[1] = 0;
+		return;
 	}
 
-	return true;
+	// Every slot starts dead, a negative timer
+	std::vector<glm::vec4> initialData(maxParticles * 2 + 2, glm::vec4(0.f, 0.f, 0.f, -1.f));
+
+	glGenBuffers(2, gpuBufferIds);
+	glGenVertexArrays(2, gpuVAOs);
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		glBindVertexArray(gpuVAOs[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, gpuBufferIds[i]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * 2 * maxParticles, &initialData[0], GL_STREAM_COPY);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * 2, (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * 2, (void*)sizeof(glm::vec4));
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void cParticleSpawner::SpawnParticles(unsigned int numToSpawn)
+unsigned int cParticleSpawner::SpawnParticles(unsigned int numToSpawn)
 {
-	for (unsigned int i = 0; i < numToSpawn; i++)
+	if (isGpuSimulated)
+	{
+		gpuPendingSpawns += numToSpawn;
+		return numToSpawn;
+	}
+
+	if (particlesNum + numToSpawn > maxParticles) numToSpawn = maxParticles - particlesNum;
+	if (numToSpawn == 0) return 0;
+
+	glm::vec3 origin = spawnPosition;
+	if (isPositionPlayerRelative)
+	{
+		origin += Player::GetPlayerPosition();
+	}
+
+	// Straight into the new particles' slots, one batch per component
+	unsigned int first = particlesNum;
+	random.FillUniform(particles.positionsX + first, numToSpawn, origin.x + minPositionOffset.x, origin.x + maxPositionOffset.x);
+	random.FillUniform(particles.positionsY + first, numToSpawn, origin.y + minPositionOffset.y, origin.y + maxPositionOffset.y);
+	random.FillUniform(particles.positionsZ + first, numToSpawn, origin.z + minPositionOffset.z, origin.z + maxPositionOffset.z);
+	random.FillUniform(particles.velocitiesX + first, numToSpawn, spawnSpeed.x + minSpeedOffset.x, spawnSpeed.x + maxSpeedOffset.x);
+	random.FillUniform(particles.velocitiesY + first, numToSpawn, spawnSpeed.y + minSpeedOffset.y, spawnSpeed.y + maxSpeedOffset.y);
+	random.FillUniform(particles.velocitiesZ + first, numToSpawn, spawnSpeed.z + minSpeedOffset.z, spawnSpeed.z + maxSpeedOffset.z);
+
+	for (unsigned int i = first; i < first + numToSpawn; i++)
 	{
-		SpawnParticle();
+		particles.timers[i] = 0.f;
 	}
+
+	particlesNum += numToSpawn;
+	return numToSpawn;
 }
 
 void cParticleSpawner::Update(float deltaTime)
 {
+	unsigned int numToSpawn = 0;
 	if (spawnRate > 0.f)
 	{
 		timer += deltaTime;
 
-		if (timer > spawnRate && SpawnParticle())
+		// Storms spawn more than one particle a frame, all in one batch
+		if (timer > spawnRate)
 		{
-			timer -= spawnRate;
+			numToSpawn = (unsigned int)(timer / spawnRate);
+			timer -= numToSpawn * spawnRate;
 		}
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, particleBufferId);
+	if (isGpuSimulated)
+	{
+		UpdateGpu(deltaTime, numToSpawn);
+		return;
+	}
+
+	if (numToSpawn > 0 && SpawnParticles(numToSpawn) < numToSpawn) timer = 0.f;
 
-	for (int i = 0; i < particles.size(); i++)
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+
+	ParticleKernels::KernelFunction integrate = ParticleKernels::GetKernelFunction(ParticleKernels::GetActiveKernel());
+	particlesNum = integrate(particles, particlesNum, deltaTime, gravity, particleLifeTime, boundsMin, boundsMax);
+
+	for (unsigned int i = 0; i < particlesNum; i++)
 	{
-		particles[i].timer += deltaTime;
+		instanceData[i] = glm::vec4(particles.positionsX[i], particles.positionsY[i], particles.positionsZ[i], particles.timers[i]);
+	}
 
-		if (particles[i].timer > particleLifeTime)
-		{
-			particles.erase(particles.begin() + i);
-			i--;
+	// Orphan the old storage so the driver doesn't wait on last frame's draw, then one upload for every particle
+	glBindBuffer(GL_ARRAY_BUFFER, particleBufferId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * maxParticles, NULL, GL_STREAM_DRAW);
+	if (particlesNum > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * particlesNum, &instanceData[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-			continue;
-		}
+	// Particles are quads of the model's scale around their position
+	float particleRadius = glm::max(model.scale.x, glm::max(model.scale.y, model.scale.z));
+	boundsMin -= glm::vec3(particleRadius);
+	boundsMax += glm::vec3(particleRadius);
+}
 
-		// Update position
-		particles[i].position += particles[i].velocity * deltaTime;
+void cParticleSpawner::UpdateGpu(float deltaTime, unsigned int numToSpawn)
+{
+	unsigned int spawnsNum = glm::min(numToSpawn + gpuPendingSpawns, maxParticles);
+	gpuPendingSpawns = 0;
 
-		// Upadte velocity
-		particles[i].velocity += gravity * deltaTime;
+	glm::vec3 origin = spawnPosition;
+	if (isPositionPlayerRelative)
+	{
+		origin += Player::GetPlayerPosition();
+	}
 
-		// Update buffer
-		glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * i, sizeof(glm::vec4), glm::value_ptr(glm::vec4(particles[i].position, particles[i].timer)));
+	static const unsigned int deltaTimeHandle = Manager::render.GetUniformHandle("deltaTime");
+	static const unsigned int lifeTimeHandle = Manager::render.GetUniformHandle("lifeTime");
+	static const unsigned int gravityHandle = Manager::render.GetUniformHandle("gravity");
+	static const unsigned int spawnSlotHandle = Manager::render.GetUniformHandle("spawnSlot");
+	static const unsigned int spawnsNumHandle = Manager::render.GetUniformHandle("spawnsNum");
+	static const unsigned int spawnSerialHandle = Manager::render.GetUniformHandle("spawnSerial");
+	static const unsigned int particlesMaxHandle = Manager::render.GetUniformHandle("particlesMax");
+	static const unsigned int seedHandle = Manager::render.GetUniformHandle("seed");
+	static const unsigned int positionMinHandle = Manager::render.GetUniformHandle("positionMin");
+	static const unsigned int positionMaxHandle = Manager::render.GetUniformHandle("positionMax");
+	static const unsigned int speedMinHandle = Manager::render.GetUniformHandle("speedMin");
+	static const unsigned int speedMaxHandle = Manager::render.GetUniformHandle("speedMax");
+
+	Manager::render.use("particleUpdate");
+	Manager::render.setFloat(deltaTimeHandle, deltaTime);
+	Manager::render.setFloat(lifeTimeHandle, particleLifeTime);
+	Manager::render.setVec3(gravityHandle, gravity);
+	Manager::render.setInt(spawnSlotHandle, maxParticles ? gpuSpawnsNum % maxParticles : 0);
+	Manager::render.setInt(spawnsNumHandle, spawnsNum);
+	Manager::render.setInt(spawnSerialHandle, (int)gpuSpawnsNum);
+	Manager::render.setInt(particlesMaxHandle, maxParticles);
+	Manager::render.setInt(seedHandle, (int)(random.GetSeed() ^ (random.GetSeed() >> 32)));
+	Manager::render.setVec3(positionMinHandle, origin + minPositionOffset);
+	Manager::render.setVec3(positionMaxHandle, origin + maxPositionOffset);
+	Manager::render.setVec3(speedMinHandle, spawnSpeed + minSpeedOffset);
+	Manager::render.setVec3(speedMaxHandle, spawnSpeed + maxSpeedOffset);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(gpuVAOs[gpuCurrentBuffer]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, gpuBufferIds[1 - gpuCurrentBuffer]);
+
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, maxParticles);
+	glEndTransformFeedback();
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	gpuCurrentBuffer = 1 - gpuCurrentBuffer;
+	gpuSpawnsNum += spawnsNum;
+
+	glm::vec3 originMin, originMax;
+	gpuLiveNum = ParticleKernels::TrackGpuSpawns(gpuSpawnBatches, deltaTime, particleLifeTime, spawnsNum, origin, maxParticles, originMin, originMax);
+
+	if (gpuLiveNum == 0)
+	{
+		boundsMin = glm::vec3(1.f);
+		boundsMax = glm::vec3(-1.f);
+		return;
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glm::vec3 travelMin, travelMax;
+	ParticleKernels::GetGpuTravelBounds(spawnSpeed + minSpeedOffset, spawnSpeed + maxSpeedOffset, gravity, particleLifeTime, travelMin, travelMax);
+
+	// Particles are quads of the model's scale around their position
+	float particleRadius = glm::max(model.scale.x, glm::max(model.scale.y, model.scale.z));
+	boundsMin = originMin + minPositionOffset + travelMin - glm::vec3(particleRadius);
+	boundsMax = originMax + maxPositionOffset + travelMax + glm::vec3(particleRadius);
 }
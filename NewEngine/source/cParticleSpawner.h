@@ -1,14 +1,9 @@
 #pragma once
 #include "cRenderModel.h"
-#include "cLinearCongruentialGenerator.h"
+#include "cXoshiroGenerator.h"
+#include "ParticleKernels.h"
 #include <memory>
-
-struct sParticle
-{
-	glm::vec3 position;
-	glm::vec3 velocity;
-	float timer;
-};
+#include <deque>
 
 class cParticleSpawner
 {
@@ -16,11 +11,14 @@ public:
 	cParticleSpawner(glm::vec3 position, cRenderModel _model, unsigned int _maxParticles);
 	~cParticleSpawner();
 
-	// Spawn position
+	// Random spawn offsets, drawn for a whole batch of particles at once
 private:
-	cLinearCongruentialGenerator lcgPosX;
-	cLinearCongruentialGenerator lcgPosY;
-	cLinearCongruentialGenerator lcgPosZ;
+	cXoshiroGenerator random;
+public:
+	void Seed(uint64_t seed) { random.Seed(seed); } // same seed and same updates replay the same particles
+	uint64_t GetSeed() const { return random.GetSeed(); }
+
+	// Spawn position
 public:
 	glm::vec3 spawnPosition;
 	glm::vec3 minPositionOffset = glm::vec3(0.f);
@@ -28,10 +26,6 @@ public:
 	bool isPositionPlayerRelative = false;
 
 	// Spawn speed
-private:
-	cLinearCongruentialGenerator lcgSpdX;
-	cLinearCongruentialGenerator lcgSpdY;
-	cLinearCongruentialGenerator lcgSpdZ;
 public:
 	glm::vec3 spawnSpeed = glm::vec3(0.f);
 	glm::vec3 minSpeedOffset = glm::vec3(0.f);
@@ -39,22 +33,46 @@ public:
 	glm::vec3 gravity = glm::vec3(0.f);
 
 private:
-	std::vector<sParticle> particles;
+	// Live particles are kept packed at the front of every array, in spawn order
+	std::vector<float> particleStorage; // all of the arrays, aligned inside it
+	sParticleArrays particles;
+	unsigned int particlesNum = 0;
+	std::vector<glm::vec4> instanceData; // position and timer, uploaded in one go every update
 	float timer = 0.f;
-	int maxParticles;
+	unsigned int maxParticles;
 public:
+	unsigned int GetParticlesNum() { return particlesNum; }
 	float spawnRate = -1.f; // particles spawned per second; negative for not spawn on timer
 	float particleLifeTime = 1.f;
 
+	// Around every live particle, updated with them. Empty (min over max) when there's none
+	glm::vec3 boundsMin = glm::vec3(1.f);
+	glm::vec3 boundsMax = glm::vec3(-1.f);
+
 private:
 	// Model
 	cRenderModel model;
 	unsigned int particleBufferId = 0;
 
+	// GPU simulation. Particles stay in two buffers the update shader ping-pongs between, one slot each,
+	// and the CPU only sends the spawner's parameters
 private:
-	bool SpawnParticle();
+	bool isGpuSimulated = false;
+	unsigned int gpuBufferIds[2] = { 0, 0 }; // position and timer, velocity
+	unsigned int gpuVAOs[2] = { 0, 0 };
+	unsigned int gpuCurrentBuffer = 0; // drawn this frame, read by the next update
+	unsigned int gpuSpawnsNum = 0; // spawns so far, picks the next slot and the random numbers
+	unsigned int gpuPendingSpawns = 0; // from SpawnParticles, made on the next update
+	std::deque<sGpuSpawnBatch> gpuSpawnBatches; // oldest first, only the ones that can still have live particles
+	unsigned int gpuLiveNum = 0; // slots the last gpuLiveNum spawns went to, everything else is dead
+	void UpdateGpu(float deltaTime, unsigned int numToSpawn);
+public:
+	// Drops the live particles. When full, new spawns take the oldest slots instead of being refused
+	void SetGpuSimulation(bool enable);
+	bool IsGpuSimulated() { return isGpuSimulated; }
+
 public:
-	void SpawnParticles(unsigned int numToSpawn);
+	unsigned int SpawnParticles(unsigned int numToSpawn); // returns how many fit
 
 	void Update(float deltaTime);
 
@@ -1,15 +1,17 @@
 #include "cRenderManager.h"
 
+#include <GLFW/glfw3.h>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cfloat>
+#include <chrono>
 
-#include <assimp/Importer.hpp>      // C++ importer interface
-#include <assimp/scene.h>           // Output data structure
-#include <assimp/postprocess.h>     // Post processing flags
+#include "cMeshCooker.h"
+#include "cJobSystem.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -36,6 +38,13 @@ const std::string PKM_DATA_PATH = "assets/pokemon/";
 
 const unsigned int SHADOW_WIDTH = 3048, SHADOW_HEIGHT = 3048;
 
+// glad is generated for 3.3 core, so multi draw indirect is loaded by hand
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFN_MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static PFN_MultiDrawElementsIndirect glMultiDrawElementsIndirectPtr = nullptr;
+
 cRenderManager::cRenderManager()
 {
 }
@@ -148,6 +157,23 @@ void cRenderManager::Startup()
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Static casters' depth, blitted into the depth map every frame before the dynamic ones are drawn on top
+    glGenFramebuffers(1, &shadowCacheFBO);
+
+    glGenTextures(1, &shadowCacheMapID);
+    glBindTexture(GL_TEXTURE_2D, shadowCacheMapID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowCacheFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowCacheMapID, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenQueries(SHADOW_TIMER_QUERIES_NUM, shadowTimerQueries);
     //*****************************************************************
 
     // setup matrices uniform block
@@ -168,16 +194,43 @@ void cRenderManager::Startup()
 
     glBindBufferRange(GL_UNIFORM_BUFFER, 2, uboFogID, 0, 2 * sizeof(glm::vec4) + 2 * sizeof(float));
 
+    // setup objects uniform block (sized on the first upload)
+    glGenBuffers(1, &uboObjectsID);
+
+    // Most meshes end up packed, the float arena is only for ones with UVs out of half range. All grow when needed
+    meshArenas[VERTEX_LAYOUT_PACKED_UNORM].Startup(VERTEX_LAYOUT_PACKED_UNORM, 65536, 196608);
+    meshArenas[VERTEX_LAYOUT_PACKED_HALF].Startup(VERTEX_LAYOUT_PACKED_HALF, 16384, 49152);
+    meshArenas[VERTEX_LAYOUT_FLOAT].Startup(VERTEX_LAYOUT_FLOAT, 4096, 12288);
+
+    // Base instance is needed so every tile type can read its own range of the shared instance buffer
+    if (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance"))
+    {
+        glMultiDrawElementsIndirectPtr = (PFN_MultiDrawElementsIndirect)glfwGetProcAddress("glMultiDrawElementsIndirect");
+        isIndirectDrawSupported = glMultiDrawElementsIndirectPtr != nullptr;
+    }
+    std::cout << "Multi draw indirect " << (isIndirectDrawSupported ? "supported" : "not supported, tiles will be drawn per model") << std::endl;
+
+    // Sprite arrays are created as sheets of each size show up
+    glGenFramebuffers(1, &spriteCopyFBO);
+    glGenBuffers(1, &spriteInstanceBufferId);
+
     // Setup shader programs
+    for (unsigned int i = 0; i < MAX_CACHED_TEXTURE_UNITS; i++)
+    {
+        textureUnitHandles[i] = GetUniformHandle("texture_" + std::to_string(i));
+    }
+
     CreateShaderProgram("scene", "VertShader1.glsl", "FragShader1.glsl");  
     CreateShaderProgram("skybox", "SkyboxVertShader.glsl", "SkyboxFragShader.glsl");
     CreateShaderProgram("sprite", "SpriteVertShader.glsl", "FragShader1.glsl");
+    CreateShaderProgram("spriteArray", "SpriteArrayVertShader.glsl", "SpriteArrayFragShader.glsl");
     CreateShaderProgram("wave", "WaveVertShader.glsl", "WaveFragShader.glsl");
     CreateShaderProgram("ocean", "OceanVertShader.glsl", "OceanFragShader.glsl");
     CreateShaderProgram("foam", "FoamVertShader.glsl", "FoamFragShader.glsl");
     CreateShaderProgram("tree", "TreeVertShader.glsl", "FragShader1.glsl");
     CreateShaderProgram("snow", "SnowVertShader.glsl", "SnowFragShader.glsl");
     CreateShaderProgram("particle", "3DParticleVertShader.glsl", "FragShader1.glsl");
+    CreateShaderProgram("particleUpdate", "ParticleUpdateVertShader.glsl", nullptr, { "outPositionTimer", "outVelocity" });
     CreateShaderProgram("ui", "UIVertShader.glsl", "UIFragShader.glsl");
     CreateShaderProgram("text", "TextVertShader.glsl", "TextFragShader.glsl");
 
@@ -206,14 +259,32 @@ void cRenderManager::Shutdown()
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteBuffers(1, &uboMatricesID);
     glDeleteBuffers(1, &uboFogID);
+    glDeleteBuffers(1, &uboObjectsID);
+    glDeleteFramebuffers(1, &shadowCacheFBO);
+    glDeleteTextures(1, &shadowCacheMapID);
+    glDeleteQueries(SHADOW_TIMER_QUERIES_NUM, shadowTimerQueries);
+    ClearTileBatches();
+    UnloadModels();
+    for (unsigned int i = 0; i < VERTEX_LAYOUT_NUM; i++)
+    {
+        meshArenas[i].Shutdown();
+    }
     glDeleteBuffers(1, &notInstancedOffsetBufferId);
 
     UnloadTextures();
+    for (unsigned int i = 0; i < spriteArrays.size(); i++)
+    {
+        glDeleteTextures(1, &spriteArrays[i].textureId);
+    }
+    spriteArrays.clear();
+    glDeleteFramebuffers(1, &spriteCopyFBO);
+    glDeleteBuffers(1, &spriteInstanceBufferId);
     mapModels.clear();
     battleModels.clear();
+    mapSpriteModels.clear();
 }
 
-void cRenderManager::CreateShaderProgram(std::string programName, const char* vertexPath, const char* fragmentPath)
+void cRenderManager::CreateShaderProgram(std::string programName, const char* vertexPath, const char* fragmentPath, const std::vector<const char*>& feedbackVaryings)
 {
     if (programs.count(programName) != 0) // it exists
     {
@@ -234,14 +305,16 @@ void cRenderManager::CreateShaderProgram(std::string programName, const char* ve
     {
         // open files
         vShaderFile.open(SHADER_PATH + vertexPath);
-        fShaderFile.open(SHADER_PATH + fragmentPath);
         std::stringstream vShaderStream, fShaderStream;
         // read file's buffer contents into streams
         vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
         vShaderFile.close();
-        fShaderFile.close();
+        if (fragmentPath)
+        {
+            fShaderFile.open(SHADER_PATH + fragmentPath);
+            fShaderStream << fShaderFile.rdbuf();
+            fShaderFile.close();
+        }
         // convert stream into string
         vertexCode = vShaderStream.str();
         fragmentCode = fShaderStream.str();
@@ -264,28 +337,58 @@ void cRenderManager::CreateShaderProgram(std::string programName, const char* ve
     checkCompileErrors(vertex, "VERTEX");
 
     // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
+    fragment = 0;
+    if (fragmentPath)
+    {
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+    }
 
     // shader Program
     unsigned int ID;
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
+    if (fragment) glAttachShader(ID, fragment);
+    if (!feedbackVaryings.empty())
+        glTransformFeedbackVaryings(ID, (GLsizei)feedbackVaryings.size(), &feedbackVaryings[0], GL_INTERLEAVED_ATTRIBS); // has to be set before linking
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
 
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    if (fragment) glDeleteShader(fragment);
 
     sShaderProgram newShader;
     newShader.ID = ID;
 
+    // Resolve every uniform name known so far
+    newShader.uniformLocations.reserve(uniformNames.size());
+    for (unsigned int i = 0; i < uniformNames.size(); i++)
+    {
+        newShader.uniformLocations.push_back(glGetUniformLocation(ID, uniformNames[i].c_str()));
+    }
+
     programs.insert(std::pair<std::string, sShaderProgram>(programName, newShader));
 
+    // Register this program's own uniforms, so their handles exist before the first draw
+    int activeUniformsNum = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &activeUniformsNum);
+    for (int i = 0; i < activeUniformsNum; i++)
+    {
+        char uniformName[256];
+        int nameLength = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, i, sizeof(uniformName), &nameLength, &size, &type, uniformName);
+
+        std::string name(uniformName, nameLength);
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            name.erase(name.size() - 3); // arrays are reported as "name[0]"
+
+        GetUniformHandle(name);
+    }
+
     // add Matrices block to matrices
     unsigned int ubMatricesIndex = glGetUniformBlockIndex(newShader.ID, "Matrices");
     glUniformBlockBinding(newShader.ID, ubMatricesIndex, 0);
@@ -296,11 +399,28 @@ void cRenderManager::CreateShaderProgram(std::string programName, const char* ve
     // add Fog block to matrices
     unsigned int ubFogIndex = glGetUniformBlockIndex(newShader.ID, "Fog");
     glUniformBlockBinding(newShader.ID, ubFogIndex, 2);
+
+    // add Objects block to matrices
+    unsigned int ubObjectsIndex = glGetUniformBlockIndex(newShader.ID, "Objects");
+    if (ubObjectsIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(newShader.ID, ubObjectsIndex, 3);
+
+    // Sampler units never change, so set them once instead of every draw
+    unsigned int shadowMapHandle = GetUniformHandle("shadowMap");
+    unsigned int spriteArrayHandle = GetUniformHandle("spriteArray");
+    const sShaderProgram& createdShader = programs[programName];
+    glUseProgram(ID);
+    glUniform1i(createdShader.uniformLocations[textureUnitHandles[0]], 0);
+    glUniform1i(createdShader.uniformLocations[shadowMapHandle], 1);
+    glUniform1i(createdShader.uniformLocations[spriteArrayHandle], SPRITE_ARRAY_TEXTURE_UNIT);
+    glUseProgram(0);
 }
 
 unsigned int cRenderManager::GetCurrentShaderId()
 {
-    return programs[currShader].ID;
+    if (!currProgram) return 0;
+
+    return currProgram->ID;
 }
 
 unsigned int cRenderManager::GetDepthMapId()
@@ -308,214 +428,353 @@ unsigned int cRenderManager::GetDepthMapId()
     return depthMapID;
 }
 
-bool cRenderManager::LoadModel(std::string fileName, std::string programName)
+MeshHandle cRenderManager::GetMeshHandle(const std::string& fileName, const std::string& programName)
 {
-    std::map<std::string, sShaderProgram>::iterator itPrograms = programs.find(programName);
-    if (itPrograms == programs.end()) return false;
+    if (fileName == "") return INVALID_MESH_HANDLE;
 
-    std::map<std::string, sModelDrawInfo>::iterator itDrawInfo = programs[programName].modelsLoaded.find(fileName);
-    if (itDrawInfo != programs[programName].modelsLoaded.end()) return true; // already loaded
+    std::map<std::string, sShaderProgram>::iterator itProgram = programs.find(programName);
+    if (itProgram == programs.end()) return INVALID_MESH_HANDLE;
 
-    Assimp::Importer importer;
+    std::string key = programName + "/" + fileName;
+    std::map<std::string, MeshHandle>::iterator itHandle = meshHandles.find(key);
+    if (itHandle != meshHandles.end()) return itHandle->second;
 
-    const aiScene* scene = importer.ReadFile(MODEL_PATH + fileName,
-        aiProcess_Triangulate |
-        aiProcess_GenSmoothNormals |
-        aiProcess_PopulateArmatureData |
-        aiProcess_FixInfacingNormals |
-        aiProcess_LimitBoneWeights);
+    // Register it now, LoadModel fills it in later
+    sMeshEntry newEntry;
+    newEntry.fileName = fileName;
+    newEntry.program = &itProgram->second;
+    newEntry.isLoaded = false;
 
-    if (scene == nullptr)
-    {
-        printf("ModelManager::LoadModel: ERROR: Failed to load file %s\n", fileName.c_str());
-        printf(importer.GetErrorString());
-        return false;
-    }
+    MeshHandle newHandle = (MeshHandle)meshes.size();
+    meshes.push_back(newEntry);
+    meshHandles.insert(std::pair<std::string, MeshHandle>(key, newHandle));
+
+    return newHandle;
+}
+
+const sMeshEntry* cRenderManager::FindLoadedMesh(MeshHandle handle)
+{
+    if (handle >= meshes.size() || !meshes[handle].isLoaded) return nullptr;
+
+    return &meshes[handle];
+}
+
+bool cRenderManager::ReadModelGeometry(const std::string& fileName, cMappedFile& cookedFileOut, sCookedModel& importedModelOut, sCookedModelView& modelOut)
+{
+    // Cooked files are mapped and used as is, Assimp only runs when there's none or it's stale
+    const std::string sourcePath = MODEL_PATH + fileName;
+    if (useMeshCache && MeshCooker::Read(sourcePath, cookedFileOut, modelOut)) return true;
 
-    if (!scene->HasMeshes())
+    if (!MeshCooker::Import(sourcePath, importedModelOut))
         return false;
 
-    use(programName);
+    if (useMeshCache && !MeshCooker::Write(sourcePath, importedModelOut))
+        printf("cRenderManager::ReadModelGeometry: WARNING: Could not cook %s\n", fileName.c_str());
 
-    sModelDrawInfo newModel;
-    newModel.numMeshes = scene->mNumMeshes;
+    modelOut = MeshCooker::GetView(importedModelOut);
+    return true;
+}
 
-    for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) // per mesh
-    {
-        aiMesh* currMesh = scene->mMeshes[meshIndex];
+MeshHandle cRenderManager::LoadModel(std::string fileName, std::string programName)
+{
+    MeshHandle handle = GetMeshHandle(fileName, programName);
+    if (handle == INVALID_MESH_HANDLE) return INVALID_MESH_HANDLE;
 
-        sMeshDrawInfo newMeshInfo;
-        newMeshInfo.numberOfVertices = currMesh->mNumVertices;
-        sVertexData* verticesData = new sVertexData[currMesh->mNumVertices];
+    // Geometry is shared between programs, only the first load of a file touches the arena
+    if (assetCache.Acquire(ASSET_MODEL, fileName))
+    {
+        const sModelDrawInfo& drawInfo = arenaModels[fileName];
 
-        for (unsigned int vertexIndex = 0; vertexIndex < currMesh->mNumVertices; vertexIndex++) // per vertex
+        // Its textures could have been evicted on their own while the model sat in the pool
+        for (unsigned int meshIndex = 0; meshIndex < drawInfo.allMeshesData.size(); meshIndex++)
         {
-            sVertexData newVertexInfo;
+            LoadTexture(drawInfo.allMeshesData[meshIndex].textureName);
+        }
 
-            newVertexInfo.x = currMesh->mVertices[vertexIndex].x;
-            newVertexInfo.y = currMesh->mVertices[vertexIndex].y;
-            newVertexInfo.z = currMesh->mVertices[vertexIndex].z;
-            newVertexInfo.w = 1;
+        meshes[handle].drawInfo = drawInfo;
+        meshes[handle].isLoaded = true;
+        staticShadowGeneration++;
+        return handle;
+    }
 
-            newVertexInfo.nx = currMesh->mNormals[vertexIndex].x;
-            newVertexInfo.ny = currMesh->mNormals[vertexIndex].y;
-            newVertexInfo.nz = currMesh->mNormals[vertexIndex].z;
-            newVertexInfo.nw = 1;
+    cMappedFile cookedFile;
+    sCookedModel importedModel;
+    sCookedModelView model;
+    if (!ReadModelGeometry(fileName, cookedFile, importedModel, model))
+        return INVALID_MESH_HANDLE;
 
-            if (currMesh->mTextureCoords[0]) // if it has textures
-            {
-                newVertexInfo.u1 = currMesh->mTextureCoords[0][vertexIndex].x;
-                newVertexInfo.v1 = 1.f - currMesh->mTextureCoords[0][vertexIndex].y;
-                newVertexInfo.u2 = 0;
-                newVertexInfo.v2 = 0;
-            }
-            //else
-            //{
-            //    newVertexInfo.u1 =  0.f;
-            //    newVertexInfo.v1 =  0.f;
-            //    newVertexInfo.u2 =  0.f;
-            //    newVertexInfo.v2 =  0.f;
-            //}
+    sModelDrawInfo newModel;
+    newModel.numMeshes = model.meshesNum;
+    newModel.totalNumOfVertices = 0;
+    newModel.boundsMin = glm::vec3(0.f);
+    newModel.boundsMax = glm::vec3(0.f);
+
+    for (unsigned int meshIndex = 0; meshIndex < model.meshesNum; meshIndex++) // per mesh
+    {
+        const sCookedMeshRange& range = model.meshes[meshIndex];
+        AllocateMesh(model.vertices + range.firstVertex, range.verticesNum, model.indices + range.firstIndex, range.indicesNum, range.textureName, newModel);
+    }
+
+    arenaModels.insert(std::pair<std::string, sModelDrawInfo>(fileName, newModel));
 
-            //newVertexInfo.r = 1.f;
-            //newVertexInfo.g = 1.f;
-            //newVertexInfo.b = 1.f;
-            //newVertexInfo.a = 1.f;
+    size_t modelBytes = 0;
+    for (unsigned int meshIndex = 0; meshIndex < newModel.allMeshesData.size(); meshIndex++)
+    {
+        const sMeshDrawInfo& meshData = newModel.allMeshesData[meshIndex];
+        modelBytes += meshData.numberOfVertices * cMeshArena::GetVertexStride(meshData.vertexLayout) + meshData.numberOfIndices * sizeof(unsigned int);
+    }
+    assetCache.Add(ASSET_MODEL, fileName, modelBytes);
 
-            verticesData[vertexIndex] = newVertexInfo;
+    meshes[handle].drawInfo = newModel;
+    meshes[handle].isLoaded = true;
+    staticShadowGeneration++;
 
-        } // end of per vertex
+    return handle;
+}
 
-        newMeshInfo.numberOfIndices = currMesh->mNumFaces * 3;
-        newMeshInfo.numberOfTriangles = currMesh->mNumFaces;
+void cRenderManager::AllocateMesh(const sVertexData* verticesData, unsigned int verticesNum, const unsigned int* indiciesData, unsigned int indicesNum, const std::string& textureName, sModelDrawInfo& modelInOut)
+{
+    sMeshDrawInfo newMeshInfo;
+    newMeshInfo.numberOfVertices = verticesNum;
+    newMeshInfo.numberOfIndices = indicesNum;
+    newMeshInfo.numberOfTriangles = indicesNum / 3;
+    newMeshInfo.textureName = textureName;
+    modelInOut.totalNumOfVertices += verticesNum;
+
+    newMeshInfo.boundsMin = glm::vec3(FLT_MAX);
+    newMeshInfo.boundsMax = glm::vec3(-FLT_MAX);
+    for (unsigned int vertexIndex = 0; vertexIndex < verticesNum; vertexIndex++)
+    {
+        glm::vec3 vertexPosition = glm::vec3(verticesData[vertexIndex].x, verticesData[vertexIndex].y, verticesData[vertexIndex].z);
+        newMeshInfo.boundsMin = glm::min(newMeshInfo.boundsMin, vertexPosition);
+        newMeshInfo.boundsMax = glm::max(newMeshInfo.boundsMax, vertexPosition);
+    }
 
-        unsigned int* indiciesData = new unsigned int[newMeshInfo.numberOfIndices];
+    if (modelInOut.allMeshesData.empty())
+    {
+        modelInOut.boundsMin = newMeshInfo.boundsMin;
+        modelInOut.boundsMax = newMeshInfo.boundsMax;
+    }
+    else
+    {
+        modelInOut.boundsMin = glm::min(modelInOut.boundsMin, newMeshInfo.boundsMin);
+        modelInOut.boundsMax = glm::max(modelInOut.boundsMax, newMeshInfo.boundsMax);
+    }
 
-        unsigned int indiceIndex = 0;
-        for (unsigned int i = 0; i < currMesh->mNumFaces; i++)
-        {
-            aiFace currFace = currMesh->mFaces[i];
-            for (unsigned int j = 0; j < currFace.mNumIndices; j++)
-            {
-                indiciesData[indiceIndex + j] = currFace.mIndices[j];
-            }
-            indiceIndex += currFace.mNumIndices;
-        }
+    // Load texture
+    LoadTexture(newMeshInfo.textureName);
 
-        if (currMesh->mMaterialIndex > 0) // get texture for this mesh
-        {
-            aiMaterial* material = scene->mMaterials[currMesh->mMaterialIndex];
+    newMeshInfo.vertexLayout = VERTEX_LAYOUT_FLOAT;
+    if (usePackedVertices)
+    {
+        // Meshes without a texture of their own get theirs from the model, assume a big one
+        unsigned int textureSize = 256;
+        std::map<std::string, sTexture>::iterator itTexture = textures.find(newMeshInfo.textureName);
+        if (itTexture != textures.end())
+            textureSize = itTexture->second.width > itTexture->second.height ? itTexture->second.width : itTexture->second.height;
 
-            aiString path;
-            material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-            newMeshInfo.textureName = path.C_Str();
+        newMeshInfo.vertexLayout = cMeshArena::ChooseVertexLayout(verticesData, newMeshInfo.numberOfVertices, textureSize);
+    }
 
-            // Load texture
-            LoadTexture(newMeshInfo.textureName);
-        }
+    cMeshArena& arena = meshArenas[newMeshInfo.vertexLayout];
+    newMeshInfo.VAO_ID = arena.GetVAO();
+    arena.Allocate(verticesData, newMeshInfo.numberOfVertices,
+        indiciesData, newMeshInfo.numberOfIndices,
+        newMeshInfo.baseVertex, newMeshInfo.firstIndex);
 
-#pragma region VAO_Creation
+    modelInOut.allMeshesData.push_back(newMeshInfo);
+}
 
-        // Generate VAO and VBO
-        glGenVertexArrays(1, &(newMeshInfo.VAO_ID));
-        glGenBuffers(1, &(newMeshInfo.VBO_ID));
+MeshHandle cRenderManager::CreateMesh(const std::string& meshName, const std::string& programName, const std::vector<sMeshGeometry>& geometry)
+{
+    MeshHandle handle = GetMeshHandle(meshName, programName);
+    if (handle == INVALID_MESH_HANDLE || builtMeshes.find(meshName) != builtMeshes.end()) return handle;
 
-        // Bind VAO and VBO
-        glBindVertexArray(newMeshInfo.VAO_ID);
-        glBindBuffer(GL_ARRAY_BUFFER, newMeshInfo.VBO_ID);
+    sModelDrawInfo newModel;
+    newModel.numMeshes = 0;
+    newModel.totalNumOfVertices = 0;
+    newModel.boundsMin = glm::vec3(0.f);
+    newModel.boundsMax = glm::vec3(0.f);
 
-        // Specify VBO data
-        glBufferData(GL_ARRAY_BUFFER,
-            sizeof(sVertexData) * newMeshInfo.numberOfVertices,
-            (GLvoid*)verticesData,
-            GL_STATIC_DRAW);
+    for (unsigned int meshIndex = 0; meshIndex < geometry.size(); meshIndex++)
+    {
+        const sMeshGeometry& mesh = geometry[meshIndex];
+        if (mesh.indices.empty()) continue;
 
-        // Generate, bind and set indeces buffer
-        glGenBuffers(1, &(newMeshInfo.INDEX_ID));
+        AllocateMesh(&mesh.vertices[0], (unsigned int)mesh.vertices.size(), &mesh.indices[0], (unsigned int)mesh.indices.size(), mesh.textureName, newModel);
+        newModel.numMeshes++;
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMeshInfo.INDEX_ID);
+    builtMeshes.insert(std::pair<std::string, sModelDrawInfo>(meshName, newModel));
 
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            sizeof(unsigned int) * newMeshInfo.numberOfIndices,
-            (GLvoid*)indiciesData,
-            GL_STATIC_DRAW);
+    meshes[handle].drawInfo = newModel;
+    meshes[handle].isLoaded = true;
+    staticShadowGeneration++;
 
-        unsigned int shaderID = GetCurrentShaderId();
+    return handle;
+}
 
-        // Set vertex ins for shader
+void cRenderManager::DestroyMesh(const std::string& meshName)
+{
+    std::map<std::string, sModelDrawInfo>::iterator itModel = builtMeshes.find(meshName);
+    if (itModel == builtMeshes.end()) return;
 
-        // Position
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 4,
-            GL_FLOAT, GL_FALSE,
-            sizeof(sVertexData),
-            (void*)offsetof(sVertexData, x));
+    for (unsigned int i = 0; i < itModel->second.allMeshesData.size(); i++)
+    {
+        const sMeshDrawInfo& meshData = itModel->second.allMeshesData[i];
+        meshArenas[meshData.vertexLayout].Free(meshData.baseVertex, meshData.numberOfVertices, meshData.firstIndex, meshData.numberOfIndices);
+        ReleaseTexture(meshData.textureName);
+    }
+    builtMeshes.erase(itModel);
 
-        // Normal
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 4,
-            GL_FLOAT, GL_FALSE,
-            sizeof(sVertexData),
-            (void*)offsetof(sVertexData, nx));
+    for (unsigned int handle = 0; handle < meshes.size(); handle++)
+    {
+        if (meshes[handle].fileName != meshName) continue;
 
-        // UVs
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 4,
-            GL_FLOAT, GL_FALSE,
-            sizeof(sVertexData),
-            (void*)offsetof(sVertexData, u1));
+        meshes[handle].drawInfo.allMeshesData.clear();
+        meshes[handle].isLoaded = false;
+    }
+    staticShadowGeneration++;
+}
 
-        // Unbind buffers
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void cRenderManager::ReleaseModel(const std::string& fileName)
+{
+    std::map<std::string, sModelDrawInfo>::iterator itModel = arenaModels.find(fileName);
+    if (itModel == arenaModels.end()) return;
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
+    // Every load took a reference on each mesh's texture as well
+    for (unsigned int meshIndex = 0; meshIndex < itModel->second.allMeshesData.size(); meshIndex++)
+    {
+        ReleaseTexture(itModel->second.allMeshesData[meshIndex].textureName);
+    }
 
-#pragma endregion VAO_Creation
+    assetCache.Release(ASSET_MODEL, fileName);
+}
 
-        delete[] verticesData;
-        delete[] indiciesData;
+bool cRenderManager::CookModel(const std::string& fileName)
+{
+    const std::string sourcePath = MODEL_PATH + fileName;
 
-        newModel.allMeshesData.push_back(newMeshInfo);
-    } // end of per mesh
+    cMappedFile cookedFile;
+    sCookedModelView cookedView;
+    if (MeshCooker::Read(sourcePath, cookedFile, cookedView)) return true; // already up to date
 
-    programs[programName].modelsLoaded.insert(std::pair<std::string, sModelDrawInfo>(fileName, newModel));
+    sCookedModel importedModel;
+    if (!MeshCooker::Import(sourcePath, importedModel)) return false;
 
-    return true;
+    return MeshCooker::Write(sourcePath, importedModel);
 }
 
 void cRenderManager::UnloadModels()
 {
-    for (auto itPrograms = programs.begin(); itPrograms != programs.end(); itPrograms++)
+    for (std::map<std::string, sModelDrawInfo>::iterator it = arenaModels.begin(); it != arenaModels.end(); it++)
     {
-        for (auto itModels = itPrograms->second.modelsLoaded.begin(); itModels != itPrograms->second.modelsLoaded.end(); itModels++)
+        for (unsigned int i = 0; i < it->second.allMeshesData.size(); i++)
         {
-            for (int i = 0; i < itModels->second.allMeshesData.size(); i++)
-            {
-                glDeleteVertexArrays(1, &itModels->second.allMeshesData[i].VAO_ID);
-                glDeleteBuffers(1, &itModels->second.allMeshesData[i].VBO_ID);
-            }
+            const sMeshDrawInfo& meshData = it->second.allMeshesData[i];
+            meshArenas[meshData.vertexLayout].Free(meshData.baseVertex, meshData.numberOfVertices, meshData.firstIndex, meshData.numberOfIndices);
+        }
+        assetCache.Remove(ASSET_MODEL, it->first);
+    }
+    arenaModels.clear();
+
+    // Handles stay registered so models that survive a scene change can still find their mesh once it's reloaded
+    for (unsigned int handle = 0; handle < meshes.size(); handle++)
+    {
+        meshes[handle].drawInfo.allMeshesData.clear();
+        meshes[handle].isLoaded = false;
+    }
+    staticShadowGeneration++;
+}
+
+void cRenderManager::EvictAsset(eAssetType type, const std::string& name)
+{
+    if (type == ASSET_MODEL)
+    {
+        std::map<std::string, sModelDrawInfo>::iterator itModel = arenaModels.find(name);
+        if (itModel == arenaModels.end()) return;
+
+        for (unsigned int i = 0; i < itModel->second.allMeshesData.size(); i++)
+        {
+            const sMeshDrawInfo& meshData = itModel->second.allMeshesData[i];
+            meshArenas[meshData.vertexLayout].Free(meshData.baseVertex, meshData.numberOfVertices, meshData.firstIndex, meshData.numberOfIndices);
+        }
+        arenaModels.erase(itModel);
+
+        // Every program's handle to this file
+        for (unsigned int handle = 0; handle < meshes.size(); handle++)
+        {
+            if (meshes[handle].fileName != name) continue;
 
-            itModels->second.allMeshesData.clear();
+            meshes[handle].drawInfo.allMeshesData.clear();
+            meshes[handle].isLoaded = false;
         }
+    }
+    else if (type == ASSET_TEXTURE)
+    {
+        std::map<std::string, sTexture>::iterator itTexture = textures.find(name);
+        if (itTexture == textures.end()) return;
+
+        glDeleteTextures(1, &itTexture->second.textureId);
+        textures.erase(itTexture);
+    }
+    else if (type == ASSET_SPRITE_SHEET)
+    {
+        std::map<std::string, sSpriteSheet>::iterator itSheet = spriteSheets.find(name);
+        if (itSheet == spriteSheets.end()) return;
 
-        itPrograms->second.modelsLoaded.clear();
+        RemoveFromSpriteArray(itSheet->second);
+        glDeleteTextures(1, &itSheet->second.textureId);
+        spriteSheets.erase(itSheet);
     }
 }
 
-bool cRenderManager::FindModelByName(std::string fileName, std::string programName, sModelDrawInfo& modelInfo)
+size_t cRenderManager::GetTextureBytes(int width, int height)
 {
-    if (programs.find(programName) == programs.end()) return false; // Didn't find it
+    // RGBA8 plus a third for the mipmaps
+    return (size_t)width * height * 4 * 4 / 3;
+}
+
+void cRenderManager::ReleaseSceneAssets()
+{
+    // With the cache, the old scene's owners already released what they loaded
+    if (useAssetCache) return;
+
+    UnloadModels();
+    UnloadTextures();
+}
 
-    std::map<std::string, sModelDrawInfo>::iterator itDrawInfo = programs[programName].modelsLoaded.find(fileName);
+void cRenderManager::TrimAssetCache()
+{
+    ZoneScopedN("TrimAssetCache");
 
-    if (itDrawInfo == programs[programName].modelsLoaded.end()) return false; // Didn't find it
+    std::vector< std::pair<eAssetType, std::string> > evicted;
+    assetCache.Evict((size_t)assetCacheBudgetMb * 1024 * 1024, evicted);
 
-    modelInfo = itDrawInfo->second;
-    return true;
+    for (unsigned int i = 0; i < evicted.size(); i++)
+    {
+        EvictAsset(evicted[i].first, evicted[i].second);
+    }
+}
+
+const sAssetCacheStats& cRenderManager::GetAssetCacheStats()
+{
+    return assetCache.GetStats();
+}
+
+void cRenderManager::ResetAssetCacheCounters()
+{
+    assetCache.ResetCounters();
+}
+
+const cMeshArena& cRenderManager::GetMeshArena(eVertexLayout layout)
+{
+    return meshArenas[layout];
+}
+
+unsigned int cRenderManager::GetArenaModelsNum()
+{
+    return (unsigned int)arenaModels.size();
 }
 
 void cRenderManager::checkCompileErrors(unsigned int shader, std::string type)
@@ -542,89 +801,178 @@ void cRenderManager::checkCompileErrors(unsigned int shader, std::string type)
     }
 }
 
-void cRenderManager::use(std::string programName)
+void cRenderManager::use(const std::string& programName)
 {
-    if (programs.count(programName) == 0) return; // Doesn't exists
+    std::map<std::string, sShaderProgram>::iterator itProgram = programs.find(programName);
+    if (itProgram == programs.end()) return; // Doesn't exists
 
-    currShader = programName;
-    glUseProgram(programs[currShader].ID);
+    use(&itProgram->second);
 }
 
-void cRenderManager::setBool(const std::string& name, bool value)
+void cRenderManager::use(sShaderProgram* program)
+{
+    currProgram = program;
+    BindProgram(currProgram->ID);
+}
+
+void cRenderManager::InvalidateStateCache()
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
+    boundProgramId = 0;
+    boundVAOId = 0;
+    boundObjectChunk = -1;
+    activeTextureUnit = 0;
+    for (unsigned int i = 0; i < MAX_CACHED_TEXTURE_UNITS; i++)
     {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
+        boundTextureIds[i] = 0;
     }
 
-    glUniform1i(programs[currShader].uniformLocations[name], (int)value);
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
 }
 
-void cRenderManager::setInt(const std::string& name, int value)
+void cRenderManager::BindProgram(unsigned int programId)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
-    {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
-    }
+    if (programId == boundProgramId) return;
 
-    glUniform1i(programs[currShader].uniformLocations[name], value);
+    glUseProgram(programId);
+    boundProgramId = programId;
+    frameStats.programBinds++;
 }
 
-void cRenderManager::setFloat(const std::string& name, float value)
+void cRenderManager::BindVAO(unsigned int vaoId)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
-    {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
-    }
+    if (vaoId == boundVAOId) return;
 
-    glUniform1f(programs[currShader].uniformLocations[name], value);
+    glBindVertexArray(vaoId);
+    boundVAOId = vaoId;
+    frameStats.vaoBinds++;
 }
 
-void cRenderManager::setMat4(const std::string& name, const glm::mat4& mat)
+void cRenderManager::BindTexture(unsigned int shaderTextureUnit, unsigned int textureId)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
+    if (shaderTextureUnit < MAX_CACHED_TEXTURE_UNITS && boundTextureIds[shaderTextureUnit] == textureId) return;
+
+    if (shaderTextureUnit != activeTextureUnit)
     {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
+        glActiveTexture(shaderTextureUnit + GL_TEXTURE0); // GL_TEXTURE0 = 33984
+        activeTextureUnit = shaderTextureUnit;
     }
 
-    glUniformMatrix4fv(programs[currShader].uniformLocations[name], 1, GL_FALSE, &mat[0][0]);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    frameStats.textureBinds++;
+
+    if (shaderTextureUnit < MAX_CACHED_TEXTURE_UNITS)
+        boundTextureIds[shaderTextureUnit] = textureId;
 }
 
-void cRenderManager::setVec2(const std::string& name, const glm::vec2& value)
+unsigned int cRenderManager::GetUniformHandle(const std::string& name)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
+    std::map<std::string, unsigned int>::iterator it = uniformHandles.find(name);
+    if (it != uniformHandles.end()) return it->second;
+
+    unsigned int newHandle = (unsigned int)uniformNames.size();
+    uniformHandles.insert(std::pair<std::string, unsigned int>(name, newHandle));
+    uniformNames.push_back(name);
+
+    // Resolve the new name in every program so all location arrays stay the same size
+    for (std::map<std::string, sShaderProgram>::iterator itProgram = programs.begin(); itProgram != programs.end(); itProgram++)
     {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
+        itProgram->second.uniformLocations.push_back(glGetUniformLocation(itProgram->second.ID, name.c_str()));
     }
 
-    glUniform2fv(programs[currShader].uniformLocations[name], 1, &value[0]);
+    return newHandle;
 }
 
-void cRenderManager::setVec3(const std::string& name, const glm::vec3& value)
+void cRenderManager::setBool(const std::string& name, bool value)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
-    {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
-    }
+    setBool(GetUniformHandle(name), value);
+}
+
+void cRenderManager::setInt(const std::string& name, int value)
+{
+    setInt(GetUniformHandle(name), value);
+}
+
+void cRenderManager::setFloat(const std::string& name, float value)
+{
+    setFloat(GetUniformHandle(name), value);
+}
+
+void cRenderManager::setMat4(const std::string& name, const glm::mat4& mat)
+{
+    setMat4(GetUniformHandle(name), mat);
+}
+
+void cRenderManager::setVec2(const std::string& name, const glm::vec2& value)
+{
+    setVec2(GetUniformHandle(name), value);
+}
 
-    glUniform3fv(programs[currShader].uniformLocations[name], 1, &value[0]);
+void cRenderManager::setVec3(const std::string& name, const glm::vec3& value)
+{
+    setVec3(GetUniformHandle(name), value);
 }
 
 void cRenderManager::setVec4(const std::string& name, const glm::vec4& value)
 {
-    if (programs[currShader].uniformLocations.count(name) == 0)
-    {
-        unsigned int newLocation = glGetUniformLocation(programs.at(currShader).ID, name.c_str());
-        programs[currShader].uniformLocations.insert(std::pair<std::string, unsigned int>(name, newLocation));
-    }
+    setVec4(GetUniformHandle(name), value);
+}
+
+void cRenderManager::setBool(unsigned int handle, bool value)
+{
+    if (!currProgram) return;
+
+    glUniform1i(currProgram->uniformLocations[handle], (int)value);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setInt(unsigned int handle, int value)
+{
+    if (!currProgram) return;
+
+    glUniform1i(currProgram->uniformLocations[handle], value);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setFloat(unsigned int handle, float value)
+{
+    if (!currProgram) return;
+
+    glUniform1f(currProgram->uniformLocations[handle], value);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setMat4(unsigned int handle, const glm::mat4& mat)
+{
+    if (!currProgram) return;
+
+    glUniformMatrix4fv(currProgram->uniformLocations[handle], 1, GL_FALSE, &mat[0][0]);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setVec2(unsigned int handle, const glm::vec2& value)
+{
+    if (!currProgram) return;
+
+    glUniform2fv(currProgram->uniformLocations[handle], 1, &value[0]);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setVec3(unsigned int handle, const glm::vec3& value)
+{
+    if (!currProgram) return;
+
+    glUniform3fv(currProgram->uniformLocations[handle], 1, &value[0]);
+    frameStats.uniformUploads++;
+}
+
+void cRenderManager::setVec4(unsigned int handle, const glm::vec4& value)
+{
+    if (!currProgram) return;
 
-    glUniform4fv(programs[currShader].uniformLocations[name], 1, &value[0]);
+    glUniform4fv(currProgram->uniformLocations[handle], 1, &value[0]);
+    frameStats.uniformUploads++;
 }
 
 std::shared_ptr<cRenderModel> cRenderManager::CreateRenderModel(bool isBattleModel)
@@ -636,6 +984,8 @@ std::shared_ptr<cRenderModel> cRenderManager::CreateRenderModel(bool isBattleMod
     else 
         mapModels.push_back(newModel);
 
+    staticShadowGeneration++;
+
     return newModel;
 }
 
@@ -645,8 +995,11 @@ std::shared_ptr<cSpriteModel> cRenderManager::CreateSpriteModel(bool isBattleMod
 
     if (isBattleModel) 
         battleModels.push_back(newModel);
-    else 
+    else
+    {
         mapModels.push_back(newModel);
+        mapSpriteModels.push_back(newModel);
+    }
 
     return newModel;
 }
@@ -676,17 +1029,29 @@ std::shared_ptr<cAnimatedModel> cRenderManager::CreateAnimatedModel(eAnimatedMod
     else
         mapModels.push_back(newModel);
 
+    staticShadowGeneration++;
+
     return newModel;
 }
 
 void cRenderManager::RemoveModel(std::shared_ptr<cRenderModel> model)
 {
+    if (!model->isDynamicShadowCaster) staticShadowGeneration++;
+
     if (Engine::currGameMode == eGameMode::MAP) // TEMP
     {
         std::vector< std::shared_ptr<cRenderModel> >::iterator it = std::find(mapModels.begin(), mapModels.end(), model);
 
         if (it != mapModels.end())
             mapModels.erase(it);
+
+        for (unsigned int i = 0; i < mapSpriteModels.size(); i++)
+        {
+            if (mapSpriteModels[i] != model) continue;
+
+            mapSpriteModels.erase(mapSpriteModels.begin() + i);
+            break;
+        }
     }
     else
     {
@@ -697,63 +1062,501 @@ void cRenderManager::RemoveModel(std::shared_ptr<cRenderModel> model)
     }
 }
 
-unsigned int cRenderManager::CreateTexture(const std::string fullPath, int& width, int& height)
+bool cRenderManager::IsIndirectDrawSupported()
 {
-    // load and generate the texture
-    int nrChannels;
-    unsigned char* data = stbi_load(fullPath.c_str(), &width, &height, &nrChannels, 0);
-    if (!data)
-    {
-        std::cout << "Failed to load texture " << fullPath << std::endl;
-        return 0;
-    }
-
-    unsigned int textureId;
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
-
-    // set the texture wrapping/filtering options (on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-    return textureId;
+    return isIndirectDrawSupported;
 }
 
-void cRenderManager::LoadTexture(const std::string fileName, const std::string subdirectory)
+void cRenderManager::BuildTileBatches(std::vector< std::shared_ptr<cRenderModel> >& tileModels)
 {
-    if (fileName == "") return;
+    ZoneScopedN("BuildTileBatches");
 
-    if (textures.find(fileName) != textures.end()) return; // texture already created
+    ClearTileBatches();
+    staticShadowGeneration++;
 
-    std::string fullPath = TEXTURE_PATH + subdirectory + fileName;
-    int width, height;
-    sTexture newTexture;
-    newTexture.textureId = CreateTexture(fullPath, width, height);
+    if (!isIndirectDrawSupported) return;
 
-    if (newTexture.textureId != 0)
+    // Geometry gathered on the CPU before it's uploaded to the batch buffers
+    struct sBatchData
+    {
+        std::vector<sVertexData> vertices;
+        eVertexLayout vertexLayout; // the least compact layout of its meshes
+        std::vector<unsigned int> indices;
+    };
+    std::vector<sBatchData> batchesData;
+
+    for (unsigned int modelIndex = 0; modelIndex < tileModels.size(); modelIndex++)
+    {
+        std::shared_ptr<cRenderModel> model = tileModels[modelIndex];
+
+        const sMeshEntry* mesh = FindLoadedMesh(model->GetMeshHandle());
+        if (mesh == nullptr) continue;
+
+        cMappedFile cookedFile;
+        sCookedModel importedModel;
+        sCookedModelView geometry;
+        if (!ReadModelGeometry(mesh->fileName, cookedFile, importedModel, geometry) || geometry.meshesNum != mesh->drawInfo.allMeshesData.size()) continue;
+
+        // Tiles never move, so their transform is baked into the batch's copy of the vertices
+        glm::mat4 matModel = CalculateModelMatrix(model.get());
+        glm::mat3 matNormal = glm::transpose(glm::inverse(glm::mat3(matModel)));
+
+        for (unsigned int meshIndex = 0; meshIndex < mesh->drawInfo.allMeshesData.size(); meshIndex++)
+        {
+            const sMeshDrawInfo& meshData = mesh->drawInfo.allMeshesData[meshIndex];
+            unsigned int textureId = model->textureName != "" ? FindTextureId(model->textureName) : FindTextureId(meshData.textureName);
+
+            // One batch per program and texture
+            unsigned int batchIndex = 0;
+            while (batchIndex < tileBatches.size() && (tileBatches[batchIndex].program != mesh->program || tileBatches[batchIndex].textureId != textureId))
+            {
+                batchIndex++;
+            }
+
+            if (batchIndex == tileBatches.size())
+            {
+                sTileBatch newBatch;
+                newBatch.program = mesh->program;
+                newBatch.textureId = textureId;
+                newBatch.uniformsModel = model;
+                newBatch.isDynamicShadowCaster = false;
+                newBatch.areCommandsDirty = true;
+                newBatch.commandsNum = 0;
+                newBatch.shadowCommandsNum = 0;
+                newBatch.mainCommandsNum = 0;
+                tileBatches.push_back(newBatch);
+                batchesData.emplace_back();
+                batchesData.back().vertexLayout = meshData.vertexLayout;
+            }
+
+            sTileBatch& batch = tileBatches[batchIndex];
+            sBatchData& data = batchesData[batchIndex];
+            if (model->isDynamicShadowCaster) batch.isDynamicShadowCaster = true;
+            if (meshData.vertexLayout > data.vertexLayout) data.vertexLayout = meshData.vertexLayout;
+
+            // The model's meshes in this batch share its instance region
+            unsigned int batchModelIndex = 0;
+            while (batchModelIndex < batch.models.size() && batch.models[batchModelIndex].model != model)
+            {
+                batchModelIndex++;
+            }
+
+            if (batchModelIndex == batch.models.size())
+            {
+                // w is the height the mesh's origin was baked to, so shaders can still tell how high up the tile a vertex is
+                sTileBatchModel newBatchModel;
+                newBatchModel.model = model;
+                newBatchModel.firstInstance = 0;
+                newBatchModel.instancesNum = 0;
+                newBatchModel.originHeight = matModel[3].y;
+                batch.models.push_back(newBatchModel);
+            }
+
+            const sCookedMeshRange& range = geometry.meshes[meshIndex];
+            unsigned int firstVertex = (unsigned int)data.vertices.size();
+            data.vertices.insert(data.vertices.end(), geometry.vertices + range.firstVertex, geometry.vertices + range.firstVertex + range.verticesNum);
+
+            sTileBatchMesh newBatchMesh;
+            newBatchMesh.modelIndex = batchModelIndex;
+            newBatchMesh.count = meshData.numberOfIndices;
+            newBatchMesh.firstIndex = (unsigned int)data.indices.size();
+            newBatchMesh.baseVertex = (int)firstVertex;
+            newBatchMesh.boundsMin = glm::vec3(FLT_MAX);
+            newBatchMesh.boundsMax = glm::vec3(-FLT_MAX);
+            for (unsigned int i = firstVertex; i < data.vertices.size(); i++)
+            {
+                sVertexData& vertex = data.vertices[i];
+
+                glm::vec4 position = matModel * glm::vec4(vertex.x, vertex.y, vertex.z, 1.f);
+                vertex.x = position.x;
+                vertex.y = position.y;
+                vertex.z = position.z;
+                newBatchMesh.boundsMin = glm::min(newBatchMesh.boundsMin, glm::vec3(position));
+                newBatchMesh.boundsMax = glm::max(newBatchMesh.boundsMax, glm::vec3(position));
+
+                glm::vec3 normal = matNormal * glm::vec3(vertex.nx, vertex.ny, vertex.nz);
+                vertex.nx = normal.x;
+                vertex.ny = normal.y;
+                vertex.nz = normal.z;
+            }
+            batch.meshes.push_back(newBatchMesh);
+
+            data.indices.insert(data.indices.end(), geometry.indices + range.firstIndex, geometry.indices + range.firstIndex + range.indicesNum);
+        }
+
+        model->isDrawnIndirect = true;
+        tileBatchModels.push_back(model);
+    }
+
+    for (unsigned int batchIndex = 0; batchIndex < tileBatches.size(); batchIndex++)
+    {
+        sTileBatch& batch = tileBatches[batchIndex];
+        sBatchData& data = batchesData[batchIndex];
+
+        glGenVertexArrays(1, &batch.VAO_ID);
+        glBindVertexArray(batch.VAO_ID);
+
+        std::vector<unsigned char> packedVertices(cMeshArena::GetVertexStride(data.vertexLayout) * data.vertices.size());
+        cMeshArena::PackVertices(data.vertexLayout, &data.vertices[0], (unsigned int)data.vertices.size(), &packedVertices[0]);
+
+        glGenBuffers(1, &batch.VBO_ID);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.VBO_ID);
+        glBufferData(GL_ARRAY_BUFFER, packedVertices.size(), &packedVertices[0], GL_STATIC_DRAW);
+
+        cMeshArena::SetupVertexAttributes(data.vertexLayout);
+
+        glGenBuffers(1, &batch.INDEX_ID);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.INDEX_ID);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * data.indices.size(), &data.indices[0], GL_STATIC_DRAW);
+
+        // baseInstance of each command points at its bucket inside its model's region
+        glGenBuffers(1, &batch.instanceBufferId);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferId);
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(3, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        LayoutTileBatchInstances(batch);
+
+        // Filled every frame with the commands that survive culling, sized for both passes then
+        glGenBuffers(1, &batch.indirectBufferId);
+    }
+}
+
+void cRenderManager::LayoutTileBatchInstances(sTileBatch& batch)
+{
+    ZoneScopedN("LayoutTileBatchInstances");
+
+    unsigned int instancesNum = 0;
+    for (unsigned int i = 0; i < batch.models.size(); i++)
+    {
+        batch.models[i].firstInstance = instancesNum;
+        batch.models[i].instancesNum = (unsigned int)batch.models[i].model->instanceOffsets.size();
+        instancesNum += batch.models[i].instancesNum;
+    }
+
+    // Same buffer name, the VAO keeps pointing at it
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * instancesNum, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (unsigned int i = 0; i < batch.models.size(); i++)
+    {
+        UploadTileBatchInstances(batch, i, 0, batch.models[i].instancesNum);
+    }
+
+    batch.areCommandsDirty = true;
+}
+
+void cRenderManager::UploadTileBatchInstances(sTileBatch& batch, unsigned int modelIndex, unsigned int firstInstance, unsigned int instancesNum)
+{
+    if (instancesNum == 0) return;
+
+    const sTileBatchModel& batchModel = batch.models[modelIndex];
+    std::vector<glm::vec4>::const_iterator first = batchModel.model->instanceOffsets.begin() + firstInstance;
+    std::vector<glm::vec4> offsets(first, first + instancesNum);
+    for (unsigned int i = 0; i < offsets.size(); i++)
+    {
+        offsets[i].w = batchModel.originHeight;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * (batchModel.firstInstance + firstInstance), sizeof(glm::vec4) * instancesNum, &offsets[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cRenderManager::BuildTileBatchCommands(sTileBatch& batch)
+{
+    batch.commands.clear();
+    batch.commandsBoundsMin.clear();
+    batch.commandsBoundsMax.clear();
+
+    for (unsigned int meshIndex = 0; meshIndex < batch.meshes.size(); meshIndex++)
+    {
+        const sTileBatchMesh& mesh = batch.meshes[meshIndex];
+        const sTileBatchModel& batchModel = batch.models[mesh.modelIndex];
+        const std::vector<sInstanceBucket>& buckets = batchModel.model->instanceBuckets;
+
+        for (unsigned int bucketIndex = 0; bucketIndex < buckets.size(); bucketIndex++)
+        {
+            sDrawElementsIndirectCommand newCommand;
+            newCommand.count = mesh.count;
+            newCommand.instanceCount = buckets[bucketIndex].instancesNum;
+            newCommand.firstIndex = mesh.firstIndex;
+            newCommand.baseVertex = mesh.baseVertex;
+            newCommand.baseInstance = batchModel.firstInstance + buckets[bucketIndex].firstInstance;
+            batch.commands.push_back(newCommand);
+
+            batch.commandsBoundsMin.push_back(mesh.boundsMin + buckets[bucketIndex].offsetsMin);
+            batch.commandsBoundsMax.push_back(mesh.boundsMax + buckets[bucketIndex].offsetsMax);
+        }
+    }
+
+    // A model with instances, the first one's timers might not be running yet
+    for (unsigned int i = 0; i < batch.models.size(); i++)
+    {
+        if (batch.models[i].model->instanceBuckets.empty()) continue;
+
+        batch.uniformsModel = batch.models[i].model;
+        break;
+    }
+
+    batch.commandsNum = (unsigned int)batch.commands.size();
+    batch.areCommandsDirty = false;
+}
+
+void cRenderManager::SetTileInstances(std::shared_ptr<cRenderModel> model, int key, const std::vector<glm::vec4>& offsets)
+{
+    model->SetInstanceBucket(key, offsets);
+    if (!model->isDynamicShadowCaster) staticShadowGeneration++;
+
+    if (!model->isDrawnIndirect) return;
+
+    const sInstanceBucket* bucket = model->FindInstanceBucket(key);
+    for (unsigned int batchIndex = 0; batchIndex < tileBatches.size(); batchIndex++)
+    {
+        sTileBatch& batch = tileBatches[batchIndex];
+        for (unsigned int i = 0; i < batch.models.size(); i++)
+        {
+            if (batch.models[i].model != model) continue;
+
+            // Its buffer grew past the region, the other models move along with it
+            if (model->instanceOffsets.size() > batch.models[i].instancesNum)
+                LayoutTileBatchInstances(batch);
+            else if (bucket)
+                UploadTileBatchInstances(batch, i, bucket->firstInstance, bucket->instancesNum);
+
+            batch.areCommandsDirty = true;
+            break;
+        }
+    }
+}
+
+void cRenderManager::RemoveTileInstances(std::shared_ptr<cRenderModel> model, int key)
+{
+    model->RemoveInstanceBucket(key);
+    if (!model->isDynamicShadowCaster) staticShadowGeneration++;
+
+    if (!model->isDrawnIndirect) return;
+
+    // The range is left as it is, only the commands stop pointing at it
+    for (unsigned int batchIndex = 0; batchIndex < tileBatches.size(); batchIndex++)
+    {
+        sTileBatch& batch = tileBatches[batchIndex];
+        for (unsigned int i = 0; i < batch.models.size(); i++)
+        {
+            if (batch.models[i].model != model) continue;
+
+            batch.areCommandsDirty = true;
+            break;
+        }
+    }
+}
+
+void cRenderManager::ClearTileBatches()
+{
+    for (unsigned int i = 0; i < tileBatches.size(); i++)
+    {
+        glDeleteVertexArrays(1, &tileBatches[i].VAO_ID);
+        glDeleteBuffers(1, &tileBatches[i].VBO_ID);
+        glDeleteBuffers(1, &tileBatches[i].INDEX_ID);
+        glDeleteBuffers(1, &tileBatches[i].instanceBufferId);
+        glDeleteBuffers(1, &tileBatches[i].indirectBufferId);
+    }
+    tileBatches.clear();
+
+    for (unsigned int i = 0; i < tileBatchModels.size(); i++)
+    {
+        tileBatchModels[i]->isDrawnIndirect = false;
+    }
+    tileBatchModels.clear();
+    staticShadowGeneration++;
+}
+
+void cRenderManager::CullTileBatches()
+{
+    if (!useIndirectTiles || tileBatches.empty()) return;
+
+    ZoneScopedN("CullTileBatches");
+
+    for (unsigned int batchIndex = 0; batchIndex < tileBatches.size(); batchIndex++)
+    {
+        sTileBatch& batch = tileBatches[batchIndex];
+        if (batch.areCommandsDirty) BuildTileBatchCommands(batch);
+
+        culler.Clear();
+        for (unsigned int i = 0; i < batch.commandsNum; i++)
+        {
+            culler.AddBox(batch.commandsBoundsMin[i], batch.commandsBoundsMax[i]);
+        }
+
+        if (useFrustumCulling)
+        {
+            culler.Cull(shadowFrustum, shadowVisibility);
+            culler.Cull(cameraFrustum, passVisibility);
+        }
+        else
+        {
+            shadowVisibility.assign(batch.commandsNum, 1);
+            passVisibility.assign(batch.commandsNum, 1);
+        }
+
+        visibleTileCommands.clear();
+        for (unsigned int i = 0; i < batch.commandsNum; i++)
+        {
+            if (shadowVisibility[i]) visibleTileCommands.push_back(batch.commands[i]);
+        }
+        batch.shadowCommandsNum = (unsigned int)visibleTileCommands.size();
+
+        for (unsigned int i = 0; i < batch.commandsNum; i++)
+        {
+            if (passVisibility[i]) visibleTileCommands.push_back(batch.commands[i]);
+        }
+        batch.mainCommandsNum = (unsigned int)visibleTileCommands.size() - batch.shadowCommandsNum;
+
+        frameStats.instanceBucketsVisible += (unsigned int)visibleTileCommands.size();
+        frameStats.instanceBucketsCulled += batch.commandsNum * 2 - (unsigned int)visibleTileCommands.size();
+
+        if (visibleTileCommands.empty()) continue;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBufferId);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(sDrawElementsIndirectCommand) * batch.commandsNum * 2, NULL, GL_STREAM_DRAW); // orphan last frame's commands
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(sDrawElementsIndirectCommand) * visibleTileCommands.size(), &visibleTileCommands[0]);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void cRenderManager::DrawTileBatches(eRenderPass pass, eShadowCasters casters)
+{
+    if (!useIndirectTiles || tileBatches.empty()) return;
+
+    ZoneScopedN("DrawTileBatches");
+
+    BindTexture(1, depthMapID);
+
+    for (unsigned int i = 0; i < tileBatches.size(); i++)
+    {
+        sTileBatch& batch = tileBatches[i];
+        if (casters == STATIC_CASTERS && batch.isDynamicShadowCaster) continue;
+        if (casters == DYNAMIC_CASTERS && !batch.isDynamicShadowCaster) continue;
+
+        unsigned int commandsNum = pass == SHADOW_PASS ? batch.shadowCommandsNum : batch.mainCommandsNum;
+        if (commandsNum == 0) continue;
+
+        size_t firstCommandOffset = pass == SHADOW_PASS ? 0 : batch.shadowCommandsNum * sizeof(sDrawElementsIndirectCommand);
+
+        use(batch.program);
+        SetupModelUniforms(batch.uniformsModel.get(), identityObjectIndex);
+        BindTexture(0, batch.textureId);
+
+        BindVAO(batch.VAO_ID);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBufferId);
+        glMultiDrawElementsIndirectPtr(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)firstCommandOffset, commandsNum, 0);
+        frameStats.drawCalls++;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+sDecodedImage::~sDecodedImage()
+{
+    if (pixels) stbi_image_free(pixels);
+}
+
+bool cRenderManager::DecodeImage(const std::string& fullPath, sDecodedImage& imageOut)
+{
+    ZoneScopedN("DecodeImage");
+
+    // Always expanded to RGBA, that's what the upload expects
+    int channelsNum;
+    imageOut.pixels = stbi_load(fullPath.c_str(), &imageOut.width, &imageOut.height, &channelsNum, STBI_rgb_alpha);
+    return imageOut.pixels != nullptr;
+}
+
+unsigned int cRenderManager::UploadTexture(const sDecodedImage& image, unsigned int textureId)
+{
+    ZoneScopedN("UploadTexture");
+
+    if (textureId == 0)
+        glGenTextures(1, &textureId);
+
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    if (activeTextureUnit < MAX_CACHED_TEXTURE_UNITS)
+        boundTextureIds[activeTextureUnit] = textureId;
+
+    // set the texture wrapping/filtering options (on the currently bound texture object)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // set texture filtering parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    return textureId;
+}
+
+unsigned int cRenderManager::CreateTexture(const std::string fullPath, int& width, int& height)
+{
+    // load and generate the texture
+    sDecodedImage image;
+    if (!DecodeImage(fullPath, image))
+    {
+        std::cout << "Failed to load texture " << fullPath << std::endl;
+        return 0;
+    }
+
+    width = image.width;
+    height = image.height;
+    return UploadTexture(image);
+}
+
+void cRenderManager::LoadTexture(const std::string fileName, const std::string subdirectory)
+{
+    if (fileName == "") return;
+
+    if (assetCache.Acquire(ASSET_TEXTURE, fileName)) return; // texture already created
+
+    std::string fullPath = TEXTURE_PATH + subdirectory + fileName;
+    sTexture newTexture;
+    newTexture.textureId = CreateTexture(fullPath, newTexture.width, newTexture.height);
+
+    if (newTexture.textureId != 0)
     {
         textures.insert(std::pair<std::string, sTexture>(fileName, newTexture));
+        assetCache.Add(ASSET_TEXTURE, fileName, GetTextureBytes(newTexture.width, newTexture.height));
     }
 }
 
+void cRenderManager::ReleaseTexture(const std::string& fileName)
+{
+    if (fileName == "") return;
+
+    assetCache.Release(ASSET_TEXTURE, fileName);
+}
+
 void cRenderManager::UnloadTextures()
 {
     for (std::map<std::string, sTexture>::iterator it = textures.begin(); it != textures.end(); it++)
     {
         glDeleteTextures(1, &it->second.textureId);
+        assetCache.Remove(ASSET_TEXTURE, it->first);
     }
     textures.clear();
 
     for (std::map<std::string, sSpriteSheet>::iterator it = spriteSheets.begin(); it != spriteSheets.end(); it++)
     {
+        RemoveFromSpriteArray(it->second);
         glDeleteTextures(1, &it->second.textureId);
+        assetCache.Remove(ASSET_SPRITE_SHEET, it->first);
     }
     spriteSheets.clear();
 }
@@ -800,55 +1603,119 @@ void cRenderManager::LoadRoamingPokemonFormSpriteSheet(const int nationalDexId,
     textureName = textureName + ".png";
 
     // Check if not already loaded
-    if (spriteSheets.find(textureName) != spriteSheets.end()) return;
+    if (assetCache.Acquire(ASSET_SPRITE_SHEET, textureName))
+    {
+        // The shiny one is loaded along with it, take a reference on it too
+        assetCache.Acquire(ASSET_SPRITE_SHEET, shinyTextureName);
+        return;
+    }
 
     std::string dexIdString = Pokemon::MakeDexNumberFolderName(nationalDexId);
     std::string texturePath = PKM_DATA_PATH + dexIdString + "/";
 
-    // Create sprite sheet
-    sSpriteSheet newSheet;
-    newSheet.numCols = 4;
-    newSheet.numRows = 4;
-    newSheet.isSymmetrical = false;
-
-    std::string fullPath = texturePath + textureName;
-    int width, height;
-    newSheet.textureId = CreateTexture(fullPath, width, height);
-
-    if (newSheet.textureId != 0)
-        spriteSheets.insert(std::pair<std::string, sSpriteSheet>(textureName, newSheet));
+    CreateSpriteSheet(textureName, texturePath + textureName, 4, 4, false);
 
     // Check if shiny not already loaded
-    if (spriteSheets.find(shinyTextureName) != spriteSheets.end()) return;
+    if (assetCache.Acquire(ASSET_SPRITE_SHEET, shinyTextureName)) return;
 
-    // Create shiny sprite sheet
-    sSpriteSheet newShinySheet;
-    newShinySheet.numCols = 4;
-    newShinySheet.numRows = 4;
-    newShinySheet.isSymmetrical = false;
+    CreateSpriteSheet(shinyTextureName, texturePath + shinyTextureName, 4, 4, false);
+}
 
-    std::string shinyFullPath = texturePath + shinyTextureName;
-    newShinySheet.textureId = CreateTexture(shinyFullPath, width, height);
+void cRenderManager::ReleaseRoamingPokemonFormSpriteSheet(const int nationalDexId, const std::string formTag)
+{
+    std::string textureName = std::to_string(nationalDexId);
+    if (formTag != "")
+    {
+        textureName = textureName + "_" + formTag;
+    }
 
-    if (newShinySheet.textureId != 0)
-        spriteSheets.insert(std::pair<std::string, sSpriteSheet>(shinyTextureName, newShinySheet));
+    ReleaseSpriteSheet(textureName + ".png");
+    ReleaseSpriteSheet(textureName + "_s.png");
 }
 
 void cRenderManager::LoadSpriteSheet(const std::string spriteSheetName, unsigned int cols, unsigned int rows, bool sym, const std::string subdirectory)
 {
-    if (spriteSheets.count(spriteSheetName)) return; // texture already created
+    if (assetCache.Acquire(ASSET_SPRITE_SHEET, spriteSheetName)) return; // texture already created
+
+    CreateSpriteSheet(spriteSheetName, TEXTURE_PATH + subdirectory + spriteSheetName, cols, rows, sym);
+}
+
+void cRenderManager::ReleaseSpriteSheet(const std::string& sheetName)
+{
+    if (sheetName == "") return;
 
+    assetCache.Release(ASSET_SPRITE_SHEET, sheetName);
+}
+
+void cRenderManager::CreateSpriteSheet(const std::string& sheetName, const std::string& fullPath, unsigned int cols, unsigned int rows, bool sym)
+{
     sSpriteSheet newSheet;
     newSheet.numCols = cols;
     newSheet.numRows = rows;
     newSheet.isSymmetrical = sym;
 
-    std::string fullPath = TEXTURE_PATH + subdirectory + spriteSheetName;
-    int width, height;
-    newSheet.textureId = CreateTexture(fullPath, width, height);
+    if (!useAsyncTextureLoading)
+    {
+        sDecodedImage image;
+        if (!DecodeImage(fullPath, image))
+        {
+            std::cout << "Failed to load texture " << fullPath << std::endl;
+            return;
+        }
+
+        newSheet.textureId = UploadTexture(image);
+        newSheet.width = image.width;
+        newSheet.height = image.height;
+        AddToSpriteArray(newSheet, image);
+
+        spriteSheets[sheetName] = newSheet;
+        assetCache.Add(ASSET_SPRITE_SHEET, sheetName, GetTextureBytes(newSheet.width, newSheet.height));
+        return;
+    }
 
-    if (newSheet.textureId != 0)
-        spriteSheets[spriteSheetName] = newSheet;
+    // The texture exists right away with a placeholder pixel, so it can be bound before the image is decoded
+    newSheet.textureId = 0;
+    glGenTextures(1, &newSheet.textureId);
+    glBindTexture(GL_TEXTURE_2D, newSheet.textureId);
+    if (activeTextureUnit < MAX_CACHED_TEXTURE_UNITS)
+        boundTextureIds[activeTextureUnit] = newSheet.textureId;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholderPixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    newSheet.width = 1;
+    newSheet.height = 1;
+
+    spriteSheets[sheetName] = newSheet;
+    assetCache.Add(ASSET_SPRITE_SHEET, sheetName, GetTextureBytes(1, 1));
+    pendingTextureLoadsNum++;
+
+    unsigned int textureId = newSheet.textureId;
+    std::shared_ptr<sDecodedImage> image = std::make_shared<sDecodedImage>();
+    Manager::jobs.Submit(
+        [fullPath, image]()
+        {
+            DecodeImage(fullPath, *image);
+        },
+        [this, sheetName, fullPath, textureId, image]()
+        {
+            pendingTextureLoadsNum--;
+
+            // Unloaded or evicted before it finished
+            std::map<std::string, sSpriteSheet>::iterator itSheet = spriteSheets.find(sheetName);
+            if (itSheet == spriteSheets.end() || itSheet->second.textureId != textureId) return;
+
+            if (!image->pixels)
+            {
+                std::cout << "Failed to load texture " << fullPath << std::endl;
+                return;
+            }
+
+            UploadTexture(*image, textureId);
+            itSheet->second.width = image->width;
+            itSheet->second.height = image->height;
+            AddToSpriteArray(itSheet->second, *image);
+            assetCache.Resize(ASSET_SPRITE_SHEET, sheetName, GetTextureBytes(image->width, image->height));
+        });
 }
 
 void cRenderManager::LoadRoamingPokemonSpecieTextures(const Pokemon::sSpeciesData& specieData)
@@ -871,93 +1738,486 @@ void cRenderManager::LoadRoamingPokemonSpecieTextures(const Pokemon::sSpeciesDat
     }
 }
 
+void cRenderManager::ReleaseRoamingPokemonSpecieTextures(const Pokemon::sSpeciesData& specieData)
+{
+    ReleaseRoamingPokemonFormSpriteSheet(specieData.nationalDexNumber);
+
+    if (specieData.isSpriteGenderBased || specieData.isFormGenderBased)
+    {
+        ReleaseRoamingPokemonFormSpriteSheet(specieData.nationalDexNumber, "f");
+    }
+    else
+    {
+        for (std::map<std::string, Pokemon::sForm>::const_iterator it = specieData.alternateForms.cbegin(); it != specieData.alternateForms.cend(); it++)
+        {
+            ReleaseRoamingPokemonFormSpriteSheet(specieData.nationalDexNumber, it->first);
+        }
+    }
+}
+
 float cRenderManager::LoadPokemonBattleSpriteSheet(Pokemon::sIndividualData& data, bool isFront)
 {
     std::string textureName = data.MakeBattleTextureName(isFront);
 
-    if (textures.find(textureName) != textures.end()) return 1.f; // already loaded
+    // Kept as a sprite sheet, the aspect ratio is worked out again from its size
+    if (assetCache.Acquire(ASSET_SPRITE_SHEET, textureName))
+    {
+        const sSpriteSheet& loadedSheet = spriteSheets[textureName];
+        return (float)loadedSheet.width / loadedSheet.numCols / loadedSheet.height;
+    }
+
+    std::string dexIdString = std::to_string(data.nationalDexNumber);
+    while (dexIdString.length() < 4)
+    {
+        dexIdString = "0" + dexIdString;
+    }
+    std::string texturePath = PKM_DATA_PATH + dexIdString + "/";
+
+    std::string fullPath = texturePath + textureName;
+    sSpriteSheet newSpriteSheet;
+    newSpriteSheet.numRows = 1;
+    newSpriteSheet.numCols = isFront ? data.form.battleFrontSpriteFrameCount : data.form.battleBackSpriteFrameCount;
+
+    newSpriteSheet.textureId = CreateTexture(fullPath, newSpriteSheet.width, newSpriteSheet.height);
+
+    spriteSheets.insert(std::pair<std::string, sSpriteSheet>(textureName, newSpriteSheet));
+    assetCache.Add(ASSET_SPRITE_SHEET, textureName, GetTextureBytes(newSpriteSheet.width, newSpriteSheet.height));
+
+    return (float)newSpriteSheet.width / newSpriteSheet.numCols / newSpriteSheet.height;
+}
+
+void cRenderManager::SetupSpriteSheet(const std::string& sheetName, const int spriteId, const unsigned int shaderTextureUnit)
+{
+    const sSpriteSheet& sheet = spriteSheets[sheetName];
+
+    static const unsigned int spriteIdHandle = GetUniformHandle("spriteId");
+    static const unsigned int numColsHandle = GetUniformHandle("numCols");
+    static const unsigned int numRowsHandle = GetUniformHandle("numRows");
+
+    setInt(spriteIdHandle, spriteId);
+    setInt(numColsHandle, sheet.numCols);
+    setInt(numRowsHandle, sheet.numRows);
+
+    BindTexture(shaderTextureUnit, sheet.textureId);
+
+    if (shaderTextureUnit < MAX_CACHED_TEXTURE_UNITS)
+        setInt(textureUnitHandles[shaderTextureUnit], shaderTextureUnit);
+    else
+        setInt("texture_" + std::to_string(shaderTextureUnit), shaderTextureUnit);
+}
+
+void cRenderManager::SetupTexture(const std::string& textureToSetup, const unsigned int shaderTextureUnit)
+{
+    std::map<std::string, sTexture>::iterator itTexture = textures.find(textureToSetup);
+    if (itTexture == textures.end())
+    {
+        std::cout << "Failed to setup texture: " << textureToSetup << std::endl;
+        return; // texture doesn't exists
+    }
+
+    BindTexture(shaderTextureUnit, itTexture->second.textureId);
+
+    if (shaderTextureUnit < MAX_CACHED_TEXTURE_UNITS)
+        setInt(textureUnitHandles[shaderTextureUnit], shaderTextureUnit);
+    else
+        setInt("texture_" + std::to_string(shaderTextureUnit), shaderTextureUnit);
+}
+
+unsigned int cRenderManager::FindTextureId(const std::string& textureName)
+{
+    std::map<std::string, sTexture>::iterator itTexture = textures.find(textureName);
+    if (itTexture != textures.end()) return itTexture->second.textureId;
+
+    std::map<std::string, sSpriteSheet>::iterator itSheet = spriteSheets.find(textureName);
+    if (itSheet != spriteSheets.end()) return itSheet->second.textureId;
+
+    return 0;
+}
+
+unsigned int cRenderManager::FindSpriteArray(int layerSize)
+{
+    unsigned int arrayIndex = 0;
+    while (arrayIndex < spriteArrays.size() && spriteArrays[arrayIndex].layerSize < layerSize)
+    {
+        arrayIndex++;
+    }
+    if (arrayIndex < spriteArrays.size() && spriteArrays[arrayIndex].layerSize == layerSize) return arrayIndex;
+
+    sSpriteArray newArray;
+    newArray.textureId = 0;
+    newArray.layerSize = layerSize;
+    newArray.layersNum = 0;
+    newArray.firstInstance = 0;
+    newArray.instancesNum = 0;
+    spriteArrays.insert(spriteArrays.begin() + arrayIndex, newArray);
+
+    // Sheets keep the index of their array
+    for (std::map<std::string, sSpriteSheet>::iterator it = spriteSheets.begin(); it != spriteSheets.end(); it++)
+    {
+        if (it->second.arrayIndex >= (int)arrayIndex) it->second.arrayIndex++;
+    }
+
+    return arrayIndex;
+}
+
+void cRenderManager::GrowSpriteArray(sSpriteArray& spriteArray)
+{
+    ZoneScopedN("GrowSpriteArray");
+
+    unsigned int newLayersNum = spriteArray.layersNum == 0 ? SPRITE_ARRAY_START_LAYERS : spriteArray.layersNum * 2;
+
+    // Sprites are filtered with GL_NEAREST so there are no mipmaps
+    unsigned int newTextureId;
+    glGenTextures(1, &newTextureId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, newTextureId);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, spriteArray.layerSize, spriteArray.layerSize, newLayersNum, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Copy the old layers on the GPU, the sheets' pixels are long gone
+    if (spriteArray.textureId != 0)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, spriteCopyFBO);
+        for (unsigned int layer = 0; layer < spriteArray.layersNum; layer++)
+        {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, spriteArray.textureId, 0, layer);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0, spriteArray.layerSize, spriteArray.layerSize);
+        }
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        glDeleteTextures(1, &spriteArray.textureId);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    for (unsigned int layer = newLayersNum; layer > spriteArray.layersNum; layer--)
+    {
+        spriteArray.freeLayers.push_back(layer - 1); // lowest layers are handed out first
+    }
+
+    spriteArray.textureId = newTextureId;
+    spriteArray.layersNum = newLayersNum;
+}
+
+void cRenderManager::AddToSpriteArray(sSpriteSheet& sheet, const sDecodedImage& image)
+{
+    if (sheet.arrayIndex != -1) return;
+
+    int layerSize = SPRITE_ARRAY_MIN_LAYER_SIZE;
+    while (layerSize < image.width || layerSize < image.height)
+    {
+        layerSize *= 2;
+    }
+    if (layerSize > SPRITE_ARRAY_MAX_LAYER_SIZE) return;
+
+    ZoneScopedN("AddToSpriteArray");
+
+    unsigned int arrayIndex = FindSpriteArray(layerSize);
+    sSpriteArray& spriteArray = spriteArrays[arrayIndex];
+    if (spriteArray.freeLayers.empty())
+        GrowSpriteArray(spriteArray);
+
+    sheet.arrayIndex = arrayIndex;
+    sheet.arrayLayer = spriteArray.freeLayers.back();
+    spriteArray.freeLayers.pop_back();
+
+    // The sheet sits in the layer's corner, whatever is left of the layer is never sampled
+    glBindTexture(GL_TEXTURE_2D_ARRAY, spriteArray.textureId);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, sheet.arrayLayer, image.width, image.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void cRenderManager::RemoveFromSpriteArray(sSpriteSheet& sheet)
+{
+    if (sheet.arrayIndex == -1) return;
+
+    spriteArrays[sheet.arrayIndex].freeLayers.push_back(sheet.arrayLayer);
+    sheet.arrayIndex = -1;
+    sheet.arrayLayer = -1;
+}
+
+void cRenderManager::BuildSpriteBatch()
+{
+    ZoneScopedN("BuildSpriteBatch");
+
+    spriteInstances.clear();
+    spriteBatchMesh = INVALID_MESH_HANDLE;
+
+    for (unsigned int i = 0; i < spriteArrays.size(); i++)
+    {
+        spriteArrays[i].instancesNum = 0;
+    }
+
+    // Sorted by array so each one draws a contiguous range, the counts come first
+    std::vector<int> instanceArrays(mapSpriteModels.size(), -1);
+    for (unsigned int i = 0; i < mapSpriteModels.size(); i++)
+    {
+        cSpriteModel* model = mapSpriteModels[i].get();
+        model->isInSpriteBatch = false;
+        if (!useSpriteArray || model->isInstanced || model->useWholeColor) continue;
+        if (model->visiblePasses == 0) continue; // one instance buffer for both passes, kept if either sees it
+
+        // Only the rotation around y is an instance attribute
+        if (model->orientation.x != 0.f || model->orientation.z != 0.f) continue;
+
+        std::map<std::string, sSpriteSheet>::iterator itSheet = spriteSheets.find(model->textureName);
+        if (itSheet == spriteSheets.end() || itSheet->second.arrayIndex == -1) continue;
+
+        // Every sprite shares the same draws, so they all have to be the same mesh
+        MeshHandle meshHandle = model->GetMeshHandle();
+        if (spriteBatchMesh == INVALID_MESH_HANDLE)
+        {
+            if (FindLoadedMesh(meshHandle) == nullptr) continue;
+            spriteBatchMesh = meshHandle;
+        }
+        else if (meshHandle != spriteBatchMesh) continue;
+
+        instanceArrays[i] = itSheet->second.arrayIndex;
+        spriteArrays[instanceArrays[i]].instancesNum++;
+        model->isInSpriteBatch = true;
+    }
+
+    unsigned int instancesNum = 0;
+    for (unsigned int i = 0; i < spriteArrays.size(); i++)
+    {
+        spriteArrays[i].firstInstance = instancesNum;
+        instancesNum += spriteArrays[i].instancesNum;
+        spriteArrays[i].instancesNum = 0;
+    }
+
+    if (instancesNum == 0) return;
+
+    spriteInstances.resize(instancesNum);
+    for (unsigned int i = 0; i < mapSpriteModels.size(); i++)
+    {
+        if (instanceArrays[i] == -1) continue;
+
+        cSpriteModel* model = mapSpriteModels[i].get();
+        const sSpriteSheet& sheet = spriteSheets[model->textureName];
+        sSpriteArray& spriteArray = spriteArrays[instanceArrays[i]];
+
+        sSpriteInstance& instance = spriteInstances[spriteArray.firstInstance + spriteArray.instancesNum];
+        instance.position = glm::vec4(model->position, model->orientation.y);
+        instance.scale = glm::vec4(model->scale, 0.f);
+        instance.sheetExtent = glm::vec4((float)sheet.width / spriteArray.layerSize, (float)sheet.height / spriteArray.layerSize, 0.f, 0.f);
+        instance.sprite = glm::ivec4(model->currSpriteId, sheet.arrayLayer, sheet.numCols, sheet.numRows);
+        spriteArray.instancesNum++;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, spriteInstanceBufferId);
+    if (spriteInstances.size() > spriteInstanceCapacity)
+        spriteInstanceCapacity = (unsigned int)spriteInstances.size() * 2;
+
+    glBufferData(GL_ARRAY_BUFFER, spriteInstanceCapacity * sizeof(sSpriteInstance), NULL, GL_STREAM_DRAW); // orphan last frame's data
+    glBufferSubData(GL_ARRAY_BUFFER, 0, spriteInstances.size() * sizeof(sSpriteInstance), &spriteInstances[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cRenderManager::DrawSpriteBatch()
+{
+    if (spriteInstances.empty()) return;
+
+    ZoneScopedN("DrawSpriteBatch");
+
+    const sMeshEntry* mesh = FindLoadedMesh(spriteBatchMesh);
+    if (mesh == nullptr) return;
+
+    const sModelDrawInfo& drawInfo = mesh->drawInfo;
+
+    use("spriteArray");
+
+    BindTexture(1, depthMapID);
+
+    for (unsigned int arrayIndex = 0; arrayIndex < spriteArrays.size(); arrayIndex++)
+    {
+        const sSpriteArray& spriteArray = spriteArrays[arrayIndex];
+        if (spriteArray.instancesNum == 0) continue;
+
+        // The state cache only tracks 2D textures, the array target is bound directly
+        if (activeTextureUnit != SPRITE_ARRAY_TEXTURE_UNIT)
+        {
+            glActiveTexture(GL_TEXTURE0 + SPRITE_ARRAY_TEXTURE_UNIT);
+            activeTextureUnit = SPRITE_ARRAY_TEXTURE_UNIT;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, spriteArray.textureId);
+        frameStats.textureBinds++;
+
+        // No base instance in 3.3, the attributes start at the array's range instead
+        size_t instancesOffset = spriteArray.firstInstance * sizeof(sSpriteInstance);
+
+        for (unsigned int i = 0; i < drawInfo.allMeshesData.size(); i++)
+        {
+            BindVAO(drawInfo.allMeshesData[i].VAO_ID);
+
+            glBindBuffer(GL_ARRAY_BUFFER, spriteInstanceBufferId);
+            for (unsigned int attribute = 3; attribute <= 5; attribute++)
+            {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribPointer(attribute, 4,
+                    GL_FLOAT, GL_FALSE,
+                    sizeof(sSpriteInstance),
+                    (void*)(instancesOffset + (attribute - 3) * sizeof(glm::vec4)));
+                glVertexAttribDivisor(attribute, 1);
+            }
+            glEnableVertexAttribArray(6);
+            glVertexAttribIPointer(6, 4,
+                GL_INT,
+                sizeof(sSpriteInstance),
+                (void*)(instancesOffset + offsetof(sSpriteInstance, sprite)));
+            glVertexAttribDivisor(6, 1);
+
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                drawInfo.allMeshesData[i].numberOfIndices,
+                GL_UNSIGNED_INT,
+                (void*)(sizeof(unsigned int) * drawInfo.allMeshesData[i].firstIndex),
+                spriteArray.instancesNum,
+                drawInfo.allMeshesData[i].baseVertex);
+            frameStats.drawCalls++;
+
+            // The arena VAO is shared with every mesh of its layout, only location 3 is set up by the other draws
+            glDisableVertexAttribArray(4);
+            glDisableVertexAttribArray(5);
+            glDisableVertexAttribArray(6);
+        }
+    }
+}
+
+unsigned int cRenderManager::GetSpriteLayersUsed()
+{
+    unsigned int layersUsed = 0;
+    for (unsigned int i = 0; i < spriteArrays.size(); i++)
+    {
+        layersUsed += spriteArrays[i].layersNum - (unsigned int)spriteArrays[i].freeLayers.size();
+    }
+    return layersUsed;
+}
+
+unsigned int cRenderManager::GetSpriteArraysNum()
+{
+    return (unsigned int)spriteArrays.size();
+}
+
+unsigned int cRenderManager::GetSpriteBatchSize()
+{
+    return (unsigned int)spriteInstances.size();
+}
+
+glm::mat4 cRenderManager::CalculateModelMatrix(cRenderModel* model)
+{
+    glm::mat4 matModel = glm::translate(glm::mat4(1.f), model->position);
+    matModel = glm::rotate(matModel, model->orientation.z, glm::vec3(0.f, 0.f, 1.f));
+    matModel = glm::rotate(matModel, model->orientation.y, glm::vec3(0.f, 1.f, 0.f));
+    matModel = glm::rotate(matModel, model->orientation.x, glm::vec3(1.f, 0.f, 0.f));
+    matModel = glm::scale(matModel, model->scale);
+
+    return matModel;
+}
+
+void cRenderManager::UploadObjectTransforms(std::vector< std::shared_ptr<cRenderModel> >& models)
+{
+    ZoneScopedN("UploadObjectTransforms");
+
+    objectTransforms.resize(models.size() + 1);
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        cRenderModel* model = models[i].get();
+        glm::mat4 matModel = CalculateModelMatrix(model);
+
+        objectTransforms[i].model = matModel;
+        objectTransforms[i].normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(matModel))));
+
+        // World bounds come out of the same matrix, the box is transformed as a center and extents
+        const sMeshEntry* mesh = FindLoadedMesh(model->GetMeshHandle());
+        if (mesh == nullptr)
+        {
+            model->worldBoundsMin = glm::vec3(-FLT_MAX);
+            model->worldBoundsMax = glm::vec3(FLT_MAX);
+            continue;
+        }
+
+        glm::vec3 localCenter = (mesh->drawInfo.boundsMin + mesh->drawInfo.boundsMax) * 0.5f;
+        glm::vec3 localExtents = (mesh->drawInfo.boundsMax - mesh->drawInfo.boundsMin) * 0.5f;
+
+        glm::mat3 absRotationScale = glm::mat3(glm::abs(glm::vec3(matModel[0])), glm::abs(glm::vec3(matModel[1])), glm::abs(glm::vec3(matModel[2])));
+        glm::vec3 worldCenter = glm::vec3(matModel * glm::vec4(localCenter, 1.f));
+        glm::vec3 worldExtents = absRotationScale * localExtents;
 
-    std::string dexIdString = std::to_string(data.nationalDexNumber);
-    while (dexIdString.length() < 4)
-    {
-        dexIdString = "0" + dexIdString;
+        model->worldBoundsMin = worldCenter - worldExtents;
+        model->worldBoundsMax = worldCenter + worldExtents;
+
+        if (model->isInstanced)
+        {
+            model->worldBoundsMin += model->instanceOffsetsMin;
+            model->worldBoundsMax += model->instanceOffsetsMax;
+        }
     }
-    std::string texturePath = PKM_DATA_PATH + dexIdString + "/";
 
-    std::string fullPath = texturePath + textureName;
-    sSpriteSheet newSpriteSheet;
-    newSpriteSheet.numRows = 1;
-    newSpriteSheet.numCols = isFront ? data.form.battleFrontSpriteFrameCount : data.form.battleBackSpriteFrameCount;
+    identityObjectIndex = (unsigned int)models.size();
+    objectTransforms[identityObjectIndex].model = glm::mat4(1.f);
+    objectTransforms[identityObjectIndex].normal = glm::mat4(1.f);
 
-    int width, height;
-    newSpriteSheet.textureId = CreateTexture(fullPath, width, height);
+    glBindBuffer(GL_UNIFORM_BUFFER, uboObjectsID);
 
-    spriteSheets.insert(std::pair<std::string, sSpriteSheet>(textureName, newSpriteSheet));
+    // Keep whole chunks allocated so the last glBindBufferRange never goes past the end
+    unsigned int chunksNum = ((unsigned int)objectTransforms.size() + OBJECTS_PER_CHUNK - 1) / OBJECTS_PER_CHUNK;
+    if (chunksNum * OBJECTS_PER_CHUNK > uboObjectsCapacity)
+        uboObjectsCapacity = chunksNum * OBJECTS_PER_CHUNK;
+
+    glBufferData(GL_UNIFORM_BUFFER, uboObjectsCapacity * sizeof(sObjectTransform), NULL, GL_STREAM_DRAW); // orphan last frame's data
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, objectTransforms.size() * sizeof(sObjectTransform), &objectTransforms[0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    return (float)width / newSpriteSheet.numCols / height;
+    boundObjectChunk = -1;
 }
 
-void cRenderManager::SetupSpriteSheet(const std::string sheetName, const int spriteId, const unsigned int shaderTextureUnit)
+void cRenderManager::BindObject(unsigned int objectIndex)
 {
-    sSpriteSheet sheet = spriteSheets[sheetName];
+    static const unsigned int objectIndexHandle = GetUniformHandle("objectIndex");
 
-    setInt("spriteId", spriteId);
-    setInt("numCols", sheet.numCols);
-    setInt("numRows", sheet.numRows);
-
-    unsigned int textureId = sheet.textureId;
-
-    //GLuint textureUnit = 0;			// Texture unit go from 0 to 79
-    glActiveTexture(shaderTextureUnit + GL_TEXTURE0);	// GL_TEXTURE0 = 33984
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    int chunk = objectIndex / OBJECTS_PER_CHUNK;
+    if (chunk != boundObjectChunk)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, 3, uboObjectsID, chunk * OBJECTS_PER_CHUNK * sizeof(sObjectTransform), OBJECTS_PER_CHUNK * sizeof(sObjectTransform));
+        boundObjectChunk = chunk;
+    }
 
-    std::string shaderVariable = "texture_" + std::to_string(shaderTextureUnit);
-    setInt(shaderVariable, shaderTextureUnit);
+    setInt(objectIndexHandle, objectIndex % OBJECTS_PER_CHUNK);
 }
 
-void cRenderManager::SetupTexture(const std::string textureToSetup, const unsigned int shaderTextureUnit)
+void cRenderManager::SetupModelUniforms(cRenderModel* model, unsigned int objectIndex)
 {
-    if (textures.find(textureToSetup) == textures.end())
-    {
-        std::cout << "Failed to setup texture: " << textureToSetup << std::endl;
-        return; // texture doesn't exists
-    }
+    static const unsigned int useWholeColorHandle = GetUniformHandle("useWholeColor");
+    static const unsigned int wholeColorHandle = GetUniformHandle("wholeColor");
 
-    unsigned int textureId = textures[textureToSetup].textureId;
+    BindObject(objectIndex);
 
-    //GLuint textureUnit = 0;			// Texture unit go from 0 to 79
-    glActiveTexture(shaderTextureUnit + GL_TEXTURE0);	// GL_TEXTURE0 = 33984
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    setBool(useWholeColorHandle, model->useWholeColor);
+    setVec4(wholeColorHandle, model->wholeColor);
 
-    std::string shaderVariable = "texture_" + std::to_string(shaderTextureUnit);
-    setInt(shaderVariable, shaderTextureUnit);
+    model->SetUpUniforms();
 }
 
-void cRenderManager::DrawObject(std::shared_ptr<cRenderModel> model)
+void cRenderManager::DrawObject(std::shared_ptr<cRenderModel> model, unsigned int objectIndex, eRenderPass pass)
 {
     ZoneScopedN("DrawObject");
 
-    sModelDrawInfo drawInfo;
-    if (!FindModelByName(model->meshName, model->shaderName, drawInfo)) return;
+    if (model->isDrawnIndirect && useIndirectTiles) return;
+    if (model->isInSpriteBatch) return;
 
-    use(model->shaderName);
-    
-    setVec3("modelPosition", model->position);
-    setMat4("modelOrientationX", glm::rotate(glm::mat4(1.0f), model->orientation.x, glm::vec3(1.f, 0.f, 0.f)));
-    setMat4("modelOrientationY", glm::rotate(glm::mat4(1.0f), model->orientation.y, glm::vec3(0.f, 1.f, 0.f)));
-    setMat4("modelOrientationZ", glm::rotate(glm::mat4(1.0f), model->orientation.z, glm::vec3(0.f, 0.f, 1.f)));
-    setMat4("modelScale", glm::scale(glm::mat4(1.0f), model->scale));
+    const sMeshEntry* mesh = FindLoadedMesh(model->GetMeshHandle());
+    if (mesh == nullptr) return;
 
-    setBool("useWholeColor", model->useWholeColor);
-    setVec4("wholeColor", model->wholeColor);
+    const sModelDrawInfo& drawInfo = mesh->drawInfo;
 
-    model->SetUpUniforms();
+    use(mesh->program);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, depthMapID);
-    setInt("shadowMap", 1);
+    SetupModelUniforms(model.get(), objectIndex);
 
-    TracyMessageL(model->meshName.c_str());
+    BindTexture(1, depthMapID);
+
+    TracyMessageL(model->GetMeshName().c_str());
     TracyMessageL(model->textureName.c_str());
 
     for (unsigned int i = 0; i < drawInfo.allMeshesData.size(); i++)
@@ -965,26 +2225,15 @@ void cRenderManager::DrawObject(std::shared_ptr<cRenderModel> model)
         if (model->textureName == "") SetupTexture(drawInfo.allMeshesData[i].textureName);
 
         // Bind VAO
-        glBindVertexArray(drawInfo.allMeshesData[i].VAO_ID);
+        BindVAO(drawInfo.allMeshesData[i].VAO_ID);
 
         // Check for instanced
         if (model->isInstanced)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, model->instanceOffsetsBufferId);
-
-            // OPTMIZATION: maybe figure out a way to not have to setup all these data every frame
-            glEnableVertexAttribArray(3);
-            glVertexAttribPointer(3, 4,
-                GL_FLOAT, GL_FALSE,
-                sizeof(glm::vec4),
-                (void*)0);
-            glVertexAttribDivisor(3, 1);
-
-            glDrawElementsInstanced(GL_TRIANGLES,
+            DrawInstances(model.get(), pass,
                 drawInfo.allMeshesData[i].numberOfIndices,
-                GL_UNSIGNED_INT,
-                (void*)0,
-                model->instancedNum);
+                drawInfo.allMeshesData[i].firstIndex,
+                drawInfo.allMeshesData[i].baseVertex);
         }
         else
         {
@@ -997,82 +2246,434 @@ void cRenderManager::DrawObject(std::shared_ptr<cRenderModel> model)
                 (void*)0);
             glVertexAttribDivisor(3, 1);
             
-            glDrawElements(GL_TRIANGLES,
+            glDrawElementsBaseVertex(GL_TRIANGLES,
                 drawInfo.allMeshesData[i].numberOfIndices,
                 GL_UNSIGNED_INT,
-                (void*)0);
+                (void*)(sizeof(unsigned int) * drawInfo.allMeshesData[i].firstIndex),
+                drawInfo.allMeshesData[i].baseVertex);
+            frameStats.drawCalls++;
         }
-
-        glBindVertexArray(0);
     }    
 }
 
+void cRenderManager::QueueModels(std::vector< std::shared_ptr<cRenderModel> >& models)
+{
+    for (unsigned int modelIndex = 0; modelIndex < models.size(); modelIndex++)
+    {
+        cRenderModel* model = models[modelIndex].get();
+        if (model->isDrawnIndirect && useIndirectTiles) continue;
+        if (model->isInSpriteBatch) continue;
+        if (model->visiblePasses == 0) continue;
+
+        MeshHandle meshHandle = model->GetMeshHandle();
+        const sMeshEntry* mesh = FindLoadedMesh(meshHandle);
+        if (mesh == nullptr) continue;
+
+        unsigned int modelTextureId = model->textureName != "" ? FindTextureId(model->textureName) : 0;
+
+        const std::vector<sMeshDrawInfo>& meshesData = mesh->drawInfo.allMeshesData;
+        for (unsigned int meshIndex = 0; meshIndex < meshesData.size(); meshIndex++)
+        {
+            sRenderCommand newCommand;
+            newCommand.model = model;
+            newCommand.meshHandle = meshHandle;
+            newCommand.meshIndex = meshIndex;
+            newCommand.objectIndex = modelIndex;
+            newCommand.programId = mesh->program->ID;
+            newCommand.textureId = model->textureName != "" ? modelTextureId : FindTextureId(meshesData[meshIndex].textureName);
+            newCommand.VAO_ID = meshesData[meshIndex].VAO_ID;
+            newCommand.baseVertex = meshesData[meshIndex].baseVertex;
+            newCommand.firstIndex = meshesData[meshIndex].firstIndex;
+            newCommand.numberOfIndices = meshesData[meshIndex].numberOfIndices;
+
+            if (model->visiblePasses & (1 << SHADOW_PASS)) renderQueue.Push(SHADOW_PASS, newCommand);
+            if (model->visiblePasses & (1 << MAIN_PASS)) renderQueue.Push(MAIN_PASS, newCommand);
+        }
+    }
+}
+
+void cRenderManager::DrawQueue(eRenderPass pass, eShadowCasters casters)
+{
+    ZoneScopedN("DrawQueue");
+
+    BindTexture(1, depthMapID);
+
+    cRenderModel* lastModel = nullptr;
+    for (unsigned int i = 0; i < renderQueue.Size(); i++)
+    {
+        const sRenderSortEntry& entry = renderQueue.GetEntry(i);
+        if (cRenderQueue::GetPassFromKey(entry.key) != pass) continue;
+
+        const sRenderCommand& command = renderQueue.GetCommand(entry);
+        cRenderModel* model = command.model;
+        if (casters == STATIC_CASTERS && model->isDynamicShadowCaster) continue;
+        if (casters == DYNAMIC_CASTERS && !model->isDynamicShadowCaster) continue;
+
+        // Uniforms belong to the program, so a program switch means setting the model ones again
+        if (command.programId != boundProgramId)
+        {
+            use(meshes[command.meshHandle].program);
+            lastModel = nullptr;
+        }
+
+        if (model != lastModel)
+        {
+            SetupModelUniforms(model, command.objectIndex);
+            lastModel = model;
+        }
+
+        if (model->textureName == "" && command.textureId != 0) BindTexture(0, command.textureId);
+
+        BindVAO(command.VAO_ID);
+
+        if (model->isInstanced)
+        {
+            DrawInstances(model, pass, command.numberOfIndices, command.firstIndex, command.baseVertex);
+            continue;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, notInstancedOffsetBufferId);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4,
+            GL_FLOAT, GL_FALSE,
+            sizeof(glm::vec4),
+            (void*)0);
+        glVertexAttribDivisor(3, 1);
+
+        glDrawElementsBaseVertex(GL_TRIANGLES,
+            command.numberOfIndices,
+            GL_UNSIGNED_INT,
+            (void*)(sizeof(unsigned int) * command.firstIndex),
+            command.baseVertex);
+        frameStats.drawCalls++;
+    }
+}
+
+void cRenderManager::DrawInstances(cRenderModel* model, eRenderPass pass, unsigned int numberOfIndices, unsigned int firstIndex, unsigned int baseVertex)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, model->instanceOffsetsBufferId);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    // Neighbouring visible buckets are drawn together, unless a removed bucket left a hole between them.
+    // No base instance in 3.3, the attribute starts at the run instead
+    const std::vector<sInstanceBucket>& buckets = model->instanceBuckets;
+    unsigned int bucketIndex = 0;
+    while (bucketIndex < buckets.size())
+    {
+        if (!(buckets[bucketIndex].visiblePasses & (1 << pass)))
+        {
+            bucketIndex++;
+            continue;
+        }
+
+        unsigned int firstInstance = buckets[bucketIndex].firstInstance;
+        unsigned int instancesNum = 0;
+        while (bucketIndex < buckets.size() && (buckets[bucketIndex].visiblePasses & (1 << pass))
+            && buckets[bucketIndex].firstInstance == firstInstance + instancesNum)
+        {
+            instancesNum += buckets[bucketIndex].instancesNum;
+            bucketIndex++;
+        }
+
+        glVertexAttribPointer(3, 4,
+            GL_FLOAT, GL_FALSE,
+            sizeof(glm::vec4),
+            (void*)(firstInstance * sizeof(glm::vec4)));
+
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+            numberOfIndices,
+            GL_UNSIGNED_INT,
+            (void*)(sizeof(unsigned int) * firstIndex),
+            instancesNum,
+            baseVertex);
+        frameStats.drawCalls++;
+    }
+}
+
+const sRenderStats& cRenderManager::GetLastFrameStats()
+{
+    return lastFrameStats;
+}
+
 void cRenderManager::DrawParticles(cParticleSpawner* spawner)
 {
-    sModelDrawInfo drawInfo;
-    if (!FindModelByName(spawner->model.meshName, spawner->model.shaderName, drawInfo)) return;
-    
-    use(spawner->model.shaderName);
-    setVec3("cameraPosition", Manager::camera.position);
-    setVec3("modelScale", spawner->model.scale);
-    setBool("useWholeColor", spawner->model.useWholeColor);
-    setVec4("wholeColor", spawner->model.wholeColor);
+    ZoneScopedN("DrawParticles");
+
+    // GPU simulated spawners only draw the ring of slots the live particles were spawned into, in at most two runs
+    unsigned int instancesNum = spawner->isGpuSimulated ? spawner->gpuLiveNum : spawner->particlesNum;
+    if (instancesNum == 0) return;
+
+    unsigned int runsNum = 1;
+    unsigned int runFirst[2] = { 0, 0 };
+    unsigned int runCount[2] = { instancesNum, 0 };
+    if (spawner->isGpuSimulated)
+    {
+        runFirst[0] = ParticleKernels::GetGpuFirstLiveSlot(spawner->gpuSpawnsNum, instancesNum, spawner->maxParticles);
+        runCount[0] = glm::min(instancesNum, spawner->maxParticles - runFirst[0]);
+        runCount[1] = instancesNum - runCount[0];
+        if (runCount[1] > 0) runsNum = 2;
+    }
+
+    if (useFrustumCulling && !cameraFrustum.IsBoxVisible(spawner->boundsMin, spawner->boundsMax))
+    {
+        frameStats.particleSpawnersCulled++;
+        return;
+    }
+
+    const sMeshEntry* mesh = FindLoadedMesh(spawner->model.GetMeshHandle());
+    if (mesh == nullptr) return;
+
+    const sModelDrawInfo& drawInfo = mesh->drawInfo;
+
+    use(mesh->program);
+
+    static const unsigned int cameraPositionHandle = GetUniformHandle("cameraPosition");
+    static const unsigned int modelScaleHandle = GetUniformHandle("modelScale");
+    static const unsigned int useWholeColorHandle = GetUniformHandle("useWholeColor");
+    static const unsigned int wholeColorHandle = GetUniformHandle("wholeColor");
+
+    setVec3(cameraPositionHandle, Manager::camera.position);
+    setVec3(modelScaleHandle, spawner->model.scale);
+    setBool(useWholeColorHandle, spawner->model.useWholeColor);
+    setVec4(wholeColorHandle, spawner->model.wholeColor);
     
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, GetDepthMapId());
-    setInt("shadowMap", 1);
+    BindTexture(1, depthMapID);
     
     // Might change this to use a constant quad instead of a custom mesh
     for (unsigned int i = 0; i < drawInfo.allMeshesData.size(); i++)
     {
         // Setup texture
-        std::string textureToUse = spawner->model.textureName;
-        SetupTexture(textureToUse);
+        SetupTexture(spawner->model.textureName);
     
         // Bind VAO
-        glBindVertexArray(drawInfo.allMeshesData[i].VAO_ID);
-    
-        glBindBuffer(GL_ARRAY_BUFFER, spawner->particleBufferId);
-    
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
-        glVertexAttribDivisor(3, 1);
-    
-        glDrawElementsInstanced(GL_TRIANGLES,
-            drawInfo.allMeshesData[i].numberOfIndices,
-            GL_UNSIGNED_INT,
-            (void*)0,
-            spawner->particles.size());
+        BindVAO(drawInfo.allMeshesData[i].VAO_ID);
     
-        glBindVertexArray(0);
+        for (unsigned int run = 0; run < runsNum; run++)
+        {
+            // No base instance in 3.3, so each run starts the instance attribute at its first slot
+            if (spawner->isGpuSimulated)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, spawner->gpuBufferIds[spawner->gpuCurrentBuffer]);
+                glEnableVertexAttribArray(3);
+                glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * 2, (void*)(sizeof(glm::vec4) * 2 * runFirst[run]));
+            }
+            else
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, spawner->particleBufferId);
+                glEnableVertexAttribArray(3);
+                glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+            }
+            glVertexAttribDivisor(3, 1);
+
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                drawInfo.allMeshesData[i].numberOfIndices,
+                GL_UNSIGNED_INT,
+                (void*)(sizeof(unsigned int) * drawInfo.allMeshesData[i].firstIndex),
+                runCount[run],
+                drawInfo.allMeshesData[i].baseVertex);
+            frameStats.drawCalls++;
+        }
     }
 }
 
-void cRenderManager::DrawShadowPass(glm::mat4& outLightSpaceMatrix)
+void cRenderManager::CalculateLightMatrices(glm::mat4& outProjection, glm::mat4& outView)
 {
-    ZoneScopedN("ShadowPass");
+    float near_plane = 1.f, far_plane = 100.f;
+    float boxSize = 50.f;
 
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
+    glm::vec3 lightOffset, anchor;
+    if (Engine::currGameMode == eGameMode::MAP)
+    {
+        lightOffset = glm::vec3(Manager::light.lights[0].position);
+        anchor = Player::GetPlayerPosition();
+    }
+    else if (Engine::currGameMode == eGameMode::BATTLE)
+    {
+        lightOffset = glm::vec3(-20.f, 12.f, -10.f);
+        anchor = glm::vec3(0.f); // look at world origin
+    }
+
+    // The box only moves in whole texels so static shadow edges don't shimmer, and with the cache on
+    // in bigger steps so the cached depth stays valid while the player walks inside one
+    float texelSize = boxSize / SHADOW_WIDTH;
+    float step = texelSize;
+    if (useShadowCache) step = glm::max(texelSize, glm::floor(shadowCacheStep / texelSize) * texelSize);
+
+    glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.f), -lightOffset, glm::vec3(0.0, 1.0, 0.0));
+    glm::vec3 lightSpaceAnchor = glm::vec3(lightRotation * glm::vec4(anchor, 1.f));
+    lightSpaceAnchor = glm::floor(lightSpaceAnchor / step + 0.5f) * step;
+    glm::vec3 lightAt = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightSpaceAnchor, 1.f));
+
+    outProjection = glm::ortho(-boxSize / 2.f, boxSize / 2.f, -boxSize / 2.f, boxSize / 2.f, near_plane, far_plane);
+    outView = glm::lookAt(lightAt + lightOffset, lightAt, glm::vec3(0.0, 1.0, 0.0));
+}
+
+void cRenderManager::CullModels(std::vector< std::shared_ptr<cRenderModel> >& models)
+{
+    ZoneScopedN("CullModels");
+
+    if (!useFrustumCulling)
+    {
+        for (unsigned int i = 0; i < models.size(); i++)
+        {
+            models[i]->visiblePasses = 0xFF;
+        }
+        frameStats.mainPassVisible = frameStats.shadowPassVisible = (unsigned int)models.size();
+        return;
+    }
+
+    glm::mat4 view = Manager::camera.GetViewMatrix();
+    cameraFrustum.FromMatrix(Manager::camera.GetProjectionMatrix() * view);
+
+    // The far plane is pulled in to the draw distance, facing back towards the camera
+    if (drawDistance > 0.f && drawDistance < Manager::camera.farPlane)
+    {
+        glm::mat4 cameraTransform = glm::inverse(view);
+        glm::vec3 cameraPosition = glm::vec3(cameraTransform[3]);
+        glm::vec3 cameraForward = -glm::normalize(glm::vec3(cameraTransform[2]));
+        cameraFrustum.planes[5] = glm::vec4(-cameraForward, glm::dot(cameraForward, cameraPosition) + drawDistance);
+    }
 
     glm::mat4 lightProjection, lightView;
-    float near_plane = 1.f, far_plane = 100.f;
+    CalculateLightMatrices(lightProjection, lightView);
+    shadowFrustum.FromMatrix(lightProjection * lightView);
+
+    culler.Clear();
+    culler.Reserve((unsigned int)models.size());
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        culler.AddBox(models[i]->worldBoundsMin, models[i]->worldBoundsMax);
+        models[i]->visiblePasses = 0;
+    }
+
+    frameStats.mainPassVisible = culler.Cull(cameraFrustum, passVisibility);
+    frameStats.mainPassCulled = (unsigned int)models.size() - frameStats.mainPassVisible;
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        if (passVisibility[i]) models[i]->visiblePasses |= 1 << MAIN_PASS;
+    }
+
+    frameStats.shadowPassVisible = culler.Cull(shadowFrustum, passVisibility);
+    frameStats.shadowPassCulled = (unsigned int)models.size() - frameStats.shadowPassVisible;
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        if (passVisibility[i]) models[i]->visiblePasses |= 1 << SHADOW_PASS;
+    }
+}
+
+void cRenderManager::CullInstanceBuckets(std::vector< std::shared_ptr<cRenderModel> >& models)
+{
+    ZoneScopedN("CullInstanceBuckets");
+
+    // Only models with more than one bucket, the model's own test already covers a single one
+    bucketedModels.clear();
+    culler.Clear();
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        cRenderModel* model = models[i].get();
+        if (!model->isInstanced || (model->isDrawnIndirect && useIndirectTiles)) continue;
+
+        for (unsigned int bucketIndex = 0; bucketIndex < model->instanceBuckets.size(); bucketIndex++)
+        {
+            model->instanceBuckets[bucketIndex].visiblePasses = model->visiblePasses;
+        }
+        if (model->instanceBuckets.size() < 2 || model->visiblePasses == 0 || !useFrustumCulling) continue;
+
+        // The model's bounds are its mesh's grown by every offset, take those back off to get the mesh's
+        glm::vec3 meshBoundsMin = model->worldBoundsMin - model->instanceOffsetsMin;
+        glm::vec3 meshBoundsMax = model->worldBoundsMax - model->instanceOffsetsMax;
+        for (unsigned int bucketIndex = 0; bucketIndex < model->instanceBuckets.size(); bucketIndex++)
+        {
+            const sInstanceBucket& bucket = model->instanceBuckets[bucketIndex];
+            culler.AddBox(meshBoundsMin + bucket.offsetsMin, meshBoundsMax + bucket.offsetsMax);
+        }
+        bucketedModels.push_back(model);
+    }
+
+    if (bucketedModels.empty()) return;
+
+    culler.Cull(shadowFrustum, shadowVisibility);
+    culler.Cull(cameraFrustum, passVisibility);
+
+    unsigned int boxIndex = 0;
+    for (unsigned int i = 0; i < bucketedModels.size(); i++)
+    {
+        std::vector<sInstanceBucket>& buckets = bucketedModels[i]->instanceBuckets;
+        for (unsigned int bucketIndex = 0; bucketIndex < buckets.size(); bucketIndex++, boxIndex++)
+        {
+            unsigned char visiblePasses = 0;
+            if (shadowVisibility[boxIndex]) visiblePasses |= 1 << SHADOW_PASS;
+            if (passVisibility[boxIndex]) visiblePasses |= 1 << MAIN_PASS;
+            buckets[bucketIndex].visiblePasses = visiblePasses;
+
+            unsigned int visibleNum = shadowVisibility[boxIndex] + passVisibility[boxIndex];
+            frameStats.instanceBucketsVisible += visibleNum;
+            frameStats.instanceBucketsCulled += 2 - visibleNum;
+        }
+    }
+}
+
+void cRenderManager::InvalidateShadowCache()
+{
+    staticShadowGeneration++;
+}
+
+void cRenderManager::DrawShadowCasters(eShadowCasters casters)
+{
+    if (useRenderQueue)
+    {
+        DrawQueue(SHADOW_PASS, casters);
+    }
+    else
+    {
+        std::vector< std::shared_ptr<cRenderModel> >* models = nullptr;
+        if (Engine::currGameMode == eGameMode::MAP) models = &mapModels;
+        else if (Engine::currGameMode == eGameMode::BATTLE) models = &battleModels;
+
+        for (size_t i = 0; models && i < models->size(); i++)
+        {
+            cRenderModel* model = (*models)[i].get();
+            if (!(model->visiblePasses & (1 << SHADOW_PASS))) continue;
+            if (casters == STATIC_CASTERS && model->isDynamicShadowCaster) continue;
+            if (casters == DYNAMIC_CASTERS && !model->isDynamicShadowCaster) continue;
+
+            DrawObject((*models)[i], (unsigned int)i, SHADOW_PASS);
+        }
+    }
 
-    glm::vec3 lightPos, lightAt;
     if (Engine::currGameMode == eGameMode::MAP)
     {
-        lightPos = glm::vec3(Manager::light.lights[0].position) + Player::GetPlayerPosition();
-        lightAt = Player::GetPlayerPosition();
+        DrawTileBatches(SHADOW_PASS, casters);
+        if (casters != STATIC_CASTERS) DrawSpriteBatch();
     }
-    else if (Engine::currGameMode == eGameMode::BATTLE)
+}
+
+void cRenderManager::DrawShadowPass(glm::mat4& outLightSpaceMatrix)
+{
+    ZoneScopedN("ShadowPass");
+
+    std::chrono::high_resolution_clock::time_point cpuStart = std::chrono::high_resolution_clock::now();
+
+    // The oldest query is a few frames old by now, read it if the GPU is done with it and reuse it
+    unsigned int timerQuery = shadowTimerQueries[shadowTimerIndex];
+    if (shadowTimerQueriesIssued >= SHADOW_TIMER_QUERIES_NUM)
     {
-        lightPos = glm::vec3(-20.f, 12.f, -10.f);
-        lightAt = glm::vec3(0.f); // look at world origin
+        GLint isAvailable = 0;
+        glGetQueryObjectiv(timerQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (isAvailable)
+        {
+            GLuint64 elapsedNs = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsedNs);
+            lastShadowPassGpuMs = elapsedNs / 1000000.f;
+        }
     }
+    glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+
+    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
 
-    lightProjection = glm::ortho(-25.0f, 25.0f, -25.0f, 25.0f, near_plane, far_plane);
-    lightView = glm::lookAt(lightPos, lightAt, glm::vec3(0.0, 1.0, 0.0));
+    glm::mat4 lightProjection, lightView;
+    CalculateLightMatrices(lightProjection, lightView);
     outLightSpaceMatrix = lightProjection * lightView;
 
     int bruh = 1; // B R U H
@@ -1084,22 +2685,50 @@ void cRenderManager::DrawShadowPass(glm::mat4& outLightSpaceMatrix)
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
     //Draw scene
-    if (Engine::currGameMode == eGameMode::MAP)
+    if (useShadowCache)
     {
-        for (int i = 0; i < mapModels.size(); i++)
+        if (!isShadowCacheValid ||
+            shadowCacheLightSpace != outLightSpaceMatrix ||
+            shadowCacheGeneration != staticShadowGeneration ||
+            shadowCacheGameMode != (int)Engine::currGameMode)
         {
-            DrawObject(mapModels[i]);
+            ZoneScopedN("RebuildShadowCache");
+
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowCacheFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            DrawShadowCasters(STATIC_CASTERS);
+
+            isShadowCacheValid = true;
+            shadowCacheLightSpace = outLightSpaceMatrix;
+            shadowCacheGeneration = staticShadowGeneration;
+            shadowCacheGameMode = (int)Engine::currGameMode;
+            shadowCacheRebuilds++;
         }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, shadowCacheFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthMapFBO);
+        glBlitFramebuffer(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT, 0, 0, SHADOW_WIDTH, SHADOW_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+        DrawShadowCasters(DYNAMIC_CASTERS);
     }
-    else if (Engine::currGameMode == eGameMode::BATTLE)
+    else
     {
-        for (int i = 0; i < battleModels.size(); i++)
-        {
-            DrawObject(battleModels[i]);
-        }
+        isShadowCacheValid = false;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        DrawShadowCasters(ALL_CASTERS);
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glEndQuery(GL_TIME_ELAPSED);
+    shadowTimerIndex = (shadowTimerIndex + 1) % SHADOW_TIMER_QUERIES_NUM;
+    if (shadowTimerQueriesIssued < SHADOW_TIMER_QUERIES_NUM) shadowTimerQueriesIssued++;
+
+    std::chrono::duration<float, std::milli> cpuElapsed = std::chrono::high_resolution_clock::now() - cpuStart;
+    lastShadowPassCpuMs = cpuElapsed.count();
 }
 
 void cRenderManager::SendTracyScreenshot()
@@ -1133,6 +2762,47 @@ void cRenderManager::DrawFrame()
 {
     ZoneScopedN("Draw Frame");
 
+    lastFrameStats = frameStats;
+    frameStats = sRenderStats();
+
+    InvalidateStateCache();
+
+    // Transforms first, the culling stage needs this frame's world bounds
+    if (Engine::currGameMode == eGameMode::MAP)
+    {
+        UploadObjectTransforms(mapModels);
+        CullModels(mapModels);
+        CullInstanceBuckets(mapModels);
+        CullTileBatches();
+    }
+    else if (Engine::currGameMode == eGameMode::BATTLE)
+    {
+        UploadObjectTransforms(battleModels);
+        CullModels(battleModels);
+        CullInstanceBuckets(battleModels);
+    }
+
+    // Sprites go in one instanced draw, the queue and the fallback draws skip them
+    if (Engine::currGameMode == eGameMode::MAP)
+        BuildSpriteBatch();
+    else
+        spriteInstances.clear();
+
+    // Build and sort this frame's draws for both passes
+    if (useRenderQueue)
+    {
+        ZoneScopedN("BuildRenderQueue");
+
+        renderQueue.Clear();
+
+        if (Engine::currGameMode == eGameMode::MAP)
+            QueueModels(mapModels);
+        else if (Engine::currGameMode == eGameMode::BATTLE)
+            QueueModels(battleModels);
+
+        renderQueue.Sort();
+    }
+
     //Shadow pass
     glm::mat4 lightSpaceMatrix;
     DrawShadowPass(lightSpaceMatrix);
@@ -1168,21 +2838,31 @@ void cRenderManager::DrawFrame()
     ZoneNamedN(finalDraw, "Final Draw", true);
 
     // Draw scene
-    if (Engine::currGameMode == eGameMode::MAP)
+    if (useRenderQueue)
+    {
+        DrawQueue(MAIN_PASS);
+    }
+    else if (Engine::currGameMode == eGameMode::MAP)
     {
         for (int i = 0; i < mapModels.size(); i++)
         {
-            DrawObject(mapModels[i]);
+            if (mapModels[i]->visiblePasses & (1 << MAIN_PASS)) DrawObject(mapModels[i], i, MAIN_PASS);
         }
     }
     else if (Engine::currGameMode == eGameMode::BATTLE)
     {
         for (int i = 0; i < battleModels.size(); i++)
         {
-            DrawObject(battleModels[i]);
+            if (battleModels[i]->visiblePasses & (1 << MAIN_PASS)) DrawObject(battleModels[i], i, MAIN_PASS);
         }
     }
 
+    if (Engine::currGameMode == eGameMode::MAP)
+    {
+        DrawTileBatches(MAIN_PASS);
+        DrawSpriteBatch();
+    }
+
     ZoneNamedN(particlesDraw, "Particles Draw", true);
 
     // Draw particles
@@ -1201,7 +2881,10 @@ void cRenderManager::DrawFrame()
 
     // Draw UI
     if (Manager::input.GetCurrentInputState() == MENU_NAVIGATION)
+    {
         Manager::ui.DrawUI();
+        InvalidateStateCache(); // UI binds its own textures and VAOs
+    }
 
     // Draw skybox
     glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
@@ -1212,10 +2895,11 @@ void cRenderManager::DrawFrame()
     setMat4("view", view);
     setMat4("projection", projection);
 
-    glBindVertexArray(skyboxVAO);
+    BindVAO(skyboxVAO);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTextureID);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    frameStats.drawCalls++;
+    BindVAO(0);
     glDepthFunc(GL_LESS); // set depth function back to default
 }
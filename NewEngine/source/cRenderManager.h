@@ -4,8 +4,13 @@
 #include <set>
 #include <map>
 #include <memory>
+#include <vector>
 #include "DrawInfo.h"
 #include "cRenderModel.h"
+#include "cRenderQueue.h"
+#include "cMeshArena.h"
+#include "cAssetCache.h"
+#include "cFrustumCuller.h"
 
 namespace Pokemon
 {
@@ -16,8 +21,16 @@ namespace Pokemon
 struct sShaderProgram
 {
     unsigned int ID;
-    std::map<std::string, sModelDrawInfo> modelsLoaded; // stored by file name
-    std::map<std::string, unsigned int> uniformLocations;
+    std::vector<int> uniformLocations; // indexed by uniform handle, -1 if the program doesn't use it
+};
+
+// A model file loaded for one shader program
+struct sMeshEntry
+{
+    std::string fileName;
+    sShaderProgram* program;
+    bool isLoaded;
+    sModelDrawInfo drawInfo;
 };
 
 enum eAnimatedModel
@@ -31,6 +44,21 @@ enum eAnimatedModel
 struct sTexture
 {
     unsigned int textureId;
+    int width;
+    int height;
+};
+
+// RGBA8 pixels straight from stb_image, freed with the struct
+struct sDecodedImage
+{
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+
+    sDecodedImage() {}
+    ~sDecodedImage();
+    sDecodedImage(const sDecodedImage&) = delete;
+    sDecodedImage& operator=(const sDecodedImage&) = delete;
 };
 
 struct sSpriteSheet : sTexture
@@ -39,6 +67,110 @@ public:
     unsigned int numCols;
     unsigned int numRows;
     bool isSymmetrical;
+    int arrayIndex = -1; // sprite array it's copied into, -1 when it's only drawn from its own texture
+    int arrayLayer = -1;
+};
+
+// One sprite of the batch, read by SpriteArrayVertShader at locations 3 to 6
+struct sSpriteInstance
+{
+    glm::vec4 position; // w is the rotation around y
+    glm::vec4 scale; // a negative z is a flipped sprite, same as the sprite animations do it
+    glm::vec4 sheetExtent; // xy is the part of the layer the sheet covers
+    glm::ivec4 sprite; // sprite id, layer, columns, rows
+};
+
+// One entry of the std140 "Objects" uniform block
+struct sObjectTransform
+{
+    glm::mat4 model;
+    glm::mat4 normal; // transpose(inverse(model)), only the upper 3x3 is used
+};
+
+// A tile model's whole offsets buffer, copied into a region of its batch's instance buffer
+struct sTileBatchModel
+{
+    std::shared_ptr<cRenderModel> model;
+    unsigned int firstInstance;
+    unsigned int instancesNum; // the model's buffer capacity when the region was laid out
+    float originHeight; // where the baked transform moved the mesh's origin, goes in every offset's w
+};
+
+// One mesh of a tile model in a batch, drawn once per instance bucket of its model
+struct sTileBatchMesh
+{
+    unsigned int modelIndex; // in the batch's models
+    unsigned int count;
+    unsigned int firstIndex;
+    int baseVertex;
+    glm::vec3 boundsMin; // baked, a bucket's offsets are added for its world bounds
+    glm::vec3 boundsMax;
+};
+
+// Every tile mesh that shares a program and a texture, packed into one arena
+// and drawn with a single glMultiDrawElementsIndirect
+struct sTileBatch
+{
+    sShaderProgram* program;
+    unsigned int textureId;
+    std::shared_ptr<cRenderModel> uniformsModel; // animation uniforms are taken from the first model, all tiles of a type animate in sync
+    bool isDynamicShadowCaster; // its program moves vertices, so it's drawn on top of the shadow cache instead of into it
+
+    unsigned int VAO_ID;
+    unsigned int VBO_ID;
+    unsigned int INDEX_ID;
+    unsigned int instanceBufferId;
+    unsigned int indirectBufferId; // this frame's visible commands, shadow pass ones first
+
+    // Geometry is baked once per map, instance buckets come and go with the streamed quadrants
+    std::vector<sTileBatchModel> models;
+    std::vector<sTileBatchMesh> meshes;
+    bool areCommandsDirty;
+
+    // One command per mesh and instance bucket, with world bounds since tiles never move
+    unsigned int commandsNum;
+    std::vector<sDrawElementsIndirectCommand> commands;
+    std::vector<glm::vec3> commandsBoundsMin;
+    std::vector<glm::vec3> commandsBoundsMax;
+    unsigned int shadowCommandsNum;
+    unsigned int mainCommandsNum;
+};
+
+// Sprite sheets of one layer size, drawn together with one instanced call
+struct sSpriteArray
+{
+    unsigned int textureId;
+    int layerSize;
+    unsigned int layersNum; // allocated, grows when every layer is taken
+    std::vector<unsigned int> freeLayers;
+    unsigned int firstInstance; // this frame's range in the sprite instance buffer
+    unsigned int instancesNum;
+};
+
+// Which models a shadow pass draw covers, static ones are drawn once into the shadow cache
+enum eShadowCasters
+{
+    ALL_CASTERS,
+    STATIC_CASTERS,
+    DYNAMIC_CASTERS
+};
+
+// Per frame counters, used to measure state changes
+struct sRenderStats
+{
+    unsigned int programBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int uniformUploads = 0;
+    unsigned int drawCalls = 0;
+
+    unsigned int mainPassVisible = 0; // models, after culling
+    unsigned int mainPassCulled = 0;
+    unsigned int shadowPassVisible = 0;
+    unsigned int shadowPassCulled = 0;
+    unsigned int particleSpawnersCulled = 0;
+    unsigned int instanceBucketsVisible = 0; // instanced models and tile batches, both passes
+    unsigned int instanceBucketsCulled = 0;
 };
 
 class cRenderManager
@@ -52,13 +184,14 @@ public:
 
     // Shaders
 private:
-    std::string currShader;
     std::map<std::string, sShaderProgram> programs;
     void checkCompileErrors(unsigned int shader, std::string type);
-    void CreateShaderProgram(std::string programName, const char* vertexPath, const char* fragmentPath);
+    // No fragment shader and a list of outputs to capture for a transform feedback program
+    void CreateShaderProgram(std::string programName, const char* vertexPath, const char* fragmentPath, const std::vector<const char*>& feedbackVaryings = {});
 public:
     unsigned int GetCurrentShaderId();
-    void use(std::string programName);
+    void use(const std::string& programName);
+    void use(sShaderProgram* program);
     void setBool(const std::string& name, bool value);
     void setInt(const std::string& name, int value);
     void setFloat(const std::string& name, float value);
@@ -67,12 +200,64 @@ public:
     void setVec3(const std::string& name, const glm::vec3& value);
     void setVec4(const std::string& name, const glm::vec4& value);
 
+    // Uniform handles (names are resolved once, every program keeps a flat location array indexed by handle)
+private:
+    std::map<std::string, unsigned int> uniformHandles;
+    std::vector<std::string> uniformNames; // indexed by handle
+    sShaderProgram* currProgram = nullptr;
+public:
+    unsigned int GetUniformHandle(const std::string& name);
+    void setBool(unsigned int handle, bool value);
+    void setInt(unsigned int handle, int value);
+    void setFloat(unsigned int handle, float value);
+    void setMat4(unsigned int handle, const glm::mat4& mat);
+    void setVec2(unsigned int handle, const glm::vec2& value);
+    void setVec3(unsigned int handle, const glm::vec3& value);
+    void setVec4(unsigned int handle, const glm::vec4& value);
+
+    // State cache (only valid during DrawFrame, anything else can change GL state between frames)
+private:
+    static const unsigned int MAX_CACHED_TEXTURE_UNITS = 16;
+    unsigned int boundProgramId = 0;
+    unsigned int boundVAOId = 0;
+    unsigned int activeTextureUnit = 0;
+    unsigned int boundTextureIds[MAX_CACHED_TEXTURE_UNITS] = { 0 };
+    void InvalidateStateCache();
+    void BindProgram(unsigned int programId);
+    void BindVAO(unsigned int vaoId);
+    void BindTexture(unsigned int shaderTextureUnit, unsigned int textureId);
+    unsigned int textureUnitHandles[MAX_CACHED_TEXTURE_UNITS]; // "texture_N" handles
+
     // Depth map
 private:
     unsigned int depthMapID, depthMapFBO;
 public:
     unsigned int GetDepthMapId();
 
+    // Shadow cache, static casters' depth kept between frames while the light box and the static models stay the same
+private:
+    static const unsigned int SHADOW_TIMER_QUERIES_NUM = 4; // results are read a few frames late so the CPU never waits on them
+    unsigned int shadowCacheMapID, shadowCacheFBO;
+    bool isShadowCacheValid = false;
+    glm::mat4 shadowCacheLightSpace;
+    unsigned int staticShadowGeneration = 0; // bumped when static casters are added, removed, loaded or rebuilt
+    unsigned int shadowCacheGeneration = 0;
+    int shadowCacheGameMode = -1;
+    unsigned int shadowCacheRebuilds = 0;
+    unsigned int shadowTimerQueries[SHADOW_TIMER_QUERIES_NUM];
+    unsigned int shadowTimerIndex = 0;
+    unsigned int shadowTimerQueriesIssued = 0;
+    float lastShadowPassCpuMs = 0.f;
+    float lastShadowPassGpuMs = 0.f;
+    void DrawShadowCasters(eShadowCasters casters);
+public:
+    bool useShadowCache = true;
+    float shadowCacheStep = 4.f; // world units the light box moves in, rounded to whole shadow map texels
+    void InvalidateShadowCache();
+    unsigned int GetShadowCacheRebuilds() { return shadowCacheRebuilds; }
+    float GetShadowPassCpuMs() { return lastShadowPassCpuMs; }
+    float GetShadowPassGpuMs() { return lastShadowPassGpuMs; } // from a few frames ago
+
     // Skybox
 private:
     unsigned int skyboxVAO, skyboxVBO;
@@ -83,48 +268,184 @@ private:
     unsigned int uboMatricesID;
     unsigned int uboFogID;
 
+    // Per object transforms, bound to the Objects block in chunks
+private:
+    static const unsigned int OBJECTS_PER_CHUNK = 128; // 128 * 128 bytes = 16KB, the minimum block size GL guarantees
+    unsigned int uboObjectsID;
+    unsigned int uboObjectsCapacity = 0; // in objects
+    int boundObjectChunk = -1;
+    std::vector<sObjectTransform> objectTransforms;
+    unsigned int identityObjectIndex = 0; // extra entry after the models, used by pre-transformed geometry
+    glm::mat4 CalculateModelMatrix(cRenderModel* model);
+    void UploadObjectTransforms(std::vector< std::shared_ptr<cRenderModel> >& models);
+    void BindObject(unsigned int objectIndex);
+
     // Models loading
 private:
     unsigned int notInstancedOffsetBufferId;
     int offsetAttributeLocation;
-    bool FindModelByName(std::string fileName, std::string programName, sModelDrawInfo& modelInfo);
+    std::vector<sMeshEntry> meshes; // indexed by MeshHandle, entries are never removed
+    std::map<std::string, MeshHandle> meshHandles; // "program/file"
+    const sMeshEntry* FindLoadedMesh(MeshHandle handle);
+    cMeshArena meshArenas[VERTEX_LAYOUT_NUM]; // one per vertex layout
+    std::map<std::string, sModelDrawInfo> arenaModels; // by file name, shared by every program that loads it
+    std::map<std::string, sModelDrawInfo> builtMeshes; // by mesh name, made at runtime and owned by whoever made them
+    void AllocateMesh(const sVertexData* verticesData, unsigned int verticesNum, const unsigned int* indiciesData, unsigned int indicesNum, const std::string& textureName, sModelDrawInfo& modelInOut);
 public:
-    bool LoadModel(std::string fileName, std::string programName);
+    // The model's geometry on the CPU, mapped from its cooked file or imported when there's none. Never reads back from GL
+    bool ReadModelGeometry(const std::string& fileName, class cMappedFile& cookedFileOut, struct sCookedModel& importedModelOut, struct sCookedModelView& modelOut);
+    bool usePackedVertices = true; // picked up by the next LoadModel
+    bool useMeshCache = true; // load from and write .cmesh files next to the models
+    const cMeshArena& GetMeshArena(eVertexLayout layout);
+    unsigned int GetArenaModelsNum();
+    MeshHandle GetMeshHandle(const std::string& fileName, const std::string& programName);
+    MeshHandle LoadModel(std::string fileName, std::string programName);
+    void ReleaseModel(const std::string& fileName); // once per LoadModel, with the textures it took
+    // Geometry that doesn't come from a file, found by meshName like a loaded model. Not cached, DestroyMesh frees it right away
+    MeshHandle CreateMesh(const std::string& meshName, const std::string& programName, const std::vector<sMeshGeometry>& geometry);
+    void DestroyMesh(const std::string& meshName);
+    // Imports and cooks a model when its .cmesh is missing or stale. Doesn't touch GL, safe on a worker thread
+    static bool CookModel(const std::string& fileName);
     void UnloadModels();
 
+    // Asset cache, keeps meshes and textures between scenes while they fit in the budget
+private:
+    cAssetCache assetCache;
+    void EvictAsset(eAssetType type, const std::string& name);
+    static size_t GetTextureBytes(int width, int height);
+public:
+    bool useAssetCache = true; // otherwise every scene change unloads everything
+    unsigned int assetCacheBudgetMb = 128;
+    void ReleaseSceneAssets(); // before the next scene's loads, only unloads anything without the cache
+    void TrimAssetCache(); // once the next scene is loaded
+    const sAssetCacheStats& GetAssetCacheStats();
+    void ResetAssetCacheCounters();
+
     // Render models
 private:
     std::vector< std::shared_ptr<cRenderModel> > mapModels;
     std::vector< std::shared_ptr<cRenderModel> > battleModels; // prob not the best idea
+    std::vector< std::shared_ptr<class cSpriteModel> > mapSpriteModels; // also in mapModels, gathered by the sprite batch
 public:
     std::shared_ptr<cRenderModel> CreateRenderModel(bool isBattleModel = false);
     std::shared_ptr<class cSpriteModel> CreateSpriteModel(bool isBattleModel = false);
     std::shared_ptr<class cAnimatedModel> CreateAnimatedModel(eAnimatedModel modelType, bool isBattleModel = false);
     void RemoveModel(std::shared_ptr<cRenderModel> model);
 
+    // Indirect tile batches (needs GL_ARB_multi_draw_indirect, otherwise tiles are drawn one model at a time)
+private:
+    bool isIndirectDrawSupported = false;
+    std::vector<sTileBatch> tileBatches;
+    std::vector< std::shared_ptr<cRenderModel> > tileBatchModels;
+    void LayoutTileBatchInstances(sTileBatch& batch); // every model's region again, when one outgrew its own
+    void UploadTileBatchInstances(sTileBatch& batch, unsigned int modelIndex, unsigned int firstInstance, unsigned int instancesNum);
+    void BuildTileBatchCommands(sTileBatch& batch);
+    void CullTileBatches();
+    void DrawTileBatches(eRenderPass pass, eShadowCasters casters = ALL_CASTERS);
+public:
+    bool useIndirectTiles = true;
+    bool IsIndirectDrawSupported();
+    // Once per map, with every tile model it can show. Models can have no instances yet
+    void BuildTileBatches(std::vector< std::shared_ptr<cRenderModel> >& tileModels);
+    void ClearTileBatches();
+    // One bucket of a tile model, its own buffer and the batches it's in only get that range uploaded
+    void SetTileInstances(std::shared_ptr<cRenderModel> model, int key, const std::vector<glm::vec4>& offsets);
+    void RemoveTileInstances(std::shared_ptr<cRenderModel> model, int key);
+
     // Textures
 private:
     std::map<std::string, sTexture> textures;
     unsigned int CreateTexture(const std::string fullPath, int& width, int& height);
+    unsigned int placeholderPixel = 0; // transparent, what async textures show until they're decoded
+    unsigned int pendingTextureLoadsNum = 0;
 public:
+    bool useAsyncTextureLoading = true; // sprite sheets decode on the job system
+    // Decoding doesn't touch GL, safe on a worker thread
+    static bool DecodeImage(const std::string& fullPath, sDecodedImage& imageOut);
+    // Creates a texture when textureId is 0, otherwise replaces that texture's image
+    unsigned int UploadTexture(const sDecodedImage& image, unsigned int textureId = 0);
+    unsigned int GetPendingTextureLoadsNum() { return pendingTextureLoadsNum; }
     void LoadTexture(const std::string fileName, const std::string subdirectory = "");
+    void ReleaseTexture(const std::string& fileName);
     void UnloadTextures();
     unsigned int CreateCubemap(const std::vector<std::string> faces); // TEMP
 
 private:
     std::map<std::string, sSpriteSheet> spriteSheets;
+    void CreateSpriteSheet(const std::string& sheetName, const std::string& fullPath, unsigned int cols, unsigned int rows, bool sym);
 public:
     void LoadRoamingPokemonFormSpriteSheet(const int nationalDexId, const std::string formTag = "");
+    void ReleaseRoamingPokemonFormSpriteSheet(const int nationalDexId, const std::string formTag = "");
     void LoadSpriteSheet(const std::string spriteSheetName, unsigned int cols, unsigned int rows, bool sym = false, const std::string subdirectory = "");
+    void ReleaseSpriteSheet(const std::string& sheetName); // once per load, battle sheets included
     void LoadRoamingPokemonSpecieTextures(const Pokemon::sSpeciesData& specieData);
+    void ReleaseRoamingPokemonSpecieTextures(const Pokemon::sSpeciesData& specieData);
     float LoadPokemonBattleSpriteSheet(Pokemon::sIndividualData& data, bool isFront = true); // kinda wanted to make this const but whatever
 
-    void SetupSpriteSheet(const std::string sheetName, const int spriteId, const unsigned int shaderTextureUnit = 0);
-    void SetupTexture(const std::string textureToSetup, const unsigned int shaderTextureUnit = 0);
+    void SetupSpriteSheet(const std::string& sheetName, const int spriteId, const unsigned int shaderTextureUnit = 0);
+    void SetupTexture(const std::string& textureToSetup, const unsigned int shaderTextureUnit = 0);
+    unsigned int FindTextureId(const std::string& textureName);
+
+    // Sprite batch, overworld sheets are copied into texture arrays by layer size so the sprite models are one instanced draw per array
+private:
+    static const int SPRITE_ARRAY_MIN_LAYER_SIZE = 128;
+    static const int SPRITE_ARRAY_MAX_LAYER_SIZE = 1024; // bigger sheets are only drawn from their own texture
+    static const unsigned int SPRITE_ARRAY_START_LAYERS = 16;
+    static const unsigned int SPRITE_ARRAY_TEXTURE_UNIT = 2;
+    std::vector<sSpriteArray> spriteArrays; // smallest layer size first
+    unsigned int spriteCopyFBO = 0; // reads the old layers when an array grows
+    unsigned int spriteInstanceBufferId = 0;
+    unsigned int spriteInstanceCapacity = 0; // in instances
+    std::vector<sSpriteInstance> spriteInstances; // grouped by array
+    MeshHandle spriteBatchMesh = INVALID_MESH_HANDLE;
+    unsigned int FindSpriteArray(int layerSize);
+    void GrowSpriteArray(sSpriteArray& spriteArray);
+    void AddToSpriteArray(sSpriteSheet& sheet, const sDecodedImage& image);
+    void RemoveFromSpriteArray(sSpriteSheet& sheet);
+    void BuildSpriteBatch();
+    void DrawSpriteBatch();
+public:
+    bool useSpriteArray = true;
+    unsigned int GetSpriteLayersUsed();
+    unsigned int GetSpriteArraysNum();
+    unsigned int GetSpriteBatchSize();
+
+    // Culling, model bounds against the camera frustum and the shadow map's box
+private:
+    cFrustumCuller culler;
+    sFrustum cameraFrustum;
+    sFrustum shadowFrustum;
+    std::vector<uint8_t> passVisibility;
+    std::vector<uint8_t> shadowVisibility;
+    std::vector<cRenderModel*> bucketedModels;
+    std::vector<sDrawElementsIndirectCommand> visibleTileCommands;
+    void CalculateLightMatrices(glm::mat4& outProjection, glm::mat4& outView);
+    void CullModels(std::vector< std::shared_ptr<cRenderModel> >& models);
+    void CullInstanceBuckets(std::vector< std::shared_ptr<cRenderModel> >& models);
+public:
+    bool useFrustumCulling = true;
+    float drawDistance = 60.f; // models further from the camera are culled from the main pass, 0 for the camera's far plane
+
+    // Render queue
+private:
+    cRenderQueue renderQueue;
+    void QueueModels(std::vector< std::shared_ptr<cRenderModel> >& models);
+    void DrawQueue(eRenderPass pass, eShadowCasters casters = ALL_CASTERS);
+public:
+    bool useRenderQueue = true; // false falls back to drawing models in insertion order
+
+    // Stats
+private:
+    sRenderStats frameStats;
+    sRenderStats lastFrameStats;
+public:
+    const sRenderStats& GetLastFrameStats();
 
     // Drawing
 private:
-    void DrawObject(std::shared_ptr<cRenderModel> model);
+    void SetupModelUniforms(cRenderModel* model, unsigned int objectIndex);
+    void DrawObject(std::shared_ptr<cRenderModel> model, unsigned int objectIndex, eRenderPass pass);
+    void DrawInstances(cRenderModel* model, eRenderPass pass, unsigned int numberOfIndices, unsigned int firstIndex, unsigned int baseVertex);
     void DrawParticles(class cParticleSpawner* spawner);
     void DrawShadowPass(glm::mat4& outLightSpaceMatrix);
 public:
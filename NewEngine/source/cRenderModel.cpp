@@ -1,5 +1,7 @@
 #include "cRenderModel.h"
 #include <glad/glad.h>
+#include <cfloat>
+#include <algorithm>
 
 #include "Engine.h"
 #include "cRenderManager.h"
@@ -12,6 +14,16 @@ cRenderModel::cRenderModel()
 
 	isWireframe = false;
 	isInstanced = false;
+	instancedNum = 0;
+	instanceOffsetsMin = glm::vec3(0.f);
+	instanceOffsetsMax = glm::vec3(0.f);
+	isDrawnIndirect = false;
+	isInSpriteBatch = false;
+	isDynamicShadowCaster = false;
+
+	worldBoundsMin = glm::vec3(-FLT_MAX);
+	worldBoundsMax = glm::vec3(FLT_MAX);
+	visiblePasses = 0xFF;
 	useWholeColor = false;
 
 	wholeColor = glm::vec4(1.f, 1.f, 1.f, 1.f);
@@ -20,29 +32,202 @@ cRenderModel::cRenderModel()
 	textureName = "";
 
 	shaderName = "scene";
+	meshHandle = INVALID_MESH_HANDLE;
 }
 
 cRenderModel::~cRenderModel()
 {
 }
 
-void cRenderModel::InstanceObject(std::vector<glm::vec4>& offsets)
+const std::string& cRenderModel::GetMeshName() const
+{
+	return meshName;
+}
+
+const std::string& cRenderModel::GetShaderName() const
+{
+	return shaderName;
+}
+
+void cRenderModel::SetMeshName(const std::string& newMeshName)
+{
+	meshName = newMeshName;
+	meshHandle = INVALID_MESH_HANDLE;
+}
+
+void cRenderModel::SetShaderName(const std::string& newShaderName)
+{
+	shaderName = newShaderName;
+	meshHandle = INVALID_MESH_HANDLE;
+}
+
+MeshHandle cRenderModel::GetMeshHandle()
 {
+	if (meshHandle == INVALID_MESH_HANDLE)
+		meshHandle = Manager::render.GetMeshHandle(meshName, shaderName);
+
+	return meshHandle;
+}
+
+void cRenderModel::InstanceObject(std::vector<glm::vec4>& offsets, const std::vector<unsigned int>& bucketSizes)
+{
+	// Instanced again when streamed quadrants come and go, keep the same buffer
+	if (!isInstanced)
+		glGenBuffers(1, &(instanceOffsetsBufferId));
+
 	isInstanced = true;
 	instancedNum = offsets.size();
+	instanceOffsets = offsets;
+
+	// Packed with no holes
+	unsigned int allocatedOffset;
+	instanceAllocator.Reset((unsigned int)offsets.size());
+	instanceAllocator.Allocate((unsigned int)offsets.size(), allocatedOffset);
+
+	// Whatever the sizes don't cover goes in one last bucket
+	std::vector<unsigned int> sizes = bucketSizes;
+	unsigned int bucketedNum = 0;
+	for (unsigned int i = 0; i < sizes.size(); i++)
+	{
+		bucketedNum += sizes[i];
+	}
+	if (bucketedNum < offsets.size())
+		sizes.push_back((unsigned int)offsets.size() - bucketedNum);
+
+	instanceBuckets.clear();
+
+	unsigned int firstInstance = 0;
+	for (unsigned int i = 0; i < sizes.size(); i++)
+	{
+		if (sizes[i] == 0) continue;
+
+		sInstanceBucket newBucket;
+		newBucket.key = (int)i;
+		newBucket.firstInstance = firstInstance;
+		newBucket.instancesNum = sizes[i];
+		newBucket.visiblePasses = 0xFF;
+		newBucket.offsetsMin = glm::vec3(offsets[firstInstance]);
+		newBucket.offsetsMax = newBucket.offsetsMin;
+		for (unsigned int instance = firstInstance + 1; instance < firstInstance + sizes[i]; instance++)
+		{
+			newBucket.offsetsMin = glm::min(newBucket.offsetsMin, glm::vec3(offsets[instance]));
+			newBucket.offsetsMax = glm::max(newBucket.offsetsMax, glm::vec3(offsets[instance]));
+		}
+
+		instanceBuckets.push_back(newBucket);
+		firstInstance += sizes[i];
+	}
+
+	UpdateInstanceBounds();
 
 	// Generate offsets buffer
-	glGenBuffers(1, &(instanceOffsetsBufferId));
 	glBindBuffer(GL_ARRAY_BUFFER, instanceOffsetsBufferId);
 
 	glBufferData(GL_ARRAY_BUFFER,
 		sizeof(glm::vec4) * offsets.size(),
-		(GLvoid*)&offsets[0],
+		offsets.empty() ? nullptr : (GLvoid*)&offsets[0],
 		GL_STATIC_DRAW);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // isn't this supposed to be a GL_ARRAY_BUFFER ?
 }
 
+void cRenderModel::SetInstanceBucket(int key, const std::vector<glm::vec4>& offsets)
+{
+	RemoveInstanceBucket(key);
+
+	if (!isInstanced)
+	{
+		glGenBuffers(1, &(instanceOffsetsBufferId));
+		isInstanced = true;
+	}
+
+	if (offsets.empty()) return;
+
+	unsigned int bucketSize = (unsigned int)offsets.size();
+	unsigned int firstInstance;
+	bool isBufferGrown = false;
+	if (!instanceAllocator.Allocate(bucketSize, firstInstance))
+	{
+		unsigned int oldCapacity = instanceAllocator.GetCapacity();
+		unsigned int newCapacity = oldCapacity * 2 > oldCapacity + bucketSize ? oldCapacity * 2 : oldCapacity + bucketSize;
+		instanceAllocator.Grow(newCapacity);
+		instanceAllocator.Allocate(bucketSize, firstInstance);
+		instanceOffsets.resize(newCapacity, glm::vec4(0.f));
+		isBufferGrown = true;
+	}
+
+	std::copy(offsets.begin(), offsets.end(), instanceOffsets.begin() + firstInstance);
+	instancedNum += bucketSize;
+
+	sInstanceBucket newBucket;
+	newBucket.key = key;
+	newBucket.firstInstance = firstInstance;
+	newBucket.instancesNum = bucketSize;
+	newBucket.visiblePasses = 0xFF;
+	newBucket.offsetsMin = glm::vec3(offsets[0]);
+	newBucket.offsetsMax = newBucket.offsetsMin;
+	for (unsigned int i = 1; i < bucketSize; i++)
+	{
+		newBucket.offsetsMin = glm::min(newBucket.offsetsMin, glm::vec3(offsets[i]));
+		newBucket.offsetsMax = glm::max(newBucket.offsetsMax, glm::vec3(offsets[i]));
+	}
+
+	// Buckets stay in buffer order so draws can still join neighbouring ones
+	unsigned int insertAt = 0;
+	while (insertAt < instanceBuckets.size() && instanceBuckets[insertAt].firstInstance < firstInstance)
+	{
+		insertAt++;
+	}
+	instanceBuckets.insert(instanceBuckets.begin() + insertAt, newBucket);
+
+	UpdateInstanceBounds();
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceOffsetsBufferId);
+	if (isBufferGrown)
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * instanceOffsets.size(), &instanceOffsets[0], GL_STATIC_DRAW);
+	else
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * firstInstance, sizeof(glm::vec4) * bucketSize, &offsets[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cRenderModel::RemoveInstanceBucket(int key)
+{
+	for (unsigned int i = 0; i < instanceBuckets.size(); i++)
+	{
+		if (instanceBuckets[i].key != key) continue;
+
+		// Nothing reads the range once its bucket is gone, so the buffer isn't touched
+		instanceAllocator.Free(instanceBuckets[i].firstInstance, instanceBuckets[i].instancesNum);
+		instancedNum -= instanceBuckets[i].instancesNum;
+		instanceBuckets.erase(instanceBuckets.begin() + i);
+
+		UpdateInstanceBounds();
+		return;
+	}
+}
+
+const sInstanceBucket* cRenderModel::FindInstanceBucket(int key) const
+{
+	for (unsigned int i = 0; i < instanceBuckets.size(); i++)
+	{
+		if (instanceBuckets[i].key == key) return &instanceBuckets[i];
+	}
+
+	return nullptr;
+}
+
+void cRenderModel::UpdateInstanceBounds()
+{
+	instanceOffsetsMin = glm::vec3(0.f);
+	instanceOffsetsMax = glm::vec3(0.f);
+
+	for (unsigned int i = 0; i < instanceBuckets.size(); i++)
+	{
+		instanceOffsetsMin = i == 0 ? instanceBuckets[i].offsetsMin : glm::min(instanceOffsetsMin, instanceBuckets[i].offsetsMin);
+		instanceOffsetsMax = i == 0 ? instanceBuckets[i].offsetsMax : glm::max(instanceOffsetsMax, instanceBuckets[i].offsetsMax);
+	}
+}
+
 // This might change when dynamic map loading is implemented (not using a general texture map)
 void cRenderModel::SetUpUniforms()
 {
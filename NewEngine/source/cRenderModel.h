@@ -2,6 +2,19 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
+#include "DrawInfo.h"
+#include "cMeshArena.h"
+
+// A run of instance offsets that are close together, culled on its own
+struct sInstanceBucket
+{
+	int key; // who set it, a streamed quadrant's cell or the bucket's index for InstanceObject
+	unsigned int firstInstance;
+	unsigned int instancesNum;
+	glm::vec3 offsetsMin;
+	glm::vec3 offsetsMax;
+	unsigned char visiblePasses; // bit per eRenderPass, set by the culling stage
+};
 
 class cRenderModel
 {
@@ -10,7 +23,16 @@ public:
 	cRenderModel();
 	~cRenderModel();
 
+private:
 	std::string meshName;
+	std::string shaderName;
+	MeshHandle meshHandle; // resolved on first use, reset when the mesh or shader changes
+public:
+	const std::string& GetMeshName() const;
+	const std::string& GetShaderName() const;
+	void SetMeshName(const std::string& newMeshName);
+	void SetShaderName(const std::string& newShaderName);
+	MeshHandle GetMeshHandle();
 
 	glm::vec3 position;
 	glm::vec3 orientation;
@@ -20,16 +42,35 @@ public:
 
 	bool isInstanced;
 	unsigned int instanceOffsetsBufferId;
-	unsigned int instancedNum;
+	unsigned int instancedNum; // live offsets, the buffer can have holes where buckets were removed
+	std::vector<glm::vec4> instanceOffsets; // what's in the buffer, tile batches are built from this copy
+	cArenaAllocator instanceAllocator; // ranges of the buffer, buckets set one at a time take theirs from it
+	glm::vec3 instanceOffsetsMin; // range of the instance offsets, the bounds grow by it
+	glm::vec3 instanceOffsetsMax;
+	std::vector<sInstanceBucket> instanceBuckets; // in buffer order, empty ones are left out
+	bool isDrawnIndirect; // part of a tile batch, skipped by the regular draw
+	bool isInSpriteBatch; // drawn by this frame's sprite batch, skipped by the regular draw
+	bool isDynamicShadowCaster; // redrawn into the shadow map every frame, everything else goes in the shadow cache
+
+	// World space, updated every frame from the mesh bounds. Infinite until the mesh is loaded
+	glm::vec3 worldBoundsMin;
+	glm::vec3 worldBoundsMax;
+	unsigned char visiblePasses; // bit per eRenderPass, set by the culling stage
 
 	bool useWholeColor;
 	glm::vec4 wholeColor;
 
 	std::string textureName;
 
-	std::string shaderName;
-
-	void InstanceObject(std::vector<glm::vec4>& offsets);
+	// bucketSizes splits the offsets into consecutive buckets, all of them are one bucket when it's empty
+	void InstanceObject(std::vector<glm::vec4>& offsets, const std::vector<unsigned int>& bucketSizes = std::vector<unsigned int>());
+	// Replaces one bucket and only uploads its range, the whole buffer is uploaded again when it has to grow
+	void SetInstanceBucket(int key, const std::vector<glm::vec4>& offsets);
+	void RemoveInstanceBucket(int key); // its range is left as a hole for the next bucket
+	const sInstanceBucket* FindInstanceBucket(int key) const;
+private:
+	void UpdateInstanceBounds();
+public:
 
 	virtual void SetUpUniforms();
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "cRenderQueue.h"
+
+#include <tracy/tracy/Tracy.hpp>
+
+cRenderQueue::cRenderQueue()
+{
+}
+
+cRenderQueue::~cRenderQueue()
+{
+}
+
+uint64_t cRenderQueue::MakeSortKey(eRenderPass pass, unsigned int programId, unsigned int textureId, unsigned int vaoId)
+{
+	uint64_t key = 0;
+	key |= ((uint64_t)pass & 0xF) << 60;
+	key |= ((uint64_t)programId & 0xFFF) << 48;
+	key |= ((uint64_t)textureId & 0xFFFFFF) << 24;
+	key |= ((uint64_t)vaoId & 0xFFFFFF);
+
+	return key;
+}
+
+eRenderPass cRenderQueue::GetPassFromKey(uint64_t key)
+{
+	return static_cast<eRenderPass>((key >> 60) & 0xF);
+}
+
+void cRenderQueue::Clear()
+{
+	commands.clear();
+	entries.clear();
+}
+
+void cRenderQueue::Push(eRenderPass pass, const sRenderCommand& command)
+{
+	sRenderSortEntry newEntry;
+	newEntry.key = MakeSortKey(pass, command.programId, command.textureId, command.VAO_ID);
+	newEntry.commandIndex = (unsigned int)commands.size();
+
+	commands.push_back(command);
+	entries.push_back(newEntry);
+}
+
+// LSD radix sort, 8 bits per pass. Stable, so objects with the same key keep their insertion order
+void cRenderQueue::Sort()
+{
+	ZoneScopedN("RenderQueueSort");
+
+	const unsigned int count = (unsigned int)entries.size();
+	if (count < 2) return;
+
+	sortBuffer.resize(count);
+
+	sRenderSortEntry* src = entries.data();
+	sRenderSortEntry* dst = sortBuffer.data();
+
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int histogram[256] = { 0 };
+		for (unsigned int i = 0; i < count; i++)
+		{
+			histogram[(src[i].key >> shift) & 0xFF]++;
+		}
+
+		// Every key has the same byte here, nothing to reorder
+		if (histogram[(src[0].key >> shift) & 0xFF] == count) continue;
+
+		unsigned int offset = 0;
+		for (unsigned int bucket = 0; bucket < 256; bucket++)
+		{
+			unsigned int bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+		}
+
+		sRenderSortEntry* temp = src;
+		src = dst;
+		dst = temp;
+	}
+
+	// Odd number of swaps leaves the result in the scratch buffer
+	if (src != entries.data())
+		entries.swap(sortBuffer);
+}
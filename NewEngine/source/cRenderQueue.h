@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DrawInfo.h"
+
+class cRenderModel;
+
+enum eRenderPass
+{
+	SHADOW_PASS,	// 0
+	MAIN_PASS		// 1
+};
+
+// One draw of one mesh of a model
+struct sRenderCommand
+{
+	cRenderModel* model;
+	MeshHandle meshHandle;
+	unsigned int meshIndex;
+	unsigned int objectIndex; // into the per frame object transforms
+
+	unsigned int programId;
+	unsigned int textureId;
+	unsigned int VAO_ID;
+	unsigned int baseVertex;
+	unsigned int firstIndex;
+	unsigned int numberOfIndices;
+};
+
+// Sort key layout (most significant first):
+// | pass (4 bits) | program (12 bits) | texture (24 bits) | VAO (24 bits) |
+struct sRenderSortEntry
+{
+	uint64_t key;
+	unsigned int commandIndex;
+};
+
+class cRenderQueue
+{
+public:
+	cRenderQueue();
+	~cRenderQueue();
+
+	static uint64_t MakeSortKey(eRenderPass pass, unsigned int programId, unsigned int textureId, unsigned int vaoId);
+	static eRenderPass GetPassFromKey(uint64_t key);
+
+private:
+	std::vector<sRenderCommand> commands;
+	std::vector<sRenderSortEntry> entries;
+	std::vector<sRenderSortEntry> sortBuffer; // radix sort ping-pong buffer, kept to avoid per frame allocations
+public:
+	void Clear();
+	void Push(eRenderPass pass, const sRenderCommand& command);
+	void Sort();
+
+	unsigned int Size() const { return (unsigned int)entries.size(); }
+	const sRenderSortEntry& GetEntry(unsigned int index) const { return entries[index]; }
+	const sRenderCommand& GetCommand(const sRenderSortEntry& entry) const { return commands[entry.commandIndex]; }
+};
@@ -10,6 +10,7 @@
 #include "cRenderManager.h"
 #include "cInputManager.h"
 #include "CanvasFactory.h"
+#include "cJobSystem.h"
 
 #include <tracy/tracy/Tracy.hpp>
 
@@ -43,6 +44,14 @@ void cSceneManager::SetWeather(eEnvironmentWeather newWeather)
 	if ((currWeather == SNOW || currWeather == HAIL || currWeather == SNOWSTORM) // snow transition
 		&& (newWeather == SNOW || newWeather == HAIL || newWeather == SNOWSTORM))
 	{
+		// Storm particles don't fit in the snow spawner, going in or out of one starts over
+		if (newWeather == SNOWSTORM || currWeather == SNOWSTORM)
+		{
+			currWeather = NONE;
+			SetWeather(newWeather);
+			return;
+		}
+
 		if (newWeather == SNOW)
 		{
 
@@ -79,8 +88,8 @@ void cSceneManager::SetWeather(eEnvironmentWeather newWeather)
 			fogColor = glm::vec3(0.89f, 0.89f, 0.89f);
 
 			cRenderModel prtcl;
-			prtcl.meshName = "ParticleHolder.obj";
-			prtcl.shaderName = "snow";
+			prtcl.SetMeshName("ParticleHolder.obj");
+			prtcl.SetShaderName("snow");
 			prtcl.textureName = "SnowFlake3.png";
 			prtcl.scale = glm::vec3(0.6f);
 
@@ -102,7 +111,27 @@ void cSceneManager::SetWeather(eEnvironmentWeather newWeather)
 		}
 		else if (newWeather == SNOWSTORM)
 		{
+			fogDensity = 0.09f;
+			fogGradient = 0.6f;
+			fogColor = glm::vec3(0.85f, 0.87f, 0.9f);
+
+			cRenderModel prtcl;
+			prtcl.SetMeshName("ParticleHolder.obj");
+			prtcl.SetShaderName("snow");
+			prtcl.textureName = "SnowFlake3.png";
+			prtcl.scale = glm::vec3(0.35f);
 
+			// Fills the whole view around the player, blown sideways
+			weatherParticleSpawner = new cParticleSpawner(glm::vec3(0.f, 13.f, 0.f), prtcl, 100000);
+			weatherParticleSpawner->minPositionOffset = glm::vec3(-30.f, -12.f, -30.f);
+			weatherParticleSpawner->maxPositionOffset = glm::vec3(30.f, 4.f, 30.f);
+			weatherParticleSpawner->isPositionPlayerRelative = true;
+			weatherParticleSpawner->spawnSpeed = glm::vec3(6.f, -5.f, 2.f);
+			weatherParticleSpawner->minSpeedOffset = glm::vec3(-2.f, -1.f, -2.f);
+			weatherParticleSpawner->maxSpeedOffset = glm::vec3(2.f, 1.f, 2.f);
+			weatherParticleSpawner->particleLifeTime = 4.f;
+			weatherParticleSpawner->spawnRate = weatherParticleSpawner->particleLifeTime / 100000.f;
+			weatherParticleSpawner->SetGpuSimulation(useGpuStormParticles);
 		}
 		else if (newWeather == RAIN)
 		{
@@ -114,7 +143,28 @@ void cSceneManager::SetWeather(eEnvironmentWeather newWeather)
 		}
 		else if (newWeather == SANDSTORM)
 		{
+			fogDensity = 0.08f;
+			fogGradient = 0.55f;
+			fogColor = glm::vec3(0.76f, 0.6f, 0.42f);
 
+			cRenderModel prtcl;
+			prtcl.SetMeshName("ParticleHolder.obj");
+			prtcl.SetShaderName("snow");
+			prtcl.useWholeColor = true;
+			prtcl.wholeColor = glm::vec4(0.78f, 0.62f, 0.4f, 1.f);
+			prtcl.scale = glm::vec3(0.12f);
+
+			// Fast grains blowing mostly along the ground
+			weatherParticleSpawner = new cParticleSpawner(glm::vec3(-30.f, 4.f, 0.f), prtcl, 100000);
+			weatherParticleSpawner->minPositionOffset = glm::vec3(0.f, -4.f, -30.f);
+			weatherParticleSpawner->maxPositionOffset = glm::vec3(10.f, 8.f, 30.f);
+			weatherParticleSpawner->isPositionPlayerRelative = true;
+			weatherParticleSpawner->spawnSpeed = glm::vec3(16.f, -0.5f, 3.f);
+			weatherParticleSpawner->minSpeedOffset = glm::vec3(-3.f, -1.f, -2.f);
+			weatherParticleSpawner->maxSpeedOffset = glm::vec3(3.f, 1.f, 2.f);
+			weatherParticleSpawner->particleLifeTime = 3.5f;
+			weatherParticleSpawner->spawnRate = weatherParticleSpawner->particleLifeTime / 100000.f;
+			weatherParticleSpawner->SetGpuSimulation(useGpuStormParticles);
 		}
 		else if (newWeather == LEAVES)
 		{
@@ -153,6 +203,7 @@ void cSceneManager::LoadSpawnData(const int nationalDexId, const int minLevel, c
 	spawnData.isSpriteGenderBased = specieData.isSpriteGenderBased;
 
 	loadedSpawnData.push_back(spawnData);
+	loadedSpawnSpecieData.push_back(specieData);
 }
 
 std::shared_ptr<cWildRoamingPokemon> cSceneManager::SpawnRandomWildPokemon()
@@ -168,25 +219,25 @@ std::shared_ptr<cWildRoamingPokemon> cSceneManager::SpawnRandomWildPokemon()
 	if (spawnData.spawnType == Pokemon::TALL_GRASS)
 	{
 		glm::vec3 spawnTilePos;
-		sTile* spawnTile = Manager::map.GetRandomSpawnTile(spawnTilePos);
+		sTile spawnTile = Manager::map.GetRandomSpawnTile(spawnTilePos);
 
-		if (spawnTile)
+		if (spawnTile.IsValid())
 			spawnedWildPokemon = SpawnWildPokemon(spawnData, spawnTilePos, spawnTile);
 	}
 	
 	return spawnedWildPokemon;
 }
 
-std::shared_ptr<cWildRoamingPokemon> cSceneManager::SpawnWildPokemon(const Pokemon::sSpawnData& spawnData, glm::vec3 tileLocation, sTile* spawnTile)
+std::shared_ptr<cWildRoamingPokemon> cSceneManager::SpawnWildPokemon(const Pokemon::sSpawnData& spawnData, glm::vec3 tileLocation, sTile spawnTile)
 {
-	if (!spawnTile) return nullptr;
+	if (!spawnTile.IsValid()) return nullptr;
 
 	Pokemon::sRoamingPokemonData roamingData = Pokemon::GenerateRoamingPokemonData(spawnData);
 
 	std::shared_ptr<cWildRoamingPokemon> newWildPokemon = std::make_shared<cWildRoamingPokemon>(roamingData, tileLocation);
 	roamingWildPokemon.push_back(newWildPokemon);
 
-	spawnTile->entity = newWildPokemon.get();
+	spawnTile.SetEntity(newWildPokemon.get());
 
 	return newWildPokemon;
 }
@@ -203,15 +254,31 @@ void cSceneManager::DespawnWildPokemon(cWildRoamingPokemon* pokemonToDespawn)
 	}
 }
 
+void cSceneManager::DespawnWildPokemonInQuadrant(int quadX, int quadZ)
+{
+	for (unsigned int i = 0; i < roamingWildPokemon.size(); )
+	{
+		glm::ivec2 quadCoords = cMapManager::GetQuadCoords(roamingWildPokemon[i]->position);
+		if (quadCoords.x != quadX || quadCoords.y != quadZ)
+		{
+			i++;
+			continue;
+		}
+
+		// Its destructor takes it off its tile while the quadrant is still there
+		roamingWildPokemon.erase(roamingWildPokemon.begin() + i);
+	}
+}
+
 std::shared_ptr<cTamedRoamingPokemon> cSceneManager::SpawnTamedPokemon(Pokemon::sRoamingPokemonData& pokemonData, glm::vec3 tileLocation)
 {
-	sTile* spawnTile = Manager::map.GetTile(tileLocation);
-	if (!spawnTile || spawnTile->entity != nullptr) return nullptr;
+	sTile spawnTile = Manager::map.GetTile(tileLocation);
+	if (!spawnTile.IsValid() || spawnTile.GetEntity() != nullptr) return nullptr;
 
 	std::shared_ptr<cTamedRoamingPokemon> newTamedPokemon = std::make_shared<cTamedRoamingPokemon>(pokemonData, tileLocation);
 	roamingTamedPokemon.push_back(newTamedPokemon);
 
-	spawnTile->entity = newTamedPokemon.get();
+	spawnTile.SetEntity(newTamedPokemon.get());
 
 	return newTamedPokemon;
 }
@@ -229,21 +296,182 @@ void cSceneManager::ChangeScene(const std::string newSceneDescFile, const int en
 
 	// TODO: despawn all entities and remove all particle spawners
 
+	if (transitionStage != TRANSITION_NONE) return; // already on its way somewhere
+
+	if (!useAsyncTransitions)
+	{
+		UnloadScene();
+
+		Pokemon::sSpeciesData followerSpecieData;
+		Pokemon::LoadSpecieData(Player::party[0].nationalDexNumber, followerSpecieData);
+		Manager::map.LoadMap(newSceneDescFile, entranceNumUsed);
+		FinishLoadingScene(followerSpecieData);
+		Manager::render.TrimAssetCache();
+		return;
+	}
+
+	// This is usually called from inside TryMoveEntity, so nothing is torn down until Process
+	transition = std::make_shared<sSceneTransition>();
+	transition->sceneDescFile = newSceneDescFile;
+	transition->entranceNumUsed = entranceNumUsed;
+	transition->cookMeshes = Manager::render.useMeshCache;
+	transition->compileMaps = Manager::map.useCompiledMaps;
+	transition->streamMap = Manager::map.useQuadrantStreaming;
+	transition->followerDexNumber = Player::party[0].nationalDexNumber;
+
+	transitionStage = TRANSITION_PREPARING;
+	transitionStats = sSceneTransitionStats();
+	transitionStart = std::chrono::high_resolution_clock::now();
+	Manager::input.ChangeInputState(IS_NONE);
+
+	// The old scene keeps rendering while the worker does the file work
+	std::shared_ptr<sSceneTransition> newTransition = transition;
+	Manager::jobs.Submit(
+		[newTransition]()
+		{
+			ZoneScopedN("SceneTransitionPrepare");
+
+			cMapManager::PrepareMap(newTransition->sceneDescFile, newTransition->compileMaps, newTransition->streamMap, newTransition->modelFiles);
+
+			if (newTransition->cookMeshes)
+			{
+				for (unsigned int i = 0; i < newTransition->modelFiles.size(); i++)
+				{
+					cRenderManager::CookModel(newTransition->modelFiles[i]);
+				}
+			}
+
+			Pokemon::LoadSpecieData(newTransition->followerDexNumber, newTransition->followerSpecieData);
+		},
+		[this, newTransition]()
+		{
+			if (newTransition != transition) return;
+
+			std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - transitionStart;
+			transitionStats.prepareMs = elapsed.count();
+
+			// Without the cache unloading drops every model, so the old scene has to go before anything is uploaded
+			transitionStage = Manager::render.useAssetCache ? TRANSITION_UPLOADING : TRANSITION_UNLOADING;
+		});
+}
+
+void cSceneManager::ProcessTransition()
+{
+	if (transitionStage == TRANSITION_NONE || transitionStage == TRANSITION_PREPARING) return;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	if (transitionStage == TRANSITION_UNLOADING)
+	{
+		ZoneScopedN("SceneTransitionUnload");
+
+		// The uploads' references keep the new scene's models alive through this
+		UnloadScene();
+		transition->isOldSceneUnloaded = true;
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		transitionStats.unloadMs = elapsed.count();
+		transitionStage = transition->uploadedModelsNum < transition->modelFiles.size() ? TRANSITION_UPLOADING : TRANSITION_LOADING_MAP;
+	}
+	else if (transitionStage == TRANSITION_UPLOADING)
+	{
+		ZoneScopedN("SceneTransitionUpload");
+
+		// Meshes are already cooked, so each one is a mapped read plus the arena and texture uploads
+		std::chrono::duration<float, std::milli> elapsed(0.f);
+		while (transition->uploadedModelsNum < transition->modelFiles.size() && elapsed.count() < transitionBudgetMs)
+		{
+			Manager::render.LoadModel(transition->modelFiles[transition->uploadedModelsNum], "scene");
+			transition->uploadedModelsNum++;
+
+			elapsed = std::chrono::high_resolution_clock::now() - start;
+		}
+
+		transitionStats.uploadMs += elapsed.count();
+		transitionStats.uploadFrames++;
+
+		if (transition->uploadedModelsNum == transition->modelFiles.size())
+			transitionStage = transition->isOldSceneUnloaded ? TRANSITION_LOADING_MAP : TRANSITION_UNLOADING;
+	}
+	else if (transitionStage == TRANSITION_LOADING_MAP)
+	{
+		ZoneScopedN("SceneTransitionLoadMap");
+
+		// The descriptions get a frame to themselves, the quadrants and batches share the upload budget after that
+		bool isMapLoaded = false;
+		if (!transition->isMapLoadStarted)
+		{
+			Manager::map.BeginLoadingMap(transition->sceneDescFile, transition->entranceNumUsed);
+			transition->isMapLoadStarted = true;
+		}
+		else
+		{
+			isMapLoaded = Manager::map.ContinueLoadingMap(transitionBudgetMs);
+		}
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		transitionStats.loadMapMs += elapsed.count();
+		transitionStats.loadMapFrames++;
+
+		if (isMapLoaded)
+			transitionStage = TRANSITION_FINISHING;
+	}
+	else if (transitionStage == TRANSITION_FINISHING)
+	{
+		ZoneScopedN("SceneTransitionFinish");
+
+		FinishLoadingScene(transition->followerSpecieData);
+
+		// The map took its own references, the uploads only had to keep them from being loaded again
+		for (unsigned int i = 0; i < transition->uploadedModelsNum; i++)
+		{
+			Manager::render.ReleaseModel(transition->modelFiles[i]);
+		}
+
+		// Whatever the old scene used and this one didn't can go now
+		Manager::render.TrimAssetCache();
+
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+		std::chrono::duration<float, std::milli> elapsed = end - start;
+		std::chrono::duration<float, std::milli> total = end - transitionStart;
+		transitionStats.finishMs = elapsed.count();
+		transitionStats.totalMs = total.count();
+
+		transition.reset();
+		transitionStage = TRANSITION_NONE;
+		Manager::input.ChangeInputState(OVERWORLD_MOVEMENT);
+	}
+}
+
+void cSceneManager::UnloadScene()
+{
 	Manager::map.UnloadMap();
 
-	Manager::render.UnloadModels();
-	Manager::render.UnloadTextures();
+	for (unsigned int i = 0; i < loadedSpawnSpecieData.size(); i++)
+	{
+		Manager::render.ReleaseRoamingPokemonSpecieTextures(loadedSpawnSpecieData[i]);
+	}
+	loadedSpawnSpecieData.clear();
+
+	if (sceneFollowerSpecieData.nationalDexNumber != 0)
+	{
+		Manager::render.ReleaseRoamingPokemonSpecieTextures(sceneFollowerSpecieData);
+		sceneFollowerSpecieData = Pokemon::sSpeciesData();
+	}
+
+	// Assets the next scene asks for again are picked back up instead of reloaded
+	Manager::render.ReleaseSceneAssets();
 
 	loadedSpawnData.clear();
 	roamingWildPokemon.clear();
 	roamingTamedPokemon.clear();
+}
 
-	Manager::map.LoadMap(newSceneDescFile, entranceNumUsed);
-
+void cSceneManager::FinishLoadingScene(const Pokemon::sSpeciesData& followerSpecieData)
+{
 	// TEMP
-	Pokemon::sSpeciesData followerSpecieData;
-	Pokemon::LoadSpecieData(Player::party[0].nationalDexNumber, followerSpecieData);
 	Manager::render.LoadRoamingPokemonSpecieTextures(followerSpecieData);
+	sceneFollowerSpecieData = followerSpecieData;
 
 	// TEMP
 	// TODO: find a good place to seed the rand
@@ -312,6 +540,8 @@ void cSceneManager::Process(float deltaTime)
 {
 	ZoneScopedN("SceneProcess");
 
+	ProcessTransition();
+
 	if (weatherParticleSpawner)
 	{
 		weatherParticleSpawner->Update(deltaTime);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <chrono>
 #include "cParticleSpawner.h"
 #include "PokemonData.h"
 
@@ -33,6 +35,45 @@ const static char* Weather_Strings[] =
 	"Leaves"
 };
 
+enum eSceneTransitionStage
+{
+	TRANSITION_NONE,
+	TRANSITION_PREPARING,	// worker: parse descriptions, cook meshes, compile collision maps, read species data
+	TRANSITION_UPLOADING,	// main: create the new scene's meshes and textures a few per frame, the old scene is still drawn
+	TRANSITION_UNLOADING,	// main: tear down the old scene
+	TRANSITION_LOADING_MAP,	// main: build the map a few quadrants per frame
+	TRANSITION_FINISHING	// main: spawn entities
+};
+
+// Filled in by the worker stage, consumed by the main thread ones
+struct sSceneTransition
+{
+	std::string sceneDescFile;
+	int entranceNumUsed;
+	bool cookMeshes;
+	bool compileMaps;
+	bool streamMap;
+
+	std::vector<std::string> modelFiles;
+	unsigned int uploadedModelsNum = 0;
+	bool isOldSceneUnloaded = false;
+	bool isMapLoadStarted = false;
+	int followerDexNumber;
+	Pokemon::sSpeciesData followerSpecieData;
+};
+
+struct sSceneTransitionStats
+{
+	float prepareMs = 0.f;
+	float unloadMs = 0.f;
+	float uploadMs = 0.f;
+	unsigned int uploadFrames = 0;
+	float loadMapMs = 0.f;
+	unsigned int loadMapFrames = 0;
+	float finishMs = 0.f;
+	float totalMs = 0.f;
+};
+
 class cSceneManager
 {
 public:
@@ -51,24 +92,40 @@ public:
 	float fogGradient;
 	glm::vec3 fogColor;
 	float windSpeed;
+	bool useGpuStormParticles = true; // storms simulate their particles on the GPU, read on the next weather change
 	void SetWeather(eEnvironmentWeather newWeather);
 
 	// Entities
 private:
 	std::vector<Pokemon::sSpawnData> loadedSpawnData;
+	std::vector<Pokemon::sSpeciesData> loadedSpawnSpecieData; // whose roaming textures loadedSpawnData loaded, released with the scene
+	Pokemon::sSpeciesData sceneFollowerSpecieData; // the follower's textures, loaded again with every scene
 	std::vector<std::shared_ptr<cWildRoamingPokemon>> roamingWildPokemon;
 	std::vector<std::shared_ptr<cTamedRoamingPokemon>> roamingTamedPokemon;
 public:
 	void LoadSpawnData(const int nationalDexId, const int minLevel, const int maxLevel, const Pokemon::eSpawnType spawnType,  const int spawnChance, const std::string formName = "");
 	std::shared_ptr<cWildRoamingPokemon> SpawnRandomWildPokemon();
-	std::shared_ptr<cWildRoamingPokemon> SpawnWildPokemon(const Pokemon::sSpawnData& spawnData, glm::vec3 tileLocation, sTile* spawnTile);
+	std::shared_ptr<cWildRoamingPokemon> SpawnWildPokemon(const Pokemon::sSpawnData& spawnData, glm::vec3 tileLocation, sTile spawnTile);
 	void DespawnWildPokemon(cWildRoamingPokemon* pokemonToDespawn);
+	void DespawnWildPokemonInQuadrant(int quadX, int quadZ); // before the map evicts it
 	std::shared_ptr<cTamedRoamingPokemon> SpawnTamedPokemon(Pokemon::sRoamingPokemonData& pokemonData, glm::vec3 tileLocation);
 
 private:
 	Pokemon::sBattleData enemyBattleData;
+
+	std::shared_ptr<sSceneTransition> transition;
+	eSceneTransitionStage transitionStage = TRANSITION_NONE;
+	sSceneTransitionStats transitionStats;
+	std::chrono::high_resolution_clock::time_point transitionStart;
+	void ProcessTransition();
+	void UnloadScene();
+	void FinishLoadingScene(const Pokemon::sSpeciesData& followerSpecieData);
 public:
+	bool useAsyncTransitions = true;
+	float transitionBudgetMs = 4.f; // main thread time per frame for creating the new scene's GL objects and building its map
 	void ChangeScene(const std::string newSceneDescFile, const int entranceNumUsed);
+	bool IsChangingScene() { return transitionStage != TRANSITION_NONE; }
+	const sSceneTransitionStats& GetTransitionStats() { return transitionStats; }
 	void EnterWildEncounter(const Pokemon::sRoamingPokemonData& roamingPokemonData, cWildRoamingPokemon* roamingEntity);
 	void CatchWildPokemon();
 	void ExitEncounter();
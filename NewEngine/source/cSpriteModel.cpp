@@ -6,7 +6,8 @@
 cSpriteModel::cSpriteModel()
 {
 	currSpriteId = 0;
-	shaderName = "sprite";
+	SetShaderName("sprite");
+	isDynamicShadowCaster = true;
 }
 
 void cSpriteModel::SetUpUniforms()
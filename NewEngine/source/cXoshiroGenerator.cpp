@@ -0,0 +1,149 @@
+#include "cXoshiroGenerator.h"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define XOSHIRO_SSE
+#include <emmintrin.h>
+#endif
+
+static uint64_t seedSequence = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+// splitmix64, spreads one seed over the whole state
+static uint64_t SplitMix(uint64_t& value)
+{
+	uint64_t result = (value += 0x9E3779B97F4A7C15ull);
+	result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ull;
+	result = (result ^ (result >> 27)) * 0x94D049BB133111EBull;
+	return result ^ (result >> 31);
+}
+
+cXoshiroGenerator::cXoshiroGenerator(uint64_t _seed)
+{
+	Seed(_seed);
+}
+
+cXoshiroGenerator::~cXoshiroGenerator()
+{
+}
+
+void cXoshiroGenerator::Seed(uint64_t newSeed)
+{
+	seed = newSeed;
+
+	uint64_t value = newSeed;
+	for (unsigned int lane = 0; lane < LANES_NUM; lane++)
+	{
+		uint64_t first = SplitMix(value);
+		uint64_t second = SplitMix(value);
+		state[0][lane] = (uint32_t)first;
+		state[1][lane] = (uint32_t)(first >> 32);
+		state[2][lane] = (uint32_t)second;
+		state[3][lane] = (uint32_t)(second >> 32);
+
+		// An all zero state never leaves zero
+		if ((state[0][lane] | state[1][lane] | state[2][lane] | state[3][lane]) == 0) state[0][lane] = 1;
+	}
+}
+
+void cXoshiroGenerator::NextGroupScalar(float* out, float min, float range, float upper)
+{
+	// Top 24 bits, exact as a float
+	const float toUnit = 1.f / 16777216.f;
+
+	for (unsigned int lane = 0; lane < LANES_NUM; lane++)
+	{
+		uint32_t result = state[0][lane] + state[3][lane];
+		uint32_t t = state[1][lane] << 9;
+		state[2][lane] ^= state[0][lane];
+		state[3][lane] ^= state[1][lane];
+		state[1][lane] ^= state[2][lane];
+		state[0][lane] ^= state[3][lane];
+		state[2][lane] ^= t;
+		state[3][lane] = (state[3][lane] << 11) | (state[3][lane] >> 21);
+
+		// min + unit * range can round up to max, same select as _mm_min_ps
+		float value = min + (float)(result >> 8) * toUnit * range;
+		out[lane] = value < upper ? value : upper;
+	}
+}
+
+void cXoshiroGenerator::NextGroupSSE(float* out, float min, float range, float upper)
+{
+#ifdef XOSHIRO_SSE
+	const float toUnit = 1.f / 16777216.f;
+
+	for (unsigned int first = 0; first < LANES_NUM; first += 4)
+	{
+		__m128i s0 = _mm_load_si128((const __m128i*)&state[0][first]);
+		__m128i s1 = _mm_load_si128((const __m128i*)&state[1][first]);
+		__m128i s2 = _mm_load_si128((const __m128i*)&state[2][first]);
+		__m128i s3 = _mm_load_si128((const __m128i*)&state[3][first]);
+
+		__m128i result = _mm_add_epi32(s0, s3);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+		_mm_store_si128((__m128i*)&state[0][first], s0);
+		_mm_store_si128((__m128i*)&state[1][first], s1);
+		_mm_store_si128((__m128i*)&state[2][first], s2);
+		_mm_store_si128((__m128i*)&state[3][first], s3);
+
+		__m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), _mm_set1_ps(toUnit));
+		__m128 value = _mm_add_ps(_mm_set1_ps(min), _mm_mul_ps(unit, _mm_set1_ps(range)));
+		_mm_storeu_ps(out + first, _mm_min_ps(value, _mm_set1_ps(upper)));
+	}
+#else
+	NextGroupScalar(out, min, range, upper);
+#endif
+}
+
+void cXoshiroGenerator::Fill(float* out, unsigned int count, float min, float max, bool useSSE)
+{
+	float range = max - min;
+	float upper = max > min ? std::nextafter(max, min) : std::numeric_limits<float>::max();
+
+	unsigned int i = 0;
+	for (; i + LANES_NUM <= count; i += LANES_NUM)
+	{
+		if (useSSE) NextGroupSSE(out + i, min, range, upper);
+		else NextGroupScalar(out + i, min, range, upper);
+	}
+
+	if (i == count) return;
+
+	float group[LANES_NUM];
+	if (useSSE) NextGroupSSE(group, min, range, upper);
+	else NextGroupScalar(group, min, range, upper);
+	for (unsigned int lane = 0; i < count; lane++, i++)
+	{
+		out[i] = group[lane];
+	}
+}
+
+void cXoshiroGenerator::FillUniform(float* out, unsigned int count, float min, float max)
+{
+	Fill(out, count, min, max, true);
+}
+
+void cXoshiroGenerator::FillUniformScalar(float* out, unsigned int count, float min, float max)
+{
+	Fill(out, count, min, max, false);
+}
+
+uint64_t cXoshiroGenerator::NextSeed()
+{
+	return SplitMix(seedSequence);
+}
+
+void cXoshiroGenerator::SetSeedSequence(uint64_t sequenceSeed)
+{
+	seedSequence = sequenceSeed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// xoshiro128+ run as LANES_NUM independent generators side by side, so a batch of draws is a few
+// vector instructions. Same seed and same calls give the same numbers on every path
+class cXoshiroGenerator
+{
+public:
+	static const unsigned int LANES_NUM = 8;
+
+	cXoshiroGenerator(uint64_t _seed = 1);
+	~cXoshiroGenerator();
+
+private:
+	alignas(16) uint32_t state[4][LANES_NUM];
+	uint64_t seed;
+
+	void NextGroupScalar(float* out, float min, float range, float upper);
+	void NextGroupSSE(float* out, float min, float range, float upper);
+	void Fill(float* out, unsigned int count, float min, float max, bool useSSE);
+public:
+	void Seed(uint64_t newSeed);
+	uint64_t GetSeed() const { return seed; }
+
+	// count floats uniform in [min, max). Draws come LANES_NUM at a time, what's left of the last group is dropped
+	void FillUniform(float* out, unsigned int count, float min, float max);
+	// Same numbers without SSE, what the SSE path is tested against
+	void FillUniformScalar(float* out, unsigned int count, float min, float max);
+
+	// Seeds handed to new generators, different for each. Starts from the clock unless set, set it to replay effects
+	static uint64_t NextSeed();
+	static void SetSeedSequence(uint64_t sequenceSeed);
+};
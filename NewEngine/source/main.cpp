@@ -38,18 +38,18 @@ int main()
     Manager::light.lights[0].extraParam.w = 1.f; // turn on
 
     // Position
-    std::shared_ptr<cFloatAnimation> lightPosAnim = std::make_shared<cFloatAnimation>(Manager::light.lights[0].position.z);
-    lightPosAnim->AddKeyFrame(sKeyFrameFloat(60.f, -17.f));
-    lightPosAnim->speed = 5.f;
-    lightPosAnim->isRepeat = true;
+    cFloatAnimation lightPosAnim(Manager::light.lights[0].position.z);
+    lightPosAnim.AddKeyFrame(sKeyFrameFloat(60.f, -17.f));
+    lightPosAnim.speed = 5.f;
+    lightPosAnim.isRepeat = true;
     //Manager::animation.AddAnimation(lightPosAnim);
 
     // Color
-    std::shared_ptr<cVec4Animation> lightColorAnim = std::make_shared<cVec4Animation>(Manager::light.lights[0].diffuse);
-    lightColorAnim->AddKeyFrame(sKeyFrameVec4(30.f, glm::vec4(1.f, 1.f, 1.f, 1.f)));
-    lightColorAnim->AddKeyFrame(sKeyFrameVec4(60.f, glm::vec4(0.12f, 0.22f, 0.5f, 1.f)));
-    lightColorAnim->speed = 5.f;
-    lightColorAnim->isRepeat = true;
+    cVec4Animation lightColorAnim(Manager::light.lights[0].diffuse);
+    lightColorAnim.AddKeyFrame(sKeyFrameVec4(30.f, glm::vec4(1.f, 1.f, 1.f, 1.f)));
+    lightColorAnim.AddKeyFrame(sKeyFrameVec4(60.f, glm::vec4(0.12f, 0.22f, 0.5f, 1.f)));
+    lightColorAnim.speed = 5.f;
+    lightColorAnim.isRepeat = true;
     //Manager::animation.AddAnimation(lightColorAnim);
 
     Manager::animation.InitializeAnimationsPresets();
@@ -0,0 +1,197 @@
+// The GPU particle scenario through ParticleUpdateVertShader.glsl itself, on Mesa's llvmpipe. A surfaceless EGL
+// context needs no window or display, so this runs on a headless machine. See the Makefile
+#include "Tests.h"
+#include "GpuParticleScenario.h"
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace Tests
+{
+	static unsigned int checksNum = 0;
+	static unsigned int failuresNum = 0;
+
+	void Check(bool condition, const char* expression, const char* file, int line)
+	{
+		checksNum++;
+		if (condition) return;
+
+		failuresNum++;
+		printf("%s(%d): check failed: %s\n", file, line, expression);
+	}
+}
+
+namespace
+{
+	// Same layout as cParticleSpawner's ping-pong buffers
+	GLuint program = 0;
+	GLuint buffers[2] = { 0, 0 };
+	GLuint VAOs[2] = { 0, 0 };
+	unsigned int currentBuffer = 0;
+
+	bool CreateContext()
+	{
+		EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) return false;
+		if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+		EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLConfig config;
+		EGLint configsNum = 0;
+		eglChooseConfig(display, configAttributes, &config, 1, &configsNum);
+
+		EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE };
+		EGLContext context = eglCreateContext(display, configsNum ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+		if (context == EGL_NO_CONTEXT) return false;
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return false;
+
+		return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+	}
+
+	bool CreateProgram(const std::string& shaderPath)
+	{
+		std::ifstream file(shaderPath);
+		if (!file.is_open())
+		{
+			printf("Could not open %s\n", shaderPath.c_str());
+			return false;
+		}
+		std::stringstream source;
+		source << file.rdbuf();
+		std::string sourceText = source.str();
+		const char* sourcePtr = sourceText.c_str();
+
+		GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(shader, 1, &sourcePtr, NULL);
+		glCompileShader(shader);
+
+		GLint isCompiled = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+		if (!isCompiled)
+		{
+			char log[2048];
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			printf("%s\n", log);
+			return false;
+		}
+
+		// Same varyings cRenderManager sets before linking the particleUpdate program
+		program = glCreateProgram();
+		glAttachShader(program, shader);
+		const char* varyings[] = { "outPositionTimer", "outVelocity" };
+		glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+		glLinkProgram(program);
+		glDeleteShader(shader);
+
+		GLint isLinked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+		return isLinked != 0;
+	}
+
+	void CreateBuffers(unsigned int maxParticles)
+	{
+		// Every slot starts dead, a negative timer
+		std::vector<sGpuParticleSlot> initialData(maxParticles);
+		for (unsigned int i = 0; i < maxParticles; i++)
+		{
+			initialData[i].positionTimer = glm::vec4(0.f, 0.f, 0.f, -1.f);
+			initialData[i].velocity = glm::vec4(0.f);
+		}
+
+		glGenBuffers(2, buffers);
+		glGenVertexArrays(2, VAOs);
+		for (unsigned int i = 0; i < 2; i++)
+		{
+			glBindVertexArray(VAOs[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(sGpuParticleSlot) * maxParticles, &initialData[0], GL_STREAM_COPY);
+
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(sGpuParticleSlot), (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(sGpuParticleSlot), (void*)sizeof(glm::vec4));
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// Surfaceless has no default framebuffer and draws need a complete one, even with nothing rasterized
+		GLuint framebuffer, renderbuffer;
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(1, &renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 4, 4);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+	}
+
+	// The particles stay in the GPU buffers between updates like they do in the engine, the slots only get a copy
+	bool UpdateWithShader(const sGpuParticleUpdate& update, std::vector<sGpuParticleSlot>& slotsInOut)
+	{
+		if (buffers[0] == 0) CreateBuffers(update.particlesMax);
+
+		glUseProgram(program);
+		glUniform1f(glGetUniformLocation(program, "deltaTime"), update.deltaTime);
+		glUniform1f(glGetUniformLocation(program, "lifeTime"), update.lifeTime);
+		glUniform3fv(glGetUniformLocation(program, "gravity"), 1, &update.gravity.x);
+		glUniform1i(glGetUniformLocation(program, "spawnSlot"), (int)update.spawnSlot);
+		glUniform1i(glGetUniformLocation(program, "spawnsNum"), (int)update.spawnsNum);
+		glUniform1i(glGetUniformLocation(program, "spawnSerial"), (int)update.spawnSerial);
+		glUniform1i(glGetUniformLocation(program, "particlesMax"), (int)update.particlesMax);
+		glUniform1i(glGetUniformLocation(program, "seed"), (int)update.seed);
+		glUniform3fv(glGetUniformLocation(program, "positionMin"), 1, &update.positionMin.x);
+		glUniform3fv(glGetUniformLocation(program, "positionMax"), 1, &update.positionMax.x);
+		glUniform3fv(glGetUniformLocation(program, "speedMin"), 1, &update.speedMin.x);
+		glUniform3fv(glGetUniformLocation(program, "speedMax"), 1, &update.speedMax.x);
+
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindVertexArray(VAOs[currentBuffer]);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - currentBuffer]);
+
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, update.particlesMax);
+		glEndTransformFeedback();
+
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindVertexArray(0);
+		glDisable(GL_RASTERIZER_DISCARD);
+
+		currentBuffer = 1 - currentBuffer;
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[currentBuffer]);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sGpuParticleSlot) * slotsInOut.size(), &slotsInOut[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		GLenum error = glGetError();
+		if (error != GL_NO_ERROR) printf("GL error 0x%x\n", error);
+		return error == GL_NO_ERROR;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string shaderPath = argc > 1 ? argv[1] : "../../NewEngine/assets/shaders/ParticleUpdateVertShader.glsl";
+
+	if (!CreateContext())
+	{
+		printf("Could not create a surfaceless OpenGL 3.3 context\n");
+		return 2;
+	}
+	printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	if (!CreateProgram(shaderPath)) return 2;
+
+	Tests::RunGpuParticleScenario(UpdateWithShader);
+
+	printf("%u checks, %u failed\n", Tests::checksNum, Tests::failuresNum);
+	return Tests::failuresNum == 0 ? 0 : 1;
+}
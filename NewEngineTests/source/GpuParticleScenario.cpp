@@ -0,0 +1,131 @@
+#include "GpuParticleScenario.h"
+#include "Tests.h"
+
+#include <deque>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+	const unsigned int MAX_PARTICLES = 500;
+	const float LIFE_TIME = 1.5f;
+	const float PARTICLE_RADIUS = 0.1f;
+	const unsigned int FRAMES_NUM = 600;
+	const unsigned int SPAWNING_FRAMES_NUM = 400;
+	const glm::vec3 GRAVITY = glm::vec3(0.3f, -4.f, 0.f);
+	const glm::vec3 SPAWN_SPEED = glm::vec3(1.f, 2.f, -0.5f);
+	const glm::vec3 MIN_SPEED_OFFSET = glm::vec3(-1.f, -1.f, -2.f);
+	const glm::vec3 MAX_SPEED_OFFSET = glm::vec3(1.f, 3.f, 2.f);
+	const glm::vec3 MIN_POSITION_OFFSET = glm::vec3(-5.f, 0.f, -5.f);
+	const glm::vec3 MAX_POSITION_OFFSET = glm::vec3(5.f, 2.f, 5.f);
+
+	// Rounding in the Euler steps, far below anything the bounds are used for
+	const float BOUNDS_TOLERANCE = 0.001f;
+
+	// Small xorshift so the pattern doesn't depend on the C library's rand
+	struct sPatternGenerator
+	{
+		uint32_t state;
+
+		unsigned int Next(unsigned int max)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (state >> 8) % max;
+		}
+	};
+
+	bool IsInside(const glm::vec3& position, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		return glm::all(glm::greaterThanEqual(position, boundsMin - glm::vec3(BOUNDS_TOLERANCE))) &&
+			glm::all(glm::lessThanEqual(position, boundsMax + glm::vec3(BOUNDS_TOLERANCE)));
+	}
+}
+
+namespace Tests
+{
+	void RunGpuParticleScenario(GpuParticleUpdateFunction update)
+	{
+		std::vector<sGpuParticleSlot> slots(MAX_PARTICLES);
+		for (unsigned int i = 0; i < MAX_PARTICLES; i++)
+		{
+			slots[i].positionTimer = glm::vec4(0.f, 0.f, 0.f, -1.f);
+			slots[i].velocity = glm::vec4(0.f);
+		}
+
+		glm::vec3 travelMin, travelMax;
+		ParticleKernels::GetGpuTravelBounds(SPAWN_SPEED + MIN_SPEED_OFFSET, SPAWN_SPEED + MAX_SPEED_OFFSET, GRAVITY, LIFE_TIME, travelMin, travelMax);
+
+		std::deque<sGpuSpawnBatch> batches;
+		sPatternGenerator pattern = { 7 };
+		unsigned int spawnsTotal = 0;
+		unsigned int mostAliveNum = 0;
+		unsigned int outsideWindowNum = 0;
+		unsigned int outsideBoundsNum = 0;
+		for (unsigned int frame = 0; frame < FRAMES_NUM; frame++)
+		{
+			float deltaTime = 1.f / 60.f + pattern.Next(100) * 0.0002f;
+
+			// A few a frame, then a burst that wraps the ring several times over
+			unsigned int spawnsNum = frame < SPAWNING_FRAMES_NUM ? pattern.Next(12) : 0;
+			if (frame > 150 && frame < 200) spawnsNum = 30;
+
+			// Following a player that walks along x and swings along z
+			glm::vec3 origin = glm::vec3(frame * 0.05f, 1.f, std::sin(frame * 0.1f) * 3.f);
+
+			sGpuParticleUpdate newUpdate;
+			newUpdate.deltaTime = deltaTime;
+			newUpdate.lifeTime = LIFE_TIME;
+			newUpdate.gravity = GRAVITY;
+			newUpdate.spawnSlot = spawnsTotal % MAX_PARTICLES;
+			newUpdate.spawnsNum = spawnsNum;
+			newUpdate.spawnSerial = spawnsTotal;
+			newUpdate.particlesMax = MAX_PARTICLES;
+			newUpdate.seed = 12345;
+			newUpdate.positionMin = origin + MIN_POSITION_OFFSET;
+			newUpdate.positionMax = origin + MAX_POSITION_OFFSET;
+			newUpdate.speedMin = SPAWN_SPEED + MIN_SPEED_OFFSET;
+			newUpdate.speedMax = SPAWN_SPEED + MAX_SPEED_OFFSET;
+			bool isUpdated = update(newUpdate, slots);
+			TEST_CHECK(isUpdated);
+			if (!isUpdated) return;
+			spawnsTotal += spawnsNum;
+
+			// Same calls and the same bounds cParticleSpawner::UpdateGpu makes
+			glm::vec3 originMin, originMax;
+			unsigned int liveNum = ParticleKernels::TrackGpuSpawns(batches, deltaTime, LIFE_TIME, spawnsNum, origin, MAX_PARTICLES, originMin, originMax);
+			unsigned int firstLiveSlot = ParticleKernels::GetGpuFirstLiveSlot(spawnsTotal, liveNum, MAX_PARTICLES);
+			glm::vec3 boundsMin = originMin + MIN_POSITION_OFFSET + travelMin - glm::vec3(PARTICLE_RADIUS);
+			glm::vec3 boundsMax = originMax + MAX_POSITION_OFFSET + travelMax + glm::vec3(PARTICLE_RADIUS);
+
+			TEST_CHECK(liveNum <= MAX_PARTICLES);
+
+			unsigned int aliveNum = 0;
+			for (unsigned int slot = 0; slot < MAX_PARTICLES; slot++)
+			{
+				if (slots[slot].positionTimer.w < 0.f) continue;
+				aliveNum++;
+
+				unsigned int windowIndex = (slot + MAX_PARTICLES - firstLiveSlot) % MAX_PARTICLES;
+				if (windowIndex >= liveNum) outsideWindowNum++;
+				if (!IsInside(glm::vec3(slots[slot].positionTimer), boundsMin, boundsMax)) outsideBoundsNum++;
+			}
+			if (aliveNum > mostAliveNum) mostAliveNum = aliveNum;
+
+			if (frame == FRAMES_NUM - 1)
+			{
+				TEST_CHECK(aliveNum == 0);
+				TEST_CHECK(liveNum == 0);
+			}
+		}
+
+		if (outsideWindowNum != 0 || outsideBoundsNum != 0)
+			printf("GPU particles: %u live slots outside the window, %u outside the bounds\n", outsideWindowNum, outsideBoundsNum);
+
+		TEST_CHECK(outsideWindowNum == 0);
+		TEST_CHECK(outsideBoundsNum == 0);
+		TEST_CHECK(mostAliveNum == MAX_PARTICLES); // the burst really did fill the ring
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "ParticleKernels.h"
+
+#include <vector>
+
+// One ring slot the way ParticleUpdateVertShader.glsl reads and writes it. A negative timer is a dead slot
+struct sGpuParticleSlot
+{
+	glm::vec4 positionTimer;
+	glm::vec4 velocity;
+};
+
+// The uniforms cParticleSpawner::UpdateGpu sets for one update
+struct sGpuParticleUpdate
+{
+	float deltaTime;
+	float lifeTime;
+	glm::vec3 gravity;
+	unsigned int spawnSlot;
+	unsigned int spawnsNum;
+	unsigned int spawnSerial;
+	unsigned int particlesMax;
+	unsigned int seed;
+	glm::vec3 positionMin;
+	glm::vec3 positionMax;
+	glm::vec3 speedMin;
+	glm::vec3 speedMax;
+};
+
+namespace Tests
+{
+	// Runs one update over every slot. False when it couldn't, which ends the scenario
+	typedef bool (*GpuParticleUpdateFunction)(const sGpuParticleUpdate& update, std::vector<sGpuParticleSlot>& slotsInOut);
+
+	// A moving, player relative spawner that overflows its ring for a while and then stops spawning. After every
+	// update the slots are checked against what the spawner keeps instead of reading them back: every live slot has
+	// to be inside the live window and the bounds, and once everything died the window has to be empty
+	void RunGpuParticleScenario(GpuParticleUpdateFunction update);
+}
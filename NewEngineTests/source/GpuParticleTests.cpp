@@ -0,0 +1,79 @@
+#include "Tests.h"
+
+#include "GpuParticleScenario.h"
+
+#include <cstdint>
+
+namespace
+{
+	uint32_t Hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	float Random(uint32_t& state)
+	{
+		state = Hash(state);
+		return (float)(state >> 8) * (1.f / 16777216.f);
+	}
+
+	// ParticleUpdateVertShader.glsl line by line, for the machines that can't run it. The llvmpipe harness in gpu/
+	// runs the same scenario through the shader itself
+	bool UpdateLikeShader(const sGpuParticleUpdate& update, std::vector<sGpuParticleSlot>& slotsInOut)
+	{
+		for (unsigned int vertexId = 0; vertexId < slotsInOut.size(); vertexId++)
+		{
+			glm::vec3 position = glm::vec3(slotsInOut[vertexId].positionTimer);
+			float timer = slotsInOut[vertexId].positionTimer.w;
+			glm::vec3 velocity = glm::vec3(slotsInOut[vertexId].velocity);
+
+			int spawnIndex = ((int)vertexId - (int)update.spawnSlot + (int)update.particlesMax) % (int)update.particlesMax;
+			if (spawnIndex < (int)update.spawnsNum)
+			{
+				uint32_t state = Hash(update.seed ^ Hash(update.spawnSerial + spawnIndex));
+				float x = Random(state);
+				float y = Random(state);
+				float z = Random(state);
+				position = glm::mix(update.positionMin, update.positionMax, glm::vec3(x, y, z));
+				x = Random(state);
+				y = Random(state);
+				z = Random(state);
+				velocity = glm::mix(update.speedMin, update.speedMax, glm::vec3(x, y, z));
+				timer = 0.f;
+			}
+
+			if (timer >= 0.f)
+			{
+				timer += update.deltaTime;
+
+				if (timer > update.lifeTime)
+				{
+					timer = -1.f;
+				}
+				else
+				{
+					position += velocity * update.deltaTime;
+					velocity += update.gravity * update.deltaTime;
+				}
+			}
+
+			slotsInOut[vertexId].positionTimer = glm::vec4(position, timer);
+			slotsInOut[vertexId].velocity = glm::vec4(velocity, 0.f);
+		}
+
+		return true;
+	}
+}
+
+namespace Tests
+{
+	void GpuParticleBookkeeping()
+	{
+		RunGpuParticleScenario(UpdateLikeShader);
+	}
+}
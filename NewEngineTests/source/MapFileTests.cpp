@@ -0,0 +1,87 @@
+#include "Tests.h"
+
+#include "cMapFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* TEST_MAP_PATH = "MapFileTests.pdsmap";
+
+	// One quadrant laid out like the editor writes them, every layer present. The first layer's cells all get
+	// tileId and height, the rest are empty
+	void WriteTestMap(int tileId, int height)
+	{
+		std::ofstream pdsmap(TEST_MAP_PATH);
+		pdsmap << "mapstart 2 -3 areaindex 0\n";
+
+		for (unsigned int layerId = 0; layerId < MAP_LAYERS_NUM; layerId++)
+		{
+			pdsmap << "tilegrid\n";
+			for (unsigned int i = 0; i < MAP_QUADRANT_SIZE * MAP_QUADRANT_SIZE; i++)
+			{
+				pdsmap << (layerId == 0 ? tileId : -1) << " ";
+			}
+			pdsmap << "\n";
+		}
+
+		for (unsigned int layerId = 0; layerId < MAP_LAYERS_NUM; layerId++)
+		{
+			pdsmap << "heightgrid\n";
+			for (unsigned int i = 0; i < MAP_QUADRANT_SIZE * MAP_QUADRANT_SIZE; i++)
+			{
+				pdsmap << (layerId == 0 ? height : 0) << " ";
+			}
+			pdsmap << "\n";
+		}
+
+		pdsmap << "mapend\n";
+	}
+
+	bool ParseTestMap(int tileId, int height, std::vector<sMapGridQuadrant>& quadsOut)
+	{
+		WriteTestMap(tileId, height);
+		bool isParsed = MapFile::ParseText(TEST_MAP_PATH, quadsOut);
+		remove(TEST_MAP_PATH);
+
+		return isParsed;
+	}
+}
+
+namespace Tests
+{
+	void MapFileParsing()
+	{
+		// Values at the edges of the ranges make it through as they are
+		{
+			std::vector<sMapGridQuadrant> quads;
+			TEST_CHECK(ParseTestMap(32767, MAP_MIN_HEIGHT, quads));
+			TEST_CHECK(quads.size() == 1);
+			if (quads.size() == 1)
+			{
+				TEST_CHECK(quads[0].posX == 2 && quads[0].posZ == -3);
+				TEST_CHECK(quads[0].layersNum == MAP_LAYERS_NUM);
+				TEST_CHECK(quads[0].tiles[0][MAP_QUADRANT_SIZE - 1][MAP_QUADRANT_SIZE - 1] == 32767);
+				TEST_CHECK(quads[0].tiles[1][0][0] == -1);
+				TEST_CHECK(quads[0].heights[0][MAP_QUADRANT_SIZE - 1][MAP_QUADRANT_SIZE - 1] == MAP_MIN_HEIGHT);
+				TEST_CHECK(quads[0].heights[1][0][0] == 0);
+			}
+
+			quads.clear();
+			TEST_CHECK(ParseTestMap(-1, MAP_MAX_HEIGHT, quads));
+		}
+
+		// Anything that would wrap when narrowed is rejected instead of compiled
+		{
+			std::vector<sMapGridQuadrant> quads;
+			TEST_CHECK(!ParseTestMap(32768, 0, quads));
+			TEST_CHECK(!ParseTestMap(-32769, 0, quads));
+			TEST_CHECK(!ParseTestMap(5, MAP_MAX_HEIGHT + 1, quads));
+			TEST_CHECK(!ParseTestMap(5, MAP_MIN_HEIGHT - 1, quads));
+			TEST_CHECK(!ParseTestMap(5, 200, quads));
+		}
+	}
+}
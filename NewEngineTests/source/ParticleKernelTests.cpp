@@ -0,0 +1,218 @@
+#include "Tests.h"
+
+#include "ParticleKernels.h"
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include <cstdio>
+#include <limits>
+
+namespace
+{
+	const unsigned int COMPONENTS_NUM = 7; // position xyz, velocity xyz, timer
+	const float DELTA_TIME = 1.f / 60.f;
+	const float LIFE_TIME = 1.f;
+	const glm::vec3 GRAVITY = glm::vec3(0.5f, -9.8f, 0.f);
+
+	// Component major, particlesNum floats each
+	struct sParticleSet
+	{
+		unsigned int particlesNum;
+		std::vector<float> values;
+
+		float& At(unsigned int component, unsigned int particle) { return values[component * particlesNum + particle]; }
+	};
+
+	struct sKernelRun
+	{
+		unsigned int aliveNum;
+		std::vector<float> values; // live part of each array, component major
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// Same layout the spawners use: aligned arrays padded to a whole kernel group
+	sKernelRun RunKernel(ParticleKernels::eKernel kernel, const sParticleSet& set, unsigned int framesNum)
+	{
+		unsigned int arrayStride = (set.particlesNum + PARTICLE_KERNEL_WIDTH - 1) / PARTICLE_KERNEL_WIDTH * PARTICLE_KERNEL_WIDTH;
+		std::vector<float> storage(arrayStride * COMPONENTS_NUM + PARTICLE_ARRAY_ALIGNMENT / sizeof(float), 0.f);
+		uintptr_t storageAddress = (uintptr_t)&storage[0];
+		float* base = (float*)((storageAddress + PARTICLE_ARRAY_ALIGNMENT - 1) & ~(uintptr_t)(PARTICLE_ARRAY_ALIGNMENT - 1));
+
+		float** arrays[COMPONENTS_NUM];
+		sParticleArrays particles;
+		arrays[0] = &particles.positionsX;
+		arrays[1] = &particles.positionsY;
+		arrays[2] = &particles.positionsZ;
+		arrays[3] = &particles.velocitiesX;
+		arrays[4] = &particles.velocitiesY;
+		arrays[5] = &particles.velocitiesZ;
+		arrays[6] = &particles.timers;
+		for (unsigned int component = 0; component < COMPONENTS_NUM; component++)
+		{
+			*arrays[component] = base + arrayStride * component;
+			if (set.particlesNum != 0)
+				memcpy(*arrays[component], &set.values[component * set.particlesNum], sizeof(float) * set.particlesNum);
+		}
+
+		ParticleKernels::KernelFunction integrate = ParticleKernels::GetKernelFunction(kernel);
+
+		sKernelRun run;
+		run.aliveNum = set.particlesNum;
+		for (unsigned int frame = 0; frame < framesNum; frame++)
+		{
+			run.boundsMin = glm::vec3(FLT_MAX);
+			run.boundsMax = glm::vec3(-FLT_MAX);
+			run.aliveNum = integrate(particles, run.aliveNum, DELTA_TIME, GRAVITY, LIFE_TIME, run.boundsMin, run.boundsMax);
+		}
+
+		// Past aliveNum the arrays are scratch
+		for (unsigned int component = 0; component < COMPONENTS_NUM; component++)
+		{
+			run.values.insert(run.values.end(), *arrays[component], *arrays[component] + run.aliveNum);
+		}
+
+		return run;
+	}
+
+	// Every SIMD kernel this CPU runs against the scalar one. The particle arrays have to match bit for bit.
+	// The bounds are compared as values, a min over +0 and -0 may keep either sign depending on the order
+	void CheckKernelsMatch(const char* caseName, const sParticleSet& set, unsigned int framesNum)
+	{
+		sKernelRun scalar = RunKernel(ParticleKernels::SCALAR_KERNEL, set, framesNum);
+
+		for (unsigned int kernel = ParticleKernels::SCALAR_KERNEL + 1; kernel < ParticleKernels::KERNELS_NUM; kernel++)
+		{
+			if (!ParticleKernels::IsKernelSupported((ParticleKernels::eKernel)kernel))
+			{
+				printf("%s: %s not supported here, skipped\n", caseName, ParticleKernels::GetKernelName((ParticleKernels::eKernel)kernel));
+				continue;
+			}
+
+			sKernelRun simd = RunKernel((ParticleKernels::eKernel)kernel, set, framesNum);
+
+			bool isSameCount = simd.aliveNum == scalar.aliveNum;
+			bool isSameBits = isSameCount && (scalar.values.empty() || memcmp(&simd.values[0], &scalar.values[0], sizeof(float) * scalar.values.size()) == 0);
+			bool isSameBounds = simd.boundsMin == scalar.boundsMin && simd.boundsMax == scalar.boundsMax;
+			if (!isSameCount || !isSameBits || !isSameBounds)
+				printf("%s: %s differs from scalar\n", caseName, ParticleKernels::GetKernelName((ParticleKernels::eKernel)kernel));
+
+			TEST_CHECK(isSameCount);
+			TEST_CHECK(isSameBits);
+			TEST_CHECK(isSameBounds);
+		}
+	}
+
+	// Small xorshift so the data doesn't depend on the C library's rand
+	struct sDataGenerator
+	{
+		uint32_t state;
+
+		float Next(float min, float max)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return min + (float)(state >> 8) / 16777216.f * (max - min);
+		}
+	};
+
+	sParticleSet MakeRandomSet(unsigned int particlesNum, uint32_t seed)
+	{
+		sDataGenerator generator = { seed };
+
+		sParticleSet set;
+		set.particlesNum = particlesNum;
+		set.values.resize(particlesNum * COMPONENTS_NUM);
+		for (unsigned int i = 0; i < particlesNum; i++)
+		{
+			for (unsigned int component = 0; component < 6; component++)
+			{
+				set.At(component, i) = generator.Next(-20.f, 20.f);
+			}
+			set.At(6, i) = generator.Next(0.f, LIFE_TIME); // ages spread over the life time, some die every frame
+		}
+
+		return set;
+	}
+}
+
+namespace Tests
+{
+	void ParticleKernels()
+	{
+		// Long runs until most die, sizes off the group width so the scalar tail runs too
+		CheckKernelsMatch("random 1000", MakeRandomSet(1000, 1), 90);
+		CheckKernelsMatch("random 100003", MakeRandomSet(100003, 2), 70);
+
+		// Every size around the group widths, including nothing at all
+		for (unsigned int particlesNum = 0; particlesNum <= 3 * PARTICLE_KERNEL_WIDTH; particlesNum++)
+		{
+			CheckKernelsMatch("small sizes", MakeRandomSet(particlesNum, 100 + particlesNum), 80);
+		}
+
+		// One group of 8 for every alive mask, so every compaction pattern happens in a single frame
+		{
+			sParticleSet set = MakeRandomSet(256 * 8, 3);
+			for (unsigned int mask = 0; mask < 256; mask++)
+			{
+				for (unsigned int lane = 0; lane < 8; lane++)
+				{
+					set.At(6, mask * 8 + lane) = (mask & (1 << lane)) ? 0.f : LIFE_TIME;
+				}
+			}
+			CheckKernelsMatch("every alive mask", set, 1);
+			CheckKernelsMatch("every alive mask, run out", set, 70);
+		}
+
+		// Everything dies on the first frame
+		{
+			sParticleSet set = MakeRandomSet(203, 4);
+			for (unsigned int i = 0; i < set.particlesNum; i++)
+			{
+				set.At(6, i) = LIFE_TIME + 1.f;
+			}
+			CheckKernelsMatch("all dead", set, 1);
+		}
+
+		// Timers right at the end of the life time. timer == lifeTime stays alive in every kernel
+		{
+			sParticleSet set = MakeRandomSet(64, 5);
+			for (unsigned int i = 0; i < set.particlesNum; i++)
+			{
+				set.At(6, i) = (i % 2) ? LIFE_TIME - DELTA_TIME : LIFE_TIME - DELTA_TIME * 0.5f;
+			}
+			CheckKernelsMatch("life time edge", set, 1);
+		}
+
+		// NaN and infinity. A NaN timer never compares greater than the life time, so it stays alive.
+		// NaN positions must not reach the bounds, which are built with glm::min/max semantics
+		{
+			const float nan = std::numeric_limits<float>::quiet_NaN();
+			const float infinity = std::numeric_limits<float>::infinity();
+
+			sParticleSet set = MakeRandomSet(77, 6);
+			for (unsigned int i = 0; i < set.particlesNum; i += 3)
+			{
+				set.At(6, i) = nan;
+			}
+			for (unsigned int i = 1; i < set.particlesNum; i += 5)
+			{
+				set.At(i % 3, i) = nan;
+			}
+			for (unsigned int i = 2; i < set.particlesNum; i += 7)
+			{
+				set.At(3 + i % 3, i) = nan;
+			}
+			set.At(0, 4) = infinity;
+			set.At(1, 8) = -infinity;
+			set.At(6, 10) = -infinity;
+			set.At(6, 12) = infinity;
+
+			CheckKernelsMatch("NaN and infinity", set, 1);
+			CheckKernelsMatch("NaN and infinity, run out", set, 70);
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Headless checks for the engine code that has to give exact results. No window or GL context, the post build step
+// runs the executable and a failed check fails the build
+namespace Tests
+{
+	void Check(bool condition, const char* expression, const char* file, int line);
+
+	void GpuParticleBookkeeping();
+	void MapFileParsing();
+	void ParticleKernels();
+	void XoshiroGenerator();
+}
+
+#define TEST_CHECK(condition) Tests::Check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,107 @@
+#include "Tests.h"
+
+#include "cXoshiroGenerator.h"
+
+#include <vector>
+#include <cstring>
+
+namespace
+{
+	bool IsSameBits(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], sizeof(float) * a.size()) == 0);
+	}
+
+	// Counts around the lane width so the partial last group is covered, called back to back like the spawners do
+	std::vector<float> DrawSequence(cXoshiroGenerator& generator, bool useScalar)
+	{
+		const unsigned int counts[] = { 1, 7, 8, 9, 16, 3, 1000, 0, 5 };
+
+		std::vector<float> draws;
+		for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+		{
+			std::vector<float> batch(counts[i]);
+			if (batch.empty()) continue;
+
+			if (useScalar) generator.FillUniformScalar(&batch[0], counts[i], -3.f, 5.f);
+			else generator.FillUniform(&batch[0], counts[i], -3.f, 5.f);
+			draws.insert(draws.end(), batch.begin(), batch.end());
+		}
+
+		return draws;
+	}
+}
+
+namespace Tests
+{
+	void XoshiroGenerator()
+	{
+		// Same seed, same sequence
+		{
+			cXoshiroGenerator first(1234);
+			cXoshiroGenerator second(5678);
+			second.Seed(1234);
+			TEST_CHECK(second.GetSeed() == 1234);
+			TEST_CHECK(IsSameBits(DrawSequence(first, false), DrawSequence(second, false)));
+
+			first.Seed(1234);
+			std::vector<float> replay = DrawSequence(first, false);
+			first.Seed(1234);
+			TEST_CHECK(IsSameBits(replay, DrawSequence(first, false)));
+
+			cXoshiroGenerator other(1235);
+			TEST_CHECK(!IsSameBits(replay, DrawSequence(other, false)));
+		}
+
+		// SSE lanes and the scalar lanes give the same numbers and leave the same state behind
+		for (uint64_t seed = 0; seed < 64; seed++)
+		{
+			cXoshiroGenerator sse(seed);
+			cXoshiroGenerator scalar(seed);
+			TEST_CHECK(IsSameBits(DrawSequence(sse, false), DrawSequence(scalar, true)));
+			TEST_CHECK(IsSameBits(DrawSequence(sse, false), DrawSequence(scalar, true)));
+		}
+
+		// The seed sequence replays too
+		{
+			cXoshiroGenerator::SetSeedSequence(42);
+			uint64_t firstSeeds[3] = { cXoshiroGenerator::NextSeed(), cXoshiroGenerator::NextSeed(), cXoshiroGenerator::NextSeed() };
+			cXoshiroGenerator::SetSeedSequence(42);
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				TEST_CHECK(cXoshiroGenerator::NextSeed() == firstSeeds[i]);
+			}
+			TEST_CHECK(firstSeeds[0] != firstSeeds[1] && firstSeeds[1] != firstSeeds[2]);
+		}
+
+		// Never max. Around 101 a float step is 2^-17, so min + unit * range rounds up to max for
+		// every unit above 1 - 2^-18, about 16 times in this many draws
+		{
+			const unsigned int drawsNum = 1 << 22;
+			std::vector<float> draws(drawsNum);
+			cXoshiroGenerator sse(99);
+			cXoshiroGenerator scalar(99);
+
+			sse.FillUniform(&draws[0], drawsNum, 100.f, 101.f);
+			bool isInRange = true;
+			for (unsigned int i = 0; i < drawsNum; i++)
+			{
+				isInRange = isInRange && draws[i] >= 100.f && draws[i] < 101.f;
+			}
+			TEST_CHECK(isInRange);
+
+			scalar.FillUniformScalar(&draws[0], drawsNum, 100.f, 101.f);
+			isInRange = true;
+			for (unsigned int i = 0; i < drawsNum; i++)
+			{
+				isInRange = isInRange && draws[i] >= 100.f && draws[i] < 101.f;
+			}
+			TEST_CHECK(isInRange);
+
+			// An empty range gives min
+			float value = 1.f;
+			sse.FillUniform(&value, 1, 7.f, 7.f);
+			TEST_CHECK(value == 7.f);
+		}
+	}
+}
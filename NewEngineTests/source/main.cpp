@@ -0,0 +1,29 @@
+#include "Tests.h"
+
+#include <cstdio>
+
+namespace Tests
+{
+	static unsigned int checksNum = 0;
+	static unsigned int failuresNum = 0;
+
+	void Check(bool condition, const char* expression, const char* file, int line)
+	{
+		checksNum++;
+		if (condition) return;
+
+		failuresNum++;
+		printf("%s(%d): check failed: %s\n", file, line, expression);
+	}
+}
+
+int main()
+{
+	Tests::GpuParticleBookkeeping();
+	Tests::MapFileParsing();
+	Tests::ParticleKernels();
+	Tests::XoshiroGenerator();
+
+	printf("%u checks, %u failed\n", Tests::checksNum, Tests::failuresNum);
+	return Tests::failuresNum == 0 ? 0 : 1;
+}